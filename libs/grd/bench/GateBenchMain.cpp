@@ -0,0 +1,105 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        GateBenchMain.cpp
+// Project:     grdLib
+// Purpose:     Command line runner for gate benchmark.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+// Usage:
+//   grd_gate_bench protocol=<p> server=<addr> client=<addr> [sizes=100,1000]
+//     [round_trips=n] [messages=n] [timeout=ms] [format=csv|json] [out=file]
+//     [<gate-param>=<value> ...]
+// Example:
+//   grd_gate_bench protocol=tcpx server=127.0.0.1:5600 client=127.0.0.1:5601 format=json
+
+#include <iostream>
+#include <fstream>
+
+#include "grd/GateBench.h"
+
+static void parseSizes(const scString &text, grdGateBenchSizeList &output)
+{
+  scString::size_type start = 0, pos;
+  output.clear();
+  do {
+    pos = text.find(',', start);
+    scString item = text.substr(start, (pos == scString::npos)?scString::npos:(pos - start));
+    if (!item.empty())
+      output.push_back(stringToUInt(item));
+    start = pos + 1;
+  } while(pos != scString::npos);
+}
+
+int main(int argc, char* argv[])
+{
+  grdGateBench bench;
+  scDataNode gateParams(ict_parent);
+  scString format("csv"), outPath;
+
+  for(int i=1; i < argc; i++)
+  {
+    scString arg(argv[i]);
+    scString::size_type pos = arg.find('=');
+    if (pos == scString::npos) {
+      std::cerr << "Wrong argument: " << arg << std::endl;
+      return 1;
+    }
+
+    scString name = arg.substr(0, pos);
+    scString value = arg.substr(pos + 1);
+
+    if (name == "protocol")
+      bench.setProtocol(value);
+    else if (name == "server")
+      bench.setServerAddress(value);
+    else if (name == "client")
+      bench.setClientAddress(value);
+    else if (name == "sizes") {
+      grdGateBenchSizeList sizes;
+      parseSizes(value, sizes);
+      bench.setPayloadSizes(sizes);
+    }
+    else if (name == "round_trips")
+      bench.setRoundTrips(stringToUInt(value));
+    else if (name == "messages")
+      bench.setMessageCount(stringToUInt(value));
+    else if (name == "timeout")
+      bench.setTimeout(stringToUInt(value));
+    else if (name == "format")
+      format = value;
+    else if (name == "out")
+      outPath = value;
+    else
+      gateParams.addChild(name, new scDataNode(value));
+  }
+
+  bench.setGateParams(gateParams);
+
+  scDataNode results;
+  scString text;
+
+  try {
+    bench.run(results);
+  }
+  catch(const std::exception &e) {
+    std::cerr << "Benchmark failed: " << e.what() << std::endl;
+    return 2;
+  }
+
+  if (format == "json")
+    grdGateBench::formatJson(results, text);
+  else
+    grdGateBench::formatCsv(results, text);
+
+  if (outPath.empty()) {
+    std::cout << text << std::endl;
+  } else {
+    std::ofstream out(outPath.c_str());
+    out << text << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,87 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        AdaptiveLimit.h
+// Project:     grdLib
+// Purpose:     Concurrency limit adjusted to response times (AIMD).
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GRDADAPTIVELIMIT_H__
+#define _GRDADAPTIVELIMIT_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file AdaptiveLimit.h
+///
+/// Limit of messages in progress, used by squeue reader:
+/// - +1 per fast response until first overload (slow start), later +1 per limit responses
+/// - * 0.75 when response time > 2 * base response time + 5 ms
+/// - * 0.5 on timeout, transmit error or overflow
+/// - decrease happens at most once per limit responses
+/// Base is the lowest response time. Lowest time of each 1000 responses 
+/// moves it up partially, so target which became slower is followed, but 
+/// slow responses under load do not raise it at once.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//sc
+#include "sc/dtypes.h"
+//perf
+#include "perf/time_utils.h"
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+const double GRD_SQUEUE_ADAPT_LATENCY_FACTOR = 2.0; ///< response time above base * factor + slack means overload
+const cpu_ticks GRD_SQUEUE_ADAPT_LATENCY_SLACK = 5; ///< ms, ignores jitter of very fast responses
+const double GRD_SQUEUE_ADAPT_LATENCY_DECREASE = 0.75; ///< limit multiplier on slow response
+const double GRD_SQUEUE_ADAPT_ERROR_DECREASE = 0.5; ///< limit multiplier on timeout / overflow / transmit error
+const uint GRD_SQUEUE_ADAPT_BASE_RESET = 1000; ///< base response time is measured again after this number of responses
+const double GRD_SQUEUE_ADAPT_BASE_DECAY = 0.25; ///< part of distance to higher minimum of last window by which base grows
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+class grdAdaptiveLimit {
+public:
+  // construction
+  grdAdaptiveLimit();
+  virtual ~grdAdaptiveLimit() {}
+  // properties
+  uint getLimit() const;
+  uint getMinLimit() const;
+  uint getMaxLimit() const;
+  bool isSlowStart() const;
+  cpu_ticks getBaseResponseTime() const;
+  // run
+  /// starts with slow start from <startLimit> (0 - <minLimit>), base is measured again
+  void start(uint minLimit, uint maxLimit, uint startLimit);
+  /// new starting point, state is kept
+  void setLimit(uint value);
+  /// successful response, returns <true> if limit was decreased
+  bool handleSuccess(cpu_ticks respTime);
+  /// timeout, overflow or transmit error, returns <true> if limit was decreased
+  bool handleOverload();
+  /// error caused by message, not by load - limit is not changed
+  void handleFailure();
+protected:
+  void updateBase(cpu_ticks respTime);
+  bool decrease(double factor);
+  void apply();
+protected:
+  uint m_limitMin;
+  uint m_limitMax;
+  double m_window; ///< current limit, fractional part collects additive increase
+  bool m_slowStart; ///< <true> until first overload
+  uint m_sinceDecrease; ///< responses since last decrease
+  cpu_ticks m_baseResponseTime; ///< lowest response time observed, grows slowly to follow slower target
+  bool m_baseValid;
+  cpu_ticks m_baseWindowMin; ///< lowest response time in current window
+  uint m_baseCount; ///< responses in current window
+};
+
+#endif // _GRDADAPTIVELIMIT_H__
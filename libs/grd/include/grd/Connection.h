@@ -49,6 +49,7 @@ public:
   virtual ~scConnection();
   // properties
   void setInactTimeout(uint msecs);
+  ulong64 getLastUsedTime() const;
   // exec
   virtual void close() = 0;
   virtual bool isConnected() = 0;  
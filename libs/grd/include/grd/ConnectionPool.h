@@ -23,6 +23,10 @@ Long description
 // ----------------------------------------------------------------------------
 // Headers
 // ----------------------------------------------------------------------------
+// std
+#include <map>
+#include <set>
+
 // boost
 #include "boost/ptr_container/ptr_map.hpp"
 
@@ -34,6 +38,23 @@ Long description
 // ----------------------------------------------------------------------------
 typedef boost::ptr_map<scString,scConnection> scConnectionMap;
 
+/// Per-peer counters & reconnect state, kept also when connection is closed
+struct scConnectionPeerInfo {
+  scConnectionPeerInfo(): msgCount(0), byteCount(0), recvMsgCount(0), recvByteCount(0),
+    errorCount(0), lastLatency(0), lastSendTime(0), failCount(0), nextRetryTime(0) {}
+  ulong64 msgCount;      ///< sent
+  ulong64 byteCount;     ///< sent
+  ulong64 recvMsgCount;  ///< replies received
+  ulong64 recvByteCount; ///< replies received
+  ulong64 errorCount;
+  uint lastLatency;     ///< ms between last send and next receive
+  ulong64 lastSendTime;
+  uint failCount;       ///< number of failures in a row
+  ulong64 nextRetryTime; ///< connection not allowed before this time
+};
+
+typedef std::map<scString,scConnectionPeerInfo> scConnectionPeerMap;
+
 // ----------------------------------------------------------------------------
 // Forward class definitions
 // ----------------------------------------------------------------------------
@@ -41,16 +62,42 @@ typedef boost::ptr_map<scString,scConnection> scConnectionMap;
 // ----------------------------------------------------------------------------
 // Constants
 // ----------------------------------------------------------------------------
+const uint SC_CONN_POOL_DEF_MAX_SIZE = 512;
+const uint SC_CONN_POOL_DEF_BACKOFF_MIN = 100;   // ms
+const uint SC_CONN_POOL_DEF_BACKOFF_MAX = 30000; // ms
+/// max number of peers with statistics (inactive peers are removed first)
+const uint SC_CONN_POOL_MAX_PEER_INFO = 1024;
 
 // ----------------------------------------------------------------------------
 // Class definitions
 // ----------------------------------------------------------------------------
 
+/// Connection pool with LRU size limit, reconnect back-off & per-peer stats
 class scConnectionPool {
 public:
+  scConnectionPool();
+  // properties
+  void setMaxSize(uint value);
+  void setBackoff(uint minDelay, uint maxDelay);
+  uint size() const;
+  // exec
   void add(const scString &connectionId, scConnection *item);
   scConnection *find(const scString &connectionId);
+  void remove(const scString &connectionId);
   void checkActive();
+  void clear();
+  /// pinned connection is not evicted by size limit, used while messages
+  /// for it are collected in a batch (pool can temporarily exceed limit)
+  void pin(const scString &connectionId);
+  void unpinAll();
+  // reconnect back-off
+  bool canConnect(const scString &connectionId);
+  void signalFailure(const scString &connectionId);
+  // stats
+  void signalSent(const scString &connectionId, ulong64 byteCount, uint msgCount = 1);
+  /// reply received from peer, counted separately from sent traffic
+  void signalReceived(const scString &connectionId, ulong64 byteCount, uint msgCount = 1);
+  void getStats(scDataNode &output) const;
   template<typename T>
   void forEach(T functor) {
     for(scConnectionMap::iterator it = m_connections.begin(), epos = m_connections.end(); it != epos; ++it)
@@ -58,8 +105,17 @@ public:
       functor(it->second);
     }
   }
+protected:
+  bool evictLeastUsed();
+  scConnectionPeerInfo &preparePeerInfo(const scString &connectionId);
+  void prunePeerInfo();
 protected:
   scConnectionMap m_connections;    
+  scConnectionPeerMap m_peers;
+  std::set<scString> m_pinned;
+  uint m_maxSize;
+  uint m_backoffMin;
+  uint m_backoffMax;
 };
 
 
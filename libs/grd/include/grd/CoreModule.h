@@ -23,6 +23,9 @@
 // ----------------------------------------------------------------------------
 // Headers
 // ----------------------------------------------------------------------------
+// std
+#include <set>
+
 // bost
 #include <boost/shared_ptr.hpp>
 #include "boost/ptr_container/ptr_map.hpp"
@@ -41,6 +44,8 @@
 // Simple type definitions
 // ----------------------------------------------------------------------------
 typedef boost::ptr_map<scString, scGateFactory> scGateFactoryColn;
+/// (address, command) notified on peer_down
+typedef std::set<std::pair<scString, scString> > scPeerWatcherSet;
 
 // ----------------------------------------------------------------------------
 // Forward class definitions
@@ -113,6 +118,9 @@ public:
 /// + sleep (time-ms) - sleep for specified milliseconds
 /// - add_gate(input|output, protocol, extra-param-list) - adds gate to active scheduler for a given protocol
 /// - forward(address, fwd_command, (fwd_params|fwd_params_json)) - send message to address
+/// - watch_peers(command[, address]) - "command" will be sent to address (default: this node)
+///   with params of each peer_down
+/// - peer_down(address, protocol, host, reason) - peer lost by transport, sent by gates
 /// - set_option name,value
 ///   - changes option, possible options:
 ///     "show_processing_time" - true/false - shows how long message was processed
@@ -164,6 +172,8 @@ protected:
     int handleCmdAddGate(scMessage *message, scResponse &response);
     int handleCmdSetOption(scMessage *message, scResponse &response);
     int handleCmdRegMap(scMessage *message, scResponse &response);
+    int handleCmdWatchPeers(scMessage *message, scResponse &response);
+    int handleCmdPeerDown(scMessage *message, scResponse &response);
     // supporting functions
     bool setOption(const scString &optionName, const scString &optionValue);
     void setOption(scSchedulerFeature option, bool newValue);
@@ -173,6 +183,7 @@ protected:
     scNoParamFunctor *m_onRestart;
     scGateFactoryColn m_gateFactoryColn;
     boost::shared_ptr<dtp::dnSerializer> m_serializer;
+    scPeerWatcherSet m_peerWatchers;
 };
 
 
@@ -0,0 +1,159 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        EnvSerializerBinDict.h
+// Project:     grdLib
+// Purpose:     Binary envelope serializer with field-name dictionaries
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef _ENVSERIALIZERBINDICT_H__
+#define _ENVSERIALIZERBINDICT_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file EnvSerializerBinDict.h
+///
+/// Compact binary serializer for envelopes.
+/// Field names, command names and addresses are sent inline only once per
+/// dictionary session, after that they are referenced by small integers.
+///
+/// One serializer object should be used per outgoing connection (one encoding
+/// dictionary). On input side one object can decode frames from many senders,
+/// each sender is recognized by session ID stored in frame header.
+///
+/// Frame layout:
+///   magic(1) version(1) session-id(vuint) flags(vuint) envelope
+/// Dictionary reference (vuint):
+///   0     - new entry, followed by string, receives next free id
+///   1     - literal string (dictionary full), not stored
+///   2+id  - reference to existing entry
+///
+/// Decoder accepts session only from frame that starts dictionary. Frame of 
+/// unknown session (receiver restarted, session evicted) or with unknown 
+/// entry is rejected, session is then forgotten and can be requested by 
+/// gate (takeResyncSession) to be sent back to sender as resync request 
+/// frame (flags = resync, no envelope). Sender starts new dictionary 
+/// in handleResyncRequest. Without back channel encoder still starts 
+/// new dictionary after GRD_BINDICT_RESYNC_INTERVAL frames.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//std
+#include <map>
+#include <vector>
+//sc
+#include "sc/dtypes.h"
+//grd
+#include "grd/core.h"
+#include "grd/Envelope.h"
+
+// ----------------------------------------------------------------------------
+// Simple type definitions
+// ----------------------------------------------------------------------------
+typedef std::map<scString, uint> grdBinDictEncodeMap;
+typedef std::vector<scString> grdBinDictDecodeList;
+
+/// decoding dictionary of one sender session
+struct grdBinDictSession {
+  grdBinDictSession(): lastUsed(0) {}
+  grdBinDictDecodeList dict;
+  ulong64 lastUsed; ///< value of use counter, for LRU eviction
+};
+
+typedef std::map<ulong64, grdBinDictSession> grdBinDictSessionMap;
+
+// ----------------------------------------------------------------------------
+// Forward class definitions
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+const unsigned char GRD_BINDICT_MAGIC = 0xB1;
+const unsigned char GRD_BINDICT_VERSION = 1;
+/// max number of entries in one dictionary
+const uint GRD_BINDICT_MAX_ENTRIES = 4096;
+/// max number of sender sessions remembered by decoder
+const uint GRD_BINDICT_MAX_SESSIONS = 256;
+/// number of frames after which encoder starts a new dictionary
+/// (recovers receivers that were restarted during session)
+const uint GRD_BINDICT_RESYNC_INTERVAL = 1000;
+/// max nesting level of decoded params
+const uint GRD_BINDICT_MAX_DEPTH = 64;
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// scEnvSerializerBinDict
+// ----------------------------------------------------------------------------
+class scEnvSerializerBinDict: public scEnvelopeSerializerBase {
+public:
+  scEnvSerializerBinDict();
+  virtual ~scEnvSerializerBinDict() {};
+  virtual int convToString(const scEnvelope& input, scString &output);
+  virtual int convFromString(const scString &input, scEnvelope& output);
+  int convFromBuffer(const char *data, size_t dataSize, scEnvelope& output);
+  /// returns <true> if buffer contains binary frame
+  static bool isBinaryFrame(const char *data, size_t dataSize);
+  /// returns <true> if buffer contains resync request, sessionId = session to be restarted
+  static bool isResyncRequest(const char *data, size_t dataSize, ulong64 &sessionId);
+  static void makeResyncRequest(ulong64 sessionId, scString &output);
+  /// encoder: starts new dictionary if request is for current session
+  bool handleResyncRequest(ulong64 sessionId);
+  /// decoder: returns <true> if last frame was rejected because of unknown 
+  /// session or entry, sessionId = session which needs resync
+  bool takeResyncSession(ulong64 &sessionId);
+  /// forget encoding dictionary, next frame will start a new session
+  void resetDictionary();
+  /// undo dictionary changes of last encoded frame - to be used when
+  /// frame was not sent (too long, rejected), keeps receiver in sync
+  void rollbackFrame();
+  /// if <true>, each frame carries its own dictionary (for receivers
+  /// that can join at any time, like 0MQ subscribers)
+  void setSelfContained(bool value);
+protected:
+  void startSession();
+  static ulong64 newSessionId();
+  void signalResyncNeeded(ulong64 sessionId);
+  // --- encoding
+  static void writeByte(unsigned char value, scString &output);
+  static void writeVarUInt(ulong64 value, scString &output);
+  static void writeVarInt(long64 value, scString &output);
+  static void writeDouble(double value, scString &output);
+  static void writeRawString(const scString &value, scString &output);
+  void writeDictString(const scString &value, scString &output);
+  void writeDataNode(const scDataNode &value, scString &output);
+  void writeValue(const scDataNode &value, scString &output);
+  // --- decoding
+  static unsigned char readByte(const char *&cursor, const char *end);
+  static ulong64 readVarUInt(const char *&cursor, const char *end);
+  static long64 readVarInt(const char *&cursor, const char *end);
+  static double readDouble(const char *&cursor, const char *end);
+  static void readRawString(const char *&cursor, const char *end, scString &output);
+  void readDictString(const char *&cursor, const char *end, grdBinDictDecodeList &dict, scString &output);
+  void readDataNode(const char *&cursor, const char *end, grdBinDictDecodeList &dict, scDataNode &output, uint depth = 0);
+  void readValue(unsigned char valueType, const char *&cursor, const char *end, scDataNode &output);
+  grdBinDictDecodeList &prepareDecodeDict(ulong64 sessionId, bool newDict);
+  void evictLeastUsedSession();
+protected:
+  ulong64 m_sessionId;
+  uint m_frameCount;
+  bool m_selfContained;
+  grdBinDictEncodeMap m_encodeDict;
+  std::vector<scString> m_frameNewEntries; ///< entries added by last frame
+  bool m_frameNewDict;                     ///< last frame started dictionary
+  grdBinDictSessionMap m_decodeSessions;
+  ulong64 m_decodeUseCounter;
+  ulong64 m_decodeSessionId;   ///< session of frame being decoded
+  bool m_resyncNeeded;         ///< last frame rejected, see takeResyncSession
+  ulong64 m_resyncSessionId;
+};
+
+
+#endif // _ENVSERIALIZERBINDICT_H__
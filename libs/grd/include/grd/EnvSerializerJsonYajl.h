@@ -52,6 +52,9 @@ public:
   virtual ~scEnvSerializerJsonYajl() {};
   virtual int convToString(const scEnvelope& input, scString &output);  
   virtual int convFromString(const scString &input, scEnvelope& output);  
+  /// encodes message params, convToString keeps result in 
+  /// scMessage::getEncodedParams cache (if message has one)
+  static void encodeParams(const scDataNode &params, scString &output);
 protected:
   int convDataNodeToEnvelope(const scDataNode &input, scEnvelope& output);
 };
@@ -47,6 +47,11 @@ Long description
 // ----------------------------------------------------------------------------
 // Constants
 // ----------------------------------------------------------------------------
+// envelope priority, selects gate lane
+const uint SC_ENV_PRIORITY_AUTO = 0;        // lane selected by command
+const uint SC_ENV_PRIORITY_CONTROL = 1;     // keep-alives, stop requests
+const uint SC_ENV_PRIORITY_INTERACTIVE = 2;
+const uint SC_ENV_PRIORITY_BULK = 3;        // large data transfers
 
 // ----------------------------------------------------------------------------
 // Class definitions
@@ -73,12 +78,15 @@ public:
     void setEvent(scEvent *a_event);
     void setTimeout(uint a_timeout);
     uint getTimeout() const;
+    void setPriority(uint a_priority);
+    uint getPriority() const;
     void clear();
 protected:
     scEvent* m_event;
     scMessageAddress m_sender;
     scMessageAddress m_receiver;
     uint m_timeout; ///< in ms
+    uint m_priority;
 };
 
 // ----------------------------------------------------------------------------
@@ -0,0 +1,111 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        GateBench.h
+// Project:     grdLib
+// Purpose:     Benchmark of message gates (latency, throughput, CPU usage).
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GRDGATEBENCH_H__
+#define _GRDGATEBENCH_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file GateBench.h
+///
+/// Builds two compact server nodes in one process (client & server),
+/// connects them with gates created by registered gate factory (add_gate)
+/// and measures for each payload size:
+/// - round-trip latency percentiles (core.echo request & response)
+/// - one-way throughput (messages without response, last one confirmed)
+/// - process CPU time per message (both nodes)
+/// Results can be written as CSV or JSON.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+#include <vector>
+
+#include "sc/dtypes.h"
+#include "grd/core.h"
+#include "grd/MessageAddress.h"
+
+// ----------------------------------------------------------------------------
+// Simple type definitions
+// ----------------------------------------------------------------------------
+typedef std::vector<uint> grdGateBenchSizeList;
+
+// ----------------------------------------------------------------------------
+// Forward class definitions
+// ----------------------------------------------------------------------------
+class grdCompactServer;
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+const uint GRD_GATE_BENCH_DEF_ROUND_TRIPS = 1000;
+const uint GRD_GATE_BENCH_DEF_MESSAGES = 10000;
+const ulong64 GRD_GATE_BENCH_DEF_BYTE_LIMIT = ulong64(256)*1024*1024; // per test
+const uint GRD_GATE_BENCH_DEF_TIMEOUT = 30000; // ms
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+class grdGateBench {
+public:
+  // construction
+  grdGateBench();
+  virtual ~grdGateBench();
+  // properties
+  void setProtocol(const scString &protocol);
+  /// addresses of input gates (positional param of add_gate)
+  void setServerAddress(const scString &address);
+  void setClientAddress(const scString &address);
+  /// named params added to each add_gate request
+  void setGateParams(const scDataNode &params);
+  void setPayloadSizes(const grdGateBenchSizeList &sizes);
+  void setRoundTrips(uint value);
+  void setMessageCount(uint value);
+  /// limits number of messages for large payloads
+  void setByteLimit(ulong64 value);
+  void setTimeout(uint value);
+  // execution
+  /// performs benchmark, output: list of result rows, one per payload size
+  void run(scDataNode &output);
+  static void formatCsv(const scDataNode &results, scString &output);
+  static void formatJson(const scDataNode &results, scString &output);
+  // callbacks
+  void handleReply(ulong64 startTime, bool success);
+protected:
+  void initNodes();
+  void addGate(grdCompactServer &node, bool input, const scString &address);
+  void stepNodes();
+  void waitForReplies(uint expected);
+  void runSize(uint payloadSize, scDataNode &output);
+  void measureLatency(const scString &payload, uint count, scDataNode &output);
+  void measureThroughput(const scString &payload, uint count, scDataNode &output);
+  void postEcho(const scString &payload, bool waitForReply);
+  uint calcCount(uint defCount, uint payloadSize, uint factor);
+protected:
+  scString m_protocol;
+  scString m_serverAddress;
+  scString m_clientAddress;
+  scDataNode m_gateParams;
+  grdGateBenchSizeList m_sizes;
+  uint m_roundTrips;
+  uint m_messageCount;
+  ulong64 m_byteLimit;
+  uint m_timeout;
+  std::auto_ptr<grdCompactServer> m_server;
+  std::auto_ptr<grdCompactServer> m_client;
+  scMessageAddress m_target;
+  std::vector<ulong64> m_latencies; // us
+  uint m_replyCount;
+  uint m_errorCount;
+};
+
+
+#endif // _GRDGATEBENCH_H__
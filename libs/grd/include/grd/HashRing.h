@@ -0,0 +1,71 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        HashRing.h
+// Project:     grdLib
+// Purpose:     Consistent hash ring assigning keys to named nodes.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GRDHASHRING_H__
+#define _GRDHASHRING_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file HashRing.h
+///
+/// Each node is placed on ring <pointsPerNode> times, key is owned by node
+/// of the first point at or after hash of key. Adding or removing a node
+/// moves only keys of this node.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//std
+#include <map>
+#include <set>
+//sc
+#include "sc/dtypes.h"
+
+// ----------------------------------------------------------------------------
+// Simple type definitions
+// ----------------------------------------------------------------------------
+typedef std::set<scString> grdHashRingNodeSet;
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+const uint GRD_HASH_RING_DEF_POINTS = 100;
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+class grdHashRing {
+  typedef std::map<uint, scString> grdHashRingPointMap;
+public:
+  // construction
+  grdHashRing(uint pointsPerNode = GRD_HASH_RING_DEF_POINTS);
+  virtual ~grdHashRing() {}
+  // properties
+  bool empty() const;
+  /// number of points (nodes * points per node, without collisions)
+  size_t size() const;
+  // run
+  void addNode(const scString &name);
+  void clear();
+  /// returns node owning key, empty string if ring is empty
+  scString findOwner(const scString &key) const;
+  /// returns first node after owner which is not in <skip>, owner if all nodes are skipped
+  scString findOwner(const scString &key, const grdHashRingNodeSet &skip) const;
+  /// FNV-1a
+  static uint calcHash(const scString &value);
+protected:
+  grdHashRingPointMap::const_iterator findPoint(const scString &key) const;
+protected:
+  grdHashRingPointMap m_points;
+  uint m_pointsPerNode;
+};
+
+#endif // _GRDHASHRING_H__
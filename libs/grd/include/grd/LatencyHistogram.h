@@ -0,0 +1,79 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        LatencyHistogram.h
+// Project:     grdLib
+// Purpose:     Fixed-size histogram of time values (ms) with log2 buckets.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GRDLATENCYHISTOGRAM_H__
+#define _GRDLATENCYHISTOGRAM_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file LatencyHistogram.h
+///
+/// Histogram used for queue wait & response times. Adding a value is O(1)
+/// and does not allocate memory, so it can be done for every message.
+/// Bucket 0 counts values below 1 ms, bucket <n> values in [2^(n-1), 2^n) ms,
+/// last bucket counts all bigger values.
+/// Percentiles are estimated as upper limit of bucket.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//sc
+#include "sc/dtypes.h"
+#include "sc/DataNode.h"
+//perf
+#include "perf/time_utils.h"
+
+// ----------------------------------------------------------------------------
+// Simple type definitions
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Forward class definitions
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+const uint GRD_LATENCY_HIST_BUCKETS = 32; ///< last limit: 2^31 ms
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+class grdLatencyHistogram {
+public:
+  // construction
+  grdLatencyHistogram();
+  virtual ~grdLatencyHistogram() {}
+  // run
+  /// adds one value in ms
+  void add(cpu_ticks value);
+  /// adds all values from other histogram
+  void add(const grdLatencyHistogram &other);
+  void clear();
+  // properties
+  ulong64 getCount() const;
+  cpu_ticks getMax() const;
+  double getAvg() const;
+  /// returns upper limit of bucket containing given percentile (0-100)
+  cpu_ticks getPercentile(double percent) const;
+  /// output: count, avg, max, p50, p90, p99, buckets (list of le, count - only not empty)
+  void getStats(scDataNode &output) const;
+protected:
+  static uint getBucketIndex(cpu_ticks value);
+  static cpu_ticks getBucketLimit(uint index);
+protected:
+  ulong64 m_buckets[GRD_LATENCY_HIST_BUCKETS];
+  ulong64 m_count;
+  ulong64 m_sum;
+  cpu_ticks m_max;
+};
+
+#endif // _GRDLATENCYHISTOGRAM_H__
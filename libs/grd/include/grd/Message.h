@@ -23,6 +23,12 @@ Long description
 // ----------------------------------------------------------------------------
 // Headers
 // ----------------------------------------------------------------------------
+// std
+#include <map>
+
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/mutex.hpp"
+
 #include "sc/dtypes.h"
 #include "grd/Event.h"
 
@@ -42,6 +48,26 @@ Long description
 // Class definitions
 // ----------------------------------------------------------------------------
 
+// ----------------------------------------------------------------------------
+// scEncodedParams
+// ----------------------------------------------------------------------------
+/// Params encoded by serializers, one value per format, filled by first 
+/// serializer which needs it - gates can encode in own threads
+class scEncodedParams {
+public:
+    scEncodedParams() {}
+    virtual ~scEncodedParams() {}
+    /// returns SC_NULL if params were not encoded in this format yet
+    const scString *find(const scString &format) const;
+    /// returns stored value (first one if other thread stored it before)
+    const scString &add(const scString &format, const scString &value);
+protected:
+    mutable boost::mutex m_mutex;
+    std::map<scString, scString> m_items;
+};
+
+typedef boost::shared_ptr<scEncodedParams> scEncodedParamsRef;
+
 // ----------------------------------------------------------------------------
 // scMessage
 // ----------------------------------------------------------------------------
@@ -63,17 +89,25 @@ public:
     scString getCoreCommand() const;
     /// returns interface from command name (for commands like "interface.command")
     scString getInterface() const;
+    /// params can be changed, so encoded params are not used anymore
     scDataNode &getParams();
+    const scDataNode &getParams() const;
     virtual void clear();
     void setCommand(const scString &a_command);
     void setParams(const scDataNode &a_params);
     bool hasParams() const;
     bool hasRequestId() const;
+    /// cache of encoded params, shared by all copies of message 
+    /// (e.g. multicast to many readers), reset by setParams, clear &
+    /// non-const getParams
+    const scEncodedParamsRef &getEncodedParams() const;
+    void setEncodedParams(const scEncodedParamsRef &value);
 protected:
     void copyFrom(const scMessage& rhs);
 protected:
     scString m_command;
     scDataNode m_params;
+    scEncodedParamsRef m_encodedParams;
 };
 
 
@@ -23,6 +23,10 @@ Long description
 // ----------------------------------------------------------------------------
 // Headers
 // ----------------------------------------------------------------------------
+// std
+#include <deque>
+#include <map>
+
 #include "sc/dtypes.h"
 #include "grd/Envelope.h"
 #include "grd/Scheduler.h"
@@ -30,6 +34,17 @@ Long description
 // ----------------------------------------------------------------------------
 // Simple type definitions
 // ----------------------------------------------------------------------------
+/// arrival number & sender/receiver pair of envelope waiting in lane,
+/// peerKey is empty for envelopes which are not ordered (explicit control)
+struct scGateLaneEntry {
+  scGateLaneEntry(ulong64 a_seq, const scString &a_peerKey): seq(a_seq), peerKey(a_peerKey) {}
+  ulong64 seq;
+  scString peerKey;
+};
+
+typedef std::deque<scGateLaneEntry> scGateLaneEntryList;
+/// arrival numbers of waiting envelopes, per sender/receiver pair
+typedef std::map<scString, std::deque<ulong64> > scGatePeerOrderMap;
 
 // ----------------------------------------------------------------------------
 // Forward class definitions
@@ -38,6 +53,19 @@ Long description
 // ----------------------------------------------------------------------------
 // Constants
 // ----------------------------------------------------------------------------
+// priority lanes of gate, waiting envelopes are returned by get() using
+// weighted round-robin, so control messages are not blocked by bulk data
+// of other peers - envelopes with the same sender & receiver are returned 
+// in order of arrival, except envelopes with explicit priority 
+// SC_ENV_PRIORITY_CONTROL, which overtake earlier envelopes of their pair
+const uint SC_GATE_LANE_CONTROL = 0;
+const uint SC_GATE_LANE_INTERACTIVE = 1;
+const uint SC_GATE_LANE_BULK = 2;
+const uint SC_GATE_LANE_COUNT = 3;
+
+const uint SC_GATE_DEF_WEIGHT_CONTROL = 8;
+const uint SC_GATE_DEF_WEIGHT_INTERACTIVE = 4;
+const uint SC_GATE_DEF_WEIGHT_BULK = 1;
 
 // ----------------------------------------------------------------------------
 // Class definitions
@@ -56,25 +84,44 @@ public:
     void put(scEnvelope* envelope);
     scEnvelope* get();
     bool empty();
+    // -- priority lanes
+    void setLaneWeights(uint controlWeight, uint interactiveWeight, uint bulkWeight);
+    /// returns envelope priority, for SC_ENV_PRIORITY_AUTO - based on command
+    static uint calcPriority(const scEnvelope &envelope);
+    static uint getLaneFor(const scEnvelope &envelope);
     // -- major functions
     virtual bool supportsProtocol(const scString &protocol) = 0;
     virtual bool getOwnAddress(const scString &protocol, scMessageAddress &output);
     // transmit messages
     virtual int run() = 0;
     virtual void init(); 
+    /// fills output with gate-specific statistics, empty if not supported
+    virtual void getStats(scDataNode &output) {}
+    /// called when local node has been registered for a given role
+    virtual void handleRoleRegistered(const scString &roleName) {}
     scSchedulerIntf *getOwner();    
     void setOwner(scSchedulerIntf *a_owner);
 protected:
     scEnvelope *createErrorResponseFor(const scEnvelope &srcEnvelope, const scString &msg, int a_status);
     void handleTransmitError(const scEnvelope &envelope, const scError &e);
     void handleTransmitError(const scEnvelope &envelope, int errorCode, const scString &errorMsg, const scString &details = "");
+    /// reports peer lost by transport (heartbeat / keepalive) as local "core.peer_down" message
+    void signalPeerDown(const scString &protocol, const scString &host, const scString &reason);
     scString getOwnerName();
     virtual void handleMsgReceived(const scEnvelope &envelope);
     virtual void handleMsgReadyForSend(const scEnvelope &envelope);
     virtual void handleMsgSent(const scEnvelope &envelope);
     void addMsgTrace(const scString &eventCode, const scEnvelope &envelope);
 private:
-    scEnvelopeColn m_waiting;           
+    bool canTakeFrom(uint lane);
+    scEnvelope *takeFrom(uint lane);
+private:
+    scEnvelopeColn m_lanes[SC_GATE_LANE_COUNT];
+    scGateLaneEntryList m_laneEntries[SC_GATE_LANE_COUNT]; // in the same order as m_lanes
+    scGatePeerOrderMap m_peerOrder;
+    ulong64 m_putCount;
+    uint m_laneWeights[SC_GATE_LANE_COUNT];
+    uint m_laneCredits[SC_GATE_LANE_COUNT];
     scSchedulerIntf *m_owner; 
 };
 
@@ -58,6 +58,8 @@ public:
     virtual scTaskIntf *prepareTaskForResponse(scResponse *response) = 0;
     virtual scStringList supportedInterfaces() const = 0;
     virtual bool supportsInterface(const scString &name, const scString &version = scString("")) = 0;
+    /// fills output with module-specific statistics, empty if not supported
+    virtual void getStats(scDataNode &output) {}
 };
 
 #endif // _GRDMODULE_H__
\ No newline at end of file
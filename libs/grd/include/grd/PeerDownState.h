@@ -0,0 +1,66 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        PeerDownState.h
+// Project:     grdLib
+// Purpose:     State of peer reported as lost by transport.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GRDPEERDOWNSTATE_H__
+#define _GRDPEERDOWNSTATE_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file PeerDownState.h
+///
+/// Used by squeue reader after "peer_down": reader is paused, peer is
+/// probed periodically (probe message makes gate connect again),
+/// successful probe response or other contact resumes reader,
+/// peer which does not return within grace period is dropped.
+/// Time is passed by caller.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//sc
+#include "sc/dtypes.h"
+//perf
+#include "perf/time_utils.h"
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+class grdPeerDownState {
+public:
+  // construction
+  grdPeerDownState(cpu_ticks grace, cpu_ticks probeInterval);
+  virtual ~grdPeerDownState() {}
+  // properties
+  bool isDown() const;
+  /// <true> if peer is down for grace period or longer
+  bool isExpired(cpu_ticks now) const;
+  /// <true> if next probe should be sent
+  bool isProbeDue(cpu_ticks now) const;
+  int getProbeRequestId() const;
+  // run
+  /// transport lost peer, time of first report is kept
+  void notePeerDown(cpu_ticks now);
+  /// peer answered or sent message - peer is up
+  void noteContact();
+  void noteProbeSent(int requestId, cpu_ticks now);
+  /// returns <true> if response is for last probe (successful one means peer is up)
+  bool handleProbeResponse(int requestId);
+protected:
+  cpu_ticks m_grace;
+  cpu_ticks m_probeInterval;
+  bool m_down;
+  cpu_ticks m_downTime;
+  bool m_probeSent;
+  cpu_ticks m_probeTime;
+  int m_probeRequestId;
+};
+
+#endif // _GRDPEERDOWNSTATE_H__
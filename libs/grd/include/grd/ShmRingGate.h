@@ -0,0 +1,59 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        ShmRingGate.h
+// Project:     grdLib
+// Purpose:     Shared-memory ring buffer gate (same-host, Linux).
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _SHMRINGGATE_H__
+#define _SHMRINGGATE_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file ShmRingGate.h
+///
+/// Gate for nodes running on the same host. Input gate creates POSIX shared
+/// memory segment with a number of single-producer / single-consumer rings,
+/// each output connection claims one ring. Records have variable length.
+/// Fast path (ring not full, receiver not sleeping) does not use syscalls,
+/// futex is used to wake up sleeping receiver thread. Sender never blocks:
+/// envelope which does not fit in ring is kept until next run.
+/// Segment of running receiver is never replaced, segment left by
+/// receiver which ended without close is removed on create.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+#include "sc/dtypes.h"
+#include "grd/core.h"
+#include "grd/GateFactory.h"
+
+// ----------------------------------------------------------------------------
+// Simple type definitions
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Forward class definitions
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+class grdShmGateFactory: public scGateFactory {
+public:
+  grdShmGateFactory();
+  virtual ~grdShmGateFactory();
+  virtual scMessageGate *createGate(bool input, const scDataNode &params, const scString &protocol) const;
+protected:
+};
+
+
+#endif // _SHMRINGGATE_H__
@@ -26,6 +26,11 @@
 #include "grd/TaskImpl.h"
 #include "grd/RequestItem.h"
 #include "grd/ModuleImpl.h"
+#include "grd/SpillLog.h"
+#include "grd/LatencyHistogram.h"
+#include "grd/HashRing.h"
+#include "grd/AdaptiveLimit.h"
+#include "grd/PeerDownState.h"
 
 // ----------------------------------------------------------------------------
 // Simple type definitions
@@ -36,7 +41,9 @@ enum scSmplQueueType {
   sstPull,
   sstMultiCast,
   sstForward,
-  sstHighAvail
+  sstHighAvail,
+  sstLeastLoaded,
+  sstKeyed
 };
 
 // ----------------------------------------------------------------------------
@@ -45,6 +52,7 @@ enum scSmplQueueType {
 class scSmplQueueModule;
 class scSmplQueueManagerTask;
 class scSmplQueueReaderTask;
+class scSmplQueueBatch;
 
 // ----------------------------------------------------------------------------
 // Constants
@@ -55,6 +63,26 @@ const scString GRD_SQUEUE_TYPE_MULTICAST   = "mcast";
 const scString GRD_SQUEUE_TYPE_NULL_DEV    = "null_dev";
 const scString GRD_SQUEUE_TYPE_FORWARD     = "forward";
 const scString GRD_SQUEUE_TYPE_HIGHAVAIL   = "highav";
+const scString GRD_SQUEUE_TYPE_LEAST_LOADED = "least_loaded";
+const scString GRD_SQUEUE_TYPE_KEYED       = "keyed";
+const uint GRD_SQUEUE_KEYED_VNODES = 100; ///< points on hash ring per reader
+const scString GRD_SQUEUE_AGGREGATE_EACH   = "each"; ///< (mcast) how reader responses are returned
+const scString GRD_SQUEUE_AGGREGATE_FIRST  = "first";
+const scString GRD_SQUEUE_AGGREGATE_ALL    = "all";
+const scString GRD_SQUEUE_AGGREGATE_QUORUM = "quorum";
+const double GRD_SQUEUE_RESP_TIME_EWMA_ALPHA = 0.2; ///< weight of last response time in average
+const uint GRD_SQUEUE_MAX_BATCH = 256; ///< max number of messages in one squeue.batch
+const scString GRD_SQUEUE_SPILL_FILE_PREFIX = "squeue_";
+const uint GRD_SQUEUE_MAX_SHARDS = 64;
+const scString GRD_SQUEUE_SHARD_SUFFIX = "#shard"; ///< shard name: <qname>#shard<n>, reserved
+const scString GRD_SQUEUE_SHARD_BY_RR = "rr";
+const scString GRD_SQUEUE_SHARD_BY_SENDER = "sender";
+const uint GRD_SQUEUE_STEAL_LIMIT = 64; ///< max number of messages moved between shards in one run
+const uint GRD_SQUEUE_STATS_STALE_LIMIT = 1024; ///< max number of enqueue times of messages removed without dispatch
+// adaptive reader limit (AIMD)
+const uint GRD_SQUEUE_ADAPT_DEF_MAX = 64; ///< default limit_max, other constants in AdaptiveLimit.h
+const cpu_ticks GRD_SQUEUE_PEER_DOWN_GRACE = 5000; ///< ms, reader at lost peer is stopped if peer does not return in this time
+const cpu_ticks GRD_SQUEUE_PEER_PROBE_INTERVAL = 1000; ///< ms, core.echo sent to lost peer of reader to reconnect
 
 // ----------------------------------------------------------------------------
 // Class definitions
@@ -64,6 +92,8 @@ typedef scReaderList::iterator scReaderListIterator;
 //typedef boost::ptr_list<scSmplQueueManagerTask> scSmplQueueManagerColn;
 typedef std::list<scSmplQueueManagerTask *> scSmplQueueManagerList;
 typedef std::auto_ptr<scTask> scSmplTaskGuard;
+typedef boost::ptr_map<int, scSmplQueueBatch> scSmplQueueBatchMap;
+typedef std::map<scString, cpu_ticks> scSmplQueueEnqueueTimeMap; ///< sender + request ID -> time of put
 
 // ----------------------------------------------------------------------------
 // scSmplQueueManagerTask
@@ -78,37 +108,103 @@ public:
   // properties
   void setLimit(int value);
   int getLimit() const;
+  /// enables overflow to disk: when <highMark> messages are in memory, next ones 
+  /// are appended to segment log and paged back in order when <lowMark> is reached
+  void setSpill(const scString &basePath, uint highMark, uint lowMark, uint segmentSize = GRD_SPILL_DEF_SEGMENT_SIZE);
+  /// number of messages stored on disk
+  size_t getSpilledCount() const;
   // run
   virtual int handleMessage(scEnvelope &envelope, scResponse &response);
   //virtual int handleMessage(scMessage *message, scResponse &response);    
   virtual void addReader(scSmplQueueReaderTask *reader);
-  void removeReader(scSmplQueueReaderTask *reader);
+  virtual void removeReader(scSmplQueueReaderTask *reader);
   virtual void deleteReaders();
   virtual bool get(scEnvelope &a_envelope);
+  /// read next message for a given reader
+  virtual bool getForReader(scSmplQueueReaderTask *reader, scEnvelope &a_envelope);
   virtual void put(const scEnvelope &envelope);  
-  void clearQueue();
+  virtual void clearQueue();
   bool isEmpty() const;
+  /// number of stored messages (ready & delayed)
+  virtual size_t getWaitingCount() const;
   virtual scString getStatus();
   virtual bool needsRun();
-  void getReaderList(scStringList &list);
+  virtual void getReaderList(scStringList &list);
   virtual bool hasMessageForReader(scSmplQueueReaderTask *reader);
-  bool hasReader(const scString &readerTarget);
+  /// called before each next message is taken by reader in one run
+  virtual bool canTakeNext(scSmplQueueReaderTask *reader);
+  virtual bool hasReader(const scString &readerTarget);
+  /// updates capacity of reader(s) with a given target, returns <true> if found
+  virtual bool setReaderLimit(const scString &readerTarget, int limit);
+  /// enables adaptive capacity of reader(s) with a given target, returns <true> if found
+  virtual bool setReaderAdaptiveLimit(const scString &readerTarget, uint minLimit, uint maxLimit);
+  /// disables adaptive capacity of reader(s) with a given target, returns <true> if found
+  virtual bool clearReaderAdaptiveLimit(const scString &readerTarget);
+  size_t getReaderCount() const;
+  /// returns <true> if any reader can accept next message
+  bool hasIdleReader();
+  /// queue to which new reader should be connected
+  virtual scSmplQueueManagerTask *getQueueForReader();
+  /// manager tasks owned by this queue (sharded queue)
+  virtual void getShards(scSmplQueueManagerList &output);
+  /// removes newest message waiting in memory, queue is no longer responsible for it
+  virtual bool releaseWaiting(scEnvelope &output);
+  // statistics
+  /// fills output with depth, counters, wait & response time histograms, per-reader stats
+  virtual void getStats(scDataNode &output);
+  /// message accepted by queue
+  void noteEnqueued(const scEnvelope &envelope);
+  /// message sent to reader
+  void noteDispatched(const scEnvelope &envelope);
+  /// reader received response (or error) after <procTime> ms
+  void noteResponse(cpu_ticks procTime, bool isError);
+  const grdLatencyHistogram &getWaitTimeHistogram() const;
+  const grdLatencyHistogram &getResponseTimeHistogram() const;
+  /// number of messages sent to readers
+  ulong64 getDispatchedCount() const;
+  ulong64 getErrorCount() const;
   bool getAllowSenderAsReader() {return m_allowSenderAsReader;}
   virtual bool handleReaderResponse(
     scSmplQueueReaderTask &reader, const scString &readerTarget, 
     const scEnvelope &envelope, const scResponse &response
   );
   virtual bool markReaderAlive(const scString &readerAddr);
+  /// removes readers located at peer lost by transport, returns number of removed readers
+  virtual uint dropReadersAt(const scMessageAddress &peerAddr);
   virtual void handleEnvelopeAccepted(scSmplQueueReaderTask *reader, const scEnvelope &envelope);
   virtual void handleEnvelopeSent(scSmplQueueReaderTask *reader, const scEnvelope &envelope);
+  /// returns message taken by reader but not accepted by it
+  virtual void putBack(scSmplQueueReaderTask *reader, const scEnvelope &envelope);
 protected:  
   scReaderListIterator findReader(const scString &name);
   scString findNextReaderName(const scString &readerName);
   void disconnectReaders();
+  // spill support
+  bool needsSpill() const;
+  /// writes message with <info> to disk, enqueue time is moved from memory to <info>
+  void spill(const scEnvelope &envelope, grdSpillRecordInfo &info);
+  bool needsPageIn() const;
+  bool readSpilled(scEnvelope &envelope, grdSpillRecordInfo &info);
+  /// moves spilled messages back to m_waiting
+  virtual void pageIn();
+  // statistics support
+  static scString calcEnqueueKey(const scEnvelope &envelope);
+  /// enqueue time of message read from disk is kept in memory again
+  void restoreEnqueueTime(const scEnvelope &envelope, const grdSpillRecordInfo &info);
+  /// removes times of messages which are no longer waiting
+  void purgeEnqueueTimes();
 protected:  
   int m_limit;
   scEnvelopeColn m_waiting;
   scReaderList m_readers;
+  std::auto_ptr<grdSpillLog> m_spill; ///< overflow tier of m_waiting, NULL - disabled
+  uint m_spillHigh;
+  uint m_spillLow;
+  scSmplQueueEnqueueTimeMap m_enqueueTimes;
+  grdLatencyHistogram m_waitTimeHist; ///< enqueue -> dispatch
+  grdLatencyHistogram m_responseTimeHist; ///< dispatch -> response
+  ulong64 m_dispatchedCount;
+  ulong64 m_errorCount;
 private:
   //scString m_lastReaderName;
   bool m_allowSenderAsReader;
@@ -130,6 +226,16 @@ public:
   scString getTarget() const;
   void setLimit(int value);
   int getLimit() const;
+  /// limit is adjusted between <minLimit> and <maxLimit> basing on responses:
+  /// increased by one per window of fast responses (doubled until first overload), 
+  /// decreased on slow response, timeout or overflow
+  void setAdaptiveLimit(uint minLimit, uint maxLimit);
+  /// current limit is kept as fixed one
+  void clearAdaptiveLimit();
+  bool isAdaptiveLimit() const;
+  /// max number of messages forwarded in one squeue.batch, 1 - no batching
+  void setBatchSize(uint value);
+  uint getBatchSize() const;
   //--- task intf ---
   virtual int handleResponse(scMessage *message, scResponse &response); ///< handle processed messages
   virtual int intRun(); ///< check if read can be performed
@@ -138,25 +244,61 @@ public:
   //--- other ---   
   void noteContactEvent();
   cpu_ticks getLastContactTime();
-  bool forwardEnvelope(scEnvelope &envelope);
+  /// transport lost peer of reader, new messages are not forwarded until contact,
+  /// peer is probed with core.echo, response resumes reader
+  void notePeerDown();
+  bool isPeerDown() const;
+  /// keepPayload - <false> if message is kept by queue manager, only reply address is stored
+  bool forwardEnvelope(scEnvelope &envelope, bool keepPayload = true);
+  bool forwardBatch(scEnvelopeColn &envelopes);
   bool acceptEnvelope(const scEnvelope &envelope);
   void sendResponse(const scEnvelope &envelope, const scResponse &response);  
   void cancelRequest(uint requestId, int reasonCode);
+  /// cancels forwarded message (or whole batch) by request ID of message in queue
+  void cancelQueuedRequest(uint queuedRequestId, int reasonCode);
   void cancelAll();
+  //--- load ---
+  uint getInFlightCount() const;
+  /// EWMA of response time in ms, 0 - no response yet
+  double getAvgResponseTime() const;
+  bool isBelowLimit();
+  //--- statistics ---
+  uint getProcessedCount() const;
+  uint getErrorCount() const;
+  /// target, in_flight, capacity, processed, errors, avg_response_time, rate (msg/s)
+  void getStats(scDataNode &output) const;
 protected:
   void addWaitingMsg(scEnvelope &envelope, int requestId);
   bool extractWaitingMsg(int requestId, scRequestItem &foundItem);
-  bool isBelowLimit();
   int handleResponse(uint requestId, scResponse &response);
+  int handleBatchResponse(uint requestId, scResponse &response);
+  /// <respTime> - time of this request (part of batch time for batch item)
+  void processResponse(scRequestItem &requestItem, scResponse &response, cpu_ticks respTime);
+  void noteResponseTime(cpu_ticks value);
+  void adaptLimit(cpu_ticks respTime, const scResponse &response);
   bool isMessageReadyForRead();
+  bool isPeerDownExpired() const;
+  void sendPeerProbe();
+  bool hasFreeSlots(uint pending);
+  int runBatch();
 private:
   scString m_target; ///< target node
   int m_processed; ///< number of processed messages
   int m_limit; ///< limit for messages handled in parallel, 0 - no limit
   scRequestItemMapColn m_waitingRequests; ///< messages sent and waiting to be answered
+  scSmplQueueBatchMap m_waitingBatches; ///< batches sent and waiting to be answered
+  uint m_batchItemCount; ///< number of messages in m_waitingBatches
+  uint m_batchSize;
   scSmplQueueManagerTask *m_queueManager;
   bool m_allowSenderAsReader;
   cpu_ticks m_lastContactTime;
+  grdPeerDownState m_peerDown;
+  double m_avgResponseTime; ///< EWMA in ms, 0 - unknown
+  uint m_errorCount; ///< error responses & cancelled requests
+  cpu_ticks m_createTime;
+  // adaptive limit
+  bool m_adaptive;
+  grdAdaptiveLimit m_adaptiveLimit;
 };
 
 // ----------------------------------------------------------------------------
@@ -166,15 +308,35 @@ private:
 /// Handled commands:
 /// - squeue.init (qname[,limit]) - returns address of initiated queue (responsible task)
 ///                               (creates scSmplQueueManagerTask)
-/// - squeue.listen (qname, target) - creates a task that will forward message to target,
+/// - squeue.listen (qname, target[, capacity]) - creates a task that will forward message to target,
 ///                                 when message is handled, this tasks receives answer and forwards it
-///                                 (scSmplQueueReaderTask)
+///                                 (scSmplQueueReaderTask), capacity - max messages in progress
+///                                 for this reader (default 1, 0 - no limit)
+///                                 named param "batch" - max number of messages forwarded
+///                                 together as one squeue.batch message (default 1)
+/// - squeue.batch (items) - handled on worker side (see scWqWorker::processBatch),
+///                          items: list of {command, params}, result: list of
+///                          {status, result|error} in the same order
+///
+/// Queue of type "keyed" sends messages with the same value of key_path param
+/// to the same reader (consistent hashing over readers).
+///
+/// Queue created with shards=N is served by N manager tasks (<qname>_shard<n>),
+/// queue name still addresses the whole queue.
+///
+/// Queues created with spill_dir & spill_high keep at most spill_high messages in memory,
+/// next ones are stored in memory-mapped segment files (see grdSpillLog).
 /// - squeue.close (qname) - close queue
 /// - squeue.list_readers (qname) - list assigned readers
 /// - squeue.clear (qname) - empty queue
 /// - squeue.get_status (qname) - returns number of msgs in queue, number of readers
+/// - squeue.get_stats ([qname]) - returns structured statistics of queue (all queues if no name)
 /// - squeue.mark_alive(exec_at_addr, queue_name, source_name) - mark sender (source_name) as alive in queue
+/// - squeue.mark_alive_multi(queue_names, source_name) - mark_alive for list of queues, 
+///   returns status for each queue
 /// - squeue.keep_alive(address, queue_name, msg_limit, delay, error_limit)
+/// - squeue.peer_down(address) - pause readers at peer lost by transport (see core.watch_peers),
+///   they are probed and removed if peer does not return in GRD_SQUEUE_PEER_DOWN_GRACE ms
 ///
 /// Note: both reader and manager should be running on the same node.
 class scSmplQueueModule: public scModule {
@@ -187,6 +349,8 @@ public:
   virtual scStringList supportedInterfaces() const;
   virtual int handleMessage(scMessage *message, scResponse &response);
   virtual scTaskIntf *prepareTaskForMessage(scMessage *message);
+  /// statistics of all queues
+  virtual void getStats(scDataNode &output);
   // --- commands ---
   scTask *prepareManager(scMessage *message);
   scTask *prepareReader(scMessage *message);
@@ -198,9 +362,12 @@ protected:
   int handleCmdClose(scMessage *message, scResponse &response);
   int handleCmdClear(scMessage *message, scResponse &response);
   int handleCmdGetStatus(scMessage *message, scResponse &response);   
+  int handleCmdGetStats(scMessage *message, scResponse &response);   
   int handleCmdListReaders(scMessage *message, scResponse &response);
   int handleCmdMarkAlive(scMessage *message, scResponse &response);
+  int handleCmdMarkAliveMulti(scMessage *message, scResponse &response);
   int handleCmdKeepAlive(scMessage *message, scResponse &response);
+  int handleCmdPeerDown(scMessage *message, scResponse &response);
   // --- other ---  
   bool queueExists(const scString &name);
   scSmplQueueManagerTask *createQueue(scSmplQueueType qtype, const scString &name, 
@@ -211,10 +378,16 @@ protected:
   void setUnknownQueueError(const scString &qname, scResponse &response);
   scTask *prepareReader(scSmplQueueManagerTask *queue, const scString &target);
   bool performMarkAlive(const scString &queueName, const scString &srcName);
+  scSmplQueueManagerTask *newQueue(scSmplQueueType qtype, const scString &name, 
+    bool allowSenderAsReader, bool durable, const scDataNode &extraParams);
+  scSmplQueueManagerTask *createShardedQueue(scSmplQueueType qtype, const scString &name, 
+    bool allowSenderAsReader, bool durable, const scDataNode &extraParams);
   scTask *prepareKeepAliveTask(scMessage *message);
   scTask *createKeepAliveTask();
   scTask *getKeepAliveTask();
+  void watchPeers();
 private:
+  bool m_watchingPeers;
   scSmplQueueManagerList m_managers;
   scSmplTaskGuard m_aliveNotifier;
   scTask *m_keepAliveTask;
@@ -0,0 +1,103 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        SpillLog.h
+// Project:     grdLib
+// Purpose:     Memory-mapped segment log for envelopes spilled from memory.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GRDSPILLLOG_H__
+#define _GRDSPILLLOG_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file SpillLog.h
+///
+/// FIFO of envelopes stored in memory-mapped files (segments).
+/// Used as overflow tier of in-memory queues - envelopes are appended to
+/// the last segment and read back from the first one in the same order.
+/// Each record: length(4, big-endian) info payload (binary envelope, self-contained).
+/// Info is queue bookkeeping of envelope (grdSpillRecordInfo, big-endian),
+/// so nothing is kept in memory for spilled envelope.
+/// Segment files are allocated on creation - full disk is reported as 
+/// error of push, not as fault on write to mapped memory.
+/// Segment is deleted when all its records are read. Files are temporary -
+/// log is not recovered after restart.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//boost
+#include "boost/ptr_container/ptr_list.hpp"
+//sc
+#include "sc/dtypes.h"
+//grd
+#include "grd/core.h"
+#include "grd/Envelope.h"
+#include "grd/EnvSerializerBinDict.h"
+
+// ----------------------------------------------------------------------------
+// Simple type definitions
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Forward class definitions
+// ----------------------------------------------------------------------------
+class grdSpillSegment;
+
+typedef boost::ptr_list<grdSpillSegment> grdSpillSegmentList;
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+const uint GRD_SPILL_DEF_SEGMENT_SIZE = 16*1024*1024;
+const uint GRD_SPILL_MIN_SEGMENT_SIZE = 64*1024;
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+/// queue bookkeeping stored together with spilled envelope
+struct grdSpillRecordInfo {
+  grdSpillRecordInfo(): enqueueTime(0), startTime(0), retryCount(0) {}
+  ulong64 enqueueTime; ///< time of put (wait time stats), 0 - not measured
+  ulong64 startTime;   ///< start time of request (store timeout), 0 - not set
+  uint retryCount;
+};
+
+class grdSpillLog {
+public:
+  // construction
+  /// segment files are named <basePath>.<number>.seg
+  grdSpillLog(const scString &basePath, uint segmentSize = GRD_SPILL_DEF_SEGMENT_SIZE);
+  virtual ~grdSpillLog();
+  // properties
+  const scString &getBasePath() const;
+  uint getSegmentSize() const;
+  /// number of stored envelopes
+  size_t size() const;
+  bool empty() const;
+  uint getSegmentCount() const;
+  // run
+  /// throws scError if new segment cannot be allocated (e.g. no space on disk)
+  void push(const scEnvelope &envelope, const grdSpillRecordInfo &info = grdSpillRecordInfo());
+  /// reads oldest envelope, returns <false> if log is empty
+  bool pop(scEnvelope &output);
+  bool pop(scEnvelope &output, grdSpillRecordInfo &info);
+  void clear();
+protected:
+  grdSpillSegment *addSegment(size_t minSize);
+  scString getSegmentPath(uint seqNo) const;
+protected:
+  scString m_basePath;
+  uint m_segmentSize;
+  uint m_nextSeqNo;
+  size_t m_count;
+  grdSpillSegmentList m_segments; ///< front - read, back - write
+  scEnvSerializerBinDict m_serializer;
+  scString m_buffer;
+};
+
+#endif // _GRDSPILLLOG_H__
@@ -0,0 +1,61 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        TcpRawGate.h
+// Project:     grdLib
+// Purpose:     Native TCP gate with length-prefixed framing (Linux).
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _TCPRAWGATE_H__
+#define _TCPRAWGATE_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file TcpRawGate.h
+///
+/// Cross-host transport without 0MQ dependency.
+/// Each message is sent as frame: length(4, big-endian) payload.
+/// Input gate runs server thread using epoll and non-blocking sockets,
+/// output gate keeps connections in pool and writes header & payload of
+/// many messages with one writev call. TCP_NODELAY is set on all sockets.
+/// With keepalive enabled output gate checks idle connections once per second
+/// and reports lost peers as core.peer_down.
+/// Address format: "host:port" or "host-port" (inside message addresses).
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+#include "sc/dtypes.h"
+#include "grd/core.h"
+#include "grd/GateFactory.h"
+
+// ----------------------------------------------------------------------------
+// Simple type definitions
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Forward class definitions
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+const uint GRD_TCPX_DEF_INPUT_QUEUE_LIMIT = 100000;
+const uint GRD_TCPX_MAX_MSG_SIZE = 16*1024*1024;
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+class grdTcpxGateFactory: public scGateFactory {
+public:
+  grdTcpxGateFactory();
+  virtual ~grdTcpxGateFactory();
+  virtual scMessageGate *createGate(bool input, const scDataNode &params, const scString &protocol) const;
+protected:
+};
+
+
+#endif // _TCPRAWGATE_H__
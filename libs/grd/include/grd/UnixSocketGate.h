@@ -0,0 +1,57 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        UnixSocketGate.h
+// Project:     grdLib
+// Purpose:     Unix domain socket gate (Linux).
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _UNIXSOCKETGATE_H__
+#define _UNIXSOCKETGATE_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file UnixSocketGate.h
+///
+/// Local transport for Linux, counterpart of W32 named pipes gates.
+/// Uses SOCK_SEQPACKET sockets (one packet = one message).
+/// Input gate runs server thread which accepts connections and reads
+/// messages in batches (recvmmsg) into a bounded input queue.
+/// Output gate groups messages per connection and sends them with sendmmsg.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+#include "sc/dtypes.h"
+#include "grd/core.h"
+#include "grd/GateFactory.h"
+
+// ----------------------------------------------------------------------------
+// Simple type definitions
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Forward class definitions
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+const uint GRD_UDS_DEF_INPUT_QUEUE_LIMIT = 100000;
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+class grdUdsGateFactory: public scGateFactory {
+public:
+  grdUdsGateFactory();
+  virtual ~grdUdsGateFactory();
+  virtual scMessageGate *createGate(bool input, const scDataNode &params, const scString &protocol) const;
+protected:
+};
+
+
+#endif // _UNIXSOCKETGATE_H__
@@ -48,12 +48,29 @@
 // ----------------------------------------------------------------------------
 // Class definitions
 // ----------------------------------------------------------------------------
+/// Iterator over part of "squeue.batch" message assigned to one worker
+class scWqBatchIterator {
+public:
+  scWqBatchIterator() {}
+  virtual ~scWqBatchIterator() {}
+  /// moves to next item, returns <false> at the end
+  virtual bool next() = 0;
+  virtual const scString &getCommand() const = 0;
+  virtual const scDataNode &getArgs() const = 0;
+  /// output of current item - result or error (depending on status)
+  virtual scDataNode &getOutput() = 0;
+  /// status of current item, SC_MSG_STATUS_OK by default
+  virtual void setStatus(int value) = 0;
+};
+
 class scWqWorker {
 public:
   scWqWorker() {}
   virtual ~scWqWorker() {}
   virtual void getSupportedCommands(scStringList &output) const = 0;
   virtual bool process(const scString &command, const scDataNode &args, scDataNode &output) = 0;
+  /// handles items of batch received from squeue reader, by default calls process() for each one
+  virtual void processBatch(scWqBatchIterator &items);
   virtual void yield() = 0;
 };
 
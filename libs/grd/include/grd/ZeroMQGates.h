@@ -48,6 +48,9 @@ public:
   virtual ~zmContextBase() {}
   static zmContextBase *newContext();
   virtual void clear() {}
+  /// Waits until I/O thread delivers messages or timeout passes.
+  /// Returns <false> (without waiting) if I/O thread is not used.
+  virtual bool waitForIoActivity(uint timeMs) { return false; }
 };
 
 class zmGateFactory: public scGateFactory {
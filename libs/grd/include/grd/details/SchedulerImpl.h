@@ -156,6 +156,8 @@ public:
     virtual void run();
     virtual bool needsRun();
     void getStats(int &taskCnt, int &moduleCnt, int &gateCnt);    
+    void getGateStats(scDataNode &output);
+    void getModuleStats(scDataNode &output);
     virtual int getNextRequestId();
     virtual void requestStop();
     int dispatchMessage(const scMessage &message, scResponse &response);
@@ -228,6 +230,7 @@ protected:
           const scDataNode *params, int requestId, scRequestHandler *handler);
     bool isSameProtocol(const scString &protocol1, const scString &protocol2);
     void registerNodeAtDirectory(const scString &srcAddr, const scString &targetAddr, cpu_ticks shareTime = 0);
+    void notifyGatesRoleRegistered(const scString &roleName);
 protected:    
     //void notifyObserversMsgArrived(const scMessage &message);
     void notifyObserversEnvArrived(const scEnvelope &envelope);
@@ -0,0 +1,143 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        AdaptiveLimit.cpp
+// Project:     grdLib
+// Purpose:     Concurrency limit adjusted to response times (AIMD).
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//grd
+#include "grd/AdaptiveLimit.h"
+
+#ifdef DEBUG_MEM
+#include "sc/DebugMem.h"
+#endif
+
+// ----------------------------------------------------------------------------
+// grdAdaptiveLimit
+// ----------------------------------------------------------------------------
+grdAdaptiveLimit::grdAdaptiveLimit():
+  m_limitMin(1), m_limitMax(1), m_window(1.0), m_slowStart(true), m_sinceDecrease(0),
+  m_baseResponseTime(0), m_baseValid(false), m_baseWindowMin(0), m_baseCount(0)
+{
+}
+
+uint grdAdaptiveLimit::getLimit() const
+{
+  return static_cast<uint>(m_window);
+}
+
+uint grdAdaptiveLimit::getMinLimit() const
+{
+  return m_limitMin;
+}
+
+uint grdAdaptiveLimit::getMaxLimit() const
+{
+  return m_limitMax;
+}
+
+bool grdAdaptiveLimit::isSlowStart() const
+{
+  return m_slowStart;
+}
+
+cpu_ticks grdAdaptiveLimit::getBaseResponseTime() const
+{
+  return m_baseResponseTime;
+}
+
+void grdAdaptiveLimit::start(uint minLimit, uint maxLimit, uint startLimit)
+{
+  if (minLimit < 1)
+    minLimit = 1;
+  if (maxLimit < minLimit)
+    maxLimit = minLimit;
+
+  m_limitMin = minLimit;
+  m_limitMax = maxLimit;
+  m_slowStart = true;
+  m_sinceDecrease = maxLimit; // first overload is handled at once
+  m_baseValid = false;
+  m_baseCount = 0;
+  setLimit(startLimit);
+}
+
+void grdAdaptiveLimit::setLimit(uint value)
+{
+  m_window = (value > 0)?static_cast<double>(value):static_cast<double>(m_limitMin);
+  apply();
+}
+
+// AIMD: window grows by one per window of fast responses (by one per 
+// response in slow start), shrinks when responses are slow
+bool grdAdaptiveLimit::handleSuccess(cpu_ticks respTime)
+{
+  bool res = false;
+
+  m_sinceDecrease++;
+  updateBase(respTime);
+
+  if (static_cast<double>(respTime) > 
+      static_cast<double>(m_baseResponseTime) * GRD_SQUEUE_ADAPT_LATENCY_FACTOR + GRD_SQUEUE_ADAPT_LATENCY_SLACK) 
+    res = decrease(GRD_SQUEUE_ADAPT_LATENCY_DECREASE);
+  else if (m_slowStart)
+    m_window += 1.0;
+  else  
+    m_window += 1.0 / m_window;
+
+  apply();
+  return res;
+}
+
+bool grdAdaptiveLimit::handleOverload()
+{
+  m_sinceDecrease++;
+  bool res = decrease(GRD_SQUEUE_ADAPT_ERROR_DECREASE);
+  apply();
+  return res;
+}
+
+void grdAdaptiveLimit::handleFailure()
+{
+  m_sinceDecrease++;
+}
+
+// lower base is used at once, higher minimum of a window (target became 
+// slower) moves base only partially - responses under load are slow too
+void grdAdaptiveLimit::updateBase(cpu_ticks respTime)
+{
+  if (!m_baseValid || (respTime < m_baseResponseTime)) {
+    m_baseResponseTime = respTime;
+    m_baseValid = true;
+  }  
+  if ((m_baseCount == 0) || (respTime < m_baseWindowMin))
+    m_baseWindowMin = respTime;
+  if (++m_baseCount >= GRD_SQUEUE_ADAPT_BASE_RESET) {
+    m_baseCount = 0;
+    if (m_baseWindowMin > m_baseResponseTime)
+      m_baseResponseTime += static_cast<cpu_ticks>(
+        static_cast<double>(m_baseWindowMin - m_baseResponseTime) * GRD_SQUEUE_ADAPT_BASE_DECAY);
+  }
+}
+
+bool grdAdaptiveLimit::decrease(double factor)
+{
+  m_slowStart = false;
+  // one overload is reported by all messages in flight - react once per window
+  if (static_cast<double>(m_sinceDecrease) < m_window)
+    return false;
+  m_window *= factor;
+  m_sinceDecrease = 0;
+  return true;
+}
+
+void grdAdaptiveLimit::apply()
+{
+  if (m_window < static_cast<double>(m_limitMin))
+    m_window = static_cast<double>(m_limitMin);
+  if (m_window > static_cast<double>(m_limitMax))
+    m_window = static_cast<double>(m_limitMax);
+}
@@ -8,7 +8,13 @@
 // Licence:     BSD
 /////////////////////////////////////////////////////////////////////////////
 
+#include <list>
+#include <cstring>
+
 #include <boost/interprocess/ipc/message_queue.hpp>
+#include "boost/thread.hpp"
+#include "boost/bind.hpp"
+#include "boost/ptr_container/ptr_list.hpp"
 
 #include "grd/BoostMsgQueueGate.h"
 #include "grd/EnvSerializerJsonYajl.h"
@@ -17,9 +23,11 @@
 #include "grd/Connection.h"
 #include "grd/ConnectionPool.h"
 #include "grd/MessageConst.h"
+#include "grd/Message.h"
 
 #include "perf/Timer.h"
 #include "perf/Counter.h"
+#include "perf/Log.h"
 
 #ifdef DEBUG_MEM
 #include "sc/DebugMem.h"
@@ -34,10 +42,37 @@ using namespace perf;
 const uint SC_BMQ_DEF_INACT_CONN_TIMEOUT = 30000;
 const uint SC_BMQ_MAX_MSG_SIZE = 65536;
 const uint SC_BMQ_MAX_MSG_COUNT = 512;
+const uint SC_BMQ_RECV_TIMEOUT = 100;         // ms, receiver thread wait limit
+const uint SC_BMQ_DRAIN_BATCH = 256;          // max messages taken per wake-up
+const uint SC_BMQ_INPUT_QUEUE_LIMIT = 4096;   // received messages waiting for scheduler
+const uint SC_BMQ_DEF_SEND_BATCH = 1;         // opt-in: older receivers decode only first envelope, rest is lost
+// all messages are sent with one queue priority - queue returns higher 
+// priorities first, which would reorder messages of the same sender, 
+// lanes of input gate (see scMessageGate) serve control messages first
+const uint SC_BMQ_PRIORITY = 0;
+
+//----------------------------------------------------------------------------------
+// Local types
+//----------------------------------------------------------------------------------
+typedef std::list<scString> grdBmqMessageList;
 
 //----------------------------------------------------------------------------------
 // Local classes - declarations
 //----------------------------------------------------------------------------------
+/// Envelopes for one queue, sent as one queue message:
+/// payloads separated with zero, each terminated with zero
+class grdBmqSendBatch {
+public:
+  grdBmqSendBatch(const scMessageAddress &a_address, const scString &a_connectionId):
+    address(a_address), connectionId(a_connectionId) {}
+  scMessageAddress address;
+  scString connectionId;
+  scString data;
+  boost::ptr_list<scEnvelope> envelopes;
+};
+
+typedef boost::ptr_list<grdBmqSendBatch> grdBmqSendBatchList;
+
 class grdBmqGate: public scMessageGate {
 public:
   grdBmqGate();
@@ -67,7 +102,7 @@ public:
   bool connect(const scString &address);  
   virtual void close();
   virtual bool isConnected();  
-  void send(char *ptr, size_t asize);
+  void send(const char *ptr, size_t asize);
 protected:  
   void checkConnected();
 protected:
@@ -78,29 +113,46 @@ class grdBmqGateInput: public grdBmqGate {
 public:
   grdBmqGateInput();
   virtual ~grdBmqGateInput();
+  void setUseThread(bool value);
   virtual void init();
   virtual int run();
 protected:    
-  bool pull(char *buffer, size_t buffer_size);
+  bool pull(char *buffer, size_t buffer_size, bool wait);
   void putEnvelopeStr(const scString &str);
+  int putAll(grdBmqMessageList &messages);
   bool isConnected();
   void tryOpen();
   void close();
+  void runThread();
+  void stopThread();
+  bool reopen();
 protected:    
   std::auto_ptr<message_queue> m_handle;
+  // received messages in order of arrival
+  grdBmqMessageList m_queue;
+  // receiver thread
+  bool m_useThread;
+  std::auto_ptr<boost::thread> m_thread;
+  volatile bool m_terminated;
+  boost::mutex m_queueMutex;
+  boost::condition_variable m_queueSpace;
 };
 
 class grdBmqGateOutput: public grdBmqGate {
 public:
   grdBmqGateOutput();
   virtual ~grdBmqGateOutput();
+  void setSendBatch(uint value);
   virtual int run();
 protected:
-  void transmitEnvelope(scEnvelope *envelope);
+  void addToBatch(grdBmqSendBatchList &batches, std::auto_ptr<scEnvelope> &envelopeGuard);
+  void flushBatch(grdBmqSendBatch &batch);
+  void reportBatchError(grdBmqSendBatch &batch, int errorCode, const scString &errorMsg, const scString &details);
   grdBmqConnectionOut *findConnection(const scString &connectionId);
   grdBmqConnectionOut *prepareConnection(const scMessageAddress &address);
 protected:
   scConnectionPool m_connections;    
+  uint m_sendBatch; // max envelopes per queue message, 1 - no batching
 };
 
 //----------------------------------------------------------------------------------
@@ -167,16 +219,22 @@ bool grdBmqGate::getOwnAddress(const scString &protocol, scMessageAddress &outpu
 //----------------------------------------------------------------------------------
 // grdBmqGateInput
 //----------------------------------------------------------------------------------
-grdBmqGateInput::grdBmqGateInput(): grdBmqGate()
+grdBmqGateInput::grdBmqGateInput(): grdBmqGate(), m_useThread(false), m_terminated(false)
 {
   initBuffer();
 }
 
 grdBmqGateInput::~grdBmqGateInput()
 {
+  stopThread();
   close();
 }
 
+void grdBmqGateInput::setUseThread(bool value)
+{
+  m_useThread = value;
+}
+
 void grdBmqGateInput::close()
 {
   m_handle.reset();
@@ -188,6 +246,73 @@ void grdBmqGateInput::close()
 void grdBmqGateInput::init()
 {
   tryOpen();
+  if (m_useThread) {
+    m_terminated = false;
+    m_thread.reset(new boost::thread(boost::bind(&grdBmqGateInput::runThread, this)));
+  }  
+}
+
+void grdBmqGateInput::stopThread()
+{
+  if (m_thread.get() == SC_NULL)
+    return;
+
+  m_terminated = true;
+  {
+    boost::mutex::scoped_lock l(m_queueMutex);
+    m_queueSpace.notify_all();
+  }
+  m_thread->join();
+  m_thread.reset();
+}
+
+// receiver thread: waits for first message, then drains queue in batch,
+// errors are logged and queue is created again, so gate keeps working
+void grdBmqGateInput::runThread()
+{
+  while(!m_terminated)
+  {
+    {
+      boost::mutex::scoped_lock l(m_queueMutex);
+      while(!m_terminated && (m_queue.size() >= SC_BMQ_INPUT_QUEUE_LIMIT))
+        m_queueSpace.timed_wait(l, boost::posix_time::milliseconds(SC_BMQ_RECV_TIMEOUT));
+    }  
+
+    if (!isConnected() && !reopen()) {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(SC_BMQ_RECV_TIMEOUT));
+      continue;
+    }
+
+    try {
+      if (pull(m_buffer.get(), getBufferSize(), true)) {
+        uint cnt = 1;
+        while((cnt < SC_BMQ_DRAIN_BATCH) && pull(m_buffer.get(), getBufferSize(), false))
+          cnt++;
+      }  
+    }
+    catch(const std::exception &e) {
+      Log::addError(scString("BMQ receiver thread - exception: ")+e.what());
+      Counter::inc("msg-bmq-recv-error");
+    }
+    catch(...) {
+      Log::addError(scString("BMQ receiver thread - exception (unknown)"));
+      Counter::inc("msg-bmq-recv-error");
+    }
+  }
+}
+
+// queue is closed by pull() on error, returns <true> if it was created again
+bool grdBmqGateInput::reopen()
+{
+  try {
+    tryOpen();
+    Log::addWarning("BMQ receiver thread - queue reopened: "+m_address);
+    return true;
+  }
+  catch(const std::exception &e) {
+    Log::addError(scString("BMQ receiver thread - reopen failed: ")+e.what());
+  }
+  return false;
 }
 
 void grdBmqGateInput::tryOpen()
@@ -209,20 +334,40 @@ bool grdBmqGateInput::isConnected()
 int grdBmqGateInput::run()
 { 
   int res = 0;
-  if (!isConnected())
-    tryOpen();
+  grdBmqMessageList messages;
+
+  if (m_useThread) {
+    boost::mutex::scoped_lock l(m_queueMutex);
+    messages.swap(m_queue);
+    m_queueSpace.notify_all();
+  } else {  
+    if (!isConnected())
+      tryOpen();
+
+    if (isConnected())
+      while(pull(m_buffer.get(), getBufferSize(), false))
+        ;
+    messages.swap(m_queue);
+  }
 
-  if (isConnected())
+  res += putAll(messages);
+  return res;
+}
+
+int grdBmqGateInput::putAll(grdBmqMessageList &messages)
+{
+  int res = 0;
+  for(grdBmqMessageList::const_iterator it = messages.begin(), epos = messages.end(); it != epos; ++it)
   {
-    while(pull(m_buffer.get(), getBufferSize()))
-    {  
-      res++;
-    }  
+    Counter::inc("msg-size", it->length());
+    putEnvelopeStr(*it);
+    res++;
   }
   return res;
 }
 
-bool grdBmqGateInput::pull(char *buffer, size_t buffer_size)
+// received message is stored in input queue
+bool grdBmqGateInput::pull(char *buffer, size_t buffer_size, bool wait)
 {
   bool res = false;
   size_t recvd_size;
@@ -231,7 +376,14 @@ bool grdBmqGateInput::pull(char *buffer, size_t buffer_size)
   if (isConnected())
   {
     try {
-      res = m_handle->try_receive(buffer, buffer_size, recvd_size, priority);  
+      if (wait) {
+        boost::posix_time::ptime timeout = 
+          boost::posix_time::microsec_clock::universal_time() + 
+          boost::posix_time::milliseconds(SC_BMQ_RECV_TIMEOUT);
+        res = m_handle->timed_receive(buffer, buffer_size, recvd_size, priority, timeout);  
+      } else {  
+        res = m_handle->try_receive(buffer, buffer_size, recvd_size, priority);  
+      }  
     }
     catch(...) {
       res = false;
@@ -241,10 +393,20 @@ bool grdBmqGateInput::pull(char *buffer, size_t buffer_size)
     }
     
     if (res) {
-      buffer[recvd_size+1] = '\0';
-      scString envelopeStr(buffer);
-      Counter::inc("msg-size", envelopeStr.length());
-      putEnvelopeStr(envelopeStr);
+      // each payload is sent with terminating zero, many payloads (batch) 
+      // can be received in one message
+      const char *ptr = buffer;
+      const char *endPtr = buffer + recvd_size;
+      boost::mutex::scoped_lock l(m_queueMutex);
+      while(ptr < endPtr)
+      {
+        const char *sepPtr = static_cast<const char *>(memchr(ptr, '\0', endPtr - ptr));
+        if (sepPtr == SC_NULL)
+          sepPtr = endPtr;
+        if (sepPtr > ptr)
+          m_queue.push_back(scString(ptr, sepPtr - ptr));
+        ptr = sepPtr + 1;
+      }
     }
   }
   return res;
@@ -261,19 +423,26 @@ void grdBmqGateInput::putEnvelopeStr(const scString &str)
 //----------------------------------------------------------------------------------
 // grdBmqGateOutput
 //----------------------------------------------------------------------------------
-grdBmqGateOutput::grdBmqGateOutput(): grdBmqGate()
+grdBmqGateOutput::grdBmqGateOutput(): grdBmqGate(), m_sendBatch(SC_BMQ_DEF_SEND_BATCH)
 {
-  initBuffer();
 }
 
 grdBmqGateOutput::~grdBmqGateOutput()
 {
 }
 
+void grdBmqGateOutput::setSendBatch(uint value)
+{
+  m_sendBatch = (value > 0)?value:1;
+}
+
+// envelopes are grouped by queue, each group is sent 
+// with one queue message (or more if buffer size is exceeded)
 int grdBmqGateOutput::run()
 {
   int res = 0;
   std::auto_ptr<scEnvelope> envelopeGuard;
+  grdBmqSendBatchList batches;
     
   m_connections.checkActive();  
 
@@ -282,7 +451,7 @@ int grdBmqGateOutput::run()
     envelopeGuard.reset(get());
     res++;
     try {
-      transmitEnvelope(envelopeGuard.get());
+      addToBatch(batches, envelopeGuard);
     }
     catch (scError &e) {
       e.addDetails(scDataNode(envelopeGuard->getReceiver().getAsString())); 
@@ -300,45 +469,94 @@ int grdBmqGateOutput::run()
     }  
   } // while     
 
+  for(grdBmqSendBatchList::iterator it = batches.begin(), epos = batches.end(); it != epos; ++it)
+  {
+    try {
+      flushBatch(*it);
+    }
+    catch (scError &e) {
+      int error = e.getErrorCode();
+      reportBatchError(*it, (error != 0)?error:SC_RESP_STATUS_TRANSMIT_ERROR, e.what(), "out-addr: "+it->address.getAsString());
+    }      
+    catch(const std::exception& e) {
+      scString msg = scString("BMQ-Transmit - exception (std): ") + e.what();
+      reportBatchError(*it, SC_MSG_STATUS_EXCEPTION, msg, "out-addr: "+it->address.getAsString());
+    }  
+    catch(...) {
+      scString msg = scString("BMQ-Transmit - exception (unknown)");
+      reportBatchError(*it, SC_MSG_STATUS_EXCEPTION, msg, "out-addr: "+it->address.getAsString());
+    }  
+  }
+
   return res;
 }
 
-void grdBmqGateOutput::transmitEnvelope(scEnvelope *envelope)
+// takes ownership of envelope on success
+void grdBmqGateOutput::addToBatch(grdBmqSendBatchList &batches, std::auto_ptr<scEnvelope> &envelopeGuard)
 {
   scString dataStr;  
 
-  m_serializer->convToString(*envelope, dataStr); 
+  m_serializer->convToString(*envelopeGuard, dataStr); 
   
-  grdBmqConnectionOut *item = prepareConnection(envelope->getReceiver());
+  if (dataStr.length() >= SC_BMQ_MAX_MSG_SIZE)
+    throw scError("BMQ message too long ("+toString(dataStr.length())+")");
+
+  const scMessageAddress &receiver = envelopeGuard->getReceiver();
+  scString connectionId = receiver.getHost();
+
+  grdBmqSendBatch *batch = SC_NULL;
+  for(grdBmqSendBatchList::reverse_iterator it = batches.rbegin(), epos = batches.rend(); it != epos; ++it)
+    if (it->connectionId == connectionId) {
+      batch = &(*it);
+      break;
+    }
+
+  if ((batch == SC_NULL) || (batch->envelopes.size() >= m_sendBatch) || 
+      (batch->data.length() + dataStr.length() + 1 > SC_BMQ_MAX_MSG_SIZE)) 
+  {
+    batches.push_back(new grdBmqSendBatch(receiver, connectionId));
+    batch = &batches.back();
+  }  
+
+  batch->data.append(dataStr);
+  batch->data.push_back('\0');
+  batch->envelopes.push_back(envelopeGuard);
+}
+
+// one queue message per batch, accounting per batch
+void grdBmqGateOutput::flushBatch(grdBmqSendBatch &batch)
+{
+  grdBmqConnectionOut *item = prepareConnection(batch.address);
   if (item == SC_NULL)
     throw scError("bmq gate.execute failed - connection failed");
-      
-  if (item) {    
-     if (dataStr.length() >= getBufferSize())
-       throw scError("BMQ message too long ("+toString(dataStr.length())+")");
-
-     //wxStrncpy(m_buffer.get(), dataStr.c_str(), dataStr.length()+1);
-     strncpy(m_buffer.get(), dataStr.c_str(), dataStr.length()+1);
 
-  Counter::inc("msg-total");
-  Counter::inc("msg-size", (dataStr.length() + 1) * sizeof(scChar));
+  for(boost::ptr_list<scEnvelope>::iterator it = batch.envelopes.begin(), epos = batch.envelopes.end(); it != epos; ++it)
+    handleMsgReadyForSend(*it);
      
 #ifdef SC_TIMER_ENABLED
   Timer::start("msg-total");
   Timer::start("msg-execute-bmq");
 #endif     
 
-  handleMsgReadyForSend(*envelope);
-  item->send(m_buffer.get(), (dataStr.length()+1)*sizeof(scChar));
-  handleMsgSent(*envelope);
+  item->send(batch.data.c_str(), batch.data.length());
 
 #ifdef SC_TIMER_ENABLED
   Timer::stop("msg-execute-bmq");
   Timer::stop("msg-total");
 #endif     
-  }
-  else
-    throw scError("BMQ gate.connect failed");  
+
+  Counter::inc("msg-total", batch.envelopes.size());
+  Counter::inc("msg-size", batch.data.length());
+  Counter::inc("msg-batch");
+
+  for(boost::ptr_list<scEnvelope>::iterator it = batch.envelopes.begin(), epos = batch.envelopes.end(); it != epos; ++it)
+    handleMsgSent(*it);
+}
+
+void grdBmqGateOutput::reportBatchError(grdBmqSendBatch &batch, int errorCode, const scString &errorMsg, const scString &details)
+{
+  for(boost::ptr_list<scEnvelope>::iterator it = batch.envelopes.begin(), epos = batch.envelopes.end(); it != epos; ++it)
+    handleTransmitError(*it, errorCode, errorMsg, details);
 }
 
 grdBmqConnectionOut *grdBmqGateOutput::prepareConnection(const scMessageAddress &address)
@@ -428,10 +646,10 @@ void grdBmqConnectionOut::checkConnected()
     throw scError("BMQ connection not active!");
 }
 
-void grdBmqConnectionOut::send(char *ptr, size_t asize)
+void grdBmqConnectionOut::send(const char *ptr, size_t asize)
 {
   checkConnected();
-  m_handle->send(ptr, asize, 0);
+  m_handle->send(ptr, asize, SC_BMQ_PRIORITY);
   signalUsed();
 }
 
@@ -451,6 +669,8 @@ scMessageGate *grdBmqGateFactory::createGate(bool input, const scDataNode &param
     res.reset(new grdBmqGateInput());
     if (params.size()>0)  
       static_cast<grdBmqGateInput *>(res.get())->setAddress(params.getString(0));  
+    if (params.hasChild("thread"))
+      static_cast<grdBmqGateInput *>(res.get())->setUseThread(params.getBool("thread"));  
   }    
   else { 
     res.reset(new grdBmqGateOutput());
@@ -461,6 +681,9 @@ scMessageGate *grdBmqGateFactory::createGate(bool input, const scDataNode &param
       uint timeout = params.getUInt(1);
       static_cast<grdBmqGateOutput *>(res.get())->setInactTimeout(timeout);  
     }  
+
+    if (params.hasChild("send_batch"))
+      static_cast<grdBmqGateOutput *>(res.get())->setSendBatch(params.getUInt("send_batch"));  
   }  
   res->setProtocol(protocol);
   return res.release();
@@ -44,6 +44,17 @@
 #include "grd/W32NamedPipesGate.h"
 #endif
 
+#ifdef GRD_USE_SHM_QUEUE
+#include "grd/ShmRingGate.h"
+#endif
+
+#ifdef GRD_USE_UDS_QUEUE
+#include "grd/UnixSocketGate.h"
+#endif
+#ifdef GRD_USE_TCPX_QUEUE
+#include "grd/TcpRawGate.h"
+#endif
+
 #include "grd/W32Watchdog.h"
 
 #include "grd/CompactServer.h"
@@ -397,6 +408,10 @@ void grdCompactServer::performYieldOutIdle(uint64 timeMs)
     Timer::stop("grd-yield-thread-idle");
     Timer::start("grd-yield-sleep-idle");
     //proc::sleepProcess(1);
+#ifdef GRD_USE_ZEROMQ
+    // with 0MQ I/O thread wake up as soon as messages arrive
+    if ((m_zmContext.get() == SC_NULL) || !m_zmContext->waitForIoActivity(static_cast<uint>(timeMs)))
+#endif
     proc::sleepThisThreadMs(timeMs);
     Timer::stop("grd-yield-sleep-idle");
     //m_lastYieldOut = cpu_time_ms();
@@ -541,6 +556,17 @@ void grdCompactServer::initGates()
 #ifdef GRD_USE_NAMED_PIPES_QUEUE
   coreModule->registerGateFactory("npq", new grdW32NamedPipesGateFactory());
 #endif
+
+#ifdef GRD_USE_SHM_QUEUE
+  coreModule->registerGateFactory("shm", new grdShmGateFactory());
+#endif
+
+#ifdef GRD_USE_UDS_QUEUE
+  coreModule->registerGateFactory("uds", new grdUdsGateFactory());
+#endif
+#ifdef GRD_USE_TCPX_QUEUE
+  coreModule->registerGateFactory("tcpx", new grdTcpxGateFactory());
+#endif
 }
 
 void grdCompactServer::setCommandNotifier(scNotifier *notifier)
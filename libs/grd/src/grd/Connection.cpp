@@ -27,6 +27,11 @@ void scConnection::setInactTimeout(uint msecs)
   this->m_inactTimeout = msecs;
 }
 
+ulong64 scConnection::getLastUsedTime() const
+{
+  return m_lastUsedTime;
+}
+
 void scConnection::checkInactivity()
 {
   if (m_inactTimeout > 0)
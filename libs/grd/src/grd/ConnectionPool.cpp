@@ -9,11 +9,35 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include "grd/ConnectionPool.h"
+#include "perf/time_utils.h"
 
 
 //----------------------------------------------------------------------------------
 // scConnectionPool
 //----------------------------------------------------------------------------------
+scConnectionPool::scConnectionPool():
+  m_maxSize(SC_CONN_POOL_DEF_MAX_SIZE),
+  m_backoffMin(SC_CONN_POOL_DEF_BACKOFF_MIN),
+  m_backoffMax(SC_CONN_POOL_DEF_BACKOFF_MAX)
+{
+}
+
+void scConnectionPool::setMaxSize(uint value)
+{
+  m_maxSize = value;
+}
+
+void scConnectionPool::setBackoff(uint minDelay, uint maxDelay)
+{
+  m_backoffMin = minDelay;
+  m_backoffMax = (maxDelay < minDelay)?minDelay:maxDelay;
+}
+
+uint scConnectionPool::size() const
+{
+  return m_connections.size();
+}
+
 scConnection *scConnectionPool::find(const scString &connectionId)
 {
   scConnectionMap::iterator p;
@@ -22,12 +46,47 @@ scConnection *scConnectionPool::find(const scString &connectionId)
   if(p != m_connections.end())
     return p->second;
   else
-    return SC_NULL;  
+    return SC_NULL;
 }
 
 void scConnectionPool::add(const scString &connectionId, scConnection *item)
 {
-  m_connections.insert(const_cast<scString &>(connectionId), item);
+  std::auto_ptr<scConnection> itemGuard(item);
+
+  if (m_maxSize > 0)
+    while((m_connections.size() >= m_maxSize) && evictLeastUsed())
+      ;
+
+  m_connections.insert(const_cast<scString &>(connectionId), itemGuard.release());
+  preparePeerInfo(connectionId);
+}
+
+void scConnectionPool::remove(const scString &connectionId)
+{
+  scConnectionMap::iterator p = m_connections.find(connectionId);
+  if(p != m_connections.end())
+    m_connections.erase(p);
+}
+
+// pool is limited to at most few hundreds of items, so linear search is ok
+// returns <false> if there was no connection that could be removed
+bool scConnectionPool::evictLeastUsed()
+{
+  scConnectionMap::iterator found = m_connections.end();
+
+  for(scConnectionMap::iterator it = m_connections.begin(), epos = m_connections.end(); it != epos; ++it)
+  {
+    if (m_pinned.find(it->first) != m_pinned.end())
+      continue;
+    if ((found == m_connections.end()) || (it->second->getLastUsedTime() < found->second->getLastUsedTime()))
+      found = it;
+  }
+
+  if (found == m_connections.end())
+    return false;
+
+  m_connections.erase(found);
+  return true;
 }
 
 void scConnectionPool::checkActive()
@@ -43,6 +102,130 @@ void scConnectionPool::checkActive()
       it = m_connections.erase(it);
     else
       ++it;
-  }    
+  }
+}
+
+void scConnectionPool::clear()
+{
+  m_connections.clear();
+  m_pinned.clear();
+}
+
+void scConnectionPool::pin(const scString &connectionId)
+{
+  m_pinned.insert(connectionId);
+}
+
+void scConnectionPool::unpinAll()
+{
+  m_pinned.clear();
 }
 
+bool scConnectionPool::canConnect(const scString &connectionId)
+{
+  scConnectionPeerMap::iterator it = m_peers.find(connectionId);
+  if (it == m_peers.end())
+    return true;
+  return (it->second.nextRetryTime == 0) || (cpu_time_ms() >= it->second.nextRetryTime);
+}
+
+// closes connection & blocks reconnect for exponentially growing time
+void scConnectionPool::signalFailure(const scString &connectionId)
+{
+  scConnectionPeerInfo &info = preparePeerInfo(connectionId);
+  ulong64 delay = m_backoffMin;
+
+  for(uint i=0; (i < info.failCount) && (delay < m_backoffMax); i++)
+    delay *= 2;
+  if (delay > m_backoffMax)
+    delay = m_backoffMax;
+
+  info.errorCount++;
+  info.failCount++;
+  info.nextRetryTime = cpu_time_ms() + delay;
+
+  remove(connectionId);
+}
+
+void scConnectionPool::signalSent(const scString &connectionId, ulong64 byteCount, uint msgCount)
+{
+  scConnectionPeerInfo &info = preparePeerInfo(connectionId);
+  info.msgCount += msgCount;
+  info.byteCount += byteCount;
+  info.lastSendTime = cpu_time_ms();
+  info.failCount = 0;
+  info.nextRetryTime = 0;
+}
+
+// traffic from peers we never sent to is not tracked
+void scConnectionPool::signalReceived(const scString &connectionId, ulong64 byteCount, uint msgCount)
+{
+  scConnectionPeerMap::iterator it = m_peers.find(connectionId);
+  if (it == m_peers.end())
+    return;
+
+  scConnectionPeerInfo &info = it->second;
+  if (info.lastSendTime > 0) {
+    info.lastLatency = static_cast<uint>(calc_cpu_time_delay(info.lastSendTime, cpu_time_ms()));
+    info.lastSendTime = 0;
+  }
+  info.recvMsgCount += msgCount;
+  info.recvByteCount += byteCount;
+}
+
+scConnectionPeerInfo &scConnectionPool::preparePeerInfo(const scString &connectionId)
+{
+  scConnectionPeerMap::iterator it = m_peers.find(connectionId);
+  if (it != m_peers.end())
+    return it->second;
+
+  if (m_peers.size() >= SC_CONN_POOL_MAX_PEER_INFO)
+    prunePeerInfo();
+
+  return m_peers[connectionId];
+}
+
+// remove info about peers that are not connected & not blocked
+void scConnectionPool::prunePeerInfo()
+{
+  ulong64 now = cpu_time_ms();
+  scConnectionPeerMap::iterator it = m_peers.begin();
+  while(it != m_peers.end())
+  {
+    if ((m_connections.find(it->first) == m_connections.end()) && (it->second.nextRetryTime <= now))
+      m_peers.erase(it++);
+    else
+      ++it;
+  }
+}
+
+void scConnectionPool::getStats(scDataNode &output) const
+{
+  ulong64 now = cpu_time_ms();
+  std::auto_ptr<scDataNode> peerGuard;
+  std::auto_ptr<scDataNode> peersGuard(new scDataNode());
+
+  peersGuard->setAsList();
+  output.setAsParent();
+  output.addChild("connections", new scDataNode(static_cast<uint>(m_connections.size())));
+  output.addChild("max_connections", new scDataNode(m_maxSize));
+
+  for(scConnectionPeerMap::const_iterator it = m_peers.begin(), epos = m_peers.end(); it != epos; ++it)
+  {
+    const scConnectionPeerInfo &info = it->second;
+    peerGuard.reset(new scDataNode(ict_parent));
+    peerGuard->addChild("peer", new scDataNode(it->first));
+    peerGuard->addChild("connected", new scDataNode(m_connections.find(it->first) != m_connections.end()));
+    peerGuard->addChild("messages", new scDataNode(info.msgCount));
+    peerGuard->addChild("bytes", new scDataNode(info.byteCount));
+    peerGuard->addChild("messages_in", new scDataNode(info.recvMsgCount));
+    peerGuard->addChild("bytes_in", new scDataNode(info.recvByteCount));
+    peerGuard->addChild("errors", new scDataNode(info.errorCount));
+    peerGuard->addChild("last_latency", new scDataNode(info.lastLatency));
+    if (info.nextRetryTime > now)
+      peerGuard->addChild("retry_in", new scDataNode(static_cast<uint>(info.nextRetryTime - now)));
+    peersGuard->addChild(peerGuard.release());
+  }
+
+  output.addChild("peers", peersGuard.release());
+}
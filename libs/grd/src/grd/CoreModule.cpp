@@ -28,6 +28,7 @@
 
 //perf
 #include "perf/Log.h"
+#include "perf/Counter.h"
 
 //grd
 #include "grd/CoreModule.h"
@@ -291,6 +292,14 @@ int scCoreModule::handleMessage(scMessage *message, scResponse &response)
     {
       res = handleCmdAddGate(message, response);
     }  
+    else if (coreCmd == "watch_peers")
+    {
+      res = handleCmdWatchPeers(message, response);
+    }  
+    else if (coreCmd == "peer_down")
+    {
+      res = handleCmdPeerDown(message, response);
+    }  
   }
   
   response.setStatus(res);
@@ -575,6 +584,17 @@ int scCoreModule::handleCmdGetStats(scMessage *message, scResponse &response)
   response.initFor(*message);        
   scDataNode resultData(ict_parent);
   resultData.setElementSafe("text", text);        
+
+  std::auto_ptr<scDataNode> gateStats(new scDataNode());
+  checkScheduler()->getGateStats(*gateStats);
+  if (!gateStats->empty())
+    resultData.addChild("gates", gateStats.release());
+
+  std::auto_ptr<scDataNode> moduleStats(new scDataNode());
+  checkScheduler()->getModuleStats(*moduleStats);
+  if (!moduleStats->empty())
+    resultData.addChild("modules", moduleStats.release());
+
   response.setResult(resultData);  
   
   return res;
@@ -912,6 +932,11 @@ int scCoreModule::handleCmdAddGate(scMessage *message, scResponse &response)
 
         if (it != m_gateFactoryColn.end()) {
           std::auto_ptr<scMessageGate> gateGuard(it->second->createGate(dirInput, extraParams, protocol));
+          if (extraParams.hasChild("weight_control") || extraParams.hasChild("weight_interactive") || extraParams.hasChild("weight_bulk"))
+            gateGuard->setLaneWeights(
+              extraParams.getUInt("weight_control", SC_GATE_DEF_WEIGHT_CONTROL),
+              extraParams.getUInt("weight_interactive", SC_GATE_DEF_WEIGHT_INTERACTIVE),
+              extraParams.getUInt("weight_bulk", SC_GATE_DEF_WEIGHT_BULK));
           if (dirInput)
             checkScheduler()->addInputGate(gateGuard.release());
           else  
@@ -926,6 +951,52 @@ int scCoreModule::handleCmdAddGate(scMessage *message, scResponse &response)
   return res;
 }
 
+int scCoreModule::handleCmdWatchPeers(scMessage *message, scResponse &response)
+{
+  int res = SC_MSG_STATUS_WRONG_PARAMS;
+  scDataNode &params = message->getParams(); 
+
+  if (m_scheduler != SC_NULL) {
+    scString command, address;
+
+    if (params.hasChild("command"))
+      command = params.getString("command");
+    else if (params.size() > 0)
+      command = params.getString(0);
+
+    if (params.hasChild("address"))
+      address = params.getString("address");
+    else if (params.size() > 1)
+      address = params.getString(1);
+    else  
+      address = checkScheduler()->getOwnAddress().getAsString();
+
+    if (!command.empty()) {
+      m_peerWatchers.insert(std::make_pair(address, command));
+      res = SC_MSG_STATUS_OK;
+    }
+  }  
+  return res;
+}
+
+// peer lost, detected by gate - forward to all watchers
+int scCoreModule::handleCmdPeerDown(scMessage *message, scResponse &response)
+{
+  int res = SC_MSG_STATUS_WRONG_PARAMS;
+  scDataNode &params = message->getParams(); 
+
+  if ((m_scheduler != SC_NULL) && params.hasChild("address")) {
+    Log::addWarning("Peer down: "+params.getString("address")+", reason: "+params.getString("reason", ""));
+    Counter::inc("core-peer-down");
+
+    for(scPeerWatcherSet::const_iterator it = m_peerWatchers.begin(), epos = m_peerWatchers.end(); it != epos; ++it)
+      checkScheduler()->postMessage(it->first, it->second, &params);
+
+    res = SC_MSG_STATUS_OK;
+  }  
+  return res;
+}
+
 scStringList scCoreModule::supportedInterfaces() const
 {
   scStringList res;
@@ -0,0 +1,616 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        EnvSerializerBinDict.cpp
+// Project:     grdLib
+// Purpose:     Binary envelope serializer with field-name dictionaries
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+// std
+#include <cstring>
+#include <fstream>
+
+// sc
+#include "sc/dtypes.h"
+#include "sc/utils.h"
+
+// perf
+#include "perf/time_utils.h"
+
+// grd
+#include "grd/EnvSerializerBinDict.h"
+#include "grd/Response.h"
+#include "grd/Message.h"
+
+#ifdef SC_TIMER_ENABLED
+#include "perf/Timer.h"
+#endif
+
+#ifdef DEBUG_MEM
+#include "sc/DebugMem.h"
+#endif
+
+using namespace perf;
+
+// value type tags
+enum grdBinDictValueType {
+  bdvtNull = 0,
+  bdvtFalse = 1,
+  bdvtTrue = 2,
+  bdvtInt = 3,
+  bdvtUInt = 4,
+  bdvtInt64 = 5,
+  bdvtUInt64 = 6,
+  bdvtDouble = 7,
+  bdvtString = 8,
+  bdvtParent = 9,
+  bdvtList = 10
+};
+
+// event kinds
+const unsigned char GRD_BINDICT_EVENT_NONE = 0;
+const unsigned char GRD_BINDICT_EVENT_MESSAGE = 1;
+const unsigned char GRD_BINDICT_EVENT_RESPONSE = 2;
+
+// frame flags
+const uint GRD_BINDICT_FLAG_NEW_DICT = 1;
+const uint GRD_BINDICT_FLAG_PRIORITY = 2;
+const uint GRD_BINDICT_FLAG_RESYNC_REQ = 4; // control frame, no envelope
+
+// dictionary reference codes
+const uint GRD_BINDICT_REF_NEW = 0;
+const uint GRD_BINDICT_REF_LITERAL = 1;
+const uint GRD_BINDICT_REF_BASE = 2;
+
+// ----------------------------------------------------------------------------
+// scEnvSerializerBinDict
+// ----------------------------------------------------------------------------
+scEnvSerializerBinDict::scEnvSerializerBinDict(): m_selfContained(false), m_frameNewDict(false),
+  m_decodeUseCounter(0), m_decodeSessionId(0), m_resyncNeeded(false), m_resyncSessionId(0)
+{
+  startSession();
+}
+
+void scEnvSerializerBinDict::setSelfContained(bool value)
+{
+  m_selfContained = value;
+}
+
+bool scEnvSerializerBinDict::isBinaryFrame(const char *data, size_t dataSize)
+{
+  return
+    (dataSize > 1)
+    &&
+    (static_cast<unsigned char>(data[0]) == GRD_BINDICT_MAGIC);
+}
+
+bool scEnvSerializerBinDict::isResyncRequest(const char *data, size_t dataSize, ulong64 &sessionId)
+{
+  if (!isBinaryFrame(data, dataSize) || (static_cast<unsigned char>(data[1]) != GRD_BINDICT_VERSION))
+    return false;
+
+  // header only, without dictionary state
+  const char *cursor = data + 2;
+  const char *end = data + dataSize;
+  try {
+    sessionId = readVarUInt(cursor, end);
+    return ((readVarUInt(cursor, end) & GRD_BINDICT_FLAG_RESYNC_REQ) != 0);
+  }
+  catch(const scError &) {
+    return false;
+  }
+}
+
+void scEnvSerializerBinDict::makeResyncRequest(ulong64 sessionId, scString &output)
+{
+  output.clear();
+  writeByte(GRD_BINDICT_MAGIC, output);
+  writeByte(GRD_BINDICT_VERSION, output);
+  writeVarUInt(sessionId, output);
+  writeVarUInt(GRD_BINDICT_FLAG_RESYNC_REQ, output);
+}
+
+// requests for older sessions are ignored, they are already replaced
+bool scEnvSerializerBinDict::handleResyncRequest(ulong64 sessionId)
+{
+  if (sessionId != m_sessionId)
+    return false;
+  startSession();
+  return true;
+}
+
+bool scEnvSerializerBinDict::takeResyncSession(ulong64 &sessionId)
+{
+  if (!m_resyncNeeded)
+    return false;
+  m_resyncNeeded = false;
+  sessionId = m_resyncSessionId;
+  return true;
+}
+
+// frames of this session can't be decoded until sender starts new dictionary
+void scEnvSerializerBinDict::signalResyncNeeded(ulong64 sessionId)
+{
+  m_decodeSessions.erase(sessionId);
+  m_resyncNeeded = true;
+  m_resyncSessionId = sessionId;
+}
+
+void scEnvSerializerBinDict::resetDictionary()
+{
+  startSession();
+}
+
+// entry ids are assigned in order, so removing entries of last frame
+// restores state from before the frame
+void scEnvSerializerBinDict::rollbackFrame()
+{
+  if (m_frameNewDict) {
+    // receiver will get a new session with new dictionary
+    startSession();
+    return;
+  }
+
+  for(std::vector<scString>::const_iterator it = m_frameNewEntries.begin(), epos = m_frameNewEntries.end(); it != epos; ++it)
+    m_encodeDict.erase(*it);
+  m_frameNewEntries.clear();
+  if (m_frameCount > 0)
+    m_frameCount--;
+}
+
+void scEnvSerializerBinDict::startSession()
+{
+  m_encodeDict.clear();
+  m_frameNewEntries.clear();
+  m_frameNewDict = false;
+  m_frameCount = 0;
+  m_sessionId = newSessionId();
+}
+
+// session IDs of many processes share one decoder, so they have to be 
+// random (time & address based IDs of restarted processes can repeat)
+ulong64 scEnvSerializerBinDict::newSessionId()
+{
+  static ulong64 sessionCounter = 0;
+  ulong64 res = 0;
+
+  std::ifstream input("/dev/urandom", std::ios::in | std::ios::binary);
+  if (!input.read(reinterpret_cast<char *>(&res), sizeof(res))) {
+    // fallback, unique only within process
+    res =
+      (static_cast<ulong64>(cpu_time_ms()) << 24)
+      ^
+      static_cast<ulong64>(reinterpret_cast<size_t>(&sessionCounter))
+      ^
+      (++sessionCounter);
+  }
+  return res;
+}
+
+int scEnvSerializerBinDict::convToString(const scEnvelope& input, scString &output)
+{
+#ifdef SC_TIMER_ENABLED
+  Timer::start("BinDict.Out.01.ToString");
+#endif
+
+  if (m_frameCount >= GRD_BINDICT_RESYNC_INTERVAL)
+    startSession();
+  else if (m_selfContained && (m_frameCount > 0)) {
+    // new dictionary in each frame, same session
+    m_encodeDict.clear();
+    m_frameCount = 0;
+  }
+
+  uint flags = 0;
+  m_frameNewEntries.clear();
+  m_frameNewDict = (m_frameCount == 0);
+  if (m_frameNewDict)
+    flags |= GRD_BINDICT_FLAG_NEW_DICT;
+  if (input.getPriority() != SC_ENV_PRIORITY_AUTO)
+    flags |= GRD_BINDICT_FLAG_PRIORITY;
+  m_frameCount++;
+
+  output.clear();
+  writeByte(GRD_BINDICT_MAGIC, output);
+  writeByte(GRD_BINDICT_VERSION, output);
+  writeVarUInt(m_sessionId, output);
+  writeVarUInt(flags, output);
+
+  writeDictString(input.getSender().getAsString(), output);
+  writeDictString(input.getReceiver().getAsString(), output);
+  writeVarUInt(input.getTimeout(), output);
+  if ((flags & GRD_BINDICT_FLAG_PRIORITY) != 0)
+    writeVarUInt(input.getPriority(), output);
+
+  if (input.getEvent() == SC_NULL)
+  {
+    writeByte(GRD_BINDICT_EVENT_NONE, output);
+  }
+  else if (input.getEvent()->isResponse())
+  {
+    scResponse *response = dynamic_cast<scResponse *>(input.getEvent());
+    writeByte(GRD_BINDICT_EVENT_RESPONSE, output);
+    writeVarInt(response->getRequestId(), output);
+    writeVarInt(response->getStatus(), output);
+    if (response->isError())
+      writeDataNode(response->getError(), output);
+    else
+      writeDataNode(response->getResult(), output);
+  } else {
+    const scMessage *message = dynamic_cast<const scMessage *>(input.getEvent());
+    writeByte(GRD_BINDICT_EVENT_MESSAGE, output);
+    writeVarInt(message->getRequestId(), output);
+    writeDictString(message->getCommand(), output);
+    writeDataNode(message->getParams(), output);
+  }
+
+#ifdef SC_TIMER_ENABLED
+  Timer::stop("BinDict.Out.01.ToString");
+#endif
+  return 0;
+}
+
+int scEnvSerializerBinDict::convFromString(const scString &input, scEnvelope& output)
+{
+  return convFromBuffer(input.c_str(), input.length(), output);
+}
+
+int scEnvSerializerBinDict::convFromBuffer(const char *data, size_t dataSize, scEnvelope& output)
+{
+#ifdef SC_TIMER_ENABLED
+  Timer::start("BinDict.In.01.FromBuffer");
+#endif
+
+  const char *cursor = data;
+  const char *end = data + dataSize;
+
+  if (readByte(cursor, end) != GRD_BINDICT_MAGIC)
+    throw scError("Binary envelope - wrong frame signature");
+  if (readByte(cursor, end) != GRD_BINDICT_VERSION)
+    throw scError("Binary envelope - unsupported version");
+
+  ulong64 sessionId = readVarUInt(cursor, end);
+  uint flags = static_cast<uint>(readVarUInt(cursor, end));
+  if ((flags & GRD_BINDICT_FLAG_RESYNC_REQ) != 0)
+    throw scError("Binary envelope - unexpected resync request");
+
+  m_decodeSessionId = sessionId;
+  grdBinDictDecodeList &dict = prepareDecodeDict(sessionId, (flags & GRD_BINDICT_FLAG_NEW_DICT) != 0);
+
+  scString addr;
+
+  output.clear();
+  readDictString(cursor, end, dict, addr);
+  output.setSender(addr);
+  readDictString(cursor, end, dict, addr);
+  output.setReceiver(addr);
+  output.setTimeout(static_cast<uint>(readVarUInt(cursor, end)));
+  if ((flags & GRD_BINDICT_FLAG_PRIORITY) != 0)
+    output.setPriority(static_cast<uint>(readVarUInt(cursor, end)));
+
+  unsigned char eventKind = readByte(cursor, end);
+  int requestId;
+
+  if (eventKind == GRD_BINDICT_EVENT_RESPONSE) {
+    std::auto_ptr<scResponse> guard(new scResponse());
+    requestId = static_cast<int>(readVarInt(cursor, end));
+    guard->setRequestId(requestId);
+    guard->setStatus(static_cast<int>(readVarInt(cursor, end)));
+    if (guard->isError())
+      readDataNode(cursor, end, dict, guard->getError());
+    else
+      readDataNode(cursor, end, dict, guard->getResult());
+    output.setEvent(guard.release());
+  } else if (eventKind == GRD_BINDICT_EVENT_MESSAGE) {
+    std::auto_ptr<scMessage> guard(new scMessage());
+    scString command;
+    requestId = static_cast<int>(readVarInt(cursor, end));
+    guard->setRequestId(requestId);
+    readDictString(cursor, end, dict, command);
+    guard->setCommand(command);
+    // decoded in place, without copy of (possibly large) params tree
+    readDataNode(cursor, end, dict, guard->getParams());
+    output.setEvent(guard.release());
+  } else {
+    throw scError("Invalid envelope - no event found");
+  }
+
+#ifdef SC_TIMER_ENABLED
+  Timer::stop("BinDict.In.01.FromBuffer");
+#endif
+  return 1;
+}
+
+// session started without us would have other entry ids, so new
+// entries of its frames can't be accepted
+grdBinDictDecodeList &scEnvSerializerBinDict::prepareDecodeDict(ulong64 sessionId, bool newDict)
+{
+  grdBinDictSessionMap::iterator it = m_decodeSessions.find(sessionId);
+  if (it == m_decodeSessions.end()) {
+    if (!newDict) {
+      signalResyncNeeded(sessionId);
+      throw scError("Binary envelope - unknown session: "+toString(sessionId));
+    }
+    if (m_decodeSessions.size() >= GRD_BINDICT_MAX_SESSIONS)
+      evictLeastUsedSession();
+    it = m_decodeSessions.insert(std::make_pair(sessionId, grdBinDictSession())).first;
+  } else if (newDict) {
+    it->second.dict.clear();
+  }
+  it->second.lastUsed = ++m_decodeUseCounter;
+  return it->second.dict;
+}
+
+// called only when new sender appears and list is full, so linear search is ok
+void scEnvSerializerBinDict::evictLeastUsedSession()
+{
+  grdBinDictSessionMap::iterator found = m_decodeSessions.end();
+
+  for(grdBinDictSessionMap::iterator it = m_decodeSessions.begin(), epos = m_decodeSessions.end(); it != epos; ++it)
+    if ((found == m_decodeSessions.end()) || (it->second.lastUsed < found->second.lastUsed))
+      found = it;
+
+  if (found != m_decodeSessions.end())
+    m_decodeSessions.erase(found);
+}
+
+// --- encoding
+void scEnvSerializerBinDict::writeByte(unsigned char value, scString &output)
+{
+  output += static_cast<char>(value);
+}
+
+void scEnvSerializerBinDict::writeVarUInt(ulong64 value, scString &output)
+{
+  while (value >= 0x80) {
+    output += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  output += static_cast<char>(value);
+}
+
+void scEnvSerializerBinDict::writeVarInt(long64 value, scString &output)
+{
+  // zig-zag, small negative values use few bytes
+  ulong64 zz = (static_cast<ulong64>(value) << 1) ^ static_cast<ulong64>(value >> 63);
+  writeVarUInt(zz, output);
+}
+
+void scEnvSerializerBinDict::writeDouble(double value, scString &output)
+{
+  ulong64 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for(uint i=0; i < sizeof(bits); i++) {
+    output += static_cast<char>(bits & 0xff);
+    bits >>= 8;
+  }
+}
+
+void scEnvSerializerBinDict::writeRawString(const scString &value, scString &output)
+{
+  writeVarUInt(value.length(), output);
+  output.append(value);
+}
+
+void scEnvSerializerBinDict::writeDictString(const scString &value, scString &output)
+{
+  grdBinDictEncodeMap::iterator it = m_encodeDict.find(value);
+  if (it != m_encodeDict.end()) {
+    writeVarUInt(GRD_BINDICT_REF_BASE + it->second, output);
+  } else if (m_encodeDict.size() < GRD_BINDICT_MAX_ENTRIES) {
+    uint newId = m_encodeDict.size();
+    m_encodeDict.insert(std::make_pair(value, newId));
+    m_frameNewEntries.push_back(value);
+    writeVarUInt(GRD_BINDICT_REF_NEW, output);
+    writeRawString(value, output);
+  } else {
+    writeVarUInt(GRD_BINDICT_REF_LITERAL, output);
+    writeRawString(value, output);
+  }
+}
+
+void scEnvSerializerBinDict::writeDataNode(const scDataNode &value, scString &output)
+{
+  scDataNode &src = const_cast<scDataNode &>(value);
+
+  if (!src.isContainer()) {
+    writeValue(src, output);
+  } else if (src.isParent()) {
+    writeByte(bdvtParent, output);
+    writeVarUInt(src.size(), output);
+    for(uint i=0, epos = src.size(); i != epos; i++) {
+      writeDictString(src.getElementName(i), output);
+      writeDataNode(src.getElement(i), output);
+    }
+  } else {
+    writeByte(bdvtList, output);
+    writeVarUInt(src.size(), output);
+    for(uint i=0, epos = src.size(); i != epos; i++)
+      writeDataNode(src.getElement(i), output);
+  }
+}
+
+void scEnvSerializerBinDict::writeValue(const scDataNode &value, scString &output)
+{
+  scDataNode &src = const_cast<scDataNode &>(value);
+
+  if (src.isNull()) {
+    writeByte(bdvtNull, output);
+    return;
+  }
+
+  switch (src.getValueType()) {
+    case vt_bool:
+      writeByte(src.getAsBool()?bdvtTrue:bdvtFalse, output);
+      break;
+    case vt_int:
+      writeByte(bdvtInt, output);
+      writeVarInt(src.getAsInt(), output);
+      break;
+    case vt_uint:
+      writeByte(bdvtUInt, output);
+      writeVarUInt(src.getAsUInt(), output);
+      break;
+    case vt_int64:
+      writeByte(bdvtInt64, output);
+      writeVarInt(src.getAsInt64(), output);
+      break;
+    case vt_uint64:
+      writeByte(bdvtUInt64, output);
+      writeVarUInt(src.getAsUInt64(), output);
+      break;
+    case vt_float:
+    case vt_double:
+      writeByte(bdvtDouble, output);
+      writeDouble(src.getAsDouble(), output);
+      break;
+    default:
+      writeByte(bdvtString, output);
+      writeRawString(src.getAsString(), output);
+      break;
+  }
+}
+
+// --- decoding
+unsigned char scEnvSerializerBinDict::readByte(const char *&cursor, const char *end)
+{
+  if (cursor >= end)
+    throw scError("Binary envelope - frame truncated");
+  return static_cast<unsigned char>(*cursor++);
+}
+
+ulong64 scEnvSerializerBinDict::readVarUInt(const char *&cursor, const char *end)
+{
+  ulong64 res = 0;
+  uint shift = 0;
+  unsigned char c;
+  do {
+    if (shift > 63)
+      throw scError("Binary envelope - integer overflow");
+    c = readByte(cursor, end);
+    res |= static_cast<ulong64>(c & 0x7f) << shift;
+    shift += 7;
+  } while ((c & 0x80) != 0);
+  return res;
+}
+
+long64 scEnvSerializerBinDict::readVarInt(const char *&cursor, const char *end)
+{
+  ulong64 zz = readVarUInt(cursor, end);
+  return static_cast<long64>(zz >> 1) ^ -static_cast<long64>(zz & 1);
+}
+
+double scEnvSerializerBinDict::readDouble(const char *&cursor, const char *end)
+{
+  ulong64 bits = 0;
+  for(uint i=0; i < sizeof(bits); i++)
+    bits |= static_cast<ulong64>(readByte(cursor, end)) << (8 * i);
+  double res;
+  memcpy(&res, &bits, sizeof(res));
+  return res;
+}
+
+void scEnvSerializerBinDict::readRawString(const char *&cursor, const char *end, scString &output)
+{
+  ulong64 len = readVarUInt(cursor, end);
+  if (len > static_cast<ulong64>(end - cursor))
+    throw scError("Binary envelope - frame truncated");
+  output.assign(cursor, static_cast<size_t>(len));
+  cursor += len;
+}
+
+void scEnvSerializerBinDict::readDictString(const char *&cursor, const char *end,
+  grdBinDictDecodeList &dict, scString &output)
+{
+  ulong64 ref = readVarUInt(cursor, end);
+  if (ref == GRD_BINDICT_REF_NEW) {
+    readRawString(cursor, end, output);
+    dict.push_back(output);
+  } else if (ref == GRD_BINDICT_REF_LITERAL) {
+    readRawString(cursor, end, output);
+  } else {
+    ulong64 idx = ref - GRD_BINDICT_REF_BASE;
+    if (idx >= dict.size()) {
+      // dict is released here
+      signalResyncNeeded(m_decodeSessionId);
+      throw scError("Binary envelope - unknown dictionary entry: "+toString(static_cast<uint>(idx)));
+    }
+    output = dict[static_cast<size_t>(idx)];
+  }
+}
+
+// depth is limited, deeply nested frame would overflow stack
+void scEnvSerializerBinDict::readDataNode(const char *&cursor, const char *end,
+  grdBinDictDecodeList &dict, scDataNode &output, uint depth)
+{
+  unsigned char valueType = readByte(cursor, end);
+
+  if (((valueType == bdvtParent) || (valueType == bdvtList)) && (depth >= GRD_BINDICT_MAX_DEPTH))
+    throw scError("Binary envelope - nesting too deep");
+
+  if (valueType == bdvtParent) {
+    uint cnt = static_cast<uint>(readVarUInt(cursor, end));
+    scString name;
+    std::auto_ptr<scDataNode> childGuard;
+    output.setAsParent();
+    for(uint i=0; i != cnt; i++) {
+      readDictString(cursor, end, dict, name);
+      childGuard.reset(new scDataNode());
+      readDataNode(cursor, end, dict, *childGuard, depth + 1);
+      output.addChild(name, childGuard.release());
+    }
+  } else if (valueType == bdvtList) {
+    uint cnt = static_cast<uint>(readVarUInt(cursor, end));
+    std::auto_ptr<scDataNode> childGuard;
+    output.setAsList();
+    for(uint i=0; i != cnt; i++) {
+      childGuard.reset(new scDataNode());
+      readDataNode(cursor, end, dict, *childGuard, depth + 1);
+      output.addChild(childGuard.release());
+    }
+  } else {
+    readValue(valueType, cursor, end, output);
+  }
+}
+
+void scEnvSerializerBinDict::readValue(unsigned char valueType, const char *&cursor, const char *end,
+  scDataNode &output)
+{
+  switch (valueType) {
+    case bdvtNull:
+      output.setAsNull();
+      break;
+    case bdvtFalse:
+      output = scDataNode(false);
+      break;
+    case bdvtTrue:
+      output = scDataNode(true);
+      break;
+    case bdvtInt:
+      output = scDataNode(static_cast<int>(readVarInt(cursor, end)));
+      break;
+    case bdvtUInt:
+      output = scDataNode(static_cast<uint>(readVarUInt(cursor, end)));
+      break;
+    case bdvtInt64:
+      output = scDataNode(static_cast<long64>(readVarInt(cursor, end)));
+      break;
+    case bdvtUInt64:
+      output = scDataNode(static_cast<ulong64>(readVarUInt(cursor, end)));
+      break;
+    case bdvtDouble:
+      output = scDataNode(readDouble(cursor, end));
+      break;
+    case bdvtString: {
+      // scDataNode keeps own copy of value, it can't reference receive buffer
+      scString text;
+      readRawString(cursor, end, text);
+      output.setAsString(text);
+      break;
+    }
+    default:
+      throw scError("Binary envelope - unknown value type: "+toString(static_cast<uint>(valueType)));
+  }
+}
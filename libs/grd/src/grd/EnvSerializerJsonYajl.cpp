@@ -35,6 +35,9 @@ using namespace perf;
 
 #define SC_STRING_TO_UCHAR(a) reinterpret_cast<unsigned char *>(const_cast<wxChar *>((a)))
 
+// key of JSON params in scEncodedParams
+const scString SC_ESJSONY_PARAMS_FORMAT = "json";
+
 
 // ----------------------------------------------------------------------------
 // scEnvSerializerJsonYajl
@@ -57,6 +60,8 @@ int scEnvSerializerJsonYajl::convToString(const scEnvelope& input, scString &out
   writer.writeAttrib("receiver", input.getReceiver().getAsString());
   if (input.getTimeout() != 0)
     writer.writeAttrib("timeout", (int)input.getTimeout());
+  if (input.getPriority() != SC_ENV_PRIORITY_AUTO)
+    writer.writeAttrib("priority", (int)input.getPriority());
   if (input.getEvent() != SC_NULL)
   {    
     writer.startAttrib("event");
@@ -83,10 +88,23 @@ int scEnvSerializerJsonYajl::convToString(const scEnvelope& input, scString &out
         }  
       }
     } else { // message
-      scMessage *message = dynamic_cast<scMessage *>(input.getEvent());
+      const scMessage *message = dynamic_cast<const scMessage *>(input.getEvent());
       writer.writeAttrib("command", message->getCommand());
       writer.startAttrib("params");
-      writer.writeDataNode(message->getParams());
+      scEncodedParams *encodedCache = message->getEncodedParams().get();
+      if (encodedCache != SC_NULL) {
+        const scString *encodedParams = encodedCache->find(SC_ESJSONY_PARAMS_FORMAT);
+        if (encodedParams == SC_NULL) {
+          scString value;
+          encodeParams(message->getParams(), value);
+          encodedParams = &encodedCache->add(SC_ESJSONY_PARAMS_FORMAT, value);
+        }
+        // yajl writes number token without changes, so it's used to 
+        // insert already encoded JSON value
+        yajl_gen_number(*ctx, encodedParams->c_str(), encodedParams->length());
+      } else {
+        writer.writeDataNode(message->getParams());
+      }
     }    
     
     //close event
@@ -114,6 +132,13 @@ int scEnvSerializerJsonYajl::convToString(const scEnvelope& input, scString &out
   return 0;
 }
 
+void scEnvSerializerJsonYajl::encodeParams(const scDataNode &params, scString &output)
+{
+  YawlWriter writer(false, SC_NULL);
+  writer.writeDataNode(params);
+  writer.outputToString(output);
+}
+
 int scEnvSerializerJsonYajl::convFromString(const scString &input, scEnvelope& output)
 {
   scDataNode workNode;
@@ -180,6 +205,9 @@ int scEnvSerializerJsonYajl::convDataNodeToEnvelope(const scDataNode &input, scE
 
   if (input.hasChild("timeout"))
     output.setTimeout(const_cast<scDataNode &>(input)["timeout"].getAsInt());
+
+  if (input.hasChild("priority"))
+    output.setPriority(const_cast<scDataNode &>(input)["priority"].getAsInt());
     
   if (input.hasChild("event"))
   {
@@ -224,7 +252,7 @@ int scEnvSerializerJsonYajl::convDataNodeToEnvelope(const scDataNode &input, scE
 
       if (eventNode.hasChild("params"))
       {
-        message->setParams(eventNode["params"]);
+        message->getParams().eatValueFrom(eventNode["params"]);
       }  
       
       output.setEvent(guard.release());
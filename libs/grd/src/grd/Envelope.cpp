@@ -16,6 +16,7 @@
 // ----------------------------------------------------------------------------
 scEnvelope::scEnvelope():m_event(SC_NULL) {
   m_timeout = 0;
+  m_priority = SC_ENV_PRIORITY_AUTO;
 }
 
 scEnvelope::scEnvelope(scEnvelope const &rhs):m_event(SC_NULL) 
@@ -24,6 +25,7 @@ scEnvelope::scEnvelope(scEnvelope const &rhs):m_event(SC_NULL)
   m_sender = rhs.m_sender;
   m_receiver = rhs.m_receiver;
   m_timeout = rhs.m_timeout;
+  m_priority = rhs.m_priority;
   if (rhs.m_event != SC_NULL)
   {
     m_event = rhs.m_event->clone();
@@ -31,7 +33,7 @@ scEnvelope::scEnvelope(scEnvelope const &rhs):m_event(SC_NULL)
 }
 
 scEnvelope::scEnvelope(const scMessageAddress &sender, const scMessageAddress &receiver, scEvent *a_event):
-m_sender(sender),m_receiver(receiver),m_event(a_event),m_timeout(0)
+m_sender(sender),m_receiver(receiver),m_event(a_event),m_timeout(0),m_priority(SC_ENV_PRIORITY_AUTO)
 {  
 }
 
@@ -45,6 +47,7 @@ scEnvelope& scEnvelope::operator=( const scEnvelope& rhs)
    m_sender = rhs.m_sender;
    m_receiver = rhs.m_receiver;
    m_timeout = rhs.m_timeout;
+   m_priority = rhs.m_priority;
    if (rhs.m_event != SC_NULL)
    {
      m_event = rhs.m_event->clone();
@@ -64,6 +67,7 @@ void scEnvelope::clear()
   m_sender.clear();
   m_receiver.clear();
   m_timeout = 0;
+  m_priority = SC_ENV_PRIORITY_AUTO;
 }
 
 
@@ -115,3 +119,13 @@ uint scEnvelope::getTimeout() const
 {
   return m_timeout;
 }
+
+void scEnvelope::setPriority(uint a_priority)
+{
+  m_priority = a_priority;
+}
+
+uint scEnvelope::getPriority() const
+{
+  return m_priority;
+}
@@ -0,0 +1,408 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        GateBench.cpp
+// Project:     grdLib
+// Purpose:     Benchmark of message gates (latency, throughput, CPU usage).
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+// posix
+#include <time.h>
+
+// std
+#include <algorithm>
+
+#include "dtp/dnode_serializer.h"
+
+#include "grd/GateBench.h"
+#include "grd/CompactServer.h"
+#include "grd/details/SchedulerImpl.h"
+#include "grd/RequestHandler.h"
+#include "grd/Message.h"
+#include "grd/Response.h"
+
+#ifdef DEBUG_MEM
+#include "sc/DebugMem.h"
+#endif
+
+//----------------------------------------------------------------------------------
+// Constants
+//----------------------------------------------------------------------------------
+const scString GRD_GATE_BENCH_SERVER_NAME = "bench_srv";
+const scString GRD_GATE_BENCH_CLIENT_NAME = "bench_cli";
+const scString GRD_GATE_BENCH_COMMAND = "core.echo";
+const uint GRD_GATE_BENCH_MIN_COUNT = 10;
+const uint GRD_GATE_BENCH_STEP_INTERVAL = 64; // posts between node steps
+
+//----------------------------------------------------------------------------------
+// Local functions
+//----------------------------------------------------------------------------------
+static ulong64 grdGateBenchTimeUs(clockid_t clockId)
+{
+  struct timespec ts;
+  clock_gettime(clockId, &ts);
+  return ulong64(ts.tv_sec) * 1000000 + ulong64(ts.tv_nsec / 1000);
+}
+
+static ulong64 grdGateBenchNowUs()
+{
+  return grdGateBenchTimeUs(CLOCK_MONOTONIC);
+}
+
+static ulong64 grdGateBenchCpuUs()
+{
+  return grdGateBenchTimeUs(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+/// returns value for percentile given in 1/1000, input must be sorted
+static ulong64 grdGateBenchPercentile(const std::vector<ulong64> &values, uint perMille)
+{
+  if (values.empty())
+    return 0;
+  return values[(values.size() - 1) * perMille / 1000];
+}
+
+//----------------------------------------------------------------------------------
+// Local classes - declarations
+//----------------------------------------------------------------------------------
+/// Node running without sleep on idle (busy polling), for exact latency
+class grdGateBenchNode: public grdCompactServer {
+public:
+  grdGateBenchNode(): grdCompactServer() {}
+  virtual ~grdGateBenchNode() {}
+protected:
+  virtual void performYieldOutIdle(uint64 timeMs = 0) {}
+};
+
+class grdGateBenchHandler: public scRequestHandler {
+public:
+  grdGateBenchHandler(grdGateBench *owner, ulong64 startTime): scRequestHandler(), m_owner(owner), m_startTime(startTime) {}
+  virtual ~grdGateBenchHandler() {}
+  virtual void handleReqResult(const scMessage &a_message, const scResponse &a_response) {
+    m_owner->handleReply(m_startTime, true);
+  }
+  virtual void handleReqError(const scMessage &a_message, const scResponse &a_response) {
+    m_owner->handleReply(m_startTime, false);
+  }
+  virtual bool handleException(const scError &error) {
+    m_owner->handleReply(m_startTime, false);
+    return true;
+  }
+protected:
+  grdGateBench *m_owner;
+  ulong64 m_startTime;
+};
+
+//----------------------------------------------------------------------------------
+// Implementation part
+//----------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------
+// grdGateBench
+//----------------------------------------------------------------------------------
+grdGateBench::grdGateBench():
+  m_roundTrips(GRD_GATE_BENCH_DEF_ROUND_TRIPS),
+  m_messageCount(GRD_GATE_BENCH_DEF_MESSAGES),
+  m_byteLimit(GRD_GATE_BENCH_DEF_BYTE_LIMIT),
+  m_timeout(GRD_GATE_BENCH_DEF_TIMEOUT),
+  m_replyCount(0),
+  m_errorCount(0)
+{
+  // 100 B .. 10 MB
+  uint size = 100;
+  for(uint i=0; i < 6; i++, size *= 10)
+    m_sizes.push_back(size);
+}
+
+grdGateBench::~grdGateBench()
+{
+  m_client.reset();
+  m_server.reset();
+}
+
+void grdGateBench::setProtocol(const scString &protocol)
+{
+  m_protocol = protocol;
+}
+
+void grdGateBench::setServerAddress(const scString &address)
+{
+  m_serverAddress = address;
+}
+
+void grdGateBench::setClientAddress(const scString &address)
+{
+  m_clientAddress = address;
+}
+
+void grdGateBench::setGateParams(const scDataNode &params)
+{
+  m_gateParams = params;
+}
+
+void grdGateBench::setPayloadSizes(const grdGateBenchSizeList &sizes)
+{
+  m_sizes = sizes;
+}
+
+void grdGateBench::setRoundTrips(uint value)
+{
+  m_roundTrips = value;
+}
+
+void grdGateBench::setMessageCount(uint value)
+{
+  m_messageCount = value;
+}
+
+void grdGateBench::setByteLimit(ulong64 value)
+{
+  m_byteLimit = value;
+}
+
+void grdGateBench::setTimeout(uint value)
+{
+  m_timeout = value;
+}
+
+void grdGateBench::run(scDataNode &output)
+{
+  std::auto_ptr<scDataNode> rowGuard;
+
+  if (m_protocol.empty())
+    throw scError("Gate benchmark - protocol not specified");
+
+  initNodes();
+
+  output.clear();
+  output.setAsList();
+
+  for(grdGateBenchSizeList::const_iterator it = m_sizes.begin(), epos = m_sizes.end(); it != epos; ++it)
+  {
+    rowGuard.reset(new scDataNode(ict_parent));
+    runSize(*it, *rowGuard);
+    output.addChild(rowGuard.release());
+  }
+}
+
+void grdGateBench::initNodes()
+{
+  m_server.reset(new grdGateBenchNode());
+  m_server->init();
+  m_server->getScheduler()->setName(GRD_GATE_BENCH_SERVER_NAME);
+
+  m_client.reset(new grdGateBenchNode());
+  m_client->init();
+  m_client->getScheduler()->setName(GRD_GATE_BENCH_CLIENT_NAME);
+
+  addGate(*m_server, true, m_serverAddress);
+  addGate(*m_server, false, "");
+  addGate(*m_client, true, m_clientAddress);
+  addGate(*m_client, false, "");
+
+  // wait for add_gate execution
+  ulong64 startTime = grdGateBenchNowUs();
+  do {
+    stepNodes();
+    m_target = m_server->getScheduler()->getOwnAddress(m_protocol);
+    if (grdGateBenchNowUs() - startTime > ulong64(m_timeout) * 1000)
+      throw scError("Gate benchmark - gates not created for protocol: "+m_protocol);
+  } while(m_target.getProtocol() != m_protocol);
+
+  if (m_target.getNode().empty())
+    m_target.setNode(GRD_GATE_BENCH_SERVER_NAME);
+}
+
+void grdGateBench::addGate(grdCompactServer &node, bool input, const scString &address)
+{
+  scDataNode params(ict_parent);
+
+  params.addChild(new scDataNode(scString(input?"input":"output")));
+  params.addChild(new scDataNode(m_protocol));
+  if (!address.empty())
+    params.addChild(new scDataNode(address));
+
+  for(uint i=0, epos = m_gateParams.size(); i != epos; i++)
+    params.addChild(m_gateParams.getElementName(i), new scDataNode(m_gateParams.getElement(i)));
+
+  node.getScheduler()->postMessage(SC_ADDR_THIS, "core.add_gate", &params);
+}
+
+void grdGateBench::stepNodes()
+{
+  m_client->runStep();
+  m_server->runStep();
+}
+
+void grdGateBench::handleReply(ulong64 startTime, bool success)
+{
+  if (success) {
+    m_replyCount++;
+    m_latencies.push_back(grdGateBenchNowUs() - startTime);
+  } else {
+    m_errorCount++;
+  }
+}
+
+void grdGateBench::waitForReplies(uint expected)
+{
+  ulong64 startTime = grdGateBenchNowUs();
+
+  while(m_replyCount + m_errorCount < expected)
+  {
+    stepNodes();
+    if (grdGateBenchNowUs() - startTime > ulong64(m_timeout) * 1000)
+      throw scError("Gate benchmark - timeout, replies: "+toString(m_replyCount)+" of "+toString(expected));
+  }
+}
+
+void grdGateBench::postEcho(const scString &payload, bool waitForReply)
+{
+  scDataNode params(ict_parent);
+  std::auto_ptr<scMessage> messageGuard(new scMessage());
+  std::auto_ptr<scEnvelope> envelopeGuard(new scEnvelope());
+
+  params.addChild("text", new scDataNode(payload));
+  messageGuard->setCommand(GRD_GATE_BENCH_COMMAND);
+  messageGuard->setParams(params);
+
+  envelopeGuard->setReceiver(m_target);
+  envelopeGuard->setTimeout(m_timeout);
+
+  scSchedulerIntf *scheduler = m_client->getScheduler();
+
+  if (waitForReply) {
+    messageGuard->setRequestId(dynamic_cast<scScheduler *>(scheduler)->getNextRequestId());
+    envelopeGuard->setEvent(messageGuard.release());
+    scheduler->postEnvelope(envelopeGuard.release(), new grdGateBenchHandler(this, grdGateBenchNowUs()));
+  } else {
+    envelopeGuard->setEvent(messageGuard.release());
+    scheduler->postEnvelope(envelopeGuard.release());
+  }
+}
+
+// limits number of messages so that transferred data do not exceed byte limit
+uint grdGateBench::calcCount(uint defCount, uint payloadSize, uint factor)
+{
+  ulong64 bytesPerMsg = ulong64(payloadSize) * factor;
+  uint res = defCount;
+
+  if ((bytesPerMsg > 0) && (bytesPerMsg * res > m_byteLimit))
+    res = static_cast<uint>(m_byteLimit / bytesPerMsg);
+
+  if (res < GRD_GATE_BENCH_MIN_COUNT)
+    res = GRD_GATE_BENCH_MIN_COUNT;
+
+  return res;
+}
+
+void grdGateBench::runSize(uint payloadSize, scDataNode &output)
+{
+  scString payload(payloadSize, 'x');
+
+  output.addChild("protocol", new scDataNode(m_protocol));
+  output.addChild("payload_size", new scDataNode(payloadSize));
+
+  // request & response carry payload
+  measureLatency(payload, calcCount(m_roundTrips, payloadSize, 2), output);
+  measureThroughput(payload, calcCount(m_messageCount, payloadSize, 1), output);
+}
+
+void grdGateBench::measureLatency(const scString &payload, uint count, scDataNode &output)
+{
+  m_latencies.clear();
+  m_latencies.reserve(count);
+  m_replyCount = m_errorCount = 0;
+
+  ulong64 cpuStart = grdGateBenchCpuUs();
+
+  for(uint i=0; i < count; i++)
+  {
+    postEcho(payload, true);
+    waitForReplies(i + 1);
+  }
+
+  ulong64 cpuTime = grdGateBenchCpuUs() - cpuStart;
+
+  std::sort(m_latencies.begin(), m_latencies.end());
+
+  ulong64 total = 0;
+  for(std::vector<ulong64>::const_iterator it = m_latencies.begin(), epos = m_latencies.end(); it != epos; ++it)
+    total += *it;
+
+  output.addChild("rt_count", new scDataNode(count));
+  output.addChild("rt_errors", new scDataNode(m_errorCount));
+  output.addChild("rt_avg_us", new scDataNode(m_latencies.empty()?ulong64(0):(total / m_latencies.size())));
+  output.addChild("rt_p50_us", new scDataNode(grdGateBenchPercentile(m_latencies, 500)));
+  output.addChild("rt_p99_us", new scDataNode(grdGateBenchPercentile(m_latencies, 990)));
+  output.addChild("rt_p999_us", new scDataNode(grdGateBenchPercentile(m_latencies, 999)));
+  output.addChild("rt_cpu_ns_per_msg", new scDataNode(cpuTime * 1000 / count));
+}
+
+// messages without response, last (empty) message is confirmed
+void grdGateBench::measureThroughput(const scString &payload, uint count, scDataNode &output)
+{
+  m_latencies.clear();
+  m_replyCount = m_errorCount = 0;
+
+  ulong64 cpuStart = grdGateBenchCpuUs();
+  ulong64 startTime = grdGateBenchNowUs();
+
+  for(uint i=0; i < count; i++)
+  {
+    postEcho(payload, false);
+    if (i % GRD_GATE_BENCH_STEP_INTERVAL == GRD_GATE_BENCH_STEP_INTERVAL - 1)
+      stepNodes();
+  }
+
+  postEcho(scString(""), true);
+  waitForReplies(1);
+
+  ulong64 elapsed = grdGateBenchNowUs() - startTime;
+  ulong64 cpuTime = grdGateBenchCpuUs() - cpuStart;
+
+  if (elapsed == 0)
+    elapsed = 1;
+
+  output.addChild("tp_count", new scDataNode(count));
+  output.addChild("tp_errors", new scDataNode(m_errorCount));
+  output.addChild("tp_msg_per_sec", new scDataNode(ulong64(count) * 1000000 / elapsed));
+  output.addChild("tp_bytes_per_sec", new scDataNode(ulong64(count) * payload.length() * 1000000 / elapsed));
+  output.addChild("tp_cpu_ns_per_msg", new scDataNode(cpuTime * 1000 / count));
+}
+
+void grdGateBench::formatCsv(const scDataNode &results, scString &output)
+{
+  output.clear();
+  if (results.empty())
+    return;
+
+  const scDataNode &header = results.getElement(0);
+  for(uint i=0, epos = header.size(); i != epos; i++)
+  {
+    if (i > 0)
+      output += ",";
+    output += header.getElementName(i);
+  }
+  output += "\n";
+
+  for(uint r=0, rpos = results.size(); r != rpos; r++)
+  {
+    const scDataNode &row = results.getElement(r);
+    for(uint i=0, epos = row.size(); i != epos; i++)
+    {
+      if (i > 0)
+        output += ",";
+      output += row.getElement(i).getAsString();
+    }
+    output += "\n";
+  }
+}
+
+void grdGateBench::formatJson(const scDataNode &results, scString &output)
+{
+  dtp::dnSerializer serializer;
+  serializer.convToString(results, output);
+}
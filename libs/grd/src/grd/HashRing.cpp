@@ -0,0 +1,96 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        HashRing.cpp
+// Project:     grdLib
+// Purpose:     Consistent hash ring assigning keys to named nodes.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//sc
+#include "sc/utils.h"
+
+//grd
+#include "grd/HashRing.h"
+
+#ifdef DEBUG_MEM
+#include "sc/DebugMem.h"
+#endif
+
+// ----------------------------------------------------------------------------
+// grdHashRing
+// ----------------------------------------------------------------------------
+grdHashRing::grdHashRing(uint pointsPerNode): m_pointsPerNode(pointsPerNode)
+{
+  if (m_pointsPerNode < 1)
+    m_pointsPerNode = 1;
+}
+
+bool grdHashRing::empty() const
+{
+  return m_points.empty();
+}
+
+size_t grdHashRing::size() const
+{
+  return m_points.size();
+}
+
+void grdHashRing::addNode(const scString &name)
+{
+  for(uint i = 0; i < m_pointsPerNode; i++)
+    m_points[calcHash(name + "#" + toString(i))] = name;
+}
+
+void grdHashRing::clear()
+{
+  m_points.clear();
+}
+
+grdHashRing::grdHashRingPointMap::const_iterator grdHashRing::findPoint(const scString &key) const
+{
+  grdHashRingPointMap::const_iterator it = m_points.lower_bound(calcHash(key));
+  if (it == m_points.end())
+    it = m_points.begin();
+  return it;
+}
+
+scString grdHashRing::findOwner(const scString &key) const
+{
+  if (m_points.empty())
+    return scString("");
+  return findPoint(key)->second;
+}
+
+scString grdHashRing::findOwner(const scString &key, const grdHashRingNodeSet &skip) const
+{
+  if (m_points.empty())
+    return scString("");
+
+  grdHashRingPointMap::const_iterator it = findPoint(key);
+  if (skip.empty())
+    return it->second;
+
+  grdHashRingPointMap::const_iterator itn = it;
+  for(size_t i = 0, epos = m_points.size(); i != epos; i++) 
+  {
+    if (skip.find(itn->second) == skip.end())
+      return itn->second;
+    ++itn;
+    if (itn == m_points.end())
+      itn = m_points.begin();
+  }  
+
+  return it->second;  
+}
+
+uint grdHashRing::calcHash(const scString &value)
+{
+  uint res = 2166136261U;
+  for(scString::size_type i = 0, epos = value.length(); i != epos; i++) {
+    res ^= static_cast<unsigned char>(value[i]);
+    res *= 16777619U;
+  }
+  return res;
+}
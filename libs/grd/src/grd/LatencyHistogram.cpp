@@ -0,0 +1,138 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        LatencyHistogram.cpp
+// Project:     grdLib
+// Purpose:     Fixed-size histogram of time values (ms) with log2 buckets.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//std
+#include <memory>
+
+//sc
+#include "sc/utils.h"
+
+//grd
+#include "grd/LatencyHistogram.h"
+
+#ifdef DEBUG_MEM
+#include "sc/DebugMem.h"
+#endif
+
+// ----------------------------------------------------------------------------
+// grdLatencyHistogram
+// ----------------------------------------------------------------------------
+grdLatencyHistogram::grdLatencyHistogram()
+{
+  clear();
+}
+
+void grdLatencyHistogram::clear()
+{
+  for(uint i=0; i < GRD_LATENCY_HIST_BUCKETS; i++)
+    m_buckets[i] = 0;
+  m_count = 0;
+  m_sum = 0;
+  m_max = 0;
+}
+
+uint grdLatencyHistogram::getBucketIndex(cpu_ticks value)
+{
+  uint res = 0;
+  while((value > 0) && (res < GRD_LATENCY_HIST_BUCKETS - 1))
+  {
+    value >>= 1;
+    res++;
+  }
+  return res;
+}
+
+cpu_ticks grdLatencyHistogram::getBucketLimit(uint index)
+{
+  return (static_cast<cpu_ticks>(1) << index) - 1;
+}
+
+void grdLatencyHistogram::add(cpu_ticks value)
+{
+  m_buckets[getBucketIndex(value)]++;
+  m_count++;
+  m_sum += value;
+  if (value > m_max)
+    m_max = value;
+}
+
+void grdLatencyHistogram::add(const grdLatencyHistogram &other)
+{
+  for(uint i=0; i < GRD_LATENCY_HIST_BUCKETS; i++)
+    m_buckets[i] += other.m_buckets[i];
+  m_count += other.m_count;
+  m_sum += other.m_sum;
+  if (other.m_max > m_max)
+    m_max = other.m_max;
+}
+
+ulong64 grdLatencyHistogram::getCount() const
+{
+  return m_count;
+}
+
+cpu_ticks grdLatencyHistogram::getMax() const
+{
+  return m_max;
+}
+
+double grdLatencyHistogram::getAvg() const
+{
+  if (!m_count)
+    return 0.0;
+  return static_cast<double>(m_sum) / static_cast<double>(m_count);
+}
+
+cpu_ticks grdLatencyHistogram::getPercentile(double percent) const
+{
+  if (!m_count)
+    return 0;
+
+  ulong64 rank = static_cast<ulong64>(percent * static_cast<double>(m_count) / 100.0);
+  if (rank < 1)
+    rank = 1;
+
+  ulong64 total = 0;
+  for(uint i=0; i < GRD_LATENCY_HIST_BUCKETS; i++)
+  {
+    total += m_buckets[i];
+    // last bucket has no upper limit
+    if ((total >= rank) && (i < GRD_LATENCY_HIST_BUCKETS - 1))
+      return SC_MIN(getBucketLimit(i), m_max);
+  }
+
+  return m_max;
+}
+
+void grdLatencyHistogram::getStats(scDataNode &output) const
+{
+  std::auto_ptr<scDataNode> bucketGuard;
+  std::auto_ptr<scDataNode> bucketsGuard(new scDataNode(ict_list));
+
+  output.setAsParent();
+  output.addChild("count", new scDataNode(m_count));
+  output.addChild("avg", new scDataNode(getAvg()));
+  output.addChild("max", new scDataNode(static_cast<ulong64>(m_max)));
+  output.addChild("p50", new scDataNode(static_cast<ulong64>(getPercentile(50.0))));
+  output.addChild("p90", new scDataNode(static_cast<ulong64>(getPercentile(90.0))));
+  output.addChild("p99", new scDataNode(static_cast<ulong64>(getPercentile(99.0))));
+
+  for(uint i=0; i < GRD_LATENCY_HIST_BUCKETS; i++)
+  {
+    if (!m_buckets[i])
+      continue;
+    bucketGuard.reset(new scDataNode(ict_parent));
+    bucketGuard->addChild("le", new scDataNode(static_cast<ulong64>(getBucketLimit(i))));
+    bucketGuard->addChild("count", new scDataNode(m_buckets[i]));
+    bucketsGuard->addChild(bucketGuard.release());
+  }
+
+  output.addChild("buckets", bucketsGuard.release());
+}
@@ -51,7 +51,8 @@ void scMessage::copyFrom(const scMessage& rhs)
 {
   m_command = rhs.getCommand();
   m_requestId = rhs.getRequestId();
-  m_params = (const_cast< scMessage &>(rhs)).getParams();
+  m_params = rhs.m_params;
+  m_encodedParams = rhs.m_encodedParams;
 }
 
 scString scMessage::getCommand() const
@@ -80,6 +81,12 @@ scString scMessage::getInterface() const
 }
 
 scDataNode &scMessage::getParams()
+{
+  m_encodedParams.reset();
+  return m_params;
+}  
+
+const scDataNode &scMessage::getParams() const
 {
   return m_params;
 }  
@@ -92,6 +99,7 @@ void scMessage::setCommand(const scString &a_command)
 void scMessage::setParams(const scDataNode &a_params)
 {
   m_params = a_params;
+  m_encodedParams.reset();
 }
 
 bool scMessage::hasParams() const
@@ -109,4 +117,34 @@ void scMessage::clear()
   scEvent::clear();
   m_command = "";
   m_params.clear();
+  m_encodedParams.reset();
+}
+
+const scEncodedParamsRef &scMessage::getEncodedParams() const
+{
+  return m_encodedParams;
+}
+
+void scMessage::setEncodedParams(const scEncodedParamsRef &value)
+{
+  m_encodedParams = value;
+}
+
+// ----------------------------------------------------------------------------
+// scEncodedParams
+// ----------------------------------------------------------------------------
+// values are never removed, so returned pointer is valid while cache exists
+const scString *scEncodedParams::find(const scString &format) const
+{
+  boost::mutex::scoped_lock l(m_mutex);
+  std::map<scString, scString>::const_iterator it = m_items.find(format);
+  if (it == m_items.end())
+    return SC_NULL;
+  return &it->second;
+}
+
+const scString &scEncodedParams::add(const scString &format, const scString &value)
+{
+  boost::mutex::scoped_lock l(m_mutex);
+  return m_items.insert(std::make_pair(format, value)).first->second;
 }
@@ -10,6 +10,7 @@
 
 #include "grd/MessageGate.h"
 #include "grd/MessageConst.h"
+#include "grd/Message.h"
 
 #ifdef SC_LOG_ERRORS
 #include "perf/Log.h"
@@ -17,37 +18,163 @@ using namespace perf;
 #endif
 
 #include "grd/MessageTrace.h"
+#include "perf/Counter.h"
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+// commands sent using control lane (besides "core" interface)
+const char *SC_GATE_CONTROL_COMMANDS[] = {
+  "squeue.mark_alive",
+  "squeue.mark_alive_multi",
+  "squeue.keep_alive",
+  "squeue.peer_down",
+  "job.stop",
+  "job.pause",
+  "job.ended",
+  "job_worker.cancel_work",
+  SC_NULL
+};
+
+// commands carrying large data
+const char *SC_GATE_BULK_COMMANDS[] = {
+  "job.set_vars",
+  "job.commit",
+  SC_NULL
+};
+
+// ----------------------------------------------------------------------------
+// Local functions
+// ----------------------------------------------------------------------------
+static bool scGateCommandInList(const scString &command, const char *list[])
+{
+  for(uint i=0; list[i] != SC_NULL; i++)
+    if (command == list[i])
+      return true;
+  return false;
+}
 
 // ----------------------------------------------------------------------------
 // scMessageGate
 // ----------------------------------------------------------------------------
-scMessageGate::scMessageGate()
+scMessageGate::scMessageGate(): m_putCount(0), m_owner(SC_NULL)
 {
+  setLaneWeights(SC_GATE_DEF_WEIGHT_CONTROL, SC_GATE_DEF_WEIGHT_INTERACTIVE, SC_GATE_DEF_WEIGHT_BULK);
 }
 
 scMessageGate::~scMessageGate() 
 {
 }
 
+// envelopes with priority set explicitly to control by sender are not 
+// ordered, so they can overtake e.g. bulk transfer to the same peer
 void scMessageGate::put(scEnvelope* envelope)
 {
-  m_waiting.push_front(envelope);
+  uint lane = getLaneFor(*envelope);
+  ulong64 seq = ++m_putCount;
+  scString peerKey;
+
+  if (envelope->getPriority() != SC_ENV_PRIORITY_CONTROL) {
+    peerKey = envelope->getSender().getAsString() + " " + envelope->getReceiver().getAsString();
+    m_peerOrder[peerKey].push_back(seq);
+  }
+
+  m_lanes[lane].push_front(envelope);
+  m_laneEntries[lane].push_front(scGateLaneEntry(seq, peerKey));
 }
 
+// weighted round-robin: each lane can return up to <weight> envelopes
+// before credits are refilled, lane is skipped when it's oldest envelope
+// would overtake older one with the same sender & receiver;
+// oldest of all envelopes can be always taken, so second pass returns 
+// something if gate is not empty
 scEnvelope* scMessageGate::get()
 {
-  if (!m_waiting.empty()) {
-    scEnvelopeTransport transp = m_waiting.pop_back();
-    //m_waiting.release( m_waiting.begin());
-    return transp.release();
-  }  
-  else
-    throw scError("Message gate is empty");     
+  for(uint pass = 0; pass < 2; pass++)
+  {
+    for(uint lane = 0; lane < SC_GATE_LANE_COUNT; lane++)
+    {
+      if ((m_laneCredits[lane] > 0) && canTakeFrom(lane)) {
+        m_laneCredits[lane]--;
+        return takeFrom(lane);
+      }
+    }
+
+    for(uint lane = 0; lane < SC_GATE_LANE_COUNT; lane++)
+      m_laneCredits[lane] = m_laneWeights[lane];
+  }
+
+  throw scError("Message gate is empty");
+}
+
+bool scMessageGate::canTakeFrom(uint lane)
+{
+  if (m_lanes[lane].empty())
+    return false;
+
+  const scGateLaneEntry &entry = m_laneEntries[lane].back();
+  if (entry.peerKey.empty())
+    return true;
+  return (m_peerOrder[entry.peerKey].front() == entry.seq);
+}
+
+scEnvelope *scMessageGate::takeFrom(uint lane)
+{
+  const scString &peerKey = m_laneEntries[lane].back().peerKey;
+  if (!peerKey.empty()) {
+    scGatePeerOrderMap::iterator it = m_peerOrder.find(peerKey);
+    it->second.pop_front();
+    if (it->second.empty())
+      m_peerOrder.erase(it);
+  }
+  m_laneEntries[lane].pop_back();
+
+  scEnvelopeTransport transp = m_lanes[lane].pop_back();
+  return transp.release();
 }
 
 bool scMessageGate::empty()
 {
-  return m_waiting.empty();
+  for(uint lane = 0; lane < SC_GATE_LANE_COUNT; lane++)
+    if (!m_lanes[lane].empty())
+      return false;
+  return true;
+}
+
+void scMessageGate::setLaneWeights(uint controlWeight, uint interactiveWeight, uint bulkWeight)
+{
+  m_laneWeights[SC_GATE_LANE_CONTROL] = (controlWeight > 0)?controlWeight:1;
+  m_laneWeights[SC_GATE_LANE_INTERACTIVE] = (interactiveWeight > 0)?interactiveWeight:1;
+  m_laneWeights[SC_GATE_LANE_BULK] = (bulkWeight > 0)?bulkWeight:1;
+
+  for(uint lane = 0; lane < SC_GATE_LANE_COUNT; lane++)
+    m_laneCredits[lane] = m_laneWeights[lane];
+}
+
+uint scMessageGate::calcPriority(const scEnvelope &envelope)
+{
+  uint res = envelope.getPriority();
+
+  if ((res != SC_ENV_PRIORITY_AUTO) && (res <= SC_ENV_PRIORITY_BULK))
+    return res;
+
+  res = SC_ENV_PRIORITY_INTERACTIVE;
+
+  if ((envelope.getEvent() != SC_NULL) && !envelope.getEvent()->isResponse())
+  {
+    scString command = dynamic_cast<scMessage *>(envelope.getEvent())->getCommand();
+    if ((command.substr(0, 5) == "core.") || scGateCommandInList(command, SC_GATE_CONTROL_COMMANDS))
+      res = SC_ENV_PRIORITY_CONTROL;
+    else if (scGateCommandInList(command, SC_GATE_BULK_COMMANDS))
+      res = SC_ENV_PRIORITY_BULK;
+  }
+
+  return res;
+}
+
+uint scMessageGate::getLaneFor(const scEnvelope &envelope)
+{
+  return calcPriority(envelope) - SC_ENV_PRIORITY_CONTROL;
 }
 
 void scMessageGate::init()
@@ -103,6 +230,26 @@ void scMessageGate::handleTransmitError(const scEnvelope &envelope, int errorCod
 #endif  
 }
 
+void scMessageGate::signalPeerDown(const scString &protocol, const scString &host, const scString &reason)
+{
+  scSchedulerIntf *node = getOwner();
+  if (node == SC_NULL)
+    return;
+
+  scMessageAddress peerAddr;
+  peerAddr.setProtocol(protocol);
+  peerAddr.setHost(host);
+
+  scDataNode params(ict_parent);
+  params.addChild("address", new scDataNode(peerAddr.getAsString()));
+  params.addChild("protocol", new scDataNode(protocol));
+  params.addChild("host", new scDataNode(host));
+  params.addChild("reason", new scDataNode(reason));
+
+  perf::Counter::inc("gate-peer-down");
+  node->postMessage(node->getOwnAddress().getAsString(), "core.peer_down", &params);
+}
+
 scSchedulerIntf *scMessageGate::getOwner() 
 {
   return m_owner;
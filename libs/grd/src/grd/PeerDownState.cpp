@@ -0,0 +1,82 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        PeerDownState.cpp
+// Project:     grdLib
+// Purpose:     State of peer reported as lost by transport.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//grd
+#include "grd/PeerDownState.h"
+#include "grd/Event.h"
+
+#ifdef DEBUG_MEM
+#include "sc/DebugMem.h"
+#endif
+
+// ----------------------------------------------------------------------------
+// grdPeerDownState
+// ----------------------------------------------------------------------------
+grdPeerDownState::grdPeerDownState(cpu_ticks grace, cpu_ticks probeInterval):
+  m_grace(grace), m_probeInterval(probeInterval), m_down(false), m_downTime(0),
+  m_probeSent(false), m_probeTime(0), m_probeRequestId(SC_REQUEST_ID_NULL)
+{
+}
+
+bool grdPeerDownState::isDown() const
+{
+  return m_down;
+}
+
+bool grdPeerDownState::isExpired(cpu_ticks now) const
+{
+  return m_down && (calc_cpu_time_delay(m_downTime, now) >= m_grace);
+}
+
+// first probe is sent at once, next ones after interval - also when
+// previous probe was lost on reconnect
+bool grdPeerDownState::isProbeDue(cpu_ticks now) const
+{
+  if (!m_down)
+    return false;
+  return !m_probeSent || (calc_cpu_time_delay(m_probeTime, now) >= m_probeInterval);
+}
+
+int grdPeerDownState::getProbeRequestId() const
+{
+  return m_probeRequestId;
+}
+
+void grdPeerDownState::notePeerDown(cpu_ticks now)
+{
+  if (m_down)
+    return;
+  m_down = true;
+  m_downTime = now;
+  m_probeSent = false;
+}
+
+void grdPeerDownState::noteContact()
+{
+  m_down = false;
+  m_probeSent = false;
+  m_probeRequestId = SC_REQUEST_ID_NULL;
+}
+
+void grdPeerDownState::noteProbeSent(int requestId, cpu_ticks now)
+{
+  m_probeSent = true;
+  m_probeTime = now;
+  m_probeRequestId = requestId;
+}
+
+bool grdPeerDownState::handleProbeResponse(int requestId)
+{
+  if ((requestId == SC_REQUEST_ID_NULL) || (requestId != m_probeRequestId))
+    return false;
+
+  m_probeRequestId = SC_REQUEST_ID_NULL;
+  return true;
+}
@@ -0,0 +1,1098 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        ShmRingGate.cpp
+// Project:     grdLib
+// Purpose:     Shared-memory ring buffer gate (same-host, Linux).
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+// std
+#include <set>
+
+// posix
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <string.h>
+
+// boost
+#include "boost/cstdint.hpp"
+#include "boost/thread.hpp"
+#include "boost/bind.hpp"
+#include "boost/ptr_container/ptr_list.hpp"
+
+#include "grd/ShmRingGate.h"
+#include "grd/EnvSerializerJsonYajl.h"
+#include "grd/EnvSerializerBinDict.h"
+#include "grd/MessageGate.h"
+#include "grd/MessageAddress.h"
+#include "grd/Connection.h"
+#include "grd/ConnectionPool.h"
+#include "grd/MessageConst.h"
+
+#include "perf/Timer.h"
+#include "perf/Counter.h"
+#include "perf/Log.h"
+#include "perf/time_utils.h"
+
+#ifdef DEBUG_MEM
+#include "sc/DebugMem.h"
+#endif
+
+using namespace perf;
+
+//----------------------------------------------------------------------------------
+// Constants
+//----------------------------------------------------------------------------------
+const uint GRD_SHM_DEF_INACT_CONN_TIMEOUT = 30000;
+const uint GRD_SHM_DEF_RING_COUNT = 16;          // max number of concurrent senders
+const uint GRD_SHM_DEF_RING_SIZE = 1024*1024;    // bytes of data per ring
+const uint GRD_SHM_MIN_RING_SIZE = 4096;
+const uint GRD_SHM_DEF_SEND_TIMEOUT = 1000;      // ms message can wait for space in ring
+const uint GRD_SHM_ALIVE_CHECK_DELAY = 1000;     // ms between checks of receiver process
+const uint GRD_SHM_WAIT_TIMEOUT = 100;           // ms, receiver thread sleep limit
+const uint GRD_SHM_INPUT_QUEUE_LIMIT = 4096;     // decoded envelopes waiting for scheduler
+const uint GRD_SHM_CACHE_LINE = 64;
+const boost::uint32_t GRD_SHM_MAGIC = 0x67736872; // "grsh"
+const boost::uint32_t GRD_SHM_VERSION = 2;
+const boost::uint32_t GRD_SHM_WRAP_MARKER = 0xFFFFFFFF;
+const scString GRD_SHM_FORMAT_JSON = "json";
+const scString GRD_SHM_FORMAT_BIN = "bin";
+
+//----------------------------------------------------------------------------------
+// Local types
+//----------------------------------------------------------------------------------
+/// Segment header, placed at offset 0
+struct grdShmSegmentHeader {
+  boost::uint32_t magic;
+  boost::uint32_t version;
+  boost::uint32_t ringCount;
+  boost::uint32_t ringSize;
+  volatile boost::uint32_t closed;          // set by receiver before segment is removed
+  volatile boost::uint32_t receiverWaiting; // receiver thread sleeps on "bell"
+  volatile boost::uint32_t bell;            // futex word, changed when data is added
+  boost::uint32_t ownerPid;                 // pid of receiver, 0 - unknown
+};
+
+/// Ring header, head & tail are kept in separate cache lines
+struct grdShmRingHeader {
+  volatile boost::uint32_t owner;         // pid of sender, 0 = free
+  boost::uint32_t reserved;
+  volatile boost::uint64_t tail;          // written only by sender
+  char pad1[GRD_SHM_CACHE_LINE - 16];
+  volatile boost::uint64_t head;          // written only by receiver
+  char pad2[GRD_SHM_CACHE_LINE - 8];
+};
+
+//----------------------------------------------------------------------------------
+// Local functions
+//----------------------------------------------------------------------------------
+static size_t grdShmAlign(size_t value, size_t alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static size_t grdShmRecordSize(size_t dataSize)
+{
+  return grdShmAlign(sizeof(boost::uint32_t) + dataSize, 8);
+}
+
+static scString grdShmSegmentName(const scString &address)
+{
+  if (!address.empty() && (address[0] == '/'))
+    return address;
+  else
+    return scString("/grd-") + address;
+}
+
+static void grdFutexWait(volatile boost::uint32_t *addr, boost::uint32_t value, uint timeoutMs)
+{
+  struct timespec ts;
+  ts.tv_sec = timeoutMs / 1000;
+  ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+  syscall(SYS_futex, const_cast<boost::uint32_t *>(addr), FUTEX_WAIT, value, &ts, SC_NULL, 0);
+}
+
+static void grdFutexWake(volatile boost::uint32_t *addr)
+{
+  syscall(SYS_futex, const_cast<boost::uint32_t *>(addr), FUTEX_WAKE, INT_MAX, SC_NULL, SC_NULL, 0);
+}
+
+//----------------------------------------------------------------------------------
+// Local classes - declarations
+//----------------------------------------------------------------------------------
+/// Mapping of shared memory segment
+class grdShmSegment {
+public:
+  grdShmSegment();
+  ~grdShmSegment();
+  void create(const scString &name, uint ringCount, uint ringSize);
+  void open(const scString &name);
+  void close();
+  /// <true> if segment was left by receiver which ended without close
+  static bool isStale(const scString &name);
+  bool isOpen() const;
+  bool isClosedByOwner() const;
+  bool isOwnerAlive() const;
+  const scString &getName() const;
+  grdShmSegmentHeader *getHeader();
+  grdShmRingHeader *getRingHeader(uint index);
+  char *getRingData(uint index);
+  uint getRingCount() const;
+  uint getRingSize() const;
+  // receiver side
+  bool isRingEmpty(uint index);
+  void wakeReceiver();
+protected:
+  void map(int fd, size_t size);
+  size_t getRingOffset(uint index) const;
+  static size_t calcSegmentSize(uint ringCount, uint ringSize);
+protected:
+  scString m_name;
+  bool m_owner;
+  char *m_base;
+  size_t m_size;
+};
+
+class grdShmGate: public scMessageGate {
+public:
+  grdShmGate();
+  virtual ~grdShmGate();
+  void setProtocol(const scString &protocol);
+  void setAddress(const scString &address);
+  void setInactTimeout(uint msecs);
+  void setFormat(const scString &format);
+  virtual bool supportsProtocol(const scString &protocol);
+  virtual bool getOwnAddress(const scString &protocol, scMessageAddress &output);
+protected:
+  scString m_protocol;
+  scString m_address;
+  scString m_format;
+  uint m_inactTimeout; // inactivity timeout for connections
+};
+
+class grdShmConnectionOut: public scConnection {
+public:
+  // construction
+  grdShmConnectionOut();
+  virtual ~grdShmConnectionOut();
+  // exec
+  bool connect(const scString &address);
+  virtual void close();
+  virtual bool isConnected();
+  /// returns <false> if there is no space in ring, does not wait
+  bool trySend(const char *ptr, size_t asize);
+  scEnvSerializerBinDict &getDictSerializer();
+protected:
+  void checkConnected();
+  void claimRing();
+  void releaseRing();
+  bool isReceiverAlive();
+protected:
+  grdShmSegment m_segment;
+  int m_ringIndex;
+  bool m_receiverLost;
+  cpu_ticks m_lastAliveCheck;
+  std::auto_ptr<scEnvSerializerBinDict> m_dictSerializer; // per-ring dictionary
+};
+
+class grdShmGateInput: public grdShmGate {
+public:
+  grdShmGateInput();
+  virtual ~grdShmGateInput();
+  void setRingCount(uint value);
+  void setRingSize(uint value);
+  void setUseThread(bool value);
+  virtual void init();
+  virtual int run();
+protected:
+  int pullAll(boost::ptr_list<scEnvelope> &output, uint limit);
+  int pullRing(uint index, boost::ptr_list<scEnvelope> &output, uint limit);
+  void decodeEnvelope(const char *data, size_t dataSize, scEnvelope &output);
+  void close();
+  void runThread();
+  void startThread();
+  void stopThread();
+  bool hasPendingData();
+protected:
+  grdShmSegment m_segment;
+  uint m_ringCount;
+  uint m_ringSize;
+  bool m_useThread;
+  std::auto_ptr<scEnvelopeSerializerBase> m_serializer;
+  std::auto_ptr<scEnvSerializerBinDict> m_binSerializer;
+  // receiver thread
+  std::auto_ptr<boost::thread> m_thread;
+  volatile bool m_terminated;
+  boost::mutex m_receivedMutex;
+  boost::ptr_list<scEnvelope> m_received;
+};
+
+/// Message waiting for space in receiver ring
+class grdShmPendingMsg {
+public:
+  grdShmPendingMsg(scEnvelope *a_envelope): envelope(a_envelope), connectionId(a_envelope->getReceiver().getHost()), 
+    startTime(cpu_time_ms()) {}
+  ~grdShmPendingMsg() { delete envelope; }
+  scEnvelope *release() { scEnvelope *res = envelope; envelope = SC_NULL; return res; }
+  scEnvelope *envelope;
+  scString connectionId;
+  cpu_ticks startTime;
+};
+
+typedef boost::ptr_list<grdShmPendingMsg> grdShmPendingList;
+
+class grdShmGateOutput: public grdShmGate {
+public:
+  grdShmGateOutput();
+  virtual ~grdShmGateOutput();
+  void setSendTimeout(uint value);
+  virtual int run();
+protected:
+  bool transmitGuarded(scEnvelope *envelope);
+  bool transmitEnvelope(scEnvelope *envelope);
+  grdShmConnectionOut *findConnection(const scString &connectionId);
+  grdShmConnectionOut *prepareConnection(const scMessageAddress &address);
+protected:
+  scConnectionPool m_connections;
+  std::auto_ptr<scEnvelopeSerializerBase> m_serializer;
+  uint m_sendTimeout;
+  grdShmPendingList m_pending; // in order of arrival, for all connections
+};
+
+//----------------------------------------------------------------------------------
+// Implementation part
+//----------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------
+// grdShmSegment
+//----------------------------------------------------------------------------------
+grdShmSegment::grdShmSegment(): m_owner(false), m_base(SC_NULL), m_size(0)
+{
+}
+
+grdShmSegment::~grdShmSegment()
+{
+  close();
+}
+
+size_t grdShmSegment::calcSegmentSize(uint ringCount, uint ringSize)
+{
+  return
+    grdShmAlign(sizeof(grdShmSegmentHeader), GRD_SHM_CACHE_LINE)
+    +
+    static_cast<size_t>(ringCount) * (sizeof(grdShmRingHeader) + ringSize);
+}
+
+size_t grdShmSegment::getRingOffset(uint index) const
+{
+  return
+    grdShmAlign(sizeof(grdShmSegmentHeader), GRD_SHM_CACHE_LINE)
+    +
+    static_cast<size_t>(index) * (sizeof(grdShmRingHeader) + getRingSize());
+}
+
+void grdShmSegment::map(int fd, size_t size)
+{
+  void *ptr = mmap(SC_NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (ptr == MAP_FAILED)
+    throw scError("SHM mmap failed: "+m_name+", errno: "+toString(errno));
+  m_base = static_cast<char *>(ptr);
+  m_size = size;
+}
+
+// segment of running receiver is never taken over
+void grdShmSegment::create(const scString &name, uint ringCount, uint ringSize)
+{
+  close();
+  m_name = name;
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if ((fd < 0) && (errno == EEXIST) && isStale(name)) {
+    Log::addWarning("SHM stale segment removed: "+name);
+    shm_unlink(name.c_str());
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  }
+
+  if (fd < 0) {
+    if (errno == EEXIST)
+      throw scError("SHM segment already used by other receiver: "+name);
+    throw scError("SHM create failed: "+name+", errno: "+toString(errno));
+  }
+
+  size_t size = calcSegmentSize(ringCount, ringSize);
+  if (ftruncate(fd, size) != 0) {
+    ::close(fd);
+    shm_unlink(name.c_str());
+    throw scError("SHM resize failed: "+name+", errno: "+toString(errno));
+  }
+
+  try {
+    map(fd, size);
+  } catch(...) {
+    shm_unlink(name.c_str());
+    throw;
+  }
+  m_owner = true;
+
+  // new segment is zero-filled
+  grdShmSegmentHeader *header = getHeader();
+  header->ownerPid = static_cast<boost::uint32_t>(getpid());
+  header->ringCount = ringCount;
+  header->ringSize = ringSize;
+  header->version = GRD_SHM_VERSION;
+  __sync_synchronize();
+  header->magic = GRD_SHM_MAGIC;
+}
+
+void grdShmSegment::open(const scString &name)
+{
+  close();
+  m_name = name;
+
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0)
+    throw scError("SHM open failed: "+name+", errno: "+toString(errno));
+
+  struct stat info;
+  if ((fstat(fd, &info) != 0) || (static_cast<size_t>(info.st_size) < sizeof(grdShmSegmentHeader))) {
+    ::close(fd);
+    throw scError("SHM segment not ready: "+name);
+  }
+
+  map(fd, info.st_size);
+
+  grdShmSegmentHeader *header = getHeader();
+  if ((header->magic != GRD_SHM_MAGIC) || (header->version != GRD_SHM_VERSION) ||
+      (calcSegmentSize(header->ringCount, header->ringSize) > m_size))
+  {
+    close();
+    throw scError("SHM segment has wrong format: "+name);
+  }
+}
+
+void grdShmSegment::close()
+{
+  if (m_base != SC_NULL) {
+    if (m_owner) {
+      getHeader()->closed = 1;
+      __sync_synchronize();
+    }
+    munmap(m_base, m_size);
+    m_base = SC_NULL;
+    m_size = 0;
+  }
+  if (m_owner) {
+    shm_unlink(m_name.c_str());
+    m_owner = false;
+  }
+}
+
+// segment with wrong format is treated as stale too - it is also left
+// by receiver which ended during create
+bool grdShmSegment::isStale(const scString &name)
+{
+  grdShmSegment segment;
+  try {
+    segment.open(name);
+  }
+  catch(const scError &e) {
+    return true;
+  }
+  return segment.isClosedByOwner() || !segment.isOwnerAlive();
+}
+
+bool grdShmSegment::isOpen() const
+{
+  return (m_base != SC_NULL);
+}
+
+bool grdShmSegment::isClosedByOwner() const
+{
+  return (reinterpret_cast<const grdShmSegmentHeader *>(m_base)->closed != 0);
+}
+
+// receiver killed without close() leaves segment & "closed" flag unchanged
+bool grdShmSegment::isOwnerAlive() const
+{
+  boost::uint32_t pid = reinterpret_cast<const grdShmSegmentHeader *>(m_base)->ownerPid;
+  if (pid == 0)
+    return true;
+  return !((kill(static_cast<pid_t>(pid), 0) != 0) && (errno == ESRCH));
+}
+
+const scString &grdShmSegment::getName() const
+{
+  return m_name;
+}
+
+grdShmSegmentHeader *grdShmSegment::getHeader()
+{
+  return reinterpret_cast<grdShmSegmentHeader *>(m_base);
+}
+
+grdShmRingHeader *grdShmSegment::getRingHeader(uint index)
+{
+  return reinterpret_cast<grdShmRingHeader *>(m_base + getRingOffset(index));
+}
+
+char *grdShmSegment::getRingData(uint index)
+{
+  return m_base + getRingOffset(index) + sizeof(grdShmRingHeader);
+}
+
+uint grdShmSegment::getRingCount() const
+{
+  return reinterpret_cast<const grdShmSegmentHeader *>(m_base)->ringCount;
+}
+
+uint grdShmSegment::getRingSize() const
+{
+  return reinterpret_cast<const grdShmSegmentHeader *>(m_base)->ringSize;
+}
+
+bool grdShmSegment::isRingEmpty(uint index)
+{
+  grdShmRingHeader *ring = getRingHeader(index);
+  return (ring->head == ring->tail);
+}
+
+void grdShmSegment::wakeReceiver()
+{
+  grdShmSegmentHeader *header = getHeader();
+  __sync_synchronize();
+  if (header->receiverWaiting != 0) {
+    __sync_fetch_and_add(&header->bell, 1);
+    grdFutexWake(&header->bell);
+  }
+}
+
+//----------------------------------------------------------------------------------
+// grdShmGate
+//----------------------------------------------------------------------------------
+grdShmGate::grdShmGate(): scMessageGate()
+{
+  m_inactTimeout = GRD_SHM_DEF_INACT_CONN_TIMEOUT;
+  m_format = GRD_SHM_FORMAT_BIN;
+}
+
+grdShmGate::~grdShmGate()
+{
+}
+
+void grdShmGate::setProtocol(const scString &protocol)
+{
+  m_protocol = protocol;
+}
+
+void grdShmGate::setAddress(const scString &address)
+{
+  m_address = address;
+}
+
+void grdShmGate::setInactTimeout(uint msecs)
+{
+  m_inactTimeout = msecs;
+}
+
+void grdShmGate::setFormat(const scString &format)
+{
+  if ((format != GRD_SHM_FORMAT_JSON) && (format != GRD_SHM_FORMAT_BIN))
+    throw scError("Unknown SHM message format: "+format);
+  m_format = format;
+}
+
+bool grdShmGate::supportsProtocol(const scString &protocol)
+{
+  return (m_protocol == protocol);
+}
+
+bool grdShmGate::getOwnAddress(const scString &protocol, scMessageAddress &output)
+{
+  bool res = false;
+  if (protocol == m_protocol)
+  {
+    output.clear();
+    output.setProtocol(protocol);
+    output.setHost(m_address);
+    output.setNode(getOwnerName());
+    res = true;
+  }
+  return res;
+}
+
+//----------------------------------------------------------------------------------
+// grdShmGateInput
+//----------------------------------------------------------------------------------
+grdShmGateInput::grdShmGateInput(): grdShmGate(),
+  m_ringCount(GRD_SHM_DEF_RING_COUNT), m_ringSize(GRD_SHM_DEF_RING_SIZE),
+  m_useThread(false), m_terminated(false)
+{
+  m_serializer.reset(new scEnvSerializerJsonYajl());
+  m_binSerializer.reset(new scEnvSerializerBinDict());
+}
+
+grdShmGateInput::~grdShmGateInput()
+{
+  stopThread();
+  close();
+}
+
+void grdShmGateInput::setRingCount(uint value)
+{
+  m_ringCount = (value > 0)?value:1;
+}
+
+// ring size is rounded up to power of 2
+void grdShmGateInput::setRingSize(uint value)
+{
+  uint size = GRD_SHM_MIN_RING_SIZE;
+  while(size < value)
+    size *= 2;
+  m_ringSize = size;
+}
+
+void grdShmGateInput::setUseThread(bool value)
+{
+  m_useThread = value;
+}
+
+void grdShmGateInput::close()
+{
+  m_segment.close();
+}
+
+void grdShmGateInput::init()
+{
+  m_segment.create(grdShmSegmentName(m_address), m_ringCount, m_ringSize);
+  if (m_useThread)
+    startThread();
+}
+
+int grdShmGateInput::run()
+{
+  int res = 0;
+  boost::ptr_list<scEnvelope> received;
+
+  if (m_useThread) {
+    boost::mutex::scoped_lock l(m_receivedMutex);
+    received.transfer(received.end(), m_received);
+  } else if (m_segment.isOpen()) {
+    pullAll(received, UINT_MAX);
+  }
+
+  while(!received.empty())
+  {
+    std::auto_ptr<scEnvelope> guard(received.pop_front().release());
+    handleMsgReceived(*guard);
+    put(guard.release());
+    res++;
+  }
+  return res;
+}
+
+int grdShmGateInput::pullAll(boost::ptr_list<scEnvelope> &output, uint limit)
+{
+  int res = 0;
+  for(uint i=0, epos = m_segment.getRingCount(); (i != epos) && (output.size() < limit); i++)
+  {
+    if (!m_segment.isRingEmpty(i))
+      res += pullRing(i, output, limit);
+  }
+  return res;
+}
+
+// envelopes are decoded directly from shared memory,
+// space is released after each record
+int grdShmGateInput::pullRing(uint index, boost::ptr_list<scEnvelope> &output, uint limit)
+{
+  int res = 0;
+  grdShmRingHeader *ring = m_segment.getRingHeader(index);
+  const char *data = m_segment.getRingData(index);
+  boost::uint64_t ringSize = m_segment.getRingSize();
+  boost::uint64_t head = ring->head;
+  boost::uint64_t tail = ring->tail;
+  __sync_synchronize();
+
+  while((head != tail) && (output.size() < limit))
+  {
+    size_t offset = static_cast<size_t>(head & (ringSize - 1));
+    boost::uint32_t recordLen;
+    memcpy(&recordLen, data + offset, sizeof(recordLen));
+
+    if (recordLen == GRD_SHM_WRAP_MARKER) {
+      head += ringSize - offset;
+    } else if (recordLen > ringSize - offset - sizeof(recordLen)) {
+      Log::addError("SHM ring corrupted, skipping data, ring: "+toString(index));
+      head = tail;
+    } else {
+      std::auto_ptr<scEnvelope> guard(new scEnvelope());
+      head += grdShmRecordSize(recordLen);
+      try {
+        decodeEnvelope(data + offset + sizeof(recordLen), recordLen, *guard);
+        Counter::inc("msg-size", recordLen);
+        output.push_back(guard.release());
+        res++;
+      }
+      catch(const std::exception &e) {
+        Log::addError(scString("SHM message decode failed: ")+e.what());
+      }
+    }
+
+    // release space after record is decoded
+    __sync_synchronize();
+    ring->head = head;
+  }
+  return res;
+}
+
+void grdShmGateInput::decodeEnvelope(const char *data, size_t dataSize, scEnvelope &output)
+{
+  if (scEnvSerializerBinDict::isBinaryFrame(data, dataSize))
+    m_binSerializer->convFromBuffer(data, dataSize, output);
+  else
+    m_serializer->convFromString(scString(data, dataSize), output);
+}
+
+bool grdShmGateInput::hasPendingData()
+{
+  for(uint i=0, epos = m_segment.getRingCount(); i != epos; i++)
+    if (!m_segment.isRingEmpty(i))
+      return true;
+  return false;
+}
+
+void grdShmGateInput::startThread()
+{
+  m_terminated = false;
+  m_thread.reset(new boost::thread(boost::bind(&grdShmGateInput::runThread, this)));
+}
+
+void grdShmGateInput::stopThread()
+{
+  if (m_thread.get() == SC_NULL)
+    return;
+
+  m_terminated = true;
+  grdShmSegmentHeader *header = m_segment.getHeader();
+  __sync_fetch_and_add(&header->bell, 1);
+  grdFutexWake(&header->bell);
+  m_thread->join();
+  m_thread.reset();
+}
+
+// receiver thread: decodes envelopes & sleeps on futex when all rings are empty
+void grdShmGateInput::runThread()
+{
+  grdShmSegmentHeader *header = m_segment.getHeader();
+  boost::ptr_list<scEnvelope> received;
+
+  while(!m_terminated)
+  {
+    uint waiting;
+    {
+      boost::mutex::scoped_lock l(m_receivedMutex);
+      waiting = m_received.size();
+    }
+
+    int pulled = 0;
+    if (waiting < GRD_SHM_INPUT_QUEUE_LIMIT)
+      pulled = pullAll(received, GRD_SHM_INPUT_QUEUE_LIMIT - waiting);
+
+    if (pulled > 0) {
+      boost::mutex::scoped_lock l(m_receivedMutex);
+      m_received.transfer(m_received.end(), received);
+    } else if (waiting >= GRD_SHM_INPUT_QUEUE_LIMIT) {
+      // scheduler is not consuming, senders will be blocked by full rings
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    } else {
+      boost::uint32_t bell = header->bell;
+      header->receiverWaiting = 1;
+      __sync_synchronize();
+      if (!hasPendingData() && !m_terminated)
+        grdFutexWait(&header->bell, bell, GRD_SHM_WAIT_TIMEOUT);
+      header->receiverWaiting = 0;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------
+// grdShmGateOutput
+//----------------------------------------------------------------------------------
+grdShmGateOutput::grdShmGateOutput(): grdShmGate(), m_sendTimeout(GRD_SHM_DEF_SEND_TIMEOUT)
+{
+  m_serializer.reset(new scEnvSerializerJsonYajl());
+}
+
+grdShmGateOutput::~grdShmGateOutput()
+{
+}
+
+void grdShmGateOutput::setSendTimeout(uint value)
+{
+  m_sendTimeout = value;
+}
+
+// scheduler thread is never blocked by full ring: message waits in pending 
+// list (keeping order per receiver) until space is released or send 
+// timeout elapses
+int grdShmGateOutput::run()
+{
+  int res = 0;
+  std::set<scString> fullRings;
+
+  m_connections.checkActive();
+
+  while(!empty())
+    m_pending.push_back(new grdShmPendingMsg(get()));
+
+  grdShmPendingList::iterator it = m_pending.begin();
+  while(it != m_pending.end())
+  {
+    bool done = false;
+    if (fullRings.find(it->connectionId) == fullRings.end()) {
+      done = transmitGuarded(it->envelope);
+      if (!done)
+        fullRings.insert(it->connectionId);
+    }
+
+    if (!done && is_cpu_time_elapsed_ms(it->startTime, m_sendTimeout)) {
+      scString msg = scString("SHM ring full, receiver not responding");
+      scString dets = scString("out-addr: ") + it->envelope->getReceiver().getAsString();
+      handleTransmitError(*it->envelope, SC_MSG_STATUS_EXCEPTION, msg, dets);
+      done = true;
+    }
+
+    if (done) {
+      it = m_pending.erase(it);
+      res++;
+    } else {
+      ++it;
+    }
+  } // while
+
+  return res;
+}
+
+// returns <false> if message has to wait for space in ring
+bool grdShmGateOutput::transmitGuarded(scEnvelope *envelope)
+{
+  try {
+    return transmitEnvelope(envelope);
+  }
+  catch (scError &e) {
+    e.addDetails(scDataNode(envelope->getReceiver().getAsString()));
+    handleTransmitError(*envelope, e);
+  }
+  catch(const std::exception& e) {
+    scString msg = scString("SHM-Transmit - exception (std): ") + e.what();
+    scString dets = scString("out-addr: ") + envelope->getReceiver().getAsString();
+    handleTransmitError(*envelope, SC_MSG_STATUS_EXCEPTION, msg, dets);
+  }
+  catch(...) {
+    scString msg = scString("SHM-Transmit - exception (unknown)");
+    scString dets = scString("out-addr: ") + envelope->getReceiver().getAsString();
+    handleTransmitError(*envelope, SC_MSG_STATUS_EXCEPTION, msg, dets);
+  }
+  return true;
+}
+
+bool grdShmGateOutput::transmitEnvelope(scEnvelope *envelope)
+{
+  scString dataStr;
+  scString connectionId = envelope->getReceiver().getHost();
+
+  grdShmConnectionOut *item = prepareConnection(envelope->getReceiver());
+  if (item == SC_NULL)
+    throw scError("shm gate.execute failed - connection failed");
+
+  if (m_format == GRD_SHM_FORMAT_BIN)
+    item->getDictSerializer().convToString(*envelope, dataStr);
+  else
+    m_serializer->convToString(*envelope, dataStr);
+
+#ifdef SC_TIMER_ENABLED
+  Timer::start("msg-total");
+  Timer::start("msg-execute-shm");
+#endif
+
+  bool sent;
+  try {
+    sent = item->trySend(dataStr.c_str(), dataStr.length());
+  }
+  catch(...) {
+    if (m_format == GRD_SHM_FORMAT_BIN)
+      item->getDictSerializer().rollbackFrame();
+    // receiver restarted or ring lost - connect again on next message
+    if (!item->isConnected())
+      m_connections.remove(connectionId);
+    throw;
+  }
+
+#ifdef SC_TIMER_ENABLED
+  Timer::stop("msg-execute-shm");
+  Timer::stop("msg-total");
+#endif
+
+  if (!sent) {
+    // frame will be encoded again when there is space
+    if (m_format == GRD_SHM_FORMAT_BIN)
+      item->getDictSerializer().rollbackFrame();
+    return false;
+  }
+
+  Counter::inc("msg-total");
+  Counter::inc("msg-size", dataStr.length());
+  handleMsgReadyForSend(*envelope);
+  handleMsgSent(*envelope);
+  return true;
+}
+
+grdShmConnectionOut *grdShmGateOutput::prepareConnection(const scMessageAddress &address)
+{
+  scString host = address.getHost();
+
+  scString connectionId = host;
+  scString connectionStr;
+
+  if (m_address.empty())
+    connectionStr = host;
+  else
+    connectionStr = m_address;
+
+  grdShmConnectionOut *item = findConnection(connectionId);
+  if (item == SC_NULL)
+  {
+    std::auto_ptr<grdShmConnectionOut> connGuard;
+    connGuard.reset(new grdShmConnectionOut());
+
+#ifdef SC_TIMER_ENABLED
+  Timer::start("msg-total");
+  Timer::start("msg-connect-shm");
+#endif
+    connGuard.get()->connect(grdShmSegmentName(connectionStr));
+#ifdef SC_TIMER_ENABLED
+  Timer::stop("msg-connect-shm");
+  Timer::stop("msg-total");
+#endif
+    item = connGuard.get();
+    item->setInactTimeout(this->m_inactTimeout);
+    m_connections.add(connectionId, connGuard.release());
+  }
+  return item;
+}
+
+grdShmConnectionOut *grdShmGateOutput::findConnection(const scString &connectionId)
+{
+  grdShmConnectionOut *res = dynamic_cast<grdShmConnectionOut *>(m_connections.find(connectionId));
+  return res;
+}
+
+//----------------------------------------------------------------------------------
+// grdShmConnectionOut
+//----------------------------------------------------------------------------------
+grdShmConnectionOut::grdShmConnectionOut(): scConnection(), m_ringIndex(-1), m_receiverLost(false),
+  m_lastAliveCheck(0)
+{
+}
+
+grdShmConnectionOut::~grdShmConnectionOut()
+{
+  performAutoClose();
+  close();
+}
+
+bool grdShmConnectionOut::isConnected()
+{
+  return m_segment.isOpen() && (m_ringIndex >= 0) && !m_segment.isClosedByOwner() && isReceiverAlive();
+}
+
+// process check is a syscall, so it is performed at most once per second
+bool grdShmConnectionOut::isReceiverAlive()
+{
+  if (m_receiverLost)
+    return false;
+
+  if ((m_lastAliveCheck == 0) || is_cpu_time_elapsed_ms(m_lastAliveCheck, GRD_SHM_ALIVE_CHECK_DELAY)) {
+    m_lastAliveCheck = cpu_time_ms();
+    if (!m_segment.isOwnerAlive()) {
+      Log::addWarning("SHM receiver process not running, segment: "+m_segment.getName());
+      m_receiverLost = true;
+    }  
+  }
+
+  return !m_receiverLost;
+}
+
+bool grdShmConnectionOut::connect(const scString &address)
+{
+  bool res = isConnected();
+  if (!res) {
+    try {
+      m_segment.open(address);
+      m_receiverLost = false;
+      m_lastAliveCheck = 0;
+      if (!isReceiverAlive())
+        throw scError("SHM receiver not running: "+address);
+      claimRing();
+    } catch(...) {
+      m_segment.close();
+      throw;
+    }
+    res = true;
+  }
+  signalConnected();
+  return res;
+}
+
+// ring of dead sender process can be reused
+void grdShmConnectionOut::claimRing()
+{
+  boost::uint32_t pid = static_cast<boost::uint32_t>(getpid());
+  for(uint i=0, epos = m_segment.getRingCount(); i != epos; i++)
+  {
+    grdShmRingHeader *ring = m_segment.getRingHeader(i);
+    boost::uint32_t owner = ring->owner;
+    if ((owner == 0) || ((owner != pid) && (kill(static_cast<pid_t>(owner), 0) != 0) && (errno == ESRCH)))
+    {
+      if (__sync_bool_compare_and_swap(&ring->owner, owner, pid)) {
+        m_ringIndex = i;
+        // new sender starts with new dictionary
+        if (m_dictSerializer.get() != SC_NULL)
+          m_dictSerializer->resetDictionary();
+        return;
+      }
+    }
+  }
+  throw scError("SHM - no free ring");
+}
+
+void grdShmConnectionOut::releaseRing()
+{
+  if ((m_ringIndex >= 0) && m_segment.isOpen()) {
+    boost::uint32_t pid = static_cast<boost::uint32_t>(getpid());
+    __sync_bool_compare_and_swap(&m_segment.getRingHeader(m_ringIndex)->owner, pid, 0);
+  }
+  m_ringIndex = -1;
+}
+
+void grdShmConnectionOut::close()
+{
+  releaseRing();
+  m_segment.close();
+}
+
+void grdShmConnectionOut::checkConnected()
+{
+  if (!isConnected())
+    throw scError("SHM connection not active!");
+}
+
+bool grdShmConnectionOut::trySend(const char *ptr, size_t asize)
+{
+  checkConnected();
+
+  boost::uint64_t ringSize = m_segment.getRingSize();
+  size_t recordSize = grdShmRecordSize(asize);
+  if (recordSize > ringSize / 2)
+    throw scError("SHM message too long ("+toString(asize)+")");
+
+  grdShmRingHeader *ring = m_segment.getRingHeader(m_ringIndex);
+  char *data = m_segment.getRingData(m_ringIndex);
+  boost::uint64_t tail = ring->tail;
+  // acquire: space is written only after receiver finished reading it
+  boost::uint64_t head = ring->head;
+  __sync_synchronize();
+  size_t offset = static_cast<size_t>(tail & (ringSize - 1));
+  size_t tailRoom = static_cast<size_t>(ringSize - offset);
+  bool wrap = (recordSize > tailRoom);
+  size_t needed = wrap?(recordSize + tailRoom):recordSize;
+
+  if (ringSize - (tail - head) < needed) {
+    Counter::inc("msg-shm-full");
+    return false;
+  }
+
+  if (wrap) {
+    memcpy(data + offset, &GRD_SHM_WRAP_MARKER, sizeof(GRD_SHM_WRAP_MARKER));
+    tail += tailRoom;
+    offset = 0;
+  }
+
+  boost::uint32_t recordLen = static_cast<boost::uint32_t>(asize);
+  memcpy(data + offset, &recordLen, sizeof(recordLen));
+  memcpy(data + offset + sizeof(recordLen), ptr, asize);
+
+  // publish record
+  __sync_synchronize();
+  ring->tail = tail + recordSize;
+
+  m_segment.wakeReceiver();
+  signalUsed();
+  return true;
+}
+
+scEnvSerializerBinDict &grdShmConnectionOut::getDictSerializer()
+{
+  if (m_dictSerializer.get() == SC_NULL)
+    m_dictSerializer.reset(new scEnvSerializerBinDict());
+  return *m_dictSerializer;
+}
+
+//----------------------------------------------------------------------------------
+// grdShmGateFactory
+//----------------------------------------------------------------------------------
+grdShmGateFactory::grdShmGateFactory(): scGateFactory()
+{
+}
+
+grdShmGateFactory::~grdShmGateFactory()
+{
+}
+
+scMessageGate *grdShmGateFactory::createGate(bool input, const scDataNode &params, const scString &protocol) const
+{
+  std::auto_ptr<grdShmGate> res;
+  if (input) {
+    grdShmGateInput *inputGate = new grdShmGateInput();
+    res.reset(inputGate);
+    if (params.size()>0)
+      inputGate->setAddress(params.getString(0));
+    if (params.hasChild("rings"))
+      inputGate->setRingCount(params.getUInt("rings"));
+    if (params.hasChild("ring_size"))
+      inputGate->setRingSize(params.getUInt("ring_size"));
+    if (params.hasChild("thread"))
+      inputGate->setUseThread(params.getBool("thread"));
+  }
+  else {
+    grdShmGateOutput *outputGate = new grdShmGateOutput();
+    res.reset(outputGate);
+    if (params.size()>0)
+      outputGate->setAddress(params.getString(0));
+
+    if (params.size()>1) {
+      uint timeout = params.getUInt(1);
+      outputGate->setInactTimeout(timeout);
+    }
+
+    if (params.hasChild("send_timeout"))
+      outputGate->setSendTimeout(params.getUInt("send_timeout"));
+  }
+
+  if (params.hasChild("format"))
+    res->setFormat(params.getString("format"));
+
+  res->setProtocol(protocol);
+  return res.release();
+}
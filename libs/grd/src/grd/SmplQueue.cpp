@@ -11,14 +11,21 @@
 //std
 #include <memory>
 #include <set>
+#include <map>
+#include <queue>
+#include <vector>
+#include <deque>
+#include <functional>
 
 //boost
 #include "boost/ptr_container/ptr_map.hpp"
 #include "boost/ptr_container/ptr_list.hpp"
+#include "boost/ptr_container/ptr_vector.hpp"
 
 //sc
 #include "sc/utils.h"
 #include "sc/dtypes.h"
+#include "sc/proc/process.h"
 #include "perf/Log.h"
 #include "perf/time_utils.h"
 #include "perf/Timer.h"
@@ -60,16 +67,83 @@ public:
   virtual bool hasMessageForReader(scSmplQueueReaderTask *reader);
 };
 
+enum scMultiCastAggregate {
+  smaEach,   ///< every reader response is returned to sender
+  smaFirst,  ///< first successful response
+  smaAll,    ///< list of responses from all readers
+  smaQuorum  ///< list of responses when quorum of readers succeeded
+};
+
+/// responses collected from readers for one multicast message
+class scMultiCastRequest {
+public:
+  scMultiCastRequest(const scMessageAddress &sender, uint requestId, const scStringList &readerTargets);
+  virtual ~scMultiCastRequest() {};
+  void addResponse(const scString &readerTarget, const scResponse &response);
+  /// <true> if response from reader is still expected
+  bool isPending(const scString &readerTarget) const { return (m_pending.find(readerTarget) != m_pending.end()); }
+  const scMessageAddress &getSender() const { return m_sender; }
+  uint getRequestId() const { return m_requestId; }
+  uint getExpected() const { return m_expected; }
+  uint getReceived() const { return m_received; }
+  uint getOkCount() const { return m_okCount; }
+  uint getFailedCount() const { return m_received - m_okCount; }
+  bool isComplete() const { return (m_received >= m_expected); }
+  bool isAnswered() const { return m_answered; }
+  void setAnswered() { m_answered = true; }
+  int getLastErrorStatus() const { return m_lastErrorStatus; }
+  /// list of {reader, status, result|error}
+  const scDataNode &getItems() const { return m_items; }
+protected:
+  scMessageAddress m_sender;
+  uint m_requestId;
+  uint m_expected;
+  uint m_received;
+  uint m_okCount;
+  bool m_answered;
+  int m_lastErrorStatus;
+  scDataNode m_items;
+  std::multiset<scString> m_pending; ///< readers which did not respond yet
+};
+
+typedef boost::ptr_map<scString, scMultiCastRequest> scMultiCastRequestMap;
+
 /// sends each message to every connected reader
 class scSmplQueueManagerTaskMultiCast: public scSmplQueueManagerTask {
 public:
-  scSmplQueueManagerTaskMultiCast(bool allowSenderAsReader): scSmplQueueManagerTask(allowSenderAsReader) {};
+  scSmplQueueManagerTaskMultiCast(bool allowSenderAsReader): scSmplQueueManagerTask(allowSenderAsReader), 
+    m_aggregate(smaEach), m_quorum(0) {};
   virtual ~scSmplQueueManagerTaskMultiCast() {};
+  /// each message is posted once to this address (e.g. pgm/epgm publisher) 
+  /// instead of forwarding it to each reader
+  void setBroadcastAddr(const scString &value);
+  /// how reader responses are returned to sender: each, first, all, quorum
+  void setAggregate(const scString &value);
+  /// number of successful responses required in quorum mode, 0 - majority of readers
+  void setQuorum(uint value);
   virtual bool get(scEnvelope &a_envelope);
   virtual int handleMessage(scEnvelope &envelope, scResponse &response);
   virtual bool needsRun();
   virtual int intRun();
   virtual bool hasMessageForReader(scSmplQueueReaderTask *reader);
+  virtual void removeReader(scSmplQueueReaderTask *reader);
+  virtual bool handleReaderResponse(
+    scSmplQueueReaderTask &reader, const scString &readerTarget, 
+    const scEnvelope &envelope, const scResponse &response
+  );
+protected:
+  void broadcastEnvelope(const scEnvelope &envelope);
+  void shareEncodedParams(scEnvelope &envelope);
+  scString getRequestKey(const scEnvelope &envelope) const;
+  void startAggregate(const scEnvelope &envelope, const scStringList &readerTargets);
+  uint getQuorumFor(const scMultiCastRequest &request) const;
+  void checkAggregate(scMultiCastRequest &request, const scResponse &lastResponse);
+  void sendAggregateResponse(scMultiCastRequest &request, const scResponse &response);
+protected:
+  scString m_broadcastAddr;
+  scMultiCastAggregate m_aggregate;
+  uint m_quorum;
+  scMultiCastRequestMap m_requests; ///< sender+request ID -> collected responses
 };
 
 class scDurableRequestInfo
@@ -81,6 +155,7 @@ public:
   virtual ~scDurableRequestInfo();
   cpu_ticks getStartTime() const; 
   uint getRetryCount();
+  void setRetryCount(uint value);
   void incRetryCount();
   void resetStartTime();
   void setStartTime(cpu_ticks ticks);
@@ -98,6 +173,20 @@ protected:
 
 typedef boost::ptr_map<uint,scDurableRequestInfo> scDurableRequestInfoMap;
 
+/// Time when request needs to be checked (retry start, result / store timeout)
+struct scDurableDeadline {
+  scDurableDeadline(cpu_ticks a_time, uint a_reqId): time(a_time), reqId(a_reqId) {}
+  bool operator>(const scDurableDeadline &rhs) const { return time > rhs.time; }
+  cpu_ticks time;
+  uint reqId;
+};
+
+/// min-heap, entries are not removed on change - they are verified when due
+typedef std::priority_queue<scDurableDeadline, std::vector<scDurableDeadline>, std::greater<scDurableDeadline> > scDurableDeadlineHeap;
+typedef std::map<uint, scEnvelopeColn::iterator> scDurableWaitingIndex;
+typedef boost::ptr_map<uint, scEnvelope> scDurableDelayedMap;
+typedef std::map<scString, scSmplQueueReaderTask *> scDurableReaderIndex;
+
 /// sends message to first available reader
 class scSmplQueueManagerTaskDurable: public scSmplQueueManagerTask {
   typedef scSmplQueueManagerTask inherited;
@@ -105,7 +194,8 @@ public:
   // create
   scSmplQueueManagerTaskDurable(bool allowSenderAsReader, bool durable): 
     scSmplQueueManagerTask(allowSenderAsReader), 
-    m_durable(durable), m_retryLimit(0), m_retryDelay(0), m_contactTimeout(0), m_resultTimeout(0), m_storeTimeout(0) 
+    m_durable(durable), m_retryLimit(0), m_retryDelay(0), m_contactTimeout(0), m_resultTimeout(0), m_storeTimeout(0),
+    m_readerIndexValid(false), m_readersRemoved(false)
     {};
   virtual ~scSmplQueueManagerTaskDurable() {};
   // properties
@@ -118,15 +208,30 @@ public:
   // run
   virtual bool get(scEnvelope &a_envelope);
   virtual void put(const scEnvelope &envelope);  
+  virtual void clearQueue();
+  virtual size_t getWaitingCount() const;
+  virtual bool releaseWaiting(scEnvelope &output);
+  virtual void addReader(scSmplQueueReaderTask *reader);
+  virtual void removeReader(scSmplQueueReaderTask *reader);
   virtual bool handleReaderResponse(
     scSmplQueueReaderTask &reader, const scString &readerTarget, 
     const scEnvelope &envelope, const scResponse &response
   );
   virtual void handleEnvelopeSent(scSmplQueueReaderTask *reader, const scEnvelope &envelope);
+  virtual void putBack(scSmplQueueReaderTask *reader, const scEnvelope &envelope);
   bool handleRequestError(uint reqId, const scEnvelope &envelope, const scResponse &response);
 protected:  
   void putRetry(const scEnvelope &envelope);
   void intPut(const scEnvelope &envelope, bool retry);
+  /// returns <false> if request was spilled (request info is moved to disk)
+  bool putReady(scEnvelope *envelope, uint reqId, bool retry);
+  virtual void appendReady(scEnvelope *envelope, uint reqId);
+  bool takeWaiting(uint reqId, scEnvelope &a_envelope);
+  virtual void pageIn();
+  void promoteDelayed();
+  scEnvelope *findWaiting(uint reqId);
+  scSmplQueueReaderTask *findReaderTask(const scString &name);
+  bool isRequestOutdated(scDurableRequestInfo &info);
   uint getRetryCount(uint reqId);
   void clearRequestInfo(uint reqId);
   void prepareRetry(uint reqId, const scEnvelope &envelope);
@@ -135,6 +240,7 @@ protected:
   virtual int intRun();
   bool sendRequestFailed(uint reqId, int statusCode);
   bool sendRequestFailed(uint reqId, const scResponse &response);
+  void postRequestFailed(const scMessageAddress &sender, uint reqId, const scResponse &response);
   void eraseFromWaiting(uint reqId);
 protected:
   bool m_durable;  
@@ -144,6 +250,13 @@ protected:
   cpu_ticks m_resultTimeout;
   cpu_ticks m_storeTimeout;
   scDurableRequestInfoMap m_requestMap;
+  scDurableWaitingIndex m_waitingIndex; // position of request in ready FIFO (m_waiting)
+  scDurableDelayedMap m_delayed;        // retries waiting for start time
+  scDurableDeadlineHeap m_retryHeap;    // start times of m_delayed
+  scDurableDeadlineHeap m_timeoutHeap;  // result & store timeouts
+  scDurableReaderIndex m_readerIndex;   // reader name -> reader
+  bool m_readerIndexValid;
+  bool m_readersRemoved;                // requests of removed readers need check
 };
 
 /// send message to next available reader
@@ -176,6 +289,112 @@ public:
   virtual bool hasMessageForReader(scSmplQueueReaderTask *reader);
 };
 
+/// sends message to reader with lowest expected wait time:
+/// (in-flight + 1) * avg-response-time / capacity
+class scSmplQueueManagerTaskLeastLoaded: public scSmplQueueManagerTaskDurable {
+  typedef scSmplQueueManagerTaskDurable inherited;
+public:
+  scSmplQueueManagerTaskLeastLoaded(bool allowSenderAsReader, bool durable): 
+    scSmplQueueManagerTaskDurable(allowSenderAsReader, durable), 
+    m_leastLoaded(SC_NULL), m_leastLoadedTime(0), m_leastLoadedValid(false) {};
+  virtual ~scSmplQueueManagerTaskLeastLoaded() {};
+  virtual void addReader(scSmplQueueReaderTask *reader);
+  virtual void removeReader(scSmplQueueReaderTask *reader);
+  virtual bool hasMessageForReader(scSmplQueueReaderTask *reader);
+  virtual bool canTakeNext(scSmplQueueReaderTask *reader);
+  virtual void handleEnvelopeAccepted(scSmplQueueReaderTask *reader, const scEnvelope &envelope);
+  virtual bool handleReaderResponse(
+    scSmplQueueReaderTask &reader, const scString &readerTarget, 
+    const scEnvelope &envelope, const scResponse &response);
+protected:
+  scSmplQueueReaderTask *getLeastLoaded();
+  scSmplQueueReaderTask *findLeastLoaded();
+  double calcExpectedWait(scSmplQueueReaderTask *reader, double defRespTime);
+private:
+  scString m_lastAcceptedReader;
+  scSmplQueueReaderTask *m_leastLoaded; ///< cached result of findLeastLoaded, only compared
+  cpu_ticks m_leastLoadedTime;
+  bool m_leastLoadedValid;
+};
+
+/// sends messages with the same key to the same reader,
+/// key is a value of param (key_path, "." separated), request ID if not found;
+/// reader is selected using consistent hashing - only keys of joining / leaving 
+/// reader are moved
+class scSmplQueueManagerTaskKeyed: public scSmplQueueManagerTaskDurable {
+  typedef scSmplQueueManagerTaskDurable inherited;
+  typedef std::deque<uint> scKeyedRequestList;
+  typedef std::map<scString, scKeyedRequestList> scKeyedQueueMap;
+  typedef std::map<uint, std::set<scString> > scKeyedRejectMap;
+public:
+  scSmplQueueManagerTaskKeyed(bool allowSenderAsReader, bool durable): 
+    scSmplQueueManagerTaskDurable(allowSenderAsReader, durable), m_ring(GRD_SQUEUE_KEYED_VNODES), 
+    m_ringValid(false), m_ringCheckTime(0), m_ringReadersHash(0) {};
+  virtual ~scSmplQueueManagerTaskKeyed() {};
+  void setKeyPath(const scString &value);
+  virtual bool getForReader(scSmplQueueReaderTask *reader, scEnvelope &a_envelope);
+  virtual bool hasMessageForReader(scSmplQueueReaderTask *reader);
+  virtual void clearQueue();
+  virtual void addReader(scSmplQueueReaderTask *reader);
+  virtual void removeReader(scSmplQueueReaderTask *reader);
+  virtual void putBack(scSmplQueueReaderTask *reader, const scEnvelope &envelope);
+protected:
+  virtual void appendReady(scEnvelope *envelope, uint reqId);
+  scString extractKey(const scEnvelope &envelope);
+  scString findKeyOwner(const scString &key, uint reqId);
+  bool isRingReader(scSmplQueueReaderTask *reader);
+  uint calcRingReadersHash();
+  void checkRing();
+  void rebuildRing();
+  bool findNextFor(const scString &target, uint &reqId);
+protected:
+  scString m_keyPath;
+  grdHashRing m_ring;      // reader targets
+  bool m_ringValid;
+  cpu_ticks m_ringCheckTime;
+  uint m_ringReadersHash;  // readers on ring, see calcRingReadersHash
+  scKeyedQueueMap m_keyQueues; // reader target -> ready requests
+  scKeyedRejectMap m_rejected; // request ID -> readers which gave message back
+};
+
+typedef std::vector<scSmplQueueManagerTask *> scSmplQueueShardList;
+
+/// logical queue served by several manager tasks (shards), stores nothing itself:
+/// puts are spread between shards, readers are connected to shard with 
+/// the lowest number of readers, shard with idle readers steals messages from busy one
+class scSmplQueueManagerTaskSharded: public scSmplQueueManagerTask {
+  typedef scSmplQueueManagerTask inherited;
+public:
+  scSmplQueueManagerTaskSharded(bool allowSenderAsReader, bool hashBySender): 
+    scSmplQueueManagerTask(allowSenderAsReader), m_hashBySender(hashBySender), m_nextShard(0) {};
+  virtual ~scSmplQueueManagerTaskSharded() {};
+  void addShard(scSmplQueueManagerTask *shard);
+  virtual int handleMessage(scEnvelope &envelope, scResponse &response);
+  virtual void clearQueue();
+  virtual size_t getWaitingCount() const;
+  virtual scString getStatus();
+  virtual bool needsRun();
+  virtual void getReaderList(scStringList &list);
+  virtual bool hasReader(const scString &readerTarget);
+  virtual bool setReaderLimit(const scString &readerTarget, int limit);
+  virtual bool setReaderAdaptiveLimit(const scString &readerTarget, uint minLimit, uint maxLimit);
+  virtual bool clearReaderAdaptiveLimit(const scString &readerTarget);
+  virtual bool markReaderAlive(const scString &readerAddr);
+  virtual uint dropReadersAt(const scMessageAddress &peerAddr);
+  virtual scSmplQueueManagerTask *getQueueForReader();
+  virtual void getShards(scSmplQueueManagerList &output);
+  virtual void getStats(scDataNode &output);
+protected:
+  virtual int intRun();
+  scSmplQueueManagerTask *selectShard(const scEnvelope &envelope);
+  bool canSteal(scSmplQueueManagerTask *thief);
+  scSmplQueueManagerTask *findStealVictim(scSmplQueueManagerTask *thief);
+protected:
+  scSmplQueueShardList m_shards;
+  bool m_hashBySender;
+  uint m_nextShard;
+};
+
 /// forwards messages to a selected target address
 class scSmplQueueManagerTaskForward: public scSmplQueueManagerTask {
 public:
@@ -244,6 +463,19 @@ protected:
 };
 
 typedef boost::ptr_list<scSmplQueueKeepAliveJobItem> scSmplQueueKeepAliveJobList;
+typedef std::vector<scSmplQueueKeepAliveJobItem *> scSmplQueueKeepAliveItemList;
+/// manager address -> items sent in one message
+typedef std::map<scString, scSmplQueueKeepAliveItemList> scSmplQueueKeepAliveGroupMap;
+
+/// sent mark_alive_multi waiting for response, expires like items it was sent for
+struct scSmplQueueKeepAliveMultiReq {
+  scSmplQueueKeepAliveMultiReq(): sentTime(0), timeout(0) {}
+  scString address;
+  std::set<scString> queueNames;
+  cpu_ticks sentTime;
+  cpu_ticks timeout;
+};
+typedef std::map<int, scSmplQueueKeepAliveMultiReq> scSmplQueueKeepAliveMultiReqMap;
 
 class scSmplQueueKeepAliveTask: public scTask {
 public:
@@ -256,20 +488,29 @@ protected:
   virtual int intRun();
   cpu_ticks calcNextDelay();
   uint processJobs();
-  void processJobItem(scSmplQueueKeepAliveJobItem &item);
+  void processJobItem(scSmplQueueKeepAliveJobItem &item, scSmplQueueKeepAliveGroupMap &groups);
+  bool isItemActive(scSmplQueueKeepAliveJobItem &item);
+  void addEarlyItems(scSmplQueueKeepAliveGroupMap &groups);
+  scString getMarkAliveSource(const scString &address);
   void postMessage(const scString &address, const scString &command, const scDataNode *params, int requestId);
   void handleResponseForItem(const scMessage &message, const scResponse &response, scSmplQueueKeepAliveJobItem &item);
   void processItemError(scSmplQueueKeepAliveJobItem &item);
   void processItemSendMarkAlive(scSmplQueueKeepAliveJobItem &item);
+  void processGroupSendMarkAlive(const scString &address, scSmplQueueKeepAliveItemList &items);
   void processItemSendListen(scSmplQueueKeepAliveJobItem &item);
+  bool handleMultiResponse(const scMessage &message, const scResponse &response);
+  void expireMultiRequests();
 protected:  
   scSmplQueueKeepAliveJobList m_jobs;
   scSmplQueueModule *m_parentModule;
+  scSmplQueueKeepAliveMultiReqMap m_multiRequests; ///< request id -> sent mark_alive_multi
+  std::set<scString> m_multiConfirmed;   ///< addresses which handled mark_alive_multi
+  std::set<scString> m_multiUnsupported; ///< addresses which do not know mark_alive_multi
 };
 
 class scSmplQueueKeepAliveHandler: public scRequestHandler {
 public: 
-  scSmplQueueKeepAliveHandler(scSmplQueueKeepAliveTask *owner): m_owner(owner), scRequestHandler() {}
+  scSmplQueueKeepAliveHandler(scSmplQueueKeepAliveTask *owner): scRequestHandler(), m_owner(owner) {}
   virtual ~scSmplQueueKeepAliveHandler() {}
   virtual void handleReqResult(const scMessage &a_message, const scResponse &a_response) {
     m_owner->handleResponse(const_cast<scMessage *>(&a_message), const_cast<scResponse &>(a_response));
@@ -281,6 +522,21 @@ protected:
   scSmplQueueKeepAliveTask *m_owner;  
 };
 
+/// messages forwarded by reader as one squeue.batch
+class scSmplQueueBatch {
+public:
+  scSmplQueueBatch() {}
+  virtual ~scSmplQueueBatch() {}
+  void addItem(const scEnvelope &envelope) {
+    scRequestHandlerTransporter emptyTransporter;
+    m_items.push_back(new scRequestItem(envelope, emptyTransporter));
+  }
+  uint size() const { return m_items.size(); }
+  scRequestItem &getItem(uint index) { return m_items[index]; }
+protected:
+  boost::ptr_vector<scRequestItem> m_items;
+};
+
 // ----------------------------------------------------------------------------
 // Local class implementations
 // ----------------------------------------------------------------------------
@@ -310,6 +566,11 @@ bool scSmplQueueManagerTaskPull::hasMessageForReader(scSmplQueueReaderTask *read
 // ----------------------------------------------------------------------------
 // scSmplQueueManagerTaskMultiCast
 // ----------------------------------------------------------------------------
+void scSmplQueueManagerTaskMultiCast::setBroadcastAddr(const scString &value)
+{
+  m_broadcastAddr = value;
+}
+
 bool scSmplQueueManagerTaskMultiCast::get(scEnvelope &a_envelope)
 {
   return false;
@@ -322,12 +583,18 @@ int scSmplQueueManagerTaskMultiCast::handleMessage(scEnvelope &envelope, scRespo
 #ifdef SMPL_QUEUE_LOG_ENABLED
   Log::addDebug("[SQueue] received message: ["+message->getCommand()+"] from: ["+envelope.getSender().getAsString()+"]");  
 #endif  
-  if (m_limit && (m_waiting.size() >= size_t(m_limit))) 
+  if (m_limit && (getWaitingCount() >= size_t(m_limit))) 
   {
     res = SC_MSG_STATUS_OVERFLOW;
   } else {  
+     // time is noted first - spilled message takes it to disk
+     noteEnqueued(envelope);
      put(envelope);    
-     res = SC_MSG_STATUS_FORWARDED;
+     // broadcast is not confirmed, answer at once
+     if (!m_broadcastAddr.empty())
+       res = SC_MSG_STATUS_OK;
+     else
+       res = SC_MSG_STATUS_FORWARDED;
   }  
   
   return res;
@@ -335,34 +602,276 @@ int scSmplQueueManagerTaskMultiCast::handleMessage(scEnvelope &envelope, scRespo
 
 bool scSmplQueueManagerTaskMultiCast::hasMessageForReader(scSmplQueueReaderTask *reader)
 {
-  return !isEmpty();
+  // with broadcast readers receive messages from broadcast address
+  return !isEmpty() && m_broadcastAddr.empty();
 }
 
 bool scSmplQueueManagerTaskMultiCast::needsRun()
 {
-  return (!m_waiting.empty()) && (!m_readers.empty());
+  return !isEmpty() && (!m_readers.empty() || !m_broadcastAddr.empty());
 }  
 
 int scSmplQueueManagerTaskMultiCast::intRun()
 {
   int res = 0;
+  scStringList sentTo;
   scSmplQueueReaderTask *task;
 
   scEnvelope envelope;
   while(scSmplQueueManagerTask::get(envelope))
   {
+    // subscribers of broadcast address would receive message twice
+    // if it was also forwarded to readers
+    if (!m_broadcastAddr.empty()) {
+      broadcastEnvelope(envelope);
+      res++;
+      continue;
+    }
+
+    if (m_readers.size() > 1)
+      shareEncodedParams(envelope);
+
+    // readers keep only reply address, one copy of message is posted to each of them
+    sentTo.clear();
     for (scReaderListIterator p = m_readers.begin(); p != m_readers.end(); p++ )
     {
       task = dynamic_cast<scSmplQueueReaderTask *>(*p);
       if (task->acceptEnvelope(envelope))
-        task->forwardEnvelope(envelope);
+        if (task->forwardEnvelope(envelope, false))
+          sentTo.push_back(task->getTarget());
     }
+
+    if (m_aggregate != smaEach)
+      startAggregate(envelope, sentTo);
     res++;
   }
 
   return res;
 }
 
+void scSmplQueueManagerTaskMultiCast::setAggregate(const scString &value)
+{
+  if (value.empty() || (value == GRD_SQUEUE_AGGREGATE_EACH))
+    m_aggregate = smaEach;
+  else if (value == GRD_SQUEUE_AGGREGATE_FIRST)
+    m_aggregate = smaFirst;
+  else if (value == GRD_SQUEUE_AGGREGATE_ALL)
+    m_aggregate = smaAll;
+  else if (value == GRD_SQUEUE_AGGREGATE_QUORUM)
+    m_aggregate = smaQuorum;
+  else
+    throw scError(scString("Unknown aggregate mode: ") + value);
+}
+
+void scSmplQueueManagerTaskMultiCast::setQuorum(uint value)
+{
+  m_quorum = value;
+}
+
+scString scSmplQueueManagerTaskMultiCast::getRequestKey(const scEnvelope &envelope) const
+{
+  // request IDs are unique only per sender
+  return envelope.getSender().getAsString() + "#" + toString(envelope.getEvent()->getRequestId());
+}
+
+// copies of message posted to readers share cache of encoded params, 
+// params are encoded by first serializer of each format which uses 
+// the cache (JSON, binary format depends on dictionary of connection)
+void scSmplQueueManagerTaskMultiCast::shareEncodedParams(scEnvelope &envelope)
+{
+  scMessage *message = dynamic_cast<scMessage *>(envelope.getEvent());
+  if (message == SC_NULL)
+    return;
+
+  message->setEncodedParams(scEncodedParamsRef(new scEncodedParams()));
+}
+
+void scSmplQueueManagerTaskMultiCast::startAggregate(const scEnvelope &envelope, const scStringList &readerTargets)
+{
+  uint requestId = envelope.getEvent()->getRequestId();
+  if (requestId == SC_REQUEST_ID_NULL)
+    return;
+
+  std::auto_ptr<scMultiCastRequest> request(
+    new scMultiCastRequest(envelope.getSender(), requestId, readerTargets));
+
+  if (readerTargets.empty()) {
+    scResponse response;
+    response.setStatus(SC_RESP_STATUS_UNDEF_ERROR);
+    response.setError(scDataNode(scString("No reader accepted message")));
+    sendAggregateResponse(*request, response);
+    return;
+  }
+
+  scString key = getRequestKey(envelope);
+  m_requests.erase(key);
+  m_requests.insert(key, request.release());
+}
+
+uint scSmplQueueManagerTaskMultiCast::getQuorumFor(const scMultiCastRequest &request) const
+{
+  uint res = m_quorum;
+  if (!res)
+    res = request.getExpected() / 2 + 1;
+  if (res > request.getExpected())
+    res = request.getExpected();
+  return res;
+}
+
+bool scSmplQueueManagerTaskMultiCast::handleReaderResponse(
+  scSmplQueueReaderTask &reader, const scString &readerTarget, 
+  const scEnvelope &envelope, const scResponse &response
+)
+{
+  if (m_aggregate == smaEach)
+    return true;
+
+  scMultiCastRequestMap::iterator it = m_requests.find(getRequestKey(envelope));
+  if (it == m_requests.end())
+    return false;
+
+  scMultiCastRequest &request = *it->second;
+  request.addResponse(readerTarget, response);
+
+  if (!request.isAnswered())
+    checkAggregate(request, response);
+
+  if (request.isComplete())
+    m_requests.erase(it);
+
+  // response is returned by queue
+  return false;
+}
+
+// reader removed without answering (e.g. contact timeout) counts as failed
+// response, so aggregated requests waiting for it are finished
+void scSmplQueueManagerTaskMultiCast::removeReader(scSmplQueueReaderTask *reader)
+{
+  scString target = reader->getTarget();
+  scSmplQueueManagerTask::removeReader(reader);
+
+  if (m_requests.empty())
+    return;
+
+  scResponse response;
+  response.setStatus(SC_RESP_STATUS_UNDEF_ERROR);
+  response.setError(scDataNode(scString("Reader removed: ")+target));
+
+  for(scMultiCastRequestMap::iterator it = m_requests.begin(); it != m_requests.end(); )
+  {
+    scMultiCastRequest &request = *it->second;
+    if (!request.isPending(target)) {
+      ++it;
+      continue;
+    }
+
+    request.addResponse(target, response);
+    if (!request.isAnswered())
+      checkAggregate(request, response);
+
+    if (request.isComplete())
+      m_requests.erase(it++);
+    else
+      ++it;
+  }
+}
+
+void scSmplQueueManagerTaskMultiCast::checkAggregate(scMultiCastRequest &request, const scResponse &lastResponse)
+{
+  scResponse response;
+
+  switch (m_aggregate) {
+    case smaFirst:
+      if (!lastResponse.isError() || request.isComplete()) 
+        sendAggregateResponse(request, lastResponse);
+      break;
+    case smaAll:
+      if (request.isComplete()) {
+        if (request.getOkCount() > 0) {
+          response.setStatus(SC_RESP_STATUS_OK);
+          response.setResult(request.getItems());
+        } else {
+          response.setStatus(request.getLastErrorStatus());
+          response.setError(request.getItems());
+        }
+        sendAggregateResponse(request, response);
+      }
+      break;
+    case smaQuorum:
+    {
+      uint quorum = getQuorumFor(request);
+      if (request.getOkCount() >= quorum) {
+        response.setStatus(SC_RESP_STATUS_OK);
+        response.setResult(request.getItems());
+        sendAggregateResponse(request, response);
+      } else if (request.getFailedCount() > request.getExpected() - quorum) {
+        // quorum cannot be reached anymore
+        response.setStatus(request.getLastErrorStatus());
+        response.setError(request.getItems());
+        sendAggregateResponse(request, response);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void scSmplQueueManagerTaskMultiCast::sendAggregateResponse(scMultiCastRequest &request, const scResponse &response)
+{
+  scMessageAddress ownAddr(getScheduler()->getOwnAddress(request.getSender().getProtocol()));
+  std::auto_ptr<scEnvelope> envelopeGuard(new scEnvelope(ownAddr, request.getSender(), new scResponse(response)));
+  //copy requestId from original message
+  envelopeGuard->getEvent()->setRequestId(request.getRequestId());
+  getScheduler()->postEnvelope(envelopeGuard.release());
+  request.setAnswered();
+  Counter::inc("sq-mcast-aggregate");
+}
+
+// one send for all subscribers of broadcast address, without response
+void scSmplQueueManagerTaskMultiCast::broadcastEnvelope(const scEnvelope &envelope)
+{
+  scMessageAddress newReceiver(m_broadcastAddr);
+  std::auto_ptr<scEnvelope> envelopeGuard(new scEnvelope(envelope));
+  envelopeGuard->setSender(getOwnAddress(newReceiver.getProtocol()));
+  envelopeGuard->setReceiver(newReceiver);
+  envelopeGuard->getEvent()->setRequestId(SC_REQUEST_ID_NULL);
+  getScheduler()->postEnvelope(envelopeGuard.release());
+  Counter::inc("sq-broadcast");
+}
+
+// ----------------------------------------------------------------------------
+// scMultiCastRequest
+// ----------------------------------------------------------------------------
+scMultiCastRequest::scMultiCastRequest(const scMessageAddress &sender, uint requestId, const scStringList &readerTargets):
+  m_sender(sender), m_requestId(requestId), m_expected(readerTargets.size()), m_received(0), m_okCount(0),
+  m_answered(false), m_lastErrorStatus(SC_RESP_STATUS_UNDEF_ERROR), m_items(ict_list),
+  m_pending(readerTargets.begin(), readerTargets.end())
+{
+}
+
+void scMultiCastRequest::addResponse(const scString &readerTarget, const scResponse &response)
+{
+  std::multiset<scString>::iterator itp = m_pending.find(readerTarget);
+  if (itp != m_pending.end())
+    m_pending.erase(itp);
+
+  std::auto_ptr<scDataNode> item(new scDataNode(ict_parent));
+  item->addChild("reader", new scDataNode(readerTarget));
+  item->addChild("status", new scDataNode(response.getStatus()));
+
+  if (response.isError()) {
+    m_lastErrorStatus = response.getStatus();
+    item->addChild("error", new scDataNode(response.getError()));
+  } else {
+    m_okCount++;
+    item->addChild("result", new scDataNode(response.getResult()));
+  }
+
+  m_items.addChild(item.release());
+  m_received++;
+}
+
 // ----------------------------------------------------------------------------
 // scSmplQueueManagerTaskHighAvail
 // ----------------------------------------------------------------------------
@@ -468,6 +977,11 @@ uint scDurableRequestInfo::getRetryCount()
   return m_retryCount;
 }  
 
+void scDurableRequestInfo::setRetryCount(uint value)
+{
+  m_retryCount = value;
+}
+
 void scDurableRequestInfo::incRetryCount()
 {
   m_retryCount++;
@@ -609,6 +1123,13 @@ void scSmplQueueManagerTaskDurable::handleEnvelopeSent(scSmplQueueReaderTask *re
   }  
 }
 
+// request info is kept while message is taken by reader, so message 
+// is added again like retry (plain put would reject it as duplicate)
+void scSmplQueueManagerTaskDurable::putBack(scSmplQueueReaderTask *reader, const scEnvelope &envelope)
+{
+  putRetry(envelope);
+}
+
 //- increase retry count
 //- set timestamp when envelope will be ready for use
 //- add message to waiting 
@@ -658,123 +1179,340 @@ bool scSmplQueueManagerTaskDurable::sendRequestFailed(uint reqId,
 bool scSmplQueueManagerTaskDurable::sendRequestFailed(uint reqId,     
   const scResponse &response)
 {
- 
-  scEnvelopeColn::iterator it = m_waiting.begin();
-  while((it != m_waiting.end()) && (static_cast<uint>(it->getEvent()->getRequestId()) != reqId))
-  {
-    it++;
-  }  
-
-  if (it == m_waiting.end())
+  scEnvelope *it = findWaiting(reqId);
+  if (it == SC_NULL)
     return false;
   
-  scMessageAddress ownAddr(getScheduler()->getOwnAddress(it->getSender().getProtocol()));
+  postRequestFailed(it->getSender(), reqId, response);
+  return true;
+}
+
+void scSmplQueueManagerTaskDurable::postRequestFailed(const scMessageAddress &sender, uint reqId, 
+  const scResponse &response)
+{
+  scMessageAddress ownAddr(getScheduler()->getOwnAddress(sender.getProtocol()));
   
-  std::auto_ptr<scEnvelope> envelopeGuard(new scEnvelope(ownAddr, it->getSender(), new scResponse(response)));
- //copy requestId from original message
-  envelopeGuard->getEvent()->setRequestId(it->getEvent()->getRequestId());
+  std::auto_ptr<scEnvelope> envelopeGuard(new scEnvelope(ownAddr, sender, new scResponse(response)));
+ //copy requestId from original message (request ID is the key)
+  envelopeGuard->getEvent()->setRequestId(reqId);
  //post response to original sender
   getScheduler()->postEnvelope(envelopeGuard.release());
-  
-  return true;
 }
 
-// read next message ready to be used (use request info)
+// read next message ready to be used, delayed retries are moved to 
+// ready FIFO when their start time is reached
 bool scSmplQueueManagerTaskDurable::get(scEnvelope &a_envelope)
 {
-  bool res = false;
-  uint reqId;
+  promoteDelayed();
+  if (needsPageIn())
+    pageIn();
+
+  if (m_waiting.empty())
+    return false;
+
+  uint reqId = m_waiting.front().getEvent()->getRequestId();
+  assert(reqId != SC_REQUEST_ID_NULL);
+
+  return takeWaiting(reqId, a_envelope);
+}
+
+// remove request from ready FIFO for sending
+bool scSmplQueueManagerTaskDurable::takeWaiting(uint reqId, scEnvelope &a_envelope)
+{
+  scDurableWaitingIndex::iterator itw = m_waitingIndex.find(reqId);
+  if (itw == m_waitingIndex.end())
+    return false;
+
+  scDurableRequestInfoMap::iterator itr = m_requestMap.find(reqId);
+  if (itr == m_requestMap.end())
+    throw scError(scString("Unknown request found"))
+       .addDetails("request_id", scDataNode(reqId))
+       .addDetails("queue", scDataNode(getName()));
+
+  scDurableRequestInfo *info = (*itr)->second;
+  info->resetStartTime();
+  if (m_resultTimeout > 0)
+    m_timeoutHeap.push(scDurableDeadline(info->getStartTime() + m_resultTimeout, reqId));
 
-  scEnvelopeColn::iterator it = m_waiting.begin();
-  scDurableRequestInfoMap::iterator itr;
-  
-  while(!res && (it != m_waiting.end()))
-  {
-    reqId = it->getEvent()->getRequestId();
-    itr = m_requestMap.find(reqId);
-    assert(reqId != SC_REQUEST_ID_NULL);
-    if (itr == m_requestMap.end())
-      throw scError(scString("Unknown request found"))
-         .addDetails("request_id", scDataNode(reqId))
-         .addDetails("queue", scDataNode(getName()));
-         
-    assert(itr != m_requestMap.end());
-    if ((*itr)->second->isTimeToStart())
-    {
-      (*itr)->second->resetStartTime();
-      a_envelope = *it;
 #ifdef SMPL_QUEUE_LOG_ENABLED
-      Log::addDebug(scString("[SQueue] Removing request from queue: ")+toString(reqId));
+  Log::addDebug(scString("[SQueue] Removing request from queue: ")+toString(reqId));
 #endif
-      m_waiting.erase(it);
-      res = true;
-    } else {
-      ++it;
-    }    
-  }
+  scEnvelopeTransport transp = m_waiting.release(itw->second);
+  m_waitingIndex.erase(itw);
+  a_envelope = *transp;
       
-  return res;  
+  return true;  
 }
 
-void scSmplQueueManagerTaskDurable::eraseFromWaiting(uint reqId)
+// used for work stealing - request is forgotten, not answered,
+// oldest message is taken first (like in get)
+bool scSmplQueueManagerTaskDurable::releaseWaiting(scEnvelope &output)
 {
-  scEnvelopeColn::iterator it = m_waiting.begin();
-  
-  while((it != m_waiting.end()) && (static_cast<uint>(it->getEvent()->getRequestId()) != reqId))
-  {
-    it++;
-  }  
-  
-  if (it != m_waiting.end())
-    m_waiting.erase(it);    
+  if (needsPageIn())
+    pageIn();
+
+  if (m_waiting.empty())
+    return false;
+
+  uint reqId = m_waiting.front().getEvent()->getRequestId();
+  scEnvelopeTransport transp = m_waiting.pop_front();
+  m_waitingIndex.erase(reqId);
+  m_requestMap.erase(reqId);
+  output = *transp;
+  return true;
 }
 
-// add message to waiting queue
-// generate request info
-void scSmplQueueManagerTaskDurable::put(const scEnvelope &envelope)
+void scSmplQueueManagerTaskDurable::eraseFromWaiting(uint reqId)
 {
-  intPut(envelope, false);
+  scDurableWaitingIndex::iterator it = m_waitingIndex.find(reqId);
+  if (it != m_waitingIndex.end()) {
+    m_waiting.erase(it->second);
+    m_waitingIndex.erase(it);
+  } else {
+    scDurableDelayedMap::iterator itd = m_delayed.find(reqId);
+    if (itd != m_delayed.end())
+      m_delayed.erase(itd);
+  }    
 }
 
-void scSmplQueueManagerTaskDurable::putRetry(const scEnvelope &envelope)
+scEnvelope *scSmplQueueManagerTaskDurable::findWaiting(uint reqId)
 {
-  intPut(envelope, true);
+  scDurableWaitingIndex::iterator it = m_waitingIndex.find(reqId);
+  if (it != m_waitingIndex.end())
+    return &(*it->second);
+
+  scDurableDelayedMap::iterator itd = m_delayed.find(reqId);
+  if (itd != m_delayed.end())
+    return itd->second;
+    
+  return SC_NULL;  
 }
 
-void scSmplQueueManagerTaskDurable::intPut(const scEnvelope &envelope, bool retry)
+// spilled request is not kept in memory - it's start time & retry count
+// are stored in spill record, request map entry is restored on page-in;
+// retry which cannot be spilled (e.g. no space on disk) stays in memory, 
+// new request is rejected
+bool scSmplQueueManagerTaskDurable::putReady(scEnvelope *envelope, uint reqId, bool retry)
 {
-  uint reqId = envelope.getEvent()->getRequestId();
-  
-#ifdef SMPL_QUEUE_LOG_ENABLED
-  Log::addDebug(scString("[SQueue] Adding request to map: ")+toString(reqId));
-#endif
+  if (!needsSpill()) {
+    appendReady(envelope, reqId);
+    return true;
+  }
   
+  std::auto_ptr<scEnvelope> envelopeGuard(envelope);
+  grdSpillRecordInfo spillInfo;
   scDurableRequestInfoMap::iterator it = m_requestMap.find(reqId);
-  if (it == m_requestMap.end())
-  {
-    m_requestMap.insert(reqId, new scDurableRequestInfo());  
-    it = m_requestMap.find(reqId);
-  } else if (retry) {
-    it->second->setReaderName("");
-  } else {
-    throw scError("Request already in queue")
-         .addDetails("request_id", scDataNode(reqId))
-         .addDetails("queue", scDataNode(getName()));
+  if (it != m_requestMap.end()) {
+    spillInfo.startTime = it->second->getStartTime();
+    spillInfo.retryCount = it->second->getRetryCount();
   }  
 
-  (*it)->second->resetStartTime();
-  scSmplQueueManagerTask::put(envelope);  
+  try {
+    spill(*envelope, spillInfo);
+  }
+  catch(const scError &e) {
+    if (!retry) {
+      m_requestMap.erase(reqId);
+      throw;
+    }
+    Log::addError(scString("Spill failed, retry kept in memory, queue: ")+getName()+", error: "+e.what());
+    appendReady(envelopeGuard.release(), reqId);
+    return true;
+  }
+    
+  m_requestMap.erase(reqId);
+  return false;
+}
 
-#ifdef SMPL_QUEUE_LOG_ENABLED
-  Log::addDebug(scString("[SQueue] Adding request to queue: ")+toString(reqId));
-#endif
+void scSmplQueueManagerTaskDurable::appendReady(scEnvelope *envelope, uint reqId)
+{
+  m_waiting.push_back(envelope);
+  m_waitingIndex[reqId] = --m_waiting.end();
 }
 
-int scSmplQueueManagerTaskDurable::intRun()
+// request info is restored from spill record, store timeout of requests 
+// which were on disk is checked here
+void scSmplQueueManagerTaskDurable::pageIn()
 {
-  int res = scSmplQueueManagerTask::intRun();
-  validateReaders();
-  validateRequests();
+  grdSpillRecordInfo spillInfo;
+  
+  while(!m_spill->empty() && (m_waiting.size() < m_spillHigh))
+  {
+    std::auto_ptr<scEnvelope> envelopeGuard(new scEnvelope());
+    if (!readSpilled(*envelopeGuard, spillInfo))
+      break;
+    uint reqId = envelopeGuard->getEvent()->getRequestId();
+    if (m_requestMap.find(reqId) != m_requestMap.end()) {
+      Log::addWarning(scString("Request already in queue - spilled copy removed, queue: ")+getName()+", request-id: "+toString(reqId));
+      continue;
+    }  
+    
+    std::auto_ptr<scDurableRequestInfo> infoGuard(new scDurableRequestInfo());
+    infoGuard->setStartTime(static_cast<cpu_ticks>(spillInfo.startTime));
+    infoGuard->setRetryCount(spillInfo.retryCount);
+    
+    if (isRequestOutdated(*infoGuard)) {
+      Log::addWarning(scString("Request outdated - removing, queue: ")+getName()+", request-id: "+toString(reqId));
+      scResponse response;
+      response.setRequestId(reqId);
+      response.setStatus(SC_RESP_STATUS_TIMEOUT);
+      postRequestFailed(envelopeGuard->getSender(), reqId, response);
+      continue;
+    }
+    
+    if (m_storeTimeout > 0)
+      m_timeoutHeap.push(scDurableDeadline(infoGuard->getStartTime() + m_storeTimeout, reqId));
+    m_requestMap.insert(reqId, infoGuard.release());
+    restoreEnqueueTime(*envelopeGuard, spillInfo);
+    appendReady(envelopeGuard.release(), reqId);
+  }
+}
+
+void scSmplQueueManagerTaskDurable::promoteDelayed()
+{
+  cpu_ticks now = cpu_time_ms();
+  
+  while(!m_retryHeap.empty() && (m_retryHeap.top().time <= now))
+  {
+    uint reqId = m_retryHeap.top().reqId;
+    m_retryHeap.pop();
+    
+    scDurableDelayedMap::iterator itd = m_delayed.find(reqId);
+    if (itd == m_delayed.end())
+      continue;
+      
+    scDurableRequestInfoMap::iterator itr = m_requestMap.find(reqId);
+    if ((itr != m_requestMap.end()) && !(*itr)->second->isTimeToStart())
+      continue; // start time changed, newer heap entry exists
+
+    putReady(m_delayed.release(itd).release(), reqId, true);
+  }
+}
+
+void scSmplQueueManagerTaskDurable::clearQueue()
+{
+  inherited::clearQueue();
+  m_waitingIndex.clear();
+  m_delayed.clear();
+  while(!m_retryHeap.empty())
+    m_retryHeap.pop();
+
+  // forget requests not sent yet
+  for(scDurableRequestInfoMap::iterator it = m_requestMap.begin(); it != m_requestMap.end(); )
+  {
+    if (it->second->getReaderName().empty())
+      m_requestMap.erase(it++);
+    else
+      ++it;
+  }
+}
+
+size_t scSmplQueueManagerTaskDurable::getWaitingCount() const
+{
+  return m_waiting.size() + m_delayed.size() + getSpilledCount();
+}
+
+void scSmplQueueManagerTaskDurable::addReader(scSmplQueueReaderTask *reader)
+{
+  inherited::addReader(reader);
+  m_readerIndexValid = false;
+}
+
+void scSmplQueueManagerTaskDurable::removeReader(scSmplQueueReaderTask *reader)
+{
+  inherited::removeReader(reader);
+  m_readerIndexValid = false;
+  m_readersRemoved = true;
+}
+
+// reader names are assigned by scheduler after reader is added, 
+// so index is rebuilt on demand
+scSmplQueueReaderTask *scSmplQueueManagerTaskDurable::findReaderTask(const scString &name)
+{
+  if (!m_readerIndexValid) {
+    m_readerIndex.clear();
+    for(scReaderListIterator p=m_readers.begin(); p!=m_readers.end(); ++p) 
+      if (!(*p)->getName().empty())
+        m_readerIndex[(*p)->getName()] = dynamic_cast<scSmplQueueReaderTask *>(*p);
+    m_readerIndexValid = true;
+  }
+
+  scDurableReaderIndex::iterator it = m_readerIndex.find(name);
+  if (it != m_readerIndex.end())
+    return it->second;
+
+  scReaderListIterator p = findReader(name);
+  if (p == m_readers.end())
+    return SC_NULL;
+    
+  scSmplQueueReaderTask *res = dynamic_cast<scSmplQueueReaderTask *>(*p);
+  m_readerIndex[name] = res;
+  return res;
+}
+
+// add message to waiting queue
+// generate request info
+void scSmplQueueManagerTaskDurable::put(const scEnvelope &envelope)
+{
+  intPut(envelope, false);
+}
+
+void scSmplQueueManagerTaskDurable::putRetry(const scEnvelope &envelope)
+{
+  intPut(envelope, true);
+}
+
+void scSmplQueueManagerTaskDurable::intPut(const scEnvelope &envelope, bool retry)
+{
+  uint reqId = envelope.getEvent()->getRequestId();
+  
+#ifdef SMPL_QUEUE_LOG_ENABLED
+  Log::addDebug(scString("[SQueue] Adding request to map: ")+toString(reqId));
+#endif
+  
+  scDurableRequestInfoMap::iterator it = m_requestMap.find(reqId);
+  if (it == m_requestMap.end())
+  {
+    m_requestMap.insert(reqId, new scDurableRequestInfo());  
+    it = m_requestMap.find(reqId);
+  } else if (retry) {
+    it->second->setReaderName("");
+  } else {
+    throw scError("Request already in queue")
+         .addDetails("request_id", scDataNode(reqId))
+         .addDetails("queue", scDataNode(getName()));
+  }  
+
+  scDurableRequestInfo *info = (*it)->second;
+  
+  // retry keeps start time set by prepareRetry (retry delay)
+  if (!retry)
+    info->resetStartTime();
+
+  std::auto_ptr<scEnvelope> envelopeGuard(new scEnvelope(envelope));
+  cpu_ticks startTime = info->getStartTime();
+  if (retry && !info->isTimeToStart()) {
+    m_delayed.insert(reqId, envelopeGuard.release());
+    m_retryHeap.push(scDurableDeadline(startTime, reqId));
+  } else if (!putReady(envelopeGuard.release(), reqId, retry)) {
+    // spilled, timeout is checked on page-in
+    return;
+  }
+  
+  if (m_storeTimeout > 0)
+    m_timeoutHeap.push(scDurableDeadline(startTime + m_storeTimeout, reqId));
+
+#ifdef SMPL_QUEUE_LOG_ENABLED
+  Log::addDebug(scString("[SQueue] Adding request to queue: ")+toString(reqId));
+#endif
+}
+
+int scSmplQueueManagerTaskDurable::intRun()
+{
+  promoteDelayed();
+  int res = scSmplQueueManagerTask::intRun();
+  validateReaders();
+  validateRequests();
   sleepFor(DEF_QUEUE_VALIDATE_DELAY);
   return res;
 }
@@ -801,26 +1539,45 @@ void scSmplQueueManagerTaskDurable::validateReaders()
   }
 }
 
+bool scSmplQueueManagerTaskDurable::isRequestOutdated(scDurableRequestInfo &info)
+{
+  const scString &rname = info.getReaderName();
+  if ((!rname.empty()) && (m_resultTimeout > 0) && (is_cpu_time_elapsed_ms(info.getStartTime(), m_resultTimeout)))
+    return true;
+  if ((rname.empty()) && (m_storeTimeout > 0) && (is_cpu_time_elapsed_ms(info.getStartTime(), m_storeTimeout)))
+    return true;
+  return false;
+}
+
+// only requests with due deadline are checked, whole map is scanned 
+// only after reader was removed
 void scSmplQueueManagerTaskDurable::validateRequests()
 {
-  scDurableRequestInfoMap::iterator itr = m_requestMap.begin();
+  scDurableRequestInfoMap::iterator itr;
   scSmplQueueReaderTask *reader;
   typedef std::map<uint, scString> cancelMap;
   
   cancelMap requestForCancel;  
   scString rname;
+  cpu_ticks now = cpu_time_ms();
   
-  while(itr != m_requestMap.end())
+  while(!m_timeoutHeap.empty() && (m_timeoutHeap.top().time <= now))
   {
-    rname = (*itr).second->getReaderName();
-    if ((!rname.empty()) && (m_resultTimeout > 0) && (is_cpu_time_elapsed_ms((*itr).second->getStartTime(), m_resultTimeout)))
-      requestForCancel.insert(std::make_pair((*itr).first, rname));
-    else if ((rname.empty()) && (m_storeTimeout > 0) && (is_cpu_time_elapsed_ms((*itr).second->getStartTime(), m_storeTimeout)))
-      requestForCancel.insert(std::make_pair((*itr).first, rname));
-    else if ((!rname.empty()) && (findReader((*itr).second->getReaderName()) == m_readers.end())) {
-      requestForCancel.insert(std::make_pair((*itr).first, rname));
+    uint reqId = m_timeoutHeap.top().reqId;
+    m_timeoutHeap.pop();
+    itr = m_requestMap.find(reqId);
+    if ((itr != m_requestMap.end()) && isRequestOutdated(*(*itr).second))
+      requestForCancel.insert(std::make_pair(reqId, (*itr).second->getReaderName()));
+  }
+
+  if (m_readersRemoved) {
+    m_readersRemoved = false;
+    for(itr = m_requestMap.begin(); itr != m_requestMap.end(); ++itr)
+    {
+      rname = (*itr).second->getReaderName();
+      if ((!rname.empty()) && (findReaderTask(rname) == SC_NULL))
+        requestForCancel.insert(std::make_pair((*itr).first, rname));
     }  
-    ++itr;
   }
     
   cancelMap::iterator cancIt;
@@ -829,7 +1586,7 @@ void scSmplQueueManagerTaskDurable::validateRequests()
   while(cancIt != requestForCancel.end())
   {    
     if (!(*cancIt).second.empty())      
-      reader = dynamic_cast<scSmplQueueReaderTask *>(*(findReader((*cancIt).second)));
+      reader = findReaderTask((*cancIt).second);
     else
       reader = SC_NULL;
         
@@ -837,7 +1594,7 @@ void scSmplQueueManagerTaskDurable::validateRequests()
     {
     // outdated & sent, reader found
       Log::addWarning(scString("Result timeout, queue: ")+getName()+", request-id: "+toString((*cancIt).first));
-      reader->cancelRequest((*cancIt).first, SC_RESP_STATUS_TIMEOUT);
+      reader->cancelQueuedRequest((*cancIt).first, SC_RESP_STATUS_TIMEOUT);
       clearRequestInfo((*cancIt).first);
     } else if ((*cancIt).second.empty())
     { 
@@ -888,6 +1645,558 @@ void scSmplQueueManagerTaskRoundRobin::handleEnvelopeAccepted(scSmplQueueReaderT
   inherited::handleEnvelopeAccepted(reader, envelope);
 }
 
+// ----------------------------------------------------------------------------
+// scSmplQueueManagerTaskLeastLoaded
+// ----------------------------------------------------------------------------
+bool scSmplQueueManagerTaskLeastLoaded::hasMessageForReader(scSmplQueueReaderTask *reader)
+{
+  if (isEmpty())
+    return false;
+
+  if (m_readers.size() <= 1)
+    return true;
+
+  return (getLeastLoaded() == reader);
+}
+
+bool scSmplQueueManagerTaskLeastLoaded::canTakeNext(scSmplQueueReaderTask *reader)
+{
+  return hasMessageForReader(reader);
+}
+
+void scSmplQueueManagerTaskLeastLoaded::addReader(scSmplQueueReaderTask *reader)
+{
+  m_leastLoadedValid = false;
+  inherited::addReader(reader);
+}
+
+void scSmplQueueManagerTaskLeastLoaded::removeReader(scSmplQueueReaderTask *reader)
+{
+  m_leastLoadedValid = false;
+  inherited::removeReader(reader);
+}
+
+void scSmplQueueManagerTaskLeastLoaded::handleEnvelopeAccepted(scSmplQueueReaderTask *reader, const scEnvelope &envelope)
+{
+  m_lastAcceptedReader = reader->getName();
+  m_leastLoadedValid = false;
+  inherited::handleEnvelopeAccepted(reader, envelope);
+}
+
+bool scSmplQueueManagerTaskLeastLoaded::handleReaderResponse(
+  scSmplQueueReaderTask &reader, const scString &readerTarget, 
+  const scEnvelope &envelope, const scResponse &response)
+{
+  m_leastLoadedValid = false;
+  return inherited::handleReaderResponse(reader, readerTarget, envelope, response);
+}
+
+// every reader asks for it's messages in each scheduler cycle, so search
+// is done once until load of readers changes (accept, response, reader 
+// list change) or time passes (timeouts, cancelled requests)
+scSmplQueueReaderTask *scSmplQueueManagerTaskLeastLoaded::getLeastLoaded()
+{
+  cpu_ticks now = cpu_time_ms();
+  if (!m_leastLoadedValid || (m_leastLoadedTime != now)) {
+    m_leastLoaded = findLeastLoaded();
+    m_leastLoadedTime = now;
+    m_leastLoadedValid = true;
+  }
+  return m_leastLoaded;
+}
+
+// readers without response yet use average of known readers, 
+// on equal wait last accepted reader is skipped
+scSmplQueueReaderTask *scSmplQueueManagerTaskLeastLoaded::findLeastLoaded()
+{
+  scSmplQueueReaderTask *reader;
+  scSmplQueueReaderTask *res = SC_NULL;
+  double respTimeSum = 0.0;
+  uint respTimeCnt = 0;
+
+  for(scReaderListIterator p=m_readers.begin(); p!=m_readers.end(); ++p) {
+    reader = dynamic_cast<scSmplQueueReaderTask *>(*p);
+    if (reader->getAvgResponseTime() > 0.0) {
+      respTimeSum += reader->getAvgResponseTime();
+      respTimeCnt++;
+    }
+  }
+
+  double defRespTime = (respTimeCnt > 0)?(respTimeSum / respTimeCnt):1.0;
+  double bestWait = 0.0, wait;
+
+  for(scReaderListIterator p=m_readers.begin(); p!=m_readers.end(); ++p) {
+    reader = dynamic_cast<scSmplQueueReaderTask *>(*p);
+    if (!reader->isBelowLimit() || (reader->getStatus() == tsStopping) || (reader->getStatus() == tsStopped))
+      continue;
+    wait = calcExpectedWait(reader, defRespTime);
+    if ((res == SC_NULL) || (wait < bestWait) || 
+        ((wait == bestWait) && (res->getName() == m_lastAcceptedReader))) 
+    {
+      res = reader;
+      bestWait = wait;
+    }
+  }
+
+  return res;
+}
+
+double scSmplQueueManagerTaskLeastLoaded::calcExpectedWait(scSmplQueueReaderTask *reader, double defRespTime)
+{
+  double respTime = reader->getAvgResponseTime();
+  if (respTime <= 0.0)
+    respTime = defRespTime;
+  int capacity = reader->getLimit();
+  if (capacity <= 0)
+    capacity = 1;
+  return (reader->getInFlightCount() + 1) * respTime / capacity;
+}
+
+// ----------------------------------------------------------------------------
+// scSmplQueueManagerTaskSharded
+// ----------------------------------------------------------------------------
+void scSmplQueueManagerTaskSharded::addShard(scSmplQueueManagerTask *shard)
+{
+  m_shards.push_back(shard);
+}
+
+void scSmplQueueManagerTaskSharded::getShards(scSmplQueueManagerList &output)
+{
+  output.insert(output.end(), m_shards.begin(), m_shards.end());
+}
+
+int scSmplQueueManagerTaskSharded::handleMessage(scEnvelope &envelope, scResponse &response)
+{
+  if (m_shards.empty())
+    return SC_MSG_STATUS_WRONG_CFG;
+  return selectShard(envelope)->handleMessage(envelope, response);
+}
+
+// sender hash keeps messages of one sender in one shard,
+// round robin skips shards without readers (if any shard has them)
+scSmplQueueManagerTask *scSmplQueueManagerTaskSharded::selectShard(const scEnvelope &envelope)
+{
+  uint shardCount = m_shards.size();
+
+  if (m_hashBySender)
+    return m_shards[grdHashRing::calcHash(envelope.getSender().getAsString()) % shardCount];
+
+  scSmplQueueManagerTask *res;  
+  for(uint i = 0; i < shardCount; i++) {
+    res = m_shards[m_nextShard];
+    m_nextShard = (m_nextShard + 1) % shardCount;
+    if (res->getReaderCount() > 0)
+      return res;
+  }
+  
+  res = m_shards[m_nextShard];
+  m_nextShard = (m_nextShard + 1) % shardCount;
+  return res;
+}
+
+scSmplQueueManagerTask *scSmplQueueManagerTaskSharded::getQueueForReader()
+{
+  scSmplQueueManagerTask *res = SC_NULL;
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    if ((res == SC_NULL) || ((*it)->getReaderCount() < res->getReaderCount()))
+      res = *it;
+
+  if (res == SC_NULL)
+    res = this;
+  return res;
+}
+
+void scSmplQueueManagerTaskSharded::clearQueue()
+{
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    (*it)->clearQueue();
+}
+
+size_t scSmplQueueManagerTaskSharded::getWaitingCount() const
+{
+  size_t res = 0;
+  for(scSmplQueueShardList::const_iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    res += (*it)->getWaitingCount();
+  return res;  
+}
+
+scString scSmplQueueManagerTaskSharded::getStatus()
+{
+  size_t readerCount = 0;
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    readerCount += (*it)->getReaderCount();
+
+  scString res = "Waiting-messages: "+toString(getWaitingCount())+
+    ", readers: "+toString(readerCount)+", shards: "+toString(m_shards.size());
+  return res;
+}
+
+// totals for all shards + stats of each shard
+void scSmplQueueManagerTaskSharded::getStats(scDataNode &output)
+{
+  grdLatencyHistogram waitTimeHist, responseTimeHist;
+  ulong64 dispatchedCount = 0, errorCount = 0;
+  std::auto_ptr<scDataNode> itemGuard;
+  std::auto_ptr<scDataNode> shardsGuard(new scDataNode(ict_list));
+
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+  {
+    waitTimeHist.add((*it)->getWaitTimeHistogram());
+    responseTimeHist.add((*it)->getResponseTimeHistogram());
+    dispatchedCount += (*it)->getDispatchedCount();
+    errorCount += (*it)->getErrorCount();
+    itemGuard.reset(new scDataNode());
+    (*it)->getStats(*itemGuard);
+    shardsGuard->addChild(itemGuard.release());
+  }
+
+  output.setAsParent();
+  output.addChild("name", new scDataNode(getName()));
+  output.addChild("depth", new scDataNode(static_cast<ulong64>(getWaitingCount())));
+  output.addChild("dispatched", new scDataNode(dispatchedCount));
+  output.addChild("responses", new scDataNode(responseTimeHist.getCount()));
+  output.addChild("errors", new scDataNode(errorCount));
+  itemGuard.reset(new scDataNode());
+  waitTimeHist.getStats(*itemGuard);
+  output.addChild("wait_time", itemGuard.release());
+  itemGuard.reset(new scDataNode());
+  responseTimeHist.getStats(*itemGuard);
+  output.addChild("response_time", itemGuard.release());
+  output.addChild("shards", shardsGuard.release());
+}
+
+void scSmplQueueManagerTaskSharded::getReaderList(scStringList &list)
+{
+  scStringList shardList;
+  list.clear();
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it) {
+    (*it)->getReaderList(shardList);
+    list.insert(list.end(), shardList.begin(), shardList.end());
+  }  
+}
+
+bool scSmplQueueManagerTaskSharded::hasReader(const scString &readerTarget)
+{
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    if ((*it)->hasReader(readerTarget))
+      return true;
+  return false;    
+}
+
+bool scSmplQueueManagerTaskSharded::setReaderLimit(const scString &readerTarget, int limit)
+{
+  bool res = false;
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    if ((*it)->setReaderLimit(readerTarget, limit))
+      res = true;
+  return res;    
+}
+
+bool scSmplQueueManagerTaskSharded::setReaderAdaptiveLimit(const scString &readerTarget, uint minLimit, uint maxLimit)
+{
+  bool res = false;
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    if ((*it)->setReaderAdaptiveLimit(readerTarget, minLimit, maxLimit))
+      res = true;
+  return res;    
+}
+
+bool scSmplQueueManagerTaskSharded::clearReaderAdaptiveLimit(const scString &readerTarget)
+{
+  bool res = false;
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    if ((*it)->clearReaderAdaptiveLimit(readerTarget))
+      res = true;
+  return res;    
+}
+
+bool scSmplQueueManagerTaskSharded::markReaderAlive(const scString &readerAddr)
+{
+  bool res = false;
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    if ((*it)->markReaderAlive(readerAddr))
+      res = true;
+  return res;    
+}
+
+uint scSmplQueueManagerTaskSharded::dropReadersAt(const scMessageAddress &peerAddr)
+{
+  uint res = 0;
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    res += (*it)->dropReadersAt(peerAddr);
+  return res;
+}
+
+bool scSmplQueueManagerTaskSharded::needsRun()
+{
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+    if (canSteal(*it) && (findStealVictim(*it) != SC_NULL))
+      return true;
+  return false;    
+}
+
+bool scSmplQueueManagerTaskSharded::canSteal(scSmplQueueManagerTask *thief)
+{
+  return thief->isEmpty() && thief->hasIdleReader();
+}
+
+// shard with the longest queue, shard with readers keeps at least one message
+scSmplQueueManagerTask *scSmplQueueManagerTaskSharded::findStealVictim(scSmplQueueManagerTask *thief)
+{
+  scSmplQueueManagerTask *res = SC_NULL;
+  size_t bestCount = 0;
+  
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+  {
+    if (*it == thief)
+      continue;
+    size_t count = (*it)->getWaitingCount();
+    size_t minCount = ((*it)->getReaderCount() > 0) ? 1 : 0;
+    if ((count > minCount) && (count > bestCount)) {
+      res = *it;
+      bestCount = count;
+    }  
+  }
+
+  return res;
+}
+
+// idle shards take half of messages waiting in the busiest shard
+int scSmplQueueManagerTaskSharded::intRun()
+{
+  int res = 0;
+  scEnvelope envelope;
+
+  for(scSmplQueueShardList::iterator it = m_shards.begin(), epos = m_shards.end(); it != epos; ++it)
+  {
+    if (!canSteal(*it))
+      continue;
+      
+    scSmplQueueManagerTask *victim = findStealVictim(*it);
+    if (victim == SC_NULL)
+      continue;
+      
+    size_t stealCount = victim->getWaitingCount();
+    if (victim->getReaderCount() > 0)
+      stealCount = (stealCount + 1) / 2;
+    if (stealCount > GRD_SQUEUE_STEAL_LIMIT)
+      stealCount = GRD_SQUEUE_STEAL_LIMIT;
+
+    while((stealCount > 0) && victim->releaseWaiting(envelope)) {
+      try {
+        (*it)->put(envelope);
+      }
+      catch(scError &e) {
+        // e.g. request with the same ID is already in thief shard
+        Log::addWarning(scString("Steal failed, queue: ")+getName()+", error: "+e.what());
+        victim->put(envelope);
+        break;
+      }
+      stealCount--;
+      res++;
+    }
+  }
+
+  if (res > 0)
+    Counter::inc("sq-shard-steal", res);
+    
+  return res;
+}
+
+// ----------------------------------------------------------------------------
+// scSmplQueueManagerTaskKeyed
+// ----------------------------------------------------------------------------
+void scSmplQueueManagerTaskKeyed::setKeyPath(const scString &value)
+{
+  m_keyPath = value;
+  m_ringValid = false;
+}
+
+// reader target is set after reader is added, so ring is rebuilt on demand
+void scSmplQueueManagerTaskKeyed::addReader(scSmplQueueReaderTask *reader)
+{
+  inherited::addReader(reader);
+  m_ringValid = false;
+}
+
+void scSmplQueueManagerTaskKeyed::removeReader(scSmplQueueReaderTask *reader)
+{
+  inherited::removeReader(reader);
+  m_ringValid = false;
+}
+
+void scSmplQueueManagerTaskKeyed::clearQueue()
+{
+  inherited::clearQueue();
+  m_keyQueues.clear();
+  m_rejected.clear();
+}
+
+// message is assigned to next reader on ring, requests which are already
+// finished are forgotten here (put back is rare, list is short)
+void scSmplQueueManagerTaskKeyed::putBack(scSmplQueueReaderTask *reader, const scEnvelope &envelope)
+{
+  for(scKeyedRejectMap::iterator it = m_rejected.begin(); it != m_rejected.end(); )
+  {
+    if (m_requestMap.find(it->first) == m_requestMap.end())
+      m_rejected.erase(it++);
+    else
+      ++it;
+  }
+
+  m_rejected[envelope.getEvent()->getRequestId()].insert(reader->getTarget());
+  inherited::putBack(reader, envelope);
+}
+
+scString scSmplQueueManagerTaskKeyed::extractKey(const scEnvelope &envelope)
+{
+  scMessage *message = dynamic_cast<scMessage *> (envelope.getEvent());
+  
+  if ((message != SC_NULL) && !m_keyPath.empty())
+  {
+    scDataNode *node = &message->getParams();
+    scString::size_type start = 0, pos;
+    do {
+      pos = m_keyPath.find('.', start);
+      scString name = m_keyPath.substr(start, (pos == scString::npos)?scString::npos:(pos - start));
+      if (!node->hasChild(name)) {
+        node = SC_NULL;
+        break;
+      }  
+      node = &((*node)[name]);
+      start = pos + 1;
+    } while(pos != scString::npos);
+
+    if (node != SC_NULL)
+      return node->getAsString();
+  }
+  
+  return toString(envelope.getEvent()->getRequestId());
+}
+
+// readers which gave the message back are skipped (if there is any other)
+scString scSmplQueueManagerTaskKeyed::findKeyOwner(const scString &key, uint reqId)
+{
+  scKeyedRejectMap::const_iterator itr = m_rejected.find(reqId);
+  if (itr == m_rejected.end())
+    return m_ring.findOwner(key);
+  return m_ring.findOwner(key, itr->second);
+}
+
+// stopped readers & readers at lost peer do not own keys
+bool scSmplQueueManagerTaskKeyed::isRingReader(scSmplQueueReaderTask *reader)
+{
+  return !reader->getTarget().empty() && !reader->isPeerDown() &&
+    (reader->getStatus() != tsStopping) && (reader->getStatus() != tsStopped);
+}
+
+uint scSmplQueueManagerTaskKeyed::calcRingReadersHash()
+{
+  uint res = 0;
+  scSmplQueueReaderTask *task;
+
+  for (scReaderListIterator p = m_readers.begin(); p != m_readers.end(); p++ )
+  {
+    task = dynamic_cast<scSmplQueueReaderTask *>(*p);
+    if (isRingReader(task))
+      res = res * 31 + grdHashRing::calcHash(task->getTarget());
+  }
+  return res;
+}
+
+// state of readers is checked at most once per ms, every reader asks 
+// for messages in each scheduler cycle
+void scSmplQueueManagerTaskKeyed::checkRing()
+{
+  cpu_ticks now = cpu_time_ms();
+  if (m_ringValid && (now == m_ringCheckTime))
+    return;
+
+  m_ringCheckTime = now;
+  if (!m_ringValid || (calcRingReadersHash() != m_ringReadersHash))
+    rebuildRing();
+}
+
+// each reader is placed on ring GRD_SQUEUE_KEYED_VNODES times,
+// ready requests are assigned again to readers
+void scSmplQueueManagerTaskKeyed::rebuildRing()
+{
+  scSmplQueueReaderTask *task;
+  
+  m_ring.clear();
+  for (scReaderListIterator p = m_readers.begin(); p != m_readers.end(); p++ )
+  {
+    task = dynamic_cast<scSmplQueueReaderTask *>(*p);
+    if (isRingReader(task))
+      m_ring.addNode(task->getTarget());
+  }
+
+  // lists of readers removed from ring are dropped here
+  m_keyQueues.clear();
+  for(scEnvelopeColn::iterator it = m_waiting.begin(), epos = m_waiting.end(); it != epos; ++it)
+  {
+    uint reqId = it->getEvent()->getRequestId();
+    m_keyQueues[findKeyOwner(extractKey(*it), reqId)].push_back(reqId);
+  }  
+    
+  m_ringReadersHash = calcRingReadersHash();
+  m_ringValid = true;
+}
+
+void scSmplQueueManagerTaskKeyed::appendReady(scEnvelope *envelope, uint reqId)
+{
+  inherited::appendReady(envelope, reqId);
+  // otherwise assigned during rebuild
+  if (m_ringValid)
+    m_keyQueues[findKeyOwner(extractKey(*envelope), reqId)].push_back(reqId);
+}
+
+// skips requests already removed from ready FIFO
+bool scSmplQueueManagerTaskKeyed::findNextFor(const scString &target, uint &reqId)
+{
+  scKeyedQueueMap::iterator it = m_keyQueues.find(target);
+  if (it == m_keyQueues.end())
+    return false;
+    
+  scKeyedRequestList &list = it->second;
+  while(!list.empty() && (m_waitingIndex.find(list.front()) == m_waitingIndex.end()))
+    list.pop_front();
+    
+  if (list.empty()) {
+    m_keyQueues.erase(it);
+    return false;
+  }
+  
+  reqId = list.front();
+  return true;    
+}
+
+bool scSmplQueueManagerTaskKeyed::hasMessageForReader(scSmplQueueReaderTask *reader)
+{
+  if (isEmpty())
+    return false;
+  if (needsPageIn())
+    pageIn();
+  checkRing();
+  uint reqId;
+  return findNextFor(reader->getTarget(), reqId);
+}
+
+bool scSmplQueueManagerTaskKeyed::getForReader(scSmplQueueReaderTask *reader, scEnvelope &a_envelope)
+{
+  promoteDelayed();
+  if (needsPageIn())
+    pageIn();
+  checkRing();
+  
+  uint reqId;
+  if (!findNextFor(reader->getTarget(), reqId))
+    return false;
+    
+  m_keyQueues[reader->getTarget()].pop_front();
+  return takeWaiting(reqId, a_envelope);
+}
+
 // ----------------------------------------------------------------------------
 // scSmplQueueKeepAliveTask
 // ----------------------------------------------------------------------------
@@ -946,15 +2255,30 @@ cpu_ticks scSmplQueueKeepAliveTask::calcNextDelay()
   return res;  
 }
 
-// find jobs for next contact & send messages
+// find jobs for next contact & send messages,
+// all items for one manager address are sent in one message
 uint scSmplQueueKeepAliveTask::processJobs()
 {
   uint res = 0;
+  scSmplQueueKeepAliveGroupMap groups;
   scSmplQueueKeepAliveJobList::iterator it;
-  for(it = m_jobs.begin(); it != m_jobs.end(); /* empty here */)
+
+  expireMultiRequests();
+
+  for(it = m_jobs.begin(); it != m_jobs.end(); ++it)
   {
-    processJobItem(*it);
+    processJobItem(*it, groups);
     res++;
+  }
+
+  if (!groups.empty()) {
+    addEarlyItems(groups);
+    for(scSmplQueueKeepAliveGroupMap::iterator itg = groups.begin(); itg != groups.end(); ++itg)
+      processGroupSendMarkAlive(itg->first, itg->second);
+  }
+
+  for(it = m_jobs.begin(); it != m_jobs.end(); /* empty here */)
+  {
     if (!it->isValid())
       it = m_jobs.erase(it);
     else
@@ -963,22 +2287,57 @@ uint scSmplQueueKeepAliveTask::processJobs()
   return res;
 }
 
-void scSmplQueueKeepAliveTask::processJobItem(scSmplQueueKeepAliveJobItem &item)
+bool scSmplQueueKeepAliveTask::isItemActive(scSmplQueueKeepAliveJobItem &item)
 {
   uint msgLimit = item.getMessageLimit();
-  if (!item.isWaiting())
-  if (item.isValid())
-  if ((msgLimit == 0) || (item.getMessageCount() < msgLimit))  
+  return 
+    !item.isWaiting() && 
+    item.isValid() && 
+    ((msgLimit == 0) || (item.getMessageCount() < msgLimit));
+}
+
+void scSmplQueueKeepAliveTask::processJobItem(scSmplQueueKeepAliveJobItem &item, scSmplQueueKeepAliveGroupMap &groups)
+{
+  if (isItemActive(item))
   if (item.getTimeLeft() == 0)
   {
     item.checkTimeOut();
     if (item.isErrorStatus())
       processItemError(item);
     else
-      processItemSendMarkAlive(item);
+      groups[item.getAddress()].push_back(&item);
   }
 }
 
+// items for the same address with less than half of delay left are sent 
+// together with due ones, so their timers align after first send
+void scSmplQueueKeepAliveTask::addEarlyItems(scSmplQueueKeepAliveGroupMap &groups)
+{
+  cpu_ticks timeLeft;
+  scSmplQueueKeepAliveGroupMap::iterator itg;
+
+  for(scSmplQueueKeepAliveJobList::iterator it = m_jobs.begin(); it != m_jobs.end(); ++it)
+  {
+    itg = groups.find(it->getAddress());
+    if (itg == groups.end())
+      continue;
+    if (!isItemActive(*it) || it->isErrorStatus())
+      continue;
+    timeLeft = it->getTimeLeft();
+    if ((timeLeft > 0) && (timeLeft <= it->getDelay() / 2))
+      itg->second.push_back(&(*it));
+  }
+}
+
+scString scSmplQueueKeepAliveTask::getMarkAliveSource(const scString &address)
+{
+  scString fullAddr = getScheduler()->evaluateAddress(address);
+  scMessageAddress ownAdrStruct(getOwnAddress(scMessageAddress(fullAddr).getProtocol()));
+  // clear task
+  ownAdrStruct.setTask("");    
+  return ownAdrStruct.getAsString();
+}
+
 void scSmplQueueKeepAliveTask::processItemError(scSmplQueueKeepAliveJobItem &item)
 {
   if (!item.isValid())
@@ -996,13 +2355,7 @@ void scSmplQueueKeepAliveTask::processItemSendMarkAlive(scSmplQueueKeepAliveJobI
 {
   scDataNode params;
   params.addChild("queue_name", new scDataNode(item.getQueueName()));
-  scString fullAddr = item.getAddress();
-  fullAddr = getScheduler()->evaluateAddress(fullAddr);
-  scMessageAddress ownAdrStruct(getOwnAddress(scMessageAddress(fullAddr).getProtocol()));
-  // clear task
-  ownAdrStruct.setTask("");    
-  scString ownAddress = ownAdrStruct.getAsString();
-  params.addChild("source_name", new scDataNode(ownAddress));
+  params.addChild("source_name", new scDataNode(getMarkAliveSource(item.getAddress())));
 
   Log::addDebug("[SQueueKeepAlive] Sending mark_alive...");
   
@@ -1017,6 +2370,62 @@ void scSmplQueueKeepAliveTask::processItemSendMarkAlive(scSmplQueueKeepAliveJobI
   item.handleMessageSent();
 }
 
+// one message for all queues at a given address, single item is sent as "mark_alive",
+// first message to a given address always needs result - to check if manager knows it 
+void scSmplQueueKeepAliveTask::processGroupSendMarkAlive(const scString &address, scSmplQueueKeepAliveItemList &items)
+{
+  scSmplQueueKeepAliveItemList::iterator it;
+
+  if (items.empty())
+    return;
+
+  if ((items.size() == 1) || (m_multiUnsupported.find(address) != m_multiUnsupported.end())) {
+    for(it = items.begin(); it != items.end(); ++it)
+      processItemSendMarkAlive(**it);
+    return;
+  }
+
+  scDataNode params(ict_parent);
+  scDataNode queueNames(ict_list);
+  bool needsResult = (m_multiConfirmed.find(address) == m_multiConfirmed.end());
+
+  for(it = items.begin(); it != items.end(); ++it)
+  {
+    queueNames.addChild(new scDataNode((*it)->getQueueName()));
+    if ((*it)->needsResult())
+      needsResult = true;
+  }
+
+  params.addChild("queue_names", new scDataNode(queueNames));
+  params.addChild("source_name", new scDataNode(getMarkAliveSource(address)));
+
+  Log::addDebug("[SQueueKeepAlive] Sending mark_alive_multi...");
+
+  if (needsResult) {
+    int reqId = getNextRequestId();
+    scSmplQueueKeepAliveMultiReq &request = m_multiRequests[reqId];
+    request.address = address;
+    request.sentTime = cpu_time_ms();
+    for(it = items.begin(); it != items.end(); ++it)
+    {
+      if ((*it)->needsResult())
+        (*it)->setLastRequestId(reqId);
+      request.queueNames.insert((*it)->getQueueName());
+      if ((*it)->getDelay() > request.timeout)
+        request.timeout = (*it)->getDelay();
+    }
+    this->postMessage(address, "squeue.mark_alive_multi", &params, reqId);
+  } else {
+    getScheduler()->postMessage(address, "squeue.mark_alive_multi", &params);
+  }
+
+  for(it = items.begin(); it != items.end(); ++it)
+    (*it)->handleMessageSent();
+
+  Counter::inc("sq-mark-alive-multi");
+  Counter::inc("sq-mark-alive-multi-items", items.size());
+}
+
 void scSmplQueueKeepAliveTask::processItemSendListen(scSmplQueueKeepAliveJobItem &item)
 {
   scDataNode params;
@@ -1048,24 +2457,84 @@ int scSmplQueueKeepAliveTask::handleResponse(scMessage *message, scResponse &res
   
   if (response.getRequestId() != SC_REQUEST_ID_NULL)
   {  
+    if (handleMultiResponse(*message, response))
+      return SC_MSG_STATUS_OK;
+
     int requestId = response.getRequestId();
     scSmplQueueKeepAliveJobList::iterator it;
     for(it = m_jobs.begin(); it != m_jobs.end(); ++it)
     {
+      // one mark_alive_multi response can be for many items
       if (it->getLastRequestId() == requestId)
       {
         handleResponseForItem(*message, response, *it);
         res = SC_MSG_STATUS_OK;
-        break;
       }
     }    
   }
   return res;
 }
 
+// returns <true> if manager does not know "mark_alive_multi" - then items 
+// of this request are re-sent as "mark_alive" now, all items of manager later
+bool scSmplQueueKeepAliveTask::handleMultiResponse(const scMessage &message, const scResponse &response)
+{
+  scSmplQueueKeepAliveMultiReqMap::iterator itr = m_multiRequests.find(response.getRequestId());
+  if (itr == m_multiRequests.end())
+    return false;
+
+  scString address = itr->second.address;
+  std::set<scString> queueNames;
+  queueNames.swap(itr->second.queueNames);
+  m_multiRequests.erase(itr);
+
+  if (response.getStatus() != SC_MSG_STATUS_UNK_MSG) {
+    if (!response.isError())
+      m_multiConfirmed.insert(address);
+    return false;
+  }
+
+  Log::addDebug("[SQueueKeepAlive] mark_alive_multi not supported at ["+address+"], using mark_alive");
+  m_multiUnsupported.insert(address);
+  m_multiConfirmed.erase(address);
+
+  for(scSmplQueueKeepAliveJobList::iterator it = m_jobs.begin(); it != m_jobs.end(); ++it)
+  {
+    if ((it->getAddress() != address) || !it->isValid())
+      continue;
+    if (queueNames.find(it->getQueueName()) == queueNames.end())
+      continue;
+    it->clearLastRequestId();
+    processItemSendMarkAlive(*it);
+  }
+
+  Counter::inc("sq-mark-alive-multi-fallback");
+  return true;
+}
+
+// request without response (peer gone, message lost) - items of it are 
+// handled by their own timeout
+void scSmplQueueKeepAliveTask::expireMultiRequests()
+{
+  cpu_ticks now = cpu_time_ms();
+  scSmplQueueKeepAliveMultiReqMap::iterator it = m_multiRequests.begin();
+  while(it != m_multiRequests.end())
+  {
+    if (calc_cpu_time_delay(it->second.sentTime, now) >= it->second.timeout)
+      m_multiRequests.erase(it++);
+    else
+      ++it;
+  }
+}
+
 void scSmplQueueKeepAliveTask::handleResponseForItem(const scMessage &message, const scResponse &response, scSmplQueueKeepAliveJobItem &item)
 {
-  if (response.isError())
+  bool failed = response.isError();
+  // result: queue name -> status
+  if (!failed && (message.getCommand() == "squeue.mark_alive_multi"))
+    failed = (response.getResult().getInt(item.getQueueName(), SC_MSG_STATUS_ERROR) != SC_MSG_STATUS_OK);
+
+  if (failed)
     item.handleErrorArrived();
   else
     item.handleSuccessArrived();  
@@ -1279,6 +2748,10 @@ scSmplQueueManagerTask::scSmplQueueManagerTask(bool allowSenderAsReader):
   scTask()
 {
   m_limit = 0;
+  m_spillHigh = 0;
+  m_spillLow = 0;
+  m_dispatchedCount = 0;
+  m_errorCount = 0;
   //m_lastReaderName = "";
   m_allowSenderAsReader = allowSenderAsReader;
 }
@@ -1295,12 +2768,14 @@ int scSmplQueueManagerTask::handleMessage(scEnvelope &envelope, scResponse &resp
 #ifdef SMPL_QUEUE_LOG_ENABLED
   Log::addDebug("[SQueue] received message: ["+message->getCommand()+"] from: ["+envelope.getSender().getAsString()+"]");  
 #endif  
-  if (m_limit && (m_waiting.size() >= size_t(m_limit))) 
+  if (m_limit && (getWaitingCount() >= size_t(m_limit))) 
   {
     res = SC_MSG_STATUS_OVERFLOW;
   } else if (message->getRequestId() == SC_REQUEST_ID_NULL) {
     res = SC_MSG_STATUS_MSG_ID_REQ;
   } else {  
+     // time is noted first - spilled message takes it to disk
+     noteEnqueued(envelope);
      put(envelope);    
      res = SC_MSG_STATUS_FORWARDED;
   }  
@@ -1337,6 +2812,9 @@ void scSmplQueueManagerTask::disconnectReaders()
 bool scSmplQueueManagerTask::get(scEnvelope &a_envelope)
 {
   bool res = false;
+
+  if (needsPageIn())
+    pageIn();
     
   if (!m_waiting.empty()) { 
     //scEnvelopeTransport transp = m_waiting.pop_back();
@@ -1348,9 +2826,82 @@ bool scSmplQueueManagerTask::get(scEnvelope &a_envelope)
   return res;
 }
 
+bool scSmplQueueManagerTask::getForReader(scSmplQueueReaderTask *reader, scEnvelope &a_envelope)
+{
+  return get(a_envelope);
+}
+
 void scSmplQueueManagerTask::clearQueue()
 {
   m_waiting.clear();
+  m_enqueueTimes.clear();
+  if (m_spill.get() != SC_NULL)
+    m_spill->clear();
+}
+
+void scSmplQueueManagerTask::setSpill(const scString &basePath, uint highMark, uint lowMark, uint segmentSize)
+{
+  if (lowMark >= highMark)
+    lowMark = highMark / 2;
+  m_spillHigh = highMark;
+  m_spillLow = lowMark;
+  if (highMark > 0)
+    m_spill.reset(new grdSpillLog(basePath, segmentSize));
+  else
+    m_spill.reset();
+}
+
+size_t scSmplQueueManagerTask::getSpilledCount() const
+{
+  if (m_spill.get() != SC_NULL)
+    return m_spill->size();
+  else
+    return 0;
+}
+
+// once anything is on disk, new messages go there too - to keep the order
+bool scSmplQueueManagerTask::needsSpill() const
+{
+  return (m_spill.get() != SC_NULL) && (!m_spill->empty() || (m_waiting.size() >= m_spillHigh));
+}
+
+void scSmplQueueManagerTask::spill(const scEnvelope &envelope, grdSpillRecordInfo &info)
+{
+  scSmplQueueEnqueueTimeMap::iterator it = m_enqueueTimes.end();
+  if (envelope.getEvent()->getRequestId() != SC_REQUEST_ID_NULL) {
+    it = m_enqueueTimes.find(calcEnqueueKey(envelope));
+    if (it != m_enqueueTimes.end())
+      info.enqueueTime = it->second;
+  }
+
+  m_spill->push(envelope, info);
+  Counter::inc("sq-spill-out");
+
+  if (it != m_enqueueTimes.end())
+    m_enqueueTimes.erase(it);
+}
+
+bool scSmplQueueManagerTask::needsPageIn() const
+{
+  return (m_spill.get() != SC_NULL) && !m_spill->empty() && (m_waiting.size() <= m_spillLow);
+}
+
+bool scSmplQueueManagerTask::readSpilled(scEnvelope &envelope, grdSpillRecordInfo &info)
+{
+  if (!m_spill->pop(envelope, info))
+    return false;
+  Counter::inc("sq-spill-in");
+  return true;
+}
+
+void scSmplQueueManagerTask::pageIn()
+{
+  scEnvelope envelope;
+  grdSpillRecordInfo info;
+  while((m_waiting.size() < m_spillHigh) && readSpilled(envelope, info)) {
+    m_waiting.push_back(new scEnvelope(envelope));
+    restoreEnqueueTime(envelope, info);
+  }
 }
 
 void scSmplQueueManagerTask::setLimit(int value)
@@ -1365,21 +2916,145 @@ int scSmplQueueManagerTask::getLimit() const
 
 bool scSmplQueueManagerTask::isEmpty() const
 {
-  return (m_waiting.size() <= 0);
+  return (m_waiting.size() <= 0) && (getSpilledCount() == 0);
+}
+
+size_t scSmplQueueManagerTask::getWaitingCount() const
+{
+  return m_waiting.size() + getSpilledCount();
 }
 
 void scSmplQueueManagerTask::put(const scEnvelope &envelope)
 {
-   m_waiting.push_back(new scEnvelope(envelope));
+   if (needsSpill()) {
+     grdSpillRecordInfo info;
+     spill(envelope, info);
+   } else {
+     m_waiting.push_back(new scEnvelope(envelope));
+   }
 }
 
 scString scSmplQueueManagerTask::getStatus()
 {
-  scString res = "Waiting-messages: "+toString(m_waiting.size())+
+  scString res = "Waiting-messages: "+toString(getWaitingCount())+
     ", readers: "+toString(m_readers.size());
+  if (m_spill.get() != SC_NULL)
+    res += ", spilled: "+toString(getSpilledCount());
   return res;
 }
 
+void scSmplQueueManagerTask::getStats(scDataNode &output)
+{
+  std::auto_ptr<scDataNode> itemGuard;
+  std::auto_ptr<scDataNode> readersGuard(new scDataNode(ict_list));
+
+  output.setAsParent();
+  output.addChild("name", new scDataNode(getName()));
+  output.addChild("depth", new scDataNode(static_cast<ulong64>(getWaitingCount())));
+  output.addChild("spilled", new scDataNode(static_cast<ulong64>(getSpilledCount())));
+  output.addChild("limit", new scDataNode(m_limit));
+  output.addChild("dispatched", new scDataNode(m_dispatchedCount));
+  output.addChild("responses", new scDataNode(m_responseTimeHist.getCount()));
+  output.addChild("errors", new scDataNode(m_errorCount));
+
+  itemGuard.reset(new scDataNode());
+  m_waitTimeHist.getStats(*itemGuard);
+  output.addChild("wait_time", itemGuard.release());
+
+  itemGuard.reset(new scDataNode());
+  m_responseTimeHist.getStats(*itemGuard);
+  output.addChild("response_time", itemGuard.release());
+
+  for (scReaderListIterator p = m_readers.begin(); p != m_readers.end(); p++ )
+  {
+    itemGuard.reset(new scDataNode());
+    dynamic_cast<scSmplQueueReaderTask *>(*p)->getStats(*itemGuard);
+    readersGuard->addChild(itemGuard.release());
+  }
+
+  output.addChild("readers", readersGuard.release());
+}
+
+scString scSmplQueueManagerTask::calcEnqueueKey(const scEnvelope &envelope)
+{
+  return envelope.getSender().getAsString()+" "+toString(envelope.getEvent()->getRequestId());
+}
+
+void scSmplQueueManagerTask::noteEnqueued(const scEnvelope &envelope)
+{
+  if (envelope.getEvent()->getRequestId() == SC_REQUEST_ID_NULL)
+    return;
+
+  // times of messages removed without dispatch (timeouts, steal) are purged 
+  // when there is enough of them
+  if (m_enqueueTimes.size() > m_waiting.size() + GRD_SQUEUE_STATS_STALE_LIMIT)
+    purgeEnqueueTimes();
+
+  m_enqueueTimes.insert(std::make_pair(calcEnqueueKey(envelope), cpu_time_ms()));
+}
+
+void scSmplQueueManagerTask::restoreEnqueueTime(const scEnvelope &envelope, const grdSpillRecordInfo &info)
+{
+  if (info.enqueueTime != 0)
+    m_enqueueTimes.insert(std::make_pair(calcEnqueueKey(envelope), static_cast<cpu_ticks>(info.enqueueTime)));
+}
+
+// times of spilled messages are stored on disk, so only messages in
+// memory are checked
+void scSmplQueueManagerTask::purgeEnqueueTimes()
+{
+  std::set<scString> waitingKeys;
+
+  for(scEnvelopeColn::iterator itw = m_waiting.begin(), epos = m_waiting.end(); itw != epos; ++itw)
+    waitingKeys.insert(calcEnqueueKey(*itw));
+
+  for(scSmplQueueEnqueueTimeMap::iterator it = m_enqueueTimes.begin(); it != m_enqueueTimes.end(); /* empty here */)
+  {
+    if (waitingKeys.find(it->first) != waitingKeys.end())
+      ++it;
+    else
+      m_enqueueTimes.erase(it++);
+  }
+}
+
+void scSmplQueueManagerTask::noteDispatched(const scEnvelope &envelope)
+{
+  m_dispatchedCount++;
+
+  scSmplQueueEnqueueTimeMap::iterator it = m_enqueueTimes.find(calcEnqueueKey(envelope));
+  if (it != m_enqueueTimes.end()) {
+    m_waitTimeHist.add(calc_cpu_time_delay(it->second, cpu_time_ms()));
+    m_enqueueTimes.erase(it);
+  }
+}
+
+void scSmplQueueManagerTask::noteResponse(cpu_ticks procTime, bool isError)
+{
+  m_responseTimeHist.add(procTime);
+  if (isError)
+    m_errorCount++;
+}
+
+const grdLatencyHistogram &scSmplQueueManagerTask::getWaitTimeHistogram() const
+{
+  return m_waitTimeHist;
+}
+
+const grdLatencyHistogram &scSmplQueueManagerTask::getResponseTimeHistogram() const
+{
+  return m_responseTimeHist;
+}
+
+ulong64 scSmplQueueManagerTask::getDispatchedCount() const
+{
+  return m_dispatchedCount;
+}
+
+ulong64 scSmplQueueManagerTask::getErrorCount() const
+{
+  return m_errorCount;
+}
+
 bool scSmplQueueManagerTask::needsRun()
 {
   return false;
@@ -1434,6 +3109,96 @@ bool scSmplQueueManagerTask::hasMessageForReader(scSmplQueueReaderTask *reader)
   return !isEmpty();
 }
 
+bool scSmplQueueManagerTask::canTakeNext(scSmplQueueReaderTask *reader)
+{
+  return true;
+}
+
+size_t scSmplQueueManagerTask::getReaderCount() const
+{
+  return m_readers.size();
+}
+
+bool scSmplQueueManagerTask::hasIdleReader()
+{
+  for (scReaderListIterator p = m_readers.begin(); p != m_readers.end(); p++ )
+    if (dynamic_cast<scSmplQueueReaderTask *>(*p)->isBelowLimit())
+      return true;
+  return false;    
+}
+
+scSmplQueueManagerTask *scSmplQueueManagerTask::getQueueForReader()
+{
+  return this;
+}
+
+void scSmplQueueManagerTask::getShards(scSmplQueueManagerList &output)
+{
+}
+
+bool scSmplQueueManagerTask::releaseWaiting(scEnvelope &output)
+{
+  if (needsPageIn())
+    pageIn();
+
+  if (m_waiting.empty())
+    return false;
+  scEnvelopeTransport transp = m_waiting.pop_front();
+  output = *transp;   
+  return true;
+}
+
+bool scSmplQueueManagerTask::setReaderLimit(const scString &readerTarget, int limit)
+{
+  bool res = false;
+  scSmplQueueReaderTask *task;
+  
+  for (scReaderListIterator p = m_readers.begin(); p != m_readers.end(); p++ )
+  {
+    task = dynamic_cast<scSmplQueueReaderTask *>(*p);
+    if (task->getTarget() == readerTarget)
+    {
+      task->setLimit(limit);
+      res = true;
+    }   
+  }
+  return res;
+}
+
+bool scSmplQueueManagerTask::setReaderAdaptiveLimit(const scString &readerTarget, uint minLimit, uint maxLimit)
+{
+  bool res = false;
+  scSmplQueueReaderTask *task;
+  
+  for (scReaderListIterator p = m_readers.begin(); p != m_readers.end(); p++ )
+  {
+    task = dynamic_cast<scSmplQueueReaderTask *>(*p);
+    if (task->getTarget() == readerTarget)
+    {
+      task->setAdaptiveLimit(minLimit, maxLimit);
+      res = true;
+    }   
+  }
+  return res;
+}
+
+bool scSmplQueueManagerTask::clearReaderAdaptiveLimit(const scString &readerTarget)
+{
+  bool res = false;
+  scSmplQueueReaderTask *task;
+  
+  for (scReaderListIterator p = m_readers.begin(); p != m_readers.end(); p++ )
+  {
+    task = dynamic_cast<scSmplQueueReaderTask *>(*p);
+    if (task->getTarget() == readerTarget)
+    {
+      task->clearAdaptiveLimit();
+      res = true;
+    }   
+  }
+  return res;
+}
+
 scString scSmplQueueManagerTask::findNextReaderName(const scString &readerName)
 {
   //scReaderListIterator p = findReader(m_lastReaderName);
@@ -1479,6 +3244,11 @@ void scSmplQueueManagerTask::handleEnvelopeSent(scSmplQueueReaderTask *reader, c
   // empty here
 }
 
+void scSmplQueueManagerTask::putBack(scSmplQueueReaderTask *reader, const scEnvelope &envelope)
+{
+  put(envelope);
+}
+
 bool scSmplQueueManagerTask::markReaderAlive(const scString &readerAddr)
 {
   bool res = false;
@@ -1490,11 +3260,32 @@ bool scSmplQueueManagerTask::markReaderAlive(const scString &readerAddr)
     reader = dynamic_cast<scSmplQueueReaderTask *>(*p);
     if (reader->getTarget() == readerAddr) 
     {
-      reader->noteContactEvent();
-      res = true;
+      reader->noteContactEvent();
+      res = true;
+    }
+  }
+  
+  return res;
+}
+
+// disconnect can be transient (0MQ reconnects), so reader is only paused here
+// and stopped by itself when peer does not return within grace period
+uint scSmplQueueManagerTask::dropReadersAt(const scMessageAddress &peerAddr)
+{
+  uint res = 0;
+  scSmplQueueReaderTask *reader;
+
+  for(scReaderListIterator p=m_readers.begin(); p!=m_readers.end(); ++p) {
+    reader = dynamic_cast<scSmplQueueReaderTask *>(*p);
+    scMessageAddress readerAddr(reader->getTarget());
+    if ((readerAddr.getProtocol() == peerAddr.getProtocol()) && (readerAddr.getHost() == peerAddr.getHost()))
+    {
+      Log::addWarning(scString("Reader peer down, queue: ")+getName()+", reader: "+reader->getTarget());
+      reader->notePeerDown();
+      res++;
     }
   }
-  
+
   return res;
 }
 
@@ -1502,11 +3293,19 @@ bool scSmplQueueManagerTask::markReaderAlive(const scString &readerAddr)
 // scSmplQueueReaderTask
 // ----------------------------------------------------------------------------
 
-scSmplQueueReaderTask::scSmplQueueReaderTask(): scTask()
+scSmplQueueReaderTask::scSmplQueueReaderTask(): scTask(),
+  m_peerDown(GRD_SQUEUE_PEER_DOWN_GRACE, GRD_SQUEUE_PEER_PROBE_INTERVAL)
 {
   m_limit = 1;
   m_lastContactTime = cpu_time_ms();
   m_queueManager = SC_NULL;
+  m_avgResponseTime = 0.0;
+  m_batchItemCount = 0;
+  m_batchSize = 1;
+  m_processed = 0;
+  m_errorCount = 0;
+  m_createTime = cpu_time_ms();
+  m_adaptive = false;
 }
 
 scSmplQueueReaderTask::~scSmplQueueReaderTask()
@@ -1547,6 +3346,11 @@ scString scSmplQueueReaderTask::getTarget() const
 void scSmplQueueReaderTask::setLimit(int value)
 {
   m_limit = value;
+  // new starting point for adaptive limit
+  if (m_adaptive) {
+    m_adaptiveLimit.setLimit((value > 0)?static_cast<uint>(value):0);
+    m_limit = m_adaptiveLimit.getLimit();
+  }  
 }
 
 int scSmplQueueReaderTask::getLimit() const
@@ -1554,9 +3358,98 @@ int scSmplQueueReaderTask::getLimit() const
   return m_limit; 
 }
 
+void scSmplQueueReaderTask::setAdaptiveLimit(uint minLimit, uint maxLimit)
+{
+  m_adaptive = true;
+  // current limit is starting point
+  m_adaptiveLimit.start(minLimit, maxLimit, (m_limit > 0)?static_cast<uint>(m_limit):0);
+  m_limit = m_adaptiveLimit.getLimit();
+}
+
+void scSmplQueueReaderTask::clearAdaptiveLimit()
+{
+  m_adaptive = false;
+}
+
+bool scSmplQueueReaderTask::isAdaptiveLimit() const
+{
+  return m_adaptive;
+}
+
+// timeouts & overflows mean overload, other errors are caused by message
+void scSmplQueueReaderTask::adaptLimit(cpu_ticks respTime, const scResponse &response)
+{
+  if (!m_adaptive)
+    return;
+
+  bool decreased = false;
+  int status = response.getStatus();
+  if (
+       (status == SC_RESP_STATUS_TIMEOUT) || 
+       (status == SC_RESP_STATUS_TRANSMIT_ERROR) || 
+       (status == SC_MSG_STATUS_OVERFLOW)
+     ) 
+    decreased = m_adaptiveLimit.handleOverload();
+  else if (!response.isError())
+    decreased = m_adaptiveLimit.handleSuccess(respTime);
+  else
+    m_adaptiveLimit.handleFailure();
+
+  if (decreased)
+    Counter::inc("sq-reader-limit-decrease");
+
+  m_limit = m_adaptiveLimit.getLimit();
+}
+
+void scSmplQueueReaderTask::setBatchSize(uint value)
+{
+  if (value < 1)
+    value = 1;
+  if (value > GRD_SQUEUE_MAX_BATCH)
+    value = GRD_SQUEUE_MAX_BATCH;
+  m_batchSize = value;
+}
+
+uint scSmplQueueReaderTask::getBatchSize() const
+{
+  return m_batchSize;
+}
+
 void scSmplQueueReaderTask::noteContactEvent()
 {
   m_lastContactTime = cpu_time_ms();
+  if (m_peerDown.isDown())
+    Log::addInfo(scString("Reader peer returned: ")+m_target);
+  m_peerDown.noteContact();
+}
+
+void scSmplQueueReaderTask::notePeerDown()
+{
+  m_peerDown.notePeerDown(cpu_time_ms());
+}
+
+bool scSmplQueueReaderTask::isPeerDown() const
+{
+  return m_peerDown.isDown();
+}
+
+bool scSmplQueueReaderTask::isPeerDownExpired() const
+{
+  return m_peerDown.isExpired(cpu_time_ms());
+}
+
+// gates drop connection of lost peer, so nothing is sent to it while reader
+// is paused - probe makes gate connect again & it's response resumes reader
+void scSmplQueueReaderTask::sendPeerProbe()
+{
+  scMessageAddress probeAddr(m_target);
+  probeAddr.setTask("");
+  int probeRequestId = getNextRequestId();
+
+  getScheduler()->postEnvelope(
+    new scEnvelope(getOwnAddress(probeAddr.getProtocol()), probeAddr, 
+      new scMessage("core.echo", SC_NULL, probeRequestId)));
+  m_peerDown.noteProbeSent(probeRequestId, cpu_time_ms());
 }
 
 cpu_ticks scSmplQueueReaderTask::getLastContactTime()
@@ -1564,6 +3457,58 @@ cpu_ticks scSmplQueueReaderTask::getLastContactTime()
   return m_lastContactTime;
 }
 
+uint scSmplQueueReaderTask::getInFlightCount() const
+{
+  return m_waitingRequests.size() + m_batchItemCount;
+}
+
+double scSmplQueueReaderTask::getAvgResponseTime() const
+{
+  return m_avgResponseTime;
+}
+
+uint scSmplQueueReaderTask::getProcessedCount() const
+{
+  return static_cast<uint>(m_processed);
+}
+
+uint scSmplQueueReaderTask::getErrorCount() const
+{
+  return m_errorCount;
+}
+
+void scSmplQueueReaderTask::getStats(scDataNode &output) const
+{
+  cpu_ticks elapsed = calc_cpu_time_delay(m_createTime, cpu_time_ms());
+  double rate = 0.0;
+  if (elapsed > 0)
+    rate = static_cast<double>(m_processed) * 1000.0 / static_cast<double>(elapsed);
+
+  output.setAsParent();
+  output.addChild("target", new scDataNode(m_target));
+  output.addChild("in_flight", new scDataNode(getInFlightCount()));
+  output.addChild("capacity", new scDataNode(m_limit));
+  if (m_adaptive) {
+    output.addChild("limit_min", new scDataNode(m_adaptiveLimit.getMinLimit()));
+    output.addChild("limit_max", new scDataNode(m_adaptiveLimit.getMaxLimit()));
+  }  
+  output.addChild("processed", new scDataNode(getProcessedCount()));
+  output.addChild("errors", new scDataNode(m_errorCount));
+  output.addChild("avg_response_time", new scDataNode(m_avgResponseTime));
+  output.addChild("rate", new scDataNode(rate));
+}
+
+void scSmplQueueReaderTask::noteResponseTime(cpu_ticks value)
+{
+  if (m_avgResponseTime <= 0.0)
+    m_avgResponseTime = static_cast<double>(value);
+  else  
+    m_avgResponseTime += GRD_SQUEUE_RESP_TIME_EWMA_ALPHA * (static_cast<double>(value) - m_avgResponseTime);
+  // 0 is reserved for "unknown"  
+  if (m_avgResponseTime < 0.001)
+    m_avgResponseTime = 0.001;
+}
+
 void scSmplQueueReaderTask::addWaitingMsg(scEnvelope &envelope, int requestId)
 {
   //scMessage *message = dynamic_cast<scMessage *> (envelope.getEvent());  
@@ -1596,19 +3541,90 @@ int scSmplQueueReaderTask::handleResponse(uint requestId, scResponse &response)
 {
    int res;
    scRequestItem requestItem; 
-   if (!extractWaitingMsg(requestId, requestItem))
+   if (m_peerDown.handleProbeResponse(requestId))
+   {
+     // error can be created locally (transmit error), peer stays down
+     if (!response.isError())
+       noteContactEvent();
+     res = SC_MSG_STATUS_OK;
+   } else if (m_waitingBatches.find(requestId) != m_waitingBatches.end())
+   {
+     res = handleBatchResponse(requestId, response);
+   } else if (!extractWaitingMsg(requestId, requestItem))
    {
      res = SC_MSG_STATUS_UNK_MSG;
    } else {
      res = SC_MSG_STATUS_OK;
      noteContactEvent();
-     
+
+     cpu_ticks respTime = calc_cpu_time_delay(requestItem.getStartTime(), cpu_time_ms());
+     // cancelled & failed requests do not measure reader speed
+     if (!response.isError())
+       noteResponseTime(respTime);
+
+     processResponse(requestItem, response, respTime);
+   }
+   
+   return res;
+}
+
+// split response for squeue.batch into responses for each forwarded message
+int scSmplQueueReaderTask::handleBatchResponse(uint requestId, scResponse &response)
+{
+   scSmplQueueBatchMap::iterator p = m_waitingBatches.find(requestId);
+   if (p == m_waitingBatches.end())
+     return SC_MSG_STATUS_UNK_MSG;
+
+   std::auto_ptr<scSmplQueueBatch> batch(m_waitingBatches.release(p).release());
+   uint itemCount = batch->size();
+   m_batchItemCount -= itemCount;
+   m_processed += itemCount;
+   noteContactEvent();
+
+   if (!itemCount)
+     return SC_MSG_STATUS_OK;
+
+   // average time of one message in batch - used for each item, so
+   // batch is not reported as slow reader
+   cpu_ticks respTime = calc_cpu_time_delay(batch->getItem(0).getStartTime(), cpu_time_ms()) / itemCount;
+   if (!response.isError())
+     noteResponseTime(respTime);
+
+   scDataNode &results = response.getResult();
+   bool resultsOk = !response.isError() && results.isContainer();
+   
+   for(uint i=0; i < itemCount; i++)
+   {
+     scResponse itemResponse;
+     itemResponse.setRequestId(requestId);
+
+     if (response.isError()) {
+       itemResponse.setStatus(response.getStatus());
+       itemResponse.setError(response.getError());
+     } else if (!resultsOk || (i >= results.size())) {
+       itemResponse.setStatus(SC_RESP_STATUS_UNDEF_ERROR);
+       itemResponse.setError(scDataNode(scString("Missing result in squeue.batch response")));
+     } else {
+       scDataNode &itemResult = results[i];
+       itemResponse.setStatus(itemResult.getInt("status", SC_MSG_STATUS_ERROR));
+       if (itemResult.hasChild("result"))
+         itemResponse.setResult(itemResult["result"]);
+       if (itemResult.hasChild("error"))
+         itemResponse.setError(itemResult["error"]);
+     }
+
+     processResponse(batch->getItem(i), itemResponse, respTime);
+   }
+
+   return SC_MSG_STATUS_OK;
+}
+
+void scSmplQueueReaderTask::processResponse(scRequestItem &requestItem, scResponse &response, cpu_ticks respTime)
+{
 #ifdef SMPL_QUEUE_TIMERS_ENABLED
-     cpu_ticks procTime;
-     procTime = calc_cpu_time_delay(requestItem.getStartTime(), cpu_time_ms());
-     Timer::inc("msg-proc-squeue-reader", procTime);
+     Timer::inc("msg-proc-squeue-reader", respTime);
      scString cmdTime = dynamic_cast<scMessage *>(requestItem.getEnvelope()->getEvent())->getCommand();
-     Timer::inc("msg-proc-squeue-reader-"+cmdTime, procTime);
+     Timer::inc("msg-proc-squeue-reader-"+cmdTime, respTime);
 #endif
 
 #ifdef SMPL_QUEUE_COUNTERS_ENABLED
@@ -1620,6 +3636,11 @@ int scSmplQueueReaderTask::handleResponse(uint requestId, scResponse &response)
 #ifdef SMPL_QUEUE_LOG_ENABLED
      Log::addDebug("SQueue received response from: ["+m_target+"]");     
 #endif  
+     if (response.isError())
+       m_errorCount++;
+     getQueueManager()->noteResponse(respTime, response.isError());
+     adaptLimit(respTime, response);
+
      bool returnResponse = false;
      
      if (getQueueManager()->handleReaderResponse(*this, m_target, *(requestItem.getEnvelope()), response))
@@ -1627,12 +3648,10 @@ int scSmplQueueReaderTask::handleResponse(uint requestId, scResponse &response)
 
      if (returnResponse) {
        if (response.isError())
-         Log::addDebug(scString("SQueue returns error from: [")+m_target+"] for message: ["+toString(requestId)+"]");     
+         Log::addDebug(scString("SQueue returns error from: [")+m_target+"] for message: ["+
+           toString(requestItem.getEnvelope()->getEvent()->getRequestId())+"]");     
        sendResponse(*(requestItem.getEnvelope()), response);
      }
-   }
-   
-   return res;
 }
 
 void scSmplQueueReaderTask::sendResponse(const scEnvelope &envelope, const scResponse &response)
@@ -1649,7 +3668,7 @@ bool scSmplQueueReaderTask::needsRun()
   //return scTask::needsRun() && (m_waitingRequests.size()>0) && (m_queueManager != SC_NULL) && (!m_queueManager->isEmpty());
   bool res = scTask::needsRun();
   if (res)
-    res = isMessageReadyForRead();
+    res = isPeerDownExpired() || m_peerDown.isProbeDue(cpu_time_ms()) || isMessageReadyForRead();
   return res;
 }
 
@@ -1665,20 +3684,34 @@ bool scSmplQueueReaderTask::isMessageReadyForRead()
 
 int scSmplQueueReaderTask::intRun()
 {
+  // peer did not return - stop like on contact timeout, waiting requests are cancelled
+  if (isPeerDownExpired()) {
+    Log::addWarning(scString("Reader peer did not return, removing reader: ")+m_target);
+    cancelAll();
+    requestStop();
+    return 0;
+  }
+
+  if (m_peerDown.isProbeDue(cpu_time_ms()))
+    sendPeerProbe();
+
+  if (m_batchSize > 1)
+    return runBatch();
+
   int res = 0;
   bool found;
   if (isMessageReadyForRead())
   {
     do {
       found = false;
-      if (isBelowLimit() && !m_queueManager->isEmpty())
+      if (isBelowLimit() && !m_queueManager->isEmpty() && m_queueManager->canTakeNext(this))
       {
         scEnvelope envelope;
-        if (m_queueManager->get(envelope))
+        if (m_queueManager->getForReader(this, envelope))
         {
           if (!acceptEnvelope(envelope)) {
           // give back the message
-            m_queueManager->put(envelope);
+            m_queueManager->putBack(this, envelope);
           } else if (forwardEnvelope(envelope))
           {
             res++;
@@ -1694,6 +3727,52 @@ int scSmplQueueReaderTask::intRun()
   return res;
 }
 
+// collect up to m_batchSize messages and forward them as one squeue.batch
+int scSmplQueueReaderTask::runBatch()
+{
+  int res = 0;
+  bool found;
+  if (isMessageReadyForRead())
+  {
+    do {
+      found = false;
+      scEnvelopeColn envelopes;
+      while ((envelopes.size() < m_batchSize) && hasFreeSlots(envelopes.size()) && 
+             !m_queueManager->isEmpty() && m_queueManager->canTakeNext(this))
+      {
+        std::auto_ptr<scEnvelope> envelopeGuard(new scEnvelope());
+        if (!m_queueManager->getForReader(this, *envelopeGuard))
+          break;
+        if (!acceptEnvelope(*envelopeGuard)) {
+          // give back the message
+          m_queueManager->putBack(this, *envelopeGuard);
+          break;
+        }
+        envelopes.push_back(envelopeGuard.release());
+      }
+
+      if (envelopes.empty())
+        break;
+
+      bool sent;
+      if (envelopes.size() == 1)
+        sent = forwardEnvelope(envelopes.front());
+      else
+        sent = forwardBatch(envelopes);
+
+      if (!sent)
+        throw scError("Forward message failed");
+
+      for(scEnvelopeColn::iterator it = envelopes.begin(); it != envelopes.end(); ++it)
+        m_queueManager->handleEnvelopeSent(this, *it);
+
+      res += envelopes.size();
+      // full batch - there can be more to read
+      found = (envelopes.size() == m_batchSize);
+    } while (found);
+  } // if  
+  return res;
+}
 
 int scSmplQueueReaderTask::runStopping()
 {
@@ -1704,7 +3783,15 @@ int scSmplQueueReaderTask::runStopping()
 
 bool scSmplQueueReaderTask::isBelowLimit()
 {
-  if (!m_limit || (m_waitingRequests.size() < size_t(m_limit))) 
+  return hasFreeSlots(0);
+}
+
+// <pending> - messages taken but not forwarded yet
+bool scSmplQueueReaderTask::hasFreeSlots(uint pending)
+{
+  if (m_peerDown.isDown())
+    return false;
+  if (!m_limit || (getInFlightCount() + pending < uint(m_limit))) 
     return true;
   else
     return false;  
@@ -1715,12 +3802,13 @@ bool scSmplQueueReaderTask::acceptEnvelope(const scEnvelope &envelope)
   bool res = false;
   if (isBelowLimit() && !envelope.getEvent()->isResponse())
   {
-    scMessage *message = dynamic_cast<scMessage *> (envelope.getEvent());  
-    scDataNode &params = message->getParams(); 
+    // read only - shared encoded params are kept
+    const scMessage *message = dynamic_cast<const scMessage *> (envelope.getEvent());  
+    const scDataNode &params = message->getParams(); 
     bool senderOk = m_allowSenderAsReader || (envelope.getSender().getAsString() != m_target);
     if (!senderOk && params.hasChild("_squeue"))
     {
-      scDataNode &squeueParams = params["_squeue"];
+      scDataNode &squeueParams = const_cast<scDataNode &>(params)["_squeue"];
       if (!squeueParams.getBool("skip_sender", true))
       {
         senderOk = true;
@@ -1736,7 +3824,7 @@ bool scSmplQueueReaderTask::acceptEnvelope(const scEnvelope &envelope)
 }
 
 // send message to reader - remote node
-bool scSmplQueueReaderTask::forwardEnvelope(scEnvelope &envelope)
+bool scSmplQueueReaderTask::forwardEnvelope(scEnvelope &envelope, bool keepPayload)
 {
   scMessage *message = dynamic_cast<scMessage *> (envelope.getEvent());  
   bool res = false;
@@ -1758,14 +3846,66 @@ bool scSmplQueueReaderTask::forwardEnvelope(scEnvelope &envelope)
      Log::addDebug("SQueue: forwarding envelope to: ["+m_target+"]");     
 #endif  
     getScheduler()->postEnvelope(envelopeGuard.release());
+    if (m_queueManager != SC_NULL)
+      m_queueManager->noteDispatched(envelope);
     
-    addWaitingMsg(envelope, outRequestId);
+    if (keepPayload) {
+      addWaitingMsg(envelope, outRequestId);
+    } else {
+      // message is kept by queue manager, response needs only sender & request ID
+      scEnvelope replyInfo(envelope.getSender(), envelope.getReceiver(), 
+        new scMessage(message->getCommand(), SC_NULL, message->getRequestId()));
+      addWaitingMsg(replyInfo, outRequestId);
+    }
     res = true;
   }
 
   return res;
 }
 
+// send messages to reader as one message, response contains list of results
+bool scSmplQueueReaderTask::forwardBatch(scEnvelopeColn &envelopes)
+{
+  assert(m_target.length()>0);  
+  assert(getScheduler() != SC_NULL);  
+
+  std::auto_ptr<scSmplQueueBatch> batch(new scSmplQueueBatch());
+  scDataNode items(ict_list);
+  
+  for(scEnvelopeColn::iterator it = envelopes.begin(); it != envelopes.end(); ++it)
+  {
+    scMessage *message = dynamic_cast<scMessage *> (it->getEvent());  
+    if ((message == SC_NULL) || (message->getRequestId() == SC_REQUEST_ID_NULL))
+      return false;
+    std::auto_ptr<scDataNode> itemGuard(new scDataNode(ict_parent));  
+    itemGuard->addChild("command", new scDataNode(message->getCommand()));
+    itemGuard->addChild("params", new scDataNode(message->getParams()));
+    items.addChild(itemGuard.release());
+    batch->addItem(*it);
+  }  
+
+  scDataNode params(ict_parent);
+  params.addChild("items", new scDataNode(items));
+
+  scMessageAddress newReceiver(m_target);
+  scMessageAddress newSender = getOwnAddress(newReceiver.getProtocol());
+  int outRequestId = getNextRequestId();
+
+#ifdef SMPL_QUEUE_LOG_ENABLED
+  Log::addDebug("SQueue: forwarding batch to: ["+m_target+"]");     
+#endif  
+  getScheduler()->postEnvelope(
+    new scEnvelope(newSender, newReceiver, new scMessage("squeue.batch", &params, outRequestId)));
+
+  if (m_queueManager != SC_NULL)
+    for(scEnvelopeColn::iterator it = envelopes.begin(); it != envelopes.end(); ++it)
+      m_queueManager->noteDispatched(*it);
+
+  m_batchItemCount += batch->size();
+  m_waitingBatches.insert(outRequestId, batch.release());
+  return true;
+}
+
 void scSmplQueueReaderTask::cancelAll()
 {
   scRequestItemMapColnIterator p = m_waitingRequests.begin();
@@ -1776,6 +3916,9 @@ void scSmplQueueReaderTask::cancelAll()
     idSet.insert((*p).first);
     ++p;
   }
+
+  for(scSmplQueueBatchMap::iterator pb = m_waitingBatches.begin(); pb != m_waitingBatches.end(); ++pb)
+    idSet.insert(pb->first);
   
   it = idSet.begin();
   while(it != idSet.end())
@@ -1785,10 +3928,28 @@ void scSmplQueueReaderTask::cancelAll()
   }
 }
 
+// forwarded messages & batches have own request IDs, original one is 
+// stored in waiting item
+void scSmplQueueReaderTask::cancelQueuedRequest(uint queuedRequestId, int reasonCode)
+{
+  for(scRequestItemMapColnIterator p = m_waitingRequests.begin(); p != m_waitingRequests.end(); ++p)
+    if (p->second->getRequestId() == queuedRequestId) {
+      cancelRequest(p->first, reasonCode);
+      return;
+    }
+
+  for(scSmplQueueBatchMap::iterator pb = m_waitingBatches.begin(); pb != m_waitingBatches.end(); ++pb)
+    for(uint i = 0, epos = pb->second->size(); i != epos; i++)
+      if (pb->second->getItem(i).getRequestId() == queuedRequestId) {
+        cancelRequest(pb->first, reasonCode);
+        return;
+      }
+}
+
 void scSmplQueueReaderTask::cancelRequest(uint requestId, int reasonCode)
 {
   scRequestItemMapColnIterator p = m_waitingRequests.find(requestId);
-  if(p == m_waitingRequests.end()) {
+  if((p == m_waitingRequests.end()) && (m_waitingBatches.find(requestId) == m_waitingBatches.end())) {
     return;
   }
 
@@ -1804,8 +3965,15 @@ void scSmplQueueReaderTask::cancelRequest(uint requestId, int reasonCode)
 // ----------------------------------------------------------------------------
 // scSmplQueueModule
 // ----------------------------------------------------------------------------
+// "adaptive" given explicitly wins over limit_min / limit_max
+static bool isAdaptiveLimitOn(const scDataNode &params)
+{
+  if (params.hasChild("adaptive"))
+    return params.getBool("adaptive");
+  return params.hasChild("limit_min") || params.hasChild("limit_max");
+}
 
-scSmplQueueModule::scSmplQueueModule(): scModule(), m_keepAliveTask(SC_NULL)
+scSmplQueueModule::scSmplQueueModule(): scModule(), m_watchingPeers(false), m_keepAliveTask(SC_NULL)
 {
 }
 
@@ -1858,10 +4026,18 @@ int scSmplQueueModule::handleMessage(scMessage *message, scResponse &response)
     {
       res = handleCmdMarkAlive(message, response);
     }  
+    else if (coreCmd == "mark_alive_multi")
+    {
+      res = handleCmdMarkAliveMulti(message, response);
+    }  
     else if (coreCmd == "get_status")
     {
       res = handleCmdGetStatus(message, response);
     }  
+    else if (coreCmd == "get_stats")
+    {
+      res = handleCmdGetStats(message, response);
+    }  
     else if (coreCmd == "clear")
     {
       res = handleCmdClear(message, response);
@@ -1878,6 +4054,10 @@ int scSmplQueueModule::handleMessage(scMessage *message, scResponse &response)
     {
       res = handleCmdKeepAlive(message, response);
     } 
+    else if (coreCmd == "peer_down")
+    {
+      res = handleCmdPeerDown(message, response);
+    } 
   }
   
   response.setStatus(res);
@@ -1980,6 +4160,16 @@ scTask *scSmplQueueModule::prepareManager(scMessage *message)
     uint contactTimeout = params.getUInt("contact_timeout", 0);    
     uint resultTimeout = params.getUInt("result_timeout", 0);  
     uint storeTimeout = params.getUInt("store_timeout", 0);  
+    scString broadcastAddr = params.getString("broadcast_addr", "");
+    scString spillDir = params.getString("spill_dir", "");
+    uint spillHigh = params.getUInt("spill_high", 0);
+    uint spillLow = params.getUInt("spill_low", spillHigh / 2);
+    uint spillSegmentSize = params.getUInt("spill_segment_size", GRD_SPILL_DEF_SEGMENT_SIZE);
+    uint shardCount = params.getUInt("shards", 0);
+    scString shardBy = params.getString("shard_by", GRD_SQUEUE_SHARD_BY_RR);
+    scString keyPath = params.getString("key_path", "");
+    scString aggregate = params.getString("aggregate", GRD_SQUEUE_AGGREGATE_EACH);
+    uint quorum = params.getUInt("quorum", 0);
 
     scDataNode extraParams;  
 
@@ -1989,6 +4179,16 @@ scTask *scSmplQueueModule::prepareManager(scMessage *message)
     extraParams.addElement("contact_timeout", scDataNode(contactTimeout));
     extraParams.addElement("result_timeout", scDataNode(resultTimeout));    
     extraParams.addElement("store_timeout", scDataNode(storeTimeout));    
+    extraParams.addElement("broadcast_addr", scDataNode(broadcastAddr));    
+    extraParams.addElement("spill_dir", scDataNode(spillDir));    
+    extraParams.addElement("spill_high", scDataNode(spillHigh));    
+    extraParams.addElement("spill_low", scDataNode(spillLow));    
+    extraParams.addElement("spill_segment_size", scDataNode(spillSegmentSize));    
+    extraParams.addElement("shards", scDataNode(shardCount));    
+    extraParams.addElement("shard_by", scDataNode(shardBy));    
+    extraParams.addElement("key_path", scDataNode(keyPath));    
+    extraParams.addElement("aggregate", scDataNode(aggregate));    
+    extraParams.addElement("quorum", scDataNode(quorum));    
     
     if (!qname.empty()) {
       if (qtypeText.empty() || (qtypeText == GRD_SQUEUE_TYPE_ROUND_ROBIN))
@@ -2006,6 +4206,12 @@ scTask *scSmplQueueModule::prepareManager(scMessage *message)
       } else if (qtypeText == GRD_SQUEUE_TYPE_FORWARD)
       {
         qtype = sstForward;
+      } else if (qtypeText == GRD_SQUEUE_TYPE_LEAST_LOADED)
+      {
+        qtype = sstLeastLoaded;
+      } else if (qtypeText == GRD_SQUEUE_TYPE_KEYED)
+      {
+        qtype = sstKeyed;
       } else if (qtypeText == GRD_SQUEUE_TYPE_NULL_DEV)
       {
         qtype = sstNullDev;
@@ -2034,6 +4240,17 @@ scTask *scSmplQueueModule::prepareReader(scMessage *message)
     
     if (!qname.empty()) {
       guard.reset(prepareReader(findQueue(qname), target));
+      scSmplQueueReaderTask *reader = static_cast<scSmplQueueReaderTask *>(guard.get());
+      if (params.hasChild("batch")) {
+        reader->setBatchSize(params.getUInt("batch"));
+        // by default allow one full batch in progress
+        if (!params.hasChild("capacity"))
+          reader->setLimit(reader->getBatchSize());
+      }  
+      if (params.hasChild("capacity"))
+        reader->setLimit(params.getUInt("capacity"));
+      if (isAdaptiveLimitOn(params))
+        reader->setAdaptiveLimit(params.getUInt("limit_min", 1), params.getUInt("limit_max", GRD_SQUEUE_ADAPT_DEF_MAX));
     }
   }  
   
@@ -2050,6 +4267,8 @@ scTask *scSmplQueueModule::prepareReader(scSmplQueueManagerTask *queue, const sc
 
   guard.reset(new scSmplQueueReaderTask());
   res = guard.get();
+  if (queue != SC_NULL)
+    queue = queue->getQueueForReader();
   res->setQueueManager(queue);
   res->setTarget(target);
   
@@ -2077,6 +4296,33 @@ scSmplQueueManagerTask *scSmplQueueModule::createQueue(scSmplQueueType qtype, co
   if (queueExists(name))
     throw scError("Queue already exists: ["+name+"]");
 
+  // shard names (and their spill files) cannot be taken by other queue
+  if (name.find(GRD_SQUEUE_SHARD_SUFFIX) != scString::npos)
+    throw scError("Queue name is reserved: ["+name+"]");
+
+  if (extraParams.getUInt("shards", 0) > 1)
+    guard.reset(createShardedQueue(qtype, name, allowSenderAsReader, durable, extraParams));
+  else
+    guard.reset(newQueue(qtype, name, allowSenderAsReader, durable, extraParams));
+
+  m_managers.push_back(guard.get());
+  watchPeers();
+  
+  if (qtype == sstForward)
+  {
+    assert(!forwardToAddr.empty());
+    prepareReader(guard.get(), forwardToAddr);
+  }  
+  
+  return guard.release();
+}
+
+// creates queue task without registering it
+scSmplQueueManagerTask *scSmplQueueModule::newQueue(scSmplQueueType qtype, const scString &name, 
+  bool allowSenderAsReader, bool durable, const scDataNode &extraParams)
+{
+  std::auto_ptr<scSmplQueueManagerTask> guard;
+
   switch (qtype) {
     case sstNullDev:  
       guard.reset(new scSmplQueueManagerTaskNullDev());  
@@ -2085,8 +4331,14 @@ scSmplQueueManagerTask *scSmplQueueModule::createQueue(scSmplQueueType qtype, co
       guard.reset(new scSmplQueueManagerTaskPull(allowSenderAsReader));  
       break;
     case sstMultiCast:  
+    {
       guard.reset(new scSmplQueueManagerTaskMultiCast(allowSenderAsReader));  
+      scSmplQueueManagerTaskMultiCast *task = static_cast<scSmplQueueManagerTaskMultiCast *>(guard.get());
+      task->setBroadcastAddr(extraParams.getString("broadcast_addr", ""));
+      task->setAggregate(extraParams.getString("aggregate", GRD_SQUEUE_AGGREGATE_EACH));
+      task->setQuorum(extraParams.getUInt("quorum", 0));
       break;
+    }
     case sstHighAvail:
       guard.reset(new scSmplQueueManagerTaskHighAvail(allowSenderAsReader, durable));  
       break;
@@ -2095,8 +4347,15 @@ scSmplQueueManagerTask *scSmplQueueModule::createQueue(scSmplQueueType qtype, co
       break;
     default: 
     { 
-      guard.reset(new scSmplQueueManagerTaskRoundRobin(allowSenderAsReader, durable));        
-      scSmplQueueManagerTaskRoundRobin *task = static_cast<scSmplQueueManagerTaskRoundRobin *>(guard.get());
+      if (qtype == sstLeastLoaded)
+        guard.reset(new scSmplQueueManagerTaskLeastLoaded(allowSenderAsReader, durable));        
+      else if (qtype == sstKeyed)
+      {
+        guard.reset(new scSmplQueueManagerTaskKeyed(allowSenderAsReader, durable));        
+        static_cast<scSmplQueueManagerTaskKeyed *>(guard.get())->setKeyPath(extraParams.getString("key_path", ""));
+      } else  
+        guard.reset(new scSmplQueueManagerTaskRoundRobin(allowSenderAsReader, durable));        
+      scSmplQueueManagerTaskDurable *task = static_cast<scSmplQueueManagerTaskDurable *>(guard.get());
       task->setRetryLimit(extraParams.getUInt("retry_limit"));
       task->setRetryDelay(extraParams.getUInt("retry_delay"));
       task->setContactTimeout(extraParams.getUInt("contact_timeout"));
@@ -2108,14 +4367,53 @@ scSmplQueueManagerTask *scSmplQueueModule::createQueue(scSmplQueueType qtype, co
 
   scSmplQueueManagerTask *res = guard.get();
   res->setName(name);
-  m_managers.push_back(res);
-  
-  if (qtype == sstForward)
+
+  scString spillDir = extraParams.getString("spill_dir", "");
+  uint spillHigh = extraParams.getUInt("spill_high", 0);
+  if (!spillDir.empty() && (spillHigh > 0) && (qtype != sstNullDev))
   {
-    assert(!forwardToAddr.empty());
-    prepareReader(guard.get(), forwardToAddr);
+    // process ID - many nodes can use the same directory
+    scString spillPath = spillDir + "/" + GRD_SQUEUE_SPILL_FILE_PREFIX + name + "_" + 
+      toString(static_cast<ulong64>(proc::getCurrentProcessId()));
+    res->setSpill(spillPath, spillHigh, extraParams.getUInt("spill_low", 0), 
+      extraParams.getUInt("spill_segment_size", GRD_SPILL_DEF_SEGMENT_SIZE));
+  }
+
+  return guard.release();
+}
+
+// shards are separate tasks running in the same scheduler, they are 
+// known only to the returned task which represents the whole queue;
+// shards are passed to scheduler only when all of them are created
+scSmplQueueManagerTask *scSmplQueueModule::createShardedQueue(scSmplQueueType qtype, const scString &name, 
+  bool allowSenderAsReader, bool durable, const scDataNode &extraParams)
+{
+  if ((qtype != sstRoundRobin) && (qtype != sstLeastLoaded))
+    throw scError("Queue type does not support shards: ["+name+"]");
+
+  uint shardCount = extraParams.getUInt("shards");
+  if (shardCount > GRD_SQUEUE_MAX_SHARDS)
+    shardCount = GRD_SQUEUE_MAX_SHARDS;
+
+  scString shardBy = extraParams.getString("shard_by", GRD_SQUEUE_SHARD_BY_RR);
+  if ((shardBy != GRD_SQUEUE_SHARD_BY_RR) && (shardBy != GRD_SQUEUE_SHARD_BY_SENDER))
+    throw scError("Unknown shard_by value: ["+shardBy+"]");
+
+  std::auto_ptr<scSmplQueueManagerTaskSharded> guard(
+    new scSmplQueueManagerTaskSharded(allowSenderAsReader, (shardBy == GRD_SQUEUE_SHARD_BY_SENDER)));
+    
+  boost::ptr_vector<scSmplQueueManagerTask> shards;
+  for(uint i = 0; i < shardCount; i++)
+    shards.push_back(newQueue(qtype, name + GRD_SQUEUE_SHARD_SUFFIX + toString(i), allowSenderAsReader, durable, extraParams));
+
+  while(!shards.empty())
+  {
+    scSmplQueueManagerTask *shard = shards.release(shards.begin()).release();
+    guard->addShard(shard);
+    m_scheduler->addTask(shard);
   }  
-  
+
+  guard->setName(name);
   return guard.release();
 }
 
@@ -2183,6 +4481,15 @@ int scSmplQueueModule::handleCmdListen(scMessage *message, scResponse &response)
         if (queue != SC_NULL)
           readerFound = queue->hasReader(readerAddr);
          
+        // capacity & adaptive mode can be changed by next listen 
+        if (readerFound && !isAdaptiveLimitOn(params) && params.hasChild("adaptive"))
+          queue->clearReaderAdaptiveLimit(readerAddr);
+        if (readerFound && params.hasChild("capacity"))
+          queue->setReaderLimit(readerAddr, params.getUInt("capacity"));
+        if (readerFound && isAdaptiveLimitOn(params))
+          queue->setReaderAdaptiveLimit(readerAddr, 
+            params.getUInt("limit_min", 1), params.getUInt("limit_max", GRD_SQUEUE_ADAPT_DEF_MAX));
+
         if (readerFound)  
      	    res = SC_MSG_STATUS_OK;        
      	  else  
@@ -2278,6 +4585,39 @@ int scSmplQueueModule::handleCmdMarkAlive(scMessage *message, scResponse &respon
   return res;
 }
 
+// one message from reader node for all its queues at this node
+int scSmplQueueModule::handleCmdMarkAliveMulti(scMessage *message, scResponse &response)
+{
+  int res = SC_MSG_STATUS_WRONG_PARAMS;
+
+  scDataNode &params = message->getParams(); 
+  response.initFor(*message);        
+
+  if (params.hasChild("queue_names") && params.hasChild("source_name")) 
+  {
+    scString srcName = params.getString("source_name");
+    scDataNode &queueNames = params["queue_names"];
+    scDataNode result(ict_parent);
+    scString queueName;
+
+    for(uint i=0, epos = queueNames.size(); i != epos; i++)
+    {
+      queueName = queueNames.getString(i);
+      if (result.hasChild(queueName))
+        continue;
+      if (performMarkAlive(queueName, srcName))
+        result.addChild(queueName, new scDataNode(SC_MSG_STATUS_OK));
+      else  
+        result.addChild(queueName, new scDataNode(SC_MSG_STATUS_ERROR));
+    }
+
+    response.setResult(result);
+    res = SC_MSG_STATUS_OK;
+  } 
+           
+  return res;
+}
+
 bool scSmplQueueModule::performMarkAlive(const scString &queueName, const scString &srcName)
 {
   bool res = false;
@@ -2289,6 +4629,37 @@ bool scSmplQueueModule::performMarkAlive(const scString &queueName, const scStri
   return res;
 }
 
+// readers are removed when gate detects lost peer (heartbeat, keepalive)
+void scSmplQueueModule::watchPeers()
+{
+  if (m_watchingPeers || (m_scheduler == SC_NULL))
+    return;
+
+  scDataNode params(ict_parent);
+  params.addChild("command", new scDataNode(scString("squeue.peer_down")));
+  m_scheduler->postMessage(m_scheduler->getOwnAddress().getAsString(), "core.watch_peers", &params);
+  m_watchingPeers = true;
+}
+
+int scSmplQueueModule::handleCmdPeerDown(scMessage *message, scResponse &response)
+{
+  int res = SC_MSG_STATUS_WRONG_PARAMS;
+
+  scDataNode &params = message->getParams(); 
+  response.initFor(*message);        
+
+  if (params.hasChild("address")) {
+    scMessageAddress peerAddr(params.getString("address"));
+    uint cnt = 0;
+    for (scSmplQueueManagerList::const_iterator p = m_managers.begin(); p != m_managers.end(); ++p)
+      cnt += (*p)->dropReadersAt(peerAddr);
+    response.setResult(scDataNode(cnt));
+    res = SC_MSG_STATUS_OK;
+  }
+
+  return res;
+}
+
 int scSmplQueueModule::handleCmdListenAt(scMessage *message, scResponse &response)
 {
   int res = SC_MSG_STATUS_WRONG_PARAMS;
@@ -2319,6 +4690,16 @@ int scSmplQueueModule::handleCmdListenAt(scMessage *message, scResponse &respons
       
       newParams.addChild("queue_name", new scDataNode(queue_name));
       newParams.addChild("target_name", new scDataNode(target_name));
+      if (params.hasChild("capacity"))
+        newParams.addChild("capacity", new scDataNode(params.getUInt("capacity")));
+      if (params.hasChild("batch"))
+        newParams.addChild("batch", new scDataNode(params.getUInt("batch")));
+      if (params.hasChild("adaptive"))
+        newParams.addChild("adaptive", new scDataNode(params.getBool("adaptive")));
+      if (params.hasChild("limit_min"))
+        newParams.addChild("limit_min", new scDataNode(params.getUInt("limit_min")));
+      if (params.hasChild("limit_max"))
+        newParams.addChild("limit_max", new scDataNode(params.getUInt("limit_max")));
       
       m_scheduler->postMessage(exec_at_addr, "squeue.listen", &newParams);
       res = SC_MSG_STATUS_OK;
@@ -2416,6 +4797,58 @@ int scSmplQueueModule::handleCmdGetStatus(scMessage *message, scResponse &respon
   return res;
 }
 
+int scSmplQueueModule::handleCmdGetStats(scMessage *message, scResponse &response)
+{
+  int res = SC_MSG_STATUS_OK;
+
+  scDataNode &params = message->getParams(); 
+  response.initFor(*message);        
+
+  scString qname;
+  if (params.hasChild("name"))
+    qname = params.getString("name");
+  else if (!params.empty())
+    qname = params.getString(0);
+
+  scDataNode result;
+
+  if (qname.empty()) {
+    getStats(result);
+  } else if (queueExists(qname)) {
+    checkQueue(qname)->getStats(result);
+  } else {
+    res = SC_MSG_STATUS_ERROR;
+    setUnknownQueueError(qname, response);
+  }
+
+  if (res == SC_MSG_STATUS_OK)
+    response.setResult(result);
+           
+  return res;
+}
+
+// shards are reported inside of their queue
+void scSmplQueueModule::getStats(scDataNode &output)
+{
+  scSmplQueueManagerList::const_iterator p;
+  std::auto_ptr<scDataNode> itemGuard;
+  std::auto_ptr<scDataNode> queuesGuard(new scDataNode(ict_list));
+
+  for (p = m_managers.begin(); p != m_managers.end(); ++p) {
+    itemGuard.reset(new scDataNode());
+    (*p)->getStats(*itemGuard);
+    queuesGuard->addChild(itemGuard.release());
+  }
+
+  output.clear();
+  if (queuesGuard->empty())
+    return;
+
+  output.setAsParent();
+  output.addChild("module", new scDataNode(scString("squeue")));
+  output.addChild("queues", queuesGuard.release());
+}
+
 int scSmplQueueModule::handleCmdKeepAlive(scMessage *message, scResponse &response)
 {
   int res = SC_MSG_STATUS_WRONG_PARAMS;
@@ -2434,9 +4867,17 @@ int scSmplQueueModule::handleCmdKeepAlive(scMessage *message, scResponse &respon
 void scSmplQueueModule::closeQueue(const scString &name)
 {
   scSmplQueueManagerTask *manager = checkQueue(name);
+  scSmplQueueManagerList shards;
+  manager->getShards(shards);
+  shards.push_back(manager);
+
   m_managers.remove(manager);
-  manager->deleteReaders();
-  scSchedulerIntf *scheduler = manager->getScheduler();
-  scheduler->deleteTask(manager);
+
+  for(scSmplQueueManagerList::iterator it = shards.begin(), epos = shards.end(); it != epos; ++it)
+  {
+    (*it)->deleteReaders();
+    scSchedulerIntf *scheduler = (*it)->getScheduler();
+    scheduler->deleteTask(*it);
+  }  
 }
 
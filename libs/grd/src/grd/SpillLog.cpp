@@ -0,0 +1,294 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        SpillLog.cpp
+// Project:     grdLib
+// Purpose:     Memory-mapped segment log for envelopes spilled from memory.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+//std
+#include <memory>
+
+//boost
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+#include "boost/interprocess/file_mapping.hpp"
+#include "boost/interprocess/mapped_region.hpp"
+
+//sc
+#include "sc/utils.h"
+#include "perf/Log.h"
+#include "perf/Counter.h"
+
+//grd
+#include "grd/SpillLog.h"
+
+#ifdef DEBUG_MEM
+#include "sc/DebugMem.h"
+#endif
+
+using namespace perf;
+
+const uint GRD_SPILL_REC_HEADER_SIZE = 4;
+const uint GRD_SPILL_REC_INFO_SIZE = 8 + 8 + 4;
+
+// ----------------------------------------------------------------------------
+// Local functions
+// ----------------------------------------------------------------------------
+static void grdSpillPutUInt(unsigned char *output, ulong64 value, uint size)
+{
+  for(uint i = size; i > 0; i--) {
+    output[i - 1] = static_cast<unsigned char>(value & 0xff);
+    value = value >> 8;
+  }
+}
+
+static ulong64 grdSpillGetUInt(const unsigned char *input, uint size)
+{
+  ulong64 res = 0;
+  for(uint i = 0; i < size; i++)
+    res = (res << 8) | input[i];
+  return res;
+}
+
+// ----------------------------------------------------------------------------
+// Local class declarations
+// ----------------------------------------------------------------------------
+/// one file of spill log, mapped to memory as a whole
+class grdSpillSegment {
+public:
+  grdSpillSegment(const scString &path, size_t size);
+  virtual ~grdSpillSegment();
+  /// appends record (info + data), returns <false> if there is no space
+  bool write(const unsigned char *info, const scString &data);
+  /// returns next record, <false> if all records were read
+  bool read(const char *&data, size_t &dataSize);
+  bool isSealed() const { return m_sealed; }
+  /// no more writes, segment will be deleted after read
+  void seal() { m_sealed = true; }
+  bool isExhausted() const { return (m_readPos >= m_writePos); }
+protected:
+  void createFile();
+  void removeFile();
+protected:
+  scString m_path;
+  size_t m_size;
+  size_t m_writePos;
+  size_t m_readPos;
+  bool m_sealed;
+  char *m_base;
+  std::auto_ptr<boost::interprocess::file_mapping> m_file;
+  std::auto_ptr<boost::interprocess::mapped_region> m_region;
+};
+
+// ----------------------------------------------------------------------------
+// grdSpillSegment
+// ----------------------------------------------------------------------------
+grdSpillSegment::grdSpillSegment(const scString &path, size_t size):
+  m_path(path), m_size(size), m_writePos(0), m_readPos(0), m_sealed(false), m_base(SC_NULL)
+{
+  createFile();
+  try {
+    m_file.reset(new boost::interprocess::file_mapping(m_path.c_str(), boost::interprocess::read_write));
+    m_region.reset(new boost::interprocess::mapped_region(*m_file, boost::interprocess::read_write, 0, m_size));
+  }
+  catch(const boost::interprocess::interprocess_exception &e) {
+    m_region.reset();
+    m_file.reset();
+    removeFile();
+    throw scError(scString("Spill segment mapping failed: ")+m_path+", "+e.what());
+  }
+  m_base = static_cast<char *>(m_region->get_address());
+}
+
+grdSpillSegment::~grdSpillSegment()
+{
+  m_region.reset();
+  m_file.reset();
+  removeFile();
+}
+
+// blocks are allocated now - sparse file would raise SIGBUS on write
+// to mapped memory when disk is full
+void grdSpillSegment::createFile()
+{
+  int fd = open(m_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0)
+    throw scError(scString("Spill segment create failed: ")+m_path+", "+strerror(errno));
+
+  int res = posix_fallocate(fd, 0, m_size);
+  close(fd);
+
+  if (res != 0) {
+    removeFile();
+    if (res == ENOSPC)
+      Counter::inc("sq-spill-no-space");
+    throw scError(scString("Spill segment allocation failed: ")+m_path+", "+strerror(res));
+  }
+}
+
+void grdSpillSegment::removeFile()
+{
+  try {
+    boost::filesystem::remove(boost::filesystem::path(m_path.c_str()));
+  }
+  catch(const std::exception &e) {
+    Log::addError(scString("Spill segment remove failed: ")+m_path+", "+e.what());
+  }
+}
+
+bool grdSpillSegment::write(const unsigned char *info, const scString &data)
+{
+  uint len = GRD_SPILL_REC_INFO_SIZE + data.length();
+  if (m_sealed || (m_writePos + GRD_SPILL_REC_HEADER_SIZE + len > m_size))
+    return false;
+
+  char *output = m_base + m_writePos;
+  grdSpillPutUInt(reinterpret_cast<unsigned char *>(output), len, GRD_SPILL_REC_HEADER_SIZE);
+  output += GRD_SPILL_REC_HEADER_SIZE;
+  memcpy(output, info, GRD_SPILL_REC_INFO_SIZE);
+  memcpy(output + GRD_SPILL_REC_INFO_SIZE, data.c_str(), data.length());
+  m_writePos += GRD_SPILL_REC_HEADER_SIZE + len;
+  return true;
+}
+
+bool grdSpillSegment::read(const char *&data, size_t &dataSize)
+{
+  if (isExhausted())
+    return false;
+
+  dataSize = static_cast<size_t>(
+    grdSpillGetUInt(reinterpret_cast<const unsigned char *>(m_base + m_readPos), GRD_SPILL_REC_HEADER_SIZE));
+  data = m_base + m_readPos + GRD_SPILL_REC_HEADER_SIZE;
+  m_readPos += GRD_SPILL_REC_HEADER_SIZE + dataSize;
+
+  // all read from segment still in use - start from beginning
+  if (!m_sealed && isExhausted())
+    m_readPos = m_writePos = 0;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// grdSpillLog
+// ----------------------------------------------------------------------------
+grdSpillLog::grdSpillLog(const scString &basePath, uint segmentSize):
+  m_basePath(basePath), m_segmentSize(segmentSize), m_nextSeqNo(1), m_count(0)
+{
+  if (m_segmentSize < GRD_SPILL_MIN_SEGMENT_SIZE)
+    m_segmentSize = GRD_SPILL_MIN_SEGMENT_SIZE;
+  // records can be decoded in any order and after clear
+  m_serializer.setSelfContained(true);
+}
+
+grdSpillLog::~grdSpillLog()
+{
+  clear();
+}
+
+const scString &grdSpillLog::getBasePath() const
+{
+  return m_basePath;
+}
+
+uint grdSpillLog::getSegmentSize() const
+{
+  return m_segmentSize;
+}
+
+size_t grdSpillLog::size() const
+{
+  return m_count;
+}
+
+bool grdSpillLog::empty() const
+{
+  return (m_count == 0);
+}
+
+uint grdSpillLog::getSegmentCount() const
+{
+  return m_segments.size();
+}
+
+scString grdSpillLog::getSegmentPath(uint seqNo) const
+{
+  return m_basePath+"."+toString(seqNo)+".seg";
+}
+
+grdSpillSegment *grdSpillLog::addSegment(size_t minSize)
+{
+  size_t segSize = m_segmentSize;
+  if (segSize < minSize)
+    segSize = minSize;
+  m_segments.push_back(new grdSpillSegment(getSegmentPath(m_nextSeqNo++), segSize));
+  Counter::inc("sq-spill-segments");
+  return &m_segments.back();
+}
+
+void grdSpillLog::push(const scEnvelope &envelope, const grdSpillRecordInfo &info)
+{
+  unsigned char infoData[GRD_SPILL_REC_INFO_SIZE];
+  grdSpillPutUInt(infoData, info.enqueueTime, 8);
+  grdSpillPutUInt(infoData + 8, info.startTime, 8);
+  grdSpillPutUInt(infoData + 16, info.retryCount, 4);
+
+  m_serializer.convToString(envelope, m_buffer);
+
+  if (m_segments.empty() || !m_segments.back().write(infoData, m_buffer))
+  {
+    if (!m_segments.empty())
+      m_segments.back().seal();
+    if (!addSegment(GRD_SPILL_REC_HEADER_SIZE + GRD_SPILL_REC_INFO_SIZE + m_buffer.length())->write(infoData, m_buffer))
+      throw scError("Spill log write failed: "+m_basePath);
+  }
+
+  m_count++;
+}
+
+bool grdSpillLog::pop(scEnvelope &output)
+{
+  grdSpillRecordInfo info;
+  return pop(output, info);
+}
+
+bool grdSpillLog::pop(scEnvelope &output, grdSpillRecordInfo &info)
+{
+  const char *data;
+  size_t dataSize;
+
+  while(!m_segments.empty())
+  {
+    grdSpillSegment &segment = m_segments.front();
+    if (segment.read(data, dataSize)) {
+      const unsigned char *infoData = reinterpret_cast<const unsigned char *>(data);
+      info.enqueueTime = grdSpillGetUInt(infoData, 8);
+      info.startTime = grdSpillGetUInt(infoData + 8, 8);
+      info.retryCount = static_cast<uint>(grdSpillGetUInt(infoData + 16, 4));
+      m_serializer.convFromBuffer(data + GRD_SPILL_REC_INFO_SIZE, dataSize - GRD_SPILL_REC_INFO_SIZE, output);
+      m_count--;
+      if (segment.isSealed() && segment.isExhausted())
+        m_segments.pop_front();
+      return true;
+    }
+
+    if (!segment.isSealed())
+      break;
+    m_segments.pop_front();
+  }
+
+  return false;
+}
+
+void grdSpillLog::clear()
+{
+  m_segments.clear();
+  m_count = 0;
+}
@@ -0,0 +1,1542 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        TcpRawGate.cpp
+// Project:     grdLib
+// Purpose:     Native TCP gate with length-prefixed framing (Linux).
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+// posix
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+
+// std
+#include <list>
+#include <map>
+#include <vector>
+#include <set>
+
+// boost
+#include "boost/thread.hpp"
+#include "boost/bind.hpp"
+#include "boost/ptr_container/ptr_vector.hpp"
+#include "boost/ptr_container/ptr_map.hpp"
+
+#include "grd/TcpRawGate.h"
+#include "grd/EnvSerializerJsonYajl.h"
+#include "grd/EnvSerializerBinDict.h"
+#include "grd/MessageGate.h"
+#include "grd/MessageAddress.h"
+#include "grd/Connection.h"
+#include "grd/ConnectionPool.h"
+#include "grd/MessageConst.h"
+
+#include "perf/time_utils.h"
+#include "perf/Timer.h"
+#include "perf/Counter.h"
+#include "perf/Log.h"
+
+#ifdef DEBUG_MEM
+#include "sc/DebugMem.h"
+#endif
+
+using namespace perf;
+
+//----------------------------------------------------------------------------------
+// Constants
+//----------------------------------------------------------------------------------
+const uint GRD_TCPX_DEF_INACT_CONN_TIMEOUT = 30000;
+const uint GRD_TCPX_HEADER_SIZE = 4;
+const uint GRD_TCPX_READ_CHUNK = 64*1024;    // min free space for one read
+const uint GRD_TCPX_MAX_CONTROL_SIZE = 256;  // max size of frame sent back by receiver
+const uint GRD_TCPX_SEND_BATCH = 64;         // max messages per writev
+const uint GRD_TCPX_MAX_EVENTS = 64;
+const uint GRD_TCPX_WAIT_TIMEOUT = 100;      // ms, server thread poll limit
+const uint GRD_TCPX_DEF_SEND_TIMEOUT = 3000; // ms without progress before pending messages fail
+const uint GRD_TCPX_DEF_CONNECT_TIMEOUT = 3000;
+const int GRD_TCPX_LISTEN_BACKLOG = 128;
+const uint GRD_TCPX_PEER_CHECK_INTERVAL = 1000; // ms, dead peer check of idle connections
+const scString GRD_TCPX_FORMAT_JSON = "json";
+const scString GRD_TCPX_FORMAT_BIN = "bin";
+const scString GRD_TCPX_CONTROL_CONN_SUFFIX = "/control";
+
+//----------------------------------------------------------------------------------
+// Local functions
+//----------------------------------------------------------------------------------
+static void grdTcpxSetNonBlocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void grdTcpxSetNoDelay(int fd)
+{
+  int flag = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+// values = 0 - OS default
+static void grdTcpxSetKeepAlive(int fd, uint idleSecs, uint intvlSecs, uint count)
+{
+  int flag = 1;
+  setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &flag, sizeof(flag));
+  int value;
+  if (idleSecs > 0) {
+    value = idleSecs;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &value, sizeof(value));
+  }
+  if (intvlSecs > 0) {
+    value = intvlSecs;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &value, sizeof(value));
+  }
+  if (count > 0) {
+    value = count;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &value, sizeof(value));
+  }
+}
+
+// ':' is reserved in message addresses, so "host-port" is accepted as well
+static void grdTcpxSplitAddress(const scString &address, scString &host, scString &port)
+{
+  scString::size_type pos = address.rfind(':');
+  if (pos == scString::npos)
+    pos = address.rfind('-');
+  if (pos == scString::npos)
+    throw scError("TCPX address without port: "+address);
+  host = address.substr(0, pos);
+  port = address.substr(pos + 1);
+  if ((host == "*") || host.empty())
+    host = "0.0.0.0";
+}
+
+// address of this host that can be used by peers: first non-loopback IPv4 
+// address of host name, host name itself if there is no such address
+static scString grdTcpxResolveOwnHost()
+{
+  char name[256];
+  if (gethostname(name, sizeof(name)) != 0)
+    return "127.0.0.1";
+  name[sizeof(name) - 1] = '\0';
+
+  scString res(name);
+  struct addrinfo hints;
+  struct addrinfo *addrList = SC_NULL;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if ((getaddrinfo(name, SC_NULL, &hints, &addrList) != 0) || (addrList == SC_NULL))
+    return res;
+
+  for(struct addrinfo *it = addrList; it != SC_NULL; it = it->ai_next)
+  {
+    const struct sockaddr_in *addr = reinterpret_cast<const struct sockaddr_in *>(it->ai_addr);
+    if ((ntohl(addr->sin_addr.s_addr) >> 24) == 127)
+      continue;
+    char buffer[INET_ADDRSTRLEN];
+    if (inet_ntop(AF_INET, &addr->sin_addr, buffer, sizeof(buffer)) != SC_NULL) {
+      res = buffer;
+      break;
+    }
+  }
+
+  freeaddrinfo(addrList);
+  return res;
+}
+
+static void grdTcpxWriteHeader(size_t dataSize, unsigned char *output)
+{
+  uint32_t value = static_cast<uint32_t>(dataSize);
+  output[0] = static_cast<unsigned char>((value >> 24) & 0xff);
+  output[1] = static_cast<unsigned char>((value >> 16) & 0xff);
+  output[2] = static_cast<unsigned char>((value >> 8) & 0xff);
+  output[3] = static_cast<unsigned char>(value & 0xff);
+}
+
+static size_t grdTcpxReadHeader(const char *input)
+{
+  const unsigned char *data = reinterpret_cast<const unsigned char *>(input);
+  return
+    (static_cast<size_t>(data[0]) << 24) |
+    (static_cast<size_t>(data[1]) << 16) |
+    (static_cast<size_t>(data[2]) << 8) |
+    static_cast<size_t>(data[3]);
+}
+
+//----------------------------------------------------------------------------------
+// Local classes - declarations
+//----------------------------------------------------------------------------------
+typedef std::list<scString> grdTcpxMessageList;
+
+/// Frame received from client, queued for scheduler
+class grdTcpxFrame {
+public:
+  grdTcpxFrame(int a_fd): fd(a_fd) {}
+  int fd; // for requests sent back to client
+  scString data;
+};
+
+typedef std::list<grdTcpxFrame> grdTcpxFrameList;
+
+/// Stream reader, extracts frames from data read from socket
+class grdTcpxReader {
+public:
+  grdTcpxReader(): m_begin(0), m_end(0) {}
+  /// returns <false> on EOF or error
+  bool read(int fd, grdTcpxMessageList &output);
+protected:
+  void extractFrames(grdTcpxMessageList &output);
+  void prepareSpace(size_t needed);
+protected:
+  std::vector<char> m_buffer;
+  size_t m_begin;
+  size_t m_end;
+};
+
+typedef boost::ptr_map<int, grdTcpxReader> grdTcpxReaderMap;
+
+class grdTcpxGate: public scMessageGate {
+public:
+  grdTcpxGate();
+  virtual ~grdTcpxGate();
+  void setProtocol(const scString &protocol);
+  void setAddress(const scString &address);
+  void setInactTimeout(uint msecs);
+  void setFormat(const scString &format);
+  virtual bool supportsProtocol(const scString &protocol);
+  virtual bool getOwnAddress(const scString &protocol, scMessageAddress &output);
+  void setKeepAlive(uint idleSecs, uint intvlSecs, uint count);
+  void setAdvertiseHost(const scString &value);
+protected:
+  void applyKeepAlive(int fd);
+protected:
+  scString m_protocol;
+  scString m_address;
+  scString m_advertiseHost; // host sent to peers, if empty - bind host or own IP
+  scString m_format;
+  uint m_inactTimeout; // inactivity timeout for connections
+  bool m_keepAlive;    // SO_KEEPALIVE on all sockets, dead peer detection
+  uint m_keepAliveIdle;
+  uint m_keepAliveIntvl;
+  uint m_keepAliveCnt;
+};
+
+class grdTcpxConnectionOut: public scConnection {
+public:
+  // construction
+  grdTcpxConnectionOut();
+  virtual ~grdTcpxConnectionOut();
+  // exec
+  /// starts non-blocking connect, returns <false> if connect is in progress
+  bool connect(const scString &address);
+  /// returns <true> if connection is established, on error or timeout throws exception
+  bool checkConnecting(uint timeoutMs);
+  bool isConnecting() const;
+  virtual void close();
+  virtual bool isConnected();
+  /// sends messages starting from <sentCount> until socket buffer is full, 
+  /// frameOffset = number of bytes of first unsent frame already written,
+  /// on error throws exception
+  void sendBatch(const std::vector<scString> &messages, size_t &sentCount, size_t &frameOffset);
+  scEnvSerializerBinDict &getDictSerializer();
+  void setGeneration(uint value) { m_generation = value; }
+  uint getGeneration() const { return m_generation; }
+  int getHandle() const;
+  void setPeerHost(const scString &value);
+  const scString &getPeerHost() const;
+  void setConnectionId(const scString &value);
+  const scString &getConnectionId() const;
+  /// returns <true> if peer closed connection or keepalive failed
+  bool checkPeerLost();
+  /// handles frames sent back by receiver (resync requests)
+  void checkControl();
+protected:
+  void checkConnected();
+  void handleControlFrame(const scString &data);
+protected:
+  int m_fd;
+  bool m_connecting;
+  cpu_ticks m_connectStart;
+  uint m_generation; // set by gate, new connection with the same ID has other value
+  scString m_address;
+  scString m_peerHost;
+  scString m_connectionId;
+  std::auto_ptr<scEnvSerializerBinDict> m_dictSerializer; // per-connection dictionary
+  scString m_controlData; // received from peer, not complete frame
+};
+
+/// Messages prepared for one connection, waiting for connect or while 
+/// socket buffer is full
+class grdTcpxBatch {
+public:
+  grdTcpxBatch(uint a_generation): generation(a_generation), sentCount(0), 
+    frameOffset(0), progressTime(cpu_time_ms()) {}
+  uint generation; // messages are encoded with dictionary of this connection
+  boost::ptr_vector<scEnvelope> envelopes;
+  std::vector<scString> messages;
+  size_t sentCount;
+  size_t frameOffset; // part of first unsent frame already written
+  cpu_ticks progressTime; // when last data was written
+};
+
+typedef boost::ptr_map<scString, grdTcpxBatch> grdTcpxBatchMap;
+
+/// Collects idle connections with lost peer
+class grdTcpxLostPeerCollector {
+public:
+  grdTcpxLostPeerCollector(std::vector<grdTcpxConnectionOut *> &output): m_output(output) {}
+  void operator()(scConnection *connection) {
+    grdTcpxConnectionOut *conn = static_cast<grdTcpxConnectionOut *>(connection);
+    if (conn->checkPeerLost())
+      m_output.push_back(conn);
+  }
+protected:
+  std::vector<grdTcpxConnectionOut *> &m_output;
+};
+typedef std::vector<scString> grdTcpxBatchOrder;
+
+class grdTcpxGateInput: public grdTcpxGate {
+public:
+  grdTcpxGateInput();
+  virtual ~grdTcpxGateInput();
+  void setQueueLimit(uint value);
+  virtual void init();
+  virtual int run();
+protected:
+  void close();
+  void runThread();
+  void acceptClients();
+  void readClient(int fd);
+  void closeClient(int fd);
+  bool isQueueFull();
+  void pauseClient(int fd);
+  void resumeClients();
+  void putEnvelopeData(const scString &data);
+  void requestResync(int fd);
+protected:
+  int m_listenFd;
+  int m_epollFd;
+  int m_wakeFd;
+  uint m_queueLimit;
+  std::auto_ptr<scEnvelopeSerializerBase> m_serializer;
+  std::auto_ptr<scEnvSerializerBinDict> m_binSerializer;
+  // server thread
+  std::auto_ptr<boost::thread> m_thread;
+  volatile bool m_terminated;
+  grdTcpxReaderMap m_clients; // used only by server thread
+  std::set<int> m_pausedClients; // not read (removed from epoll) while queue is full
+  // input queue
+  boost::mutex m_queueMutex;
+  grdTcpxFrameList m_queue;
+  size_t m_queueSize;
+};
+
+class grdTcpxGateOutput: public grdTcpxGate {
+public:
+  grdTcpxGateOutput();
+  virtual ~grdTcpxGateOutput();
+  void setSendTimeout(uint value);
+  void setConnectTimeout(uint value);
+  void setMaxConnections(uint value);
+  void setBackoff(uint minDelay, uint maxDelay);
+  void setLaneSockets(bool value);
+  virtual int run();
+  virtual void getStats(scDataNode &output);
+protected:
+  void prepareForSend(scEnvelope *envelope);
+  /// returns <true> if batch is finished (sent or failed)
+  bool transmitBatch(const scString &connectionId, grdTcpxBatch &batch);
+  void failBatch(grdTcpxBatch &batch, const scString &errorMsg);
+  void checkPending();
+  grdTcpxConnectionOut *findConnection(const scString &connectionId);
+  grdTcpxConnectionOut *prepareConnection(const scMessageAddress &address, const scString &connectionId);
+  int checkLostPeers();
+protected:
+  scConnectionPool m_connections;
+  cpu_ticks m_lastPeerCheck;
+  std::auto_ptr<scEnvelopeSerializerBase> m_serializer;
+  uint m_sendTimeout;
+  uint m_connectTimeout;
+  bool m_laneSockets; // separate connection for control lane
+  uint m_connGeneration;
+  grdTcpxBatchMap m_pending; // connection ID -> messages not sent yet
+  grdTcpxBatchOrder m_pendingOrder; // connection IDs in order of first message
+};
+
+//----------------------------------------------------------------------------------
+// Implementation part
+//----------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------
+// grdTcpxReader
+//----------------------------------------------------------------------------------
+void grdTcpxReader::prepareSpace(size_t needed)
+{
+  if (m_begin == m_end) {
+    m_begin = m_end = 0;
+  } else if ((m_begin > 0) && (m_buffer.size() - m_end < needed)) {
+    // move partial frame to front
+    memmove(&m_buffer[0], &m_buffer[m_begin], m_end - m_begin);
+    m_end -= m_begin;
+    m_begin = 0;
+  }
+
+  if (m_buffer.size() - m_end < needed)
+    m_buffer.resize(m_end + needed);
+}
+
+bool grdTcpxReader::read(int fd, grdTcpxMessageList &output)
+{
+  while(true)
+  {
+    size_t needed = GRD_TCPX_READ_CHUNK;
+    // read whole large frame at once
+    if (m_end - m_begin >= GRD_TCPX_HEADER_SIZE) {
+      size_t frameSize = GRD_TCPX_HEADER_SIZE + grdTcpxReadHeader(&m_buffer[m_begin]);
+      if (frameSize > m_end - m_begin + needed)
+        needed = frameSize - (m_end - m_begin);
+    }
+    prepareSpace(needed);
+
+    ssize_t cnt = ::read(fd, &m_buffer[m_end], m_buffer.size() - m_end);
+    if (cnt == 0)
+      return false;
+
+    if (cnt < 0) {
+      if (errno == EINTR)
+        continue;
+      return ((errno == EAGAIN) || (errno == EWOULDBLOCK));
+    }
+
+    m_end += cnt;
+    extractFrames(output);
+
+    if (static_cast<size_t>(cnt) < needed)
+      return true;
+  }
+}
+
+void grdTcpxReader::extractFrames(grdTcpxMessageList &output)
+{
+  while(m_end - m_begin >= GRD_TCPX_HEADER_SIZE)
+  {
+    size_t dataSize = grdTcpxReadHeader(&m_buffer[m_begin]);
+    if (dataSize > GRD_TCPX_MAX_MSG_SIZE)
+      throw scError("TCPX frame too long ("+toString(dataSize)+")");
+
+    if (m_end - m_begin < GRD_TCPX_HEADER_SIZE + dataSize)
+      break;
+
+    output.push_back(scString(&m_buffer[m_begin + GRD_TCPX_HEADER_SIZE], dataSize));
+    m_begin += GRD_TCPX_HEADER_SIZE + dataSize;
+  }
+}
+
+//----------------------------------------------------------------------------------
+// grdTcpxGate
+//----------------------------------------------------------------------------------
+grdTcpxGate::grdTcpxGate(): scMessageGate()
+{
+  m_inactTimeout = GRD_TCPX_DEF_INACT_CONN_TIMEOUT;
+  m_format = GRD_TCPX_FORMAT_BIN;
+  m_keepAlive = false;
+  m_keepAliveIdle = m_keepAliveIntvl = m_keepAliveCnt = 0;
+}
+
+grdTcpxGate::~grdTcpxGate()
+{
+}
+
+void grdTcpxGate::setKeepAlive(uint idleSecs, uint intvlSecs, uint count)
+{
+  m_keepAlive = true;
+  m_keepAliveIdle = idleSecs;
+  m_keepAliveIntvl = intvlSecs;
+  m_keepAliveCnt = count;
+}
+
+void grdTcpxGate::applyKeepAlive(int fd)
+{
+  if (m_keepAlive)
+    grdTcpxSetKeepAlive(fd, m_keepAliveIdle, m_keepAliveIntvl, m_keepAliveCnt);
+}
+
+void grdTcpxGate::setProtocol(const scString &protocol)
+{
+  m_protocol = protocol;
+}
+
+void grdTcpxGate::setAddress(const scString &address)
+{
+  m_address = address;
+}
+
+void grdTcpxGate::setInactTimeout(uint msecs)
+{
+  m_inactTimeout = msecs;
+}
+
+void grdTcpxGate::setFormat(const scString &format)
+{
+  if ((format != GRD_TCPX_FORMAT_JSON) && (format != GRD_TCPX_FORMAT_BIN))
+    throw scError("Unknown TCPX message format: "+format);
+  m_format = format;
+}
+
+bool grdTcpxGate::supportsProtocol(const scString &protocol)
+{
+  return (m_protocol == protocol);
+}
+
+void grdTcpxGate::setAdvertiseHost(const scString &value)
+{
+  m_advertiseHost = value;
+}
+
+// wildcard bind address ("*:port") is not usable by peers, so 
+// configured or resolved host is returned instead
+bool grdTcpxGate::getOwnAddress(const scString &protocol, scMessageAddress &output)
+{
+  bool res = false;
+  if (protocol == m_protocol)
+  {
+    output.clear();
+    output.setProtocol(protocol);
+    scString host(m_address);
+    scString::size_type pos = host.rfind(':');
+    if (pos != scString::npos) {
+      scString bindHost, port;
+      grdTcpxSplitAddress(m_address, bindHost, port);
+      if (!m_advertiseHost.empty())
+        bindHost = m_advertiseHost;
+      else if (bindHost == "0.0.0.0") {
+        m_advertiseHost = grdTcpxResolveOwnHost();
+        bindHost = m_advertiseHost;
+      }
+      host = bindHost + "-" + port;
+    }
+    output.setHost(host);
+    res = true;
+  }
+  return res;
+}
+
+//----------------------------------------------------------------------------------
+// grdTcpxGateInput
+//----------------------------------------------------------------------------------
+grdTcpxGateInput::grdTcpxGateInput(): grdTcpxGate(),
+  m_listenFd(-1), m_epollFd(-1), m_wakeFd(-1),
+  m_queueLimit(GRD_TCPX_DEF_INPUT_QUEUE_LIMIT), m_terminated(false), m_queueSize(0)
+{
+  m_serializer.reset(new scEnvSerializerJsonYajl());
+  m_binSerializer.reset(new scEnvSerializerBinDict());
+}
+
+grdTcpxGateInput::~grdTcpxGateInput()
+{
+  close();
+}
+
+void grdTcpxGateInput::setQueueLimit(uint value)
+{
+  m_queueLimit = (value > 0)?value:1;
+}
+
+void grdTcpxGateInput::init()
+{
+  scString host, port;
+  grdTcpxSplitAddress(m_address, host, port);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(stringToUInt(port)));
+  if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+    throw scError("TCPX wrong bind address: "+m_address);
+
+  try {
+    m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listenFd < 0)
+      throw scError("TCPX socket failed, errno: "+toString(errno));
+
+    int flag = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+
+    if (bind(m_listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0)
+      throw scError("TCPX bind failed: "+m_address+", errno: "+toString(errno));
+
+    if (listen(m_listenFd, GRD_TCPX_LISTEN_BACKLOG) != 0)
+      throw scError("TCPX listen failed: "+m_address+", errno: "+toString(errno));
+
+    grdTcpxSetNonBlocking(m_listenFd);
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK);
+    m_epollFd = epoll_create(GRD_TCPX_MAX_EVENTS);
+    if ((m_wakeFd < 0) || (m_epollFd < 0))
+      throw scError("TCPX epoll init failed, errno: "+toString(errno));
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = m_listenFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &event);
+    event.data.fd = m_wakeFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+
+    m_terminated = false;
+    m_thread.reset(new boost::thread(boost::bind(&grdTcpxGateInput::runThread, this)));
+  }
+  catch(...) {
+    close();
+    throw;
+  }
+}
+
+void grdTcpxGateInput::close()
+{
+  if (m_thread.get() != SC_NULL) {
+    m_terminated = true;
+    uint64_t value = 1;
+    if (write(m_wakeFd, &value, sizeof(value)) < 0)
+      Log::addError("TCPX - server thread wake-up failed");
+    m_thread->join();
+    m_thread.reset();
+  }
+
+  if (m_epollFd >= 0) {
+    ::close(m_epollFd);
+    m_epollFd = -1;
+  }
+
+  if (m_wakeFd >= 0) {
+    ::close(m_wakeFd);
+    m_wakeFd = -1;
+  }
+
+  if (m_listenFd >= 0) {
+    ::close(m_listenFd);
+    m_listenFd = -1;
+  }
+}
+
+int grdTcpxGateInput::run()
+{
+  int res = 0;
+  grdTcpxFrameList messages;
+  bool wasFull;
+
+  {
+    boost::mutex::scoped_lock l(m_queueMutex);
+    if (m_queueSize == 0)
+      return 0;
+    wasFull = (m_queueSize >= m_queueLimit);
+    messages.swap(m_queue);
+    m_queueSize = 0;
+  }
+
+  // server thread could stop reading some clients
+  if (wasFull) {
+    uint64_t value = 1;
+    if (write(m_wakeFd, &value, sizeof(value)) < 0)
+      Log::addError("TCPX - server thread wake-up failed");
+  }
+
+  for(grdTcpxFrameList::const_iterator it = messages.begin(), epos = messages.end(); it != epos; ++it)
+  {
+    try {
+      putEnvelopeData(it->data);
+      res++;
+    }
+    catch(const std::exception &e) {
+      Log::addError(scString("TCPX message decode failed: ")+e.what());
+      requestResync(it->fd);
+    }
+  }
+  return res;
+}
+
+// binary dictionary of sender is lost (session evicted by other senders), 
+// sender is asked to start a new one; if fd was closed & reused by other 
+// client meanwhile, request is ignored there (other session)
+void grdTcpxGateInput::requestResync(int fd)
+{
+  ulong64 sessionId;
+  if (!m_binSerializer->takeResyncSession(sessionId))
+    return;
+
+  scString data;
+  scEnvSerializerBinDict::makeResyncRequest(sessionId, data);
+  unsigned char header[GRD_TCPX_HEADER_SIZE];
+  grdTcpxWriteHeader(data.length(), header);
+  data.insert(0, reinterpret_cast<const char *>(header), GRD_TCPX_HEADER_SIZE);
+
+  // sender does not write to this direction, so buffer has space for small frame
+  if (send(fd, data.c_str(), data.length(), MSG_NOSIGNAL | MSG_DONTWAIT) == static_cast<ssize_t>(data.length()))
+    Counter::inc("msg-tcpx-resync-req");
+}
+
+void grdTcpxGateInput::putEnvelopeData(const scString &data)
+{
+  std::auto_ptr<scEnvelope> guard(new scEnvelope());
+  if (scEnvSerializerBinDict::isBinaryFrame(data.c_str(), data.length()))
+    m_binSerializer->convFromBuffer(data.c_str(), data.length(), *guard);
+  else
+    m_serializer->convFromString(data, *guard);
+  Counter::inc("msg-size", data.length());
+  handleMsgReceived(*guard);
+  put(guard.release());
+}
+
+// server thread: accepts connections & reads frames into input queue
+void grdTcpxGateInput::runThread()
+{
+  struct epoll_event events[GRD_TCPX_MAX_EVENTS];
+
+  while(!m_terminated)
+  {
+    int cnt = epoll_wait(m_epollFd, events, GRD_TCPX_MAX_EVENTS, GRD_TCPX_WAIT_TIMEOUT);
+    if (cnt < 0) {
+      if (errno != EINTR)
+        Log::addError("TCPX epoll_wait failed, errno: "+toString(errno));
+      continue;
+    }
+
+    for(int i=0; (i < cnt) && !m_terminated; i++)
+    {
+      int fd = events[i].data.fd;
+      if (fd == m_listenFd) {
+        acceptClients();
+      } else if (fd == m_wakeFd) {
+        uint64_t value;
+        if (read(m_wakeFd, &value, sizeof(value)) < 0) {
+          // nothing to do, counter already reset
+        }
+      } else if ((events[i].events & EPOLLIN) != 0) {
+        readClient(fd);
+      } else {
+        closeClient(fd);
+      }
+    }
+
+    if (!m_pausedClients.empty())
+      resumeClients();
+  }
+
+  // close remaining client sockets
+  for(grdTcpxReaderMap::iterator it = m_clients.begin(), epos = m_clients.end(); it != epos; ++it)
+    ::close(it->first);
+  m_clients.clear();
+}
+
+void grdTcpxGateInput::acceptClients()
+{
+  int fd;
+  while((fd = accept(m_listenFd, SC_NULL, SC_NULL)) >= 0)
+  {
+    grdTcpxSetNonBlocking(fd);
+    grdTcpxSetNoDelay(fd);
+    applyKeepAlive(fd);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      ::close(fd);
+    } else {
+      int key = fd;
+      m_clients.insert(key, new grdTcpxReader());
+    }
+  }
+}
+
+void grdTcpxGateInput::closeClient(int fd)
+{
+  epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, SC_NULL);
+  m_clients.erase(fd);
+  m_pausedClients.erase(fd);
+  ::close(fd);
+}
+
+bool grdTcpxGateInput::isQueueFull()
+{
+  boost::mutex::scoped_lock l(m_queueMutex);
+  return (m_queueSize >= m_queueLimit);
+}
+
+// client is removed from epoll set (not only EPOLLIN cleared, hang-up would 
+// be still reported), unread data waits in socket buffer & TCP window
+// stops the sender
+void grdTcpxGateInput::pauseClient(int fd)
+{
+  if (m_pausedClients.insert(fd).second) {
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, SC_NULL);
+    Counter::inc("msg-tcpx-read-paused");
+  }
+}
+
+// scheduler wakes server thread when it takes messages from full queue
+void grdTcpxGateInput::resumeClients()
+{
+  if (isQueueFull())
+    return;
+
+  std::set<int> paused;
+  paused.swap(m_pausedClients);
+  for(std::set<int>::const_iterator it = paused.begin(), epos = paused.end(); it != epos; ++it)
+  {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = *it;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, *it, &event) != 0)
+      closeClient(*it);
+  }
+}
+
+void grdTcpxGateInput::readClient(int fd)
+{
+  grdTcpxReaderMap::iterator it = m_clients.find(fd);
+  if (it == m_clients.end()) {
+    closeClient(fd);
+    return;
+  }
+
+  if (isQueueFull()) {
+    pauseClient(fd);
+    return;
+  }
+
+  grdTcpxMessageList received;
+  bool connected;
+  try {
+    connected = it->second->read(fd, received);
+  }
+  catch(const std::exception &e) {
+    Log::addError(scString("TCPX read failed: ")+e.what());
+    connected = false;
+  }
+
+  if (!received.empty()) {
+    grdTcpxFrameList frames;
+    for(grdTcpxMessageList::iterator it = received.begin(), epos = received.end(); it != epos; ++it)
+    {
+      frames.push_back(grdTcpxFrame(fd));
+      frames.back().data.swap(*it);
+    }
+    boost::mutex::scoped_lock l(m_queueMutex);
+    m_queueSize += frames.size();
+    m_queue.splice(m_queue.end(), frames);
+  }
+
+  if (!connected)
+    closeClient(fd);
+}
+
+//----------------------------------------------------------------------------------
+// grdTcpxGateOutput
+//----------------------------------------------------------------------------------
+grdTcpxGateOutput::grdTcpxGateOutput(): grdTcpxGate(),
+  m_sendTimeout(GRD_TCPX_DEF_SEND_TIMEOUT), m_connectTimeout(GRD_TCPX_DEF_CONNECT_TIMEOUT),
+  m_laneSockets(false), m_lastPeerCheck(0), m_connGeneration(0)
+{
+  m_serializer.reset(new scEnvSerializerJsonYajl());
+}
+
+grdTcpxGateOutput::~grdTcpxGateOutput()
+{
+}
+
+void grdTcpxGateOutput::setSendTimeout(uint value)
+{
+  m_sendTimeout = value;
+}
+
+void grdTcpxGateOutput::setConnectTimeout(uint value)
+{
+  m_connectTimeout = value;
+}
+
+void grdTcpxGateOutput::setMaxConnections(uint value)
+{
+  m_connections.setMaxSize(value);
+}
+
+void grdTcpxGateOutput::setBackoff(uint minDelay, uint maxDelay)
+{
+  m_connections.setBackoff(minDelay, maxDelay);
+}
+
+void grdTcpxGateOutput::setLaneSockets(bool value)
+{
+  m_laneSockets = value;
+}
+
+void grdTcpxGateOutput::getStats(scDataNode &output)
+{
+  m_connections.getStats(output);
+  output.setElementSafe("protocol", scDataNode(m_protocol));
+}
+
+// messages are grouped per connection & sent in batches, batches are sent
+// in order of first message (control lane first); scheduler thread is never
+// blocked by connect or full socket buffer: messages wait in m_pending
+// (in order) and are sent in next runs
+int grdTcpxGateOutput::run()
+{
+  int res = 0;
+
+  m_connections.checkActive();
+
+  if (m_keepAlive && ((m_lastPeerCheck == 0) || is_cpu_time_elapsed_ms(m_lastPeerCheck, GRD_TCPX_PEER_CHECK_INTERVAL))) {
+    m_lastPeerCheck = cpu_time_ms();
+    res += checkLostPeers();
+  }
+
+  checkPending();
+
+  // connections with pending messages are pinned, so they are not
+  // evicted by pool limit when next connection is opened
+  for(grdTcpxBatchMap::iterator it = m_pending.begin(), epos = m_pending.end(); it != epos; ++it)
+    m_connections.pin(it->first);
+
+  while(!empty())
+  {
+    prepareForSend(get());
+    res++;
+  }
+
+  grdTcpxBatchOrder order;
+  order.swap(m_pendingOrder);
+  for(grdTcpxBatchOrder::const_iterator it = order.begin(), epos = order.end(); it != epos; ++it)
+  {
+    grdTcpxBatchMap::iterator batchIt = m_pending.find(*it);
+    if (batchIt == m_pending.end())
+      continue;
+    if (transmitBatch(*it, *batchIt->second))
+      m_pending.erase(batchIt);
+    else
+      m_pendingOrder.push_back(*it);
+  }
+
+  m_connections.unpinAll();
+  return res;
+}
+
+// messages of closed / replaced connections are encoded with lost dictionary
+void grdTcpxGateOutput::checkPending()
+{
+  for(grdTcpxBatchMap::iterator it = m_pending.begin(); it != m_pending.end(); /* empty here */)
+  {
+    grdTcpxConnectionOut *connection = findConnection(it->first);
+    if ((connection == SC_NULL) || (connection->getGeneration() != it->second->generation)) {
+      failBatch(*it->second, "TCPX-Transmit - connection closed");
+      m_pending.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// takes ownership of envelope
+void grdTcpxGateOutput::prepareForSend(scEnvelope *envelope)
+{
+  std::auto_ptr<scEnvelope> envelopeGuard(envelope);
+
+  try {
+    scString connectionId = envelope->getReceiver().getHost();
+    if (m_laneSockets && (getLaneFor(*envelope) == SC_GATE_LANE_CONTROL))
+      connectionId += GRD_TCPX_CONTROL_CONN_SUFFIX;
+
+    grdTcpxConnectionOut *connection = prepareConnection(envelope->getReceiver(), connectionId);
+    m_connections.pin(connectionId);
+
+    grdTcpxBatchMap::iterator it = m_pending.find(connectionId);
+    if (it == m_pending.end()) {
+      it = m_pending.insert(connectionId, new grdTcpxBatch(connection->getGeneration())).first;
+      m_pendingOrder.push_back(connectionId);
+    }
+
+    grdTcpxBatch &batch = *it->second;
+    scString dataStr;
+    bool binFormat = (m_format == GRD_TCPX_FORMAT_BIN);
+    if (binFormat)
+      connection->getDictSerializer().convToString(*envelope, dataStr);
+    else
+      m_serializer->convToString(*envelope, dataStr);
+
+    if (dataStr.length() > GRD_TCPX_MAX_MSG_SIZE) {
+      // frame is not sent, receiver must not miss dictionary entries
+      if (binFormat)
+        connection->getDictSerializer().rollbackFrame();
+      throw scError("TCPX message too long ("+toString(dataStr.length())+")");
+    }
+
+    handleMsgReadyForSend(*envelope);
+    batch.messages.push_back(dataStr);
+    batch.envelopes.push_back(envelopeGuard.release());
+  }
+  catch (scError &e) {
+    e.addDetails(scDataNode(envelopeGuard->getReceiver().getAsString()));
+    handleTransmitError(*envelopeGuard, e);
+  }
+  catch(const std::exception& e) {
+    scString msg = scString("TCPX-Transmit - exception (std): ") + e.what();
+    scString dets = scString("out-addr: ") + envelopeGuard->getReceiver().getAsString();
+    handleTransmitError(*envelopeGuard, SC_MSG_STATUS_EXCEPTION, msg, dets);
+  }
+}
+
+bool grdTcpxGateOutput::transmitBatch(const scString &connectionId, grdTcpxBatch &batch)
+{
+  size_t startCount = batch.sentCount;
+  size_t startOffset = batch.frameOffset;
+  ulong64 sentBytes = 0;
+  bool connecting = false;
+  scString errorMsg;
+
+  if (batch.messages.empty())
+    return true;
+
+#ifdef SC_TIMER_ENABLED
+  Timer::start("msg-total");
+  Timer::start("msg-execute-tcpx");
+#endif
+
+  try {
+    grdTcpxConnectionOut *connection = findConnection(connectionId);
+    if (connection == SC_NULL)
+      throw scError("connection closed");
+
+    // send timeout is counted from end of connect
+    if (connection->isConnecting()) {
+      connecting = !connection->checkConnecting(m_connectTimeout);
+      batch.progressTime = cpu_time_ms();
+    }
+
+    if (!connecting) {
+      connection->checkControl();
+      connection->sendBatch(batch.messages, batch.sentCount, batch.frameOffset);
+    }
+  }
+  catch (scError &e) {
+    errorMsg = scString("TCPX-Transmit - error: ") + e.what();
+  }
+  catch(const std::exception& e) {
+    errorMsg = scString("TCPX-Transmit - exception (std): ") + e.what();
+  }
+  catch(...) {
+    errorMsg = scString("TCPX-Transmit - exception (unknown)");
+  }
+
+#ifdef SC_TIMER_ENABLED
+  Timer::stop("msg-execute-tcpx");
+  Timer::stop("msg-total");
+#endif
+
+  if ((batch.sentCount > startCount) || (batch.frameOffset != startOffset)) {
+    Counter::inc("msg-total", batch.sentCount - startCount);
+    Counter::inc("msg-tcpx-batch");
+    batch.progressTime = cpu_time_ms();
+  }
+
+  for(size_t i = startCount; i < batch.sentCount; i++)
+  {
+    sentBytes += batch.messages[i].length();
+    handleMsgSent(batch.envelopes[i]);
+  }
+
+  Counter::inc("msg-size", sentBytes);
+  if (batch.sentCount > startCount)
+    m_connections.signalSent(connectionId, sentBytes, batch.sentCount - startCount);
+
+  if (errorMsg.empty() && !connecting && (batch.sentCount < batch.messages.size()) &&
+      is_cpu_time_elapsed_ms(batch.progressTime, m_sendTimeout))
+    errorMsg = scString("TCPX send timeout, peer not responding");
+
+  if (!errorMsg.empty()) {
+    failBatch(batch, errorMsg);
+    // stream (with dictionary) is not usable after error
+    m_connections.signalFailure(connectionId);
+    return true;
+  }
+
+  if (batch.sentCount < batch.messages.size()) {
+    if (batch.sentCount > 0) {
+      Counter::inc("msg-tcpx-send-partial");
+      batch.messages.erase(batch.messages.begin(), batch.messages.begin() + batch.sentCount);
+      batch.envelopes.erase(batch.envelopes.begin(), batch.envelopes.begin() + batch.sentCount);
+      batch.sentCount = 0;
+    }
+    return false;
+  }
+
+  return true;
+}
+
+void grdTcpxGateOutput::failBatch(grdTcpxBatch &batch, const scString &errorMsg)
+{
+  for(size_t i = batch.sentCount, epos = batch.envelopes.size(); i != epos; i++)
+  {
+    scString dets = scString("out-addr: ") + batch.envelopes[i].getReceiver().getAsString();
+    handleTransmitError(batch.envelopes[i], SC_MSG_STATUS_EXCEPTION, errorMsg, dets);
+  }
+  batch.sentCount = batch.messages.size();
+  batch.frameOffset = 0;
+}
+
+grdTcpxConnectionOut *grdTcpxGateOutput::prepareConnection(const scMessageAddress &address, const scString &connectionId)
+{
+  scString host = address.getHost();
+  scString connectionStr;
+
+  if (m_address.empty())
+    connectionStr = host;
+  else
+    connectionStr = m_address;
+
+  grdTcpxConnectionOut *item = findConnection(connectionId);
+  if (item == SC_NULL)
+  {
+    if (!m_connections.canConnect(connectionId))
+      throw scError("TCPX peer unavailable (reconnect back-off): "+host);
+
+    std::auto_ptr<grdTcpxConnectionOut> connGuard;
+    connGuard.reset(new grdTcpxConnectionOut());
+
+#ifdef SC_TIMER_ENABLED
+  Timer::start("msg-total");
+  Timer::start("msg-connect-tcpx");
+#endif
+    try {
+      connGuard.get()->connect(connectionStr);
+    }
+    catch(...) {
+      m_connections.signalFailure(connectionId);
+      throw;
+    }
+#ifdef SC_TIMER_ENABLED
+  Timer::stop("msg-connect-tcpx");
+  Timer::stop("msg-total");
+#endif
+    item = connGuard.get();
+    item->setInactTimeout(this->m_inactTimeout);
+    item->setPeerHost(host);
+    item->setConnectionId(connectionId);
+    item->setGeneration(++m_connGeneration);
+    applyKeepAlive(item->getHandle());
+    m_connections.add(connectionId, connGuard.release());
+  }
+  return item;
+}
+
+// lost connections are removed from pool, peer_down is reported once per host
+int grdTcpxGateOutput::checkLostPeers()
+{
+  std::vector<grdTcpxConnectionOut *> lost;
+  m_connections.forEach(grdTcpxLostPeerCollector(lost));
+  if (lost.empty())
+    return 0;
+
+  std::vector<scString> connectionIds;
+  std::set<scString> hosts;
+  for(std::vector<grdTcpxConnectionOut *>::const_iterator it = lost.begin(), epos = lost.end(); it != epos; ++it)
+  {
+    connectionIds.push_back((*it)->getConnectionId());
+    hosts.insert((*it)->getPeerHost());
+  }
+
+  for(std::vector<scString>::const_iterator it = connectionIds.begin(), epos = connectionIds.end(); it != epos; ++it)
+    m_connections.signalFailure(*it);
+
+  for(std::set<scString>::const_iterator it = hosts.begin(), epos = hosts.end(); it != epos; ++it)
+  {
+    Log::addWarning("TCPX peer lost: "+*it);
+    signalPeerDown(m_protocol, *it, "keepalive");
+  }
+
+  return static_cast<int>(hosts.size());
+}
+
+grdTcpxConnectionOut *grdTcpxGateOutput::findConnection(const scString &connectionId)
+{
+  grdTcpxConnectionOut *res = dynamic_cast<grdTcpxConnectionOut *>(m_connections.find(connectionId));
+  return res;
+}
+
+//----------------------------------------------------------------------------------
+// grdTcpxConnectionOut
+//----------------------------------------------------------------------------------
+grdTcpxConnectionOut::grdTcpxConnectionOut(): scConnection(), m_fd(-1), 
+  m_connecting(false), m_connectStart(0), m_generation(0)
+{
+}
+
+grdTcpxConnectionOut::~grdTcpxConnectionOut()
+{
+  performAutoClose();
+  close();
+}
+
+bool grdTcpxConnectionOut::isConnected()
+{
+  return (m_fd >= 0);
+}
+
+// connect is finished by checkConnecting in next runs, so scheduler 
+// is not blocked by slow / unreachable peer
+bool grdTcpxConnectionOut::connect(const scString &address)
+{
+  bool res = isConnected();
+  if (!res) {
+    scString host, port;
+    grdTcpxSplitAddress(address, host, port);
+
+    struct addrinfo hints;
+    struct addrinfo *addrList = SC_NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if ((getaddrinfo(host.c_str(), port.c_str(), &hints, &addrList) != 0) || (addrList == SC_NULL))
+      throw scError("TCPX unknown host: "+address);
+
+    m_address = address;
+    try {
+      m_fd = socket(addrList->ai_family, addrList->ai_socktype, addrList->ai_protocol);
+      if (m_fd < 0)
+        throw scError("TCPX socket failed, errno: "+toString(errno));
+
+      grdTcpxSetNonBlocking(m_fd);
+      grdTcpxSetNoDelay(m_fd);
+
+      if (::connect(m_fd, addrList->ai_addr, addrList->ai_addrlen) != 0) {
+        if (errno != EINPROGRESS)
+          throw scError("TCPX connect failed: "+address+", errno: "+toString(errno));
+        m_connecting = true;
+        m_connectStart = cpu_time_ms();
+      }
+    }
+    catch(...) {
+      freeaddrinfo(addrList);
+      close();
+      throw;
+    }
+
+    freeaddrinfo(addrList);
+    res = !m_connecting;
+  }
+  signalConnected();
+  return res;
+}
+
+bool grdTcpxConnectionOut::checkConnecting(uint timeoutMs)
+{
+  checkConnected();
+  if (!m_connecting)
+    return true;
+
+  struct pollfd pfd;
+  pfd.fd = m_fd;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+  if (poll(&pfd, 1, 0) <= 0) {
+    if (is_cpu_time_elapsed_ms(m_connectStart, timeoutMs)) {
+      close();
+      throw scError("TCPX connect timeout: "+m_address);
+    }
+    return false;
+  }
+
+  int error = 0;
+  socklen_t errorLen = sizeof(error);
+  getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &errorLen);
+  if (error != 0) {
+    close();
+    throw scError("TCPX connect failed: "+m_address+", errno: "+toString(error));
+  }
+
+  m_connecting = false;
+  signalConnected();
+  return true;
+}
+
+bool grdTcpxConnectionOut::isConnecting() const
+{
+  return m_connecting;
+}
+
+void grdTcpxConnectionOut::close()
+{
+  if (isConnected())
+  {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+  m_connecting = false;
+}
+
+int grdTcpxConnectionOut::getHandle() const
+{
+  return m_fd;
+}
+
+void grdTcpxConnectionOut::setPeerHost(const scString &value)
+{
+  m_peerHost = value;
+}
+
+const scString &grdTcpxConnectionOut::getPeerHost() const
+{
+  return m_peerHost;
+}
+
+void grdTcpxConnectionOut::setConnectionId(const scString &value)
+{
+  m_connectionId = value;
+}
+
+const scString &grdTcpxConnectionOut::getConnectionId() const
+{
+  return m_connectionId;
+}
+
+// receiver never writes to this socket, so readable means EOF or error
+bool grdTcpxConnectionOut::checkPeerLost()
+{
+  if (!isConnected() || m_connecting)
+    return false;
+
+  struct pollfd item;
+  item.fd = m_fd;
+  item.events = POLLIN;
+#ifdef POLLRDHUP
+  item.events |= POLLRDHUP;
+#endif
+  item.revents = 0;
+
+  if (poll(&item, 1, 0) <= 0)
+    return false;
+
+  if (item.revents & (POLLERR | POLLHUP))
+    return true;
+#ifdef POLLRDHUP
+  if (item.revents & POLLRDHUP)
+    return true;
+#endif
+  if (item.revents & POLLIN) {
+    char c;
+    ssize_t cnt = recv(m_fd, &c, 1, MSG_PEEK);
+    if ((cnt == 0) || ((cnt < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK)))
+      return true;
+  }
+  return false;
+}
+
+// receiver writes back only resync requests, EOF closes connection
+void grdTcpxConnectionOut::checkControl()
+{
+  char buffer[GRD_TCPX_MAX_CONTROL_SIZE];
+
+  while(isConnected())
+  {
+    ssize_t cnt = recv(m_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (cnt < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        close();
+      break;
+    }
+    if (cnt == 0) {
+      close();
+      break;
+    }
+    m_controlData.append(buffer, cnt);
+
+    while(m_controlData.length() >= GRD_TCPX_HEADER_SIZE)
+    {
+      size_t dataSize = grdTcpxReadHeader(m_controlData.c_str());
+      if (dataSize > GRD_TCPX_MAX_CONTROL_SIZE) {
+        close();
+        break;
+      }
+      if (m_controlData.length() < GRD_TCPX_HEADER_SIZE + dataSize)
+        break;
+      handleControlFrame(m_controlData.substr(GRD_TCPX_HEADER_SIZE, dataSize));
+      m_controlData.erase(0, GRD_TCPX_HEADER_SIZE + dataSize);
+    }
+  }
+}
+
+void grdTcpxConnectionOut::handleControlFrame(const scString &data)
+{
+  ulong64 sessionId;
+  if (scEnvSerializerBinDict::isResyncRequest(data.c_str(), data.length(), sessionId) &&
+      (m_dictSerializer.get() != SC_NULL) && m_dictSerializer->handleResyncRequest(sessionId))
+    Counter::inc("msg-tcpx-resync");
+}
+
+void grdTcpxConnectionOut::checkConnected()
+{
+  if (!isConnected())
+    throw scError("TCPX connection not active!");
+}
+
+// header & payload of many messages are written with one writev call,
+// on full socket buffer rest (also rest of partially written frame) 
+// is sent in next call
+void grdTcpxConnectionOut::sendBatch(const std::vector<scString> &messages, size_t &sentCount, size_t &frameOffset)
+{
+  struct iovec iovecs[GRD_TCPX_SEND_BATCH * 2];
+  unsigned char headers[GRD_TCPX_SEND_BATCH][GRD_TCPX_HEADER_SIZE];
+
+  checkConnected();
+
+  while(sentCount < messages.size())
+  {
+    uint cnt = 0;
+    while((cnt < GRD_TCPX_SEND_BATCH) && (sentCount + cnt < messages.size()))
+    {
+      const scString &message = messages[sentCount + cnt];
+      grdTcpxWriteHeader(message.length(), headers[cnt]);
+      iovecs[cnt * 2].iov_base = headers[cnt];
+      iovecs[cnt * 2].iov_len = GRD_TCPX_HEADER_SIZE;
+      iovecs[cnt * 2 + 1].iov_base = const_cast<char *>(message.c_str());
+      iovecs[cnt * 2 + 1].iov_len = message.length();
+      cnt++;
+    }
+
+    struct iovec *pending = iovecs;
+    int pendingCnt = cnt * 2;
+
+    // skip part of first frame written in previous call
+    size_t left = frameOffset;
+    while((left > 0) && (left >= pending->iov_len))
+    {
+      left -= pending->iov_len;
+      pending++;
+      pendingCnt--;
+    }
+    pending->iov_base = static_cast<char *>(pending->iov_base) + left;
+    pending->iov_len -= left;
+
+    while(pendingCnt > 0)
+    {
+      ssize_t written = writev(m_fd, pending, pendingCnt);
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        // socket buffer is full
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+          return;
+        int error = errno;
+        close();
+        throw scError("TCPX send failed, errno: "+toString(error));
+      }
+
+      signalUsed();
+      left = static_cast<size_t>(written);
+      while((pendingCnt > 0) && (left >= pending->iov_len))
+      {
+        left -= pending->iov_len;
+        frameOffset += pending->iov_len;
+        // odd iovec = payload, frame is complete
+        if ((pending - iovecs) % 2 == 1) {
+          sentCount++;
+          frameOffset = 0;
+        }
+        pending++;
+        pendingCnt--;
+      }
+      if (left > 0) {
+        pending->iov_base = static_cast<char *>(pending->iov_base) + left;
+        pending->iov_len -= left;
+        frameOffset += left;
+      }
+    }
+  }
+}
+
+scEnvSerializerBinDict &grdTcpxConnectionOut::getDictSerializer()
+{
+  if (m_dictSerializer.get() == SC_NULL)
+    m_dictSerializer.reset(new scEnvSerializerBinDict());
+  return *m_dictSerializer;
+}
+
+//----------------------------------------------------------------------------------
+// grdTcpxGateFactory
+//----------------------------------------------------------------------------------
+grdTcpxGateFactory::grdTcpxGateFactory(): scGateFactory()
+{
+}
+
+grdTcpxGateFactory::~grdTcpxGateFactory()
+{
+}
+
+scMessageGate *grdTcpxGateFactory::createGate(bool input, const scDataNode &params, const scString &protocol) const
+{
+  std::auto_ptr<grdTcpxGate> res;
+  if (input) {
+    grdTcpxGateInput *inputGate = new grdTcpxGateInput();
+    res.reset(inputGate);
+    if (params.size()>0)
+      inputGate->setAddress(params.getString(0));
+    if (params.hasChild("queue_limit"))
+      inputGate->setQueueLimit(params.getUInt("queue_limit"));
+  }
+  else {
+    grdTcpxGateOutput *outputGate = new grdTcpxGateOutput();
+    res.reset(outputGate);
+    if (params.size()>0)
+      outputGate->setAddress(params.getString(0));
+
+    if (params.size()>1) {
+      uint timeout = params.getUInt(1);
+      outputGate->setInactTimeout(timeout);
+    }
+
+    if (params.hasChild("send_timeout"))
+      outputGate->setSendTimeout(params.getUInt("send_timeout"));
+    if (params.hasChild("connect_timeout"))
+      outputGate->setConnectTimeout(params.getUInt("connect_timeout"));
+    if (params.hasChild("max_connections"))
+      outputGate->setMaxConnections(params.getUInt("max_connections"));
+    if (params.hasChild("backoff_min") || params.hasChild("backoff_max"))
+      outputGate->setBackoff(
+        params.getUInt("backoff_min", SC_CONN_POOL_DEF_BACKOFF_MIN),
+        params.getUInt("backoff_max", SC_CONN_POOL_DEF_BACKOFF_MAX));
+    if (params.hasChild("lane_sockets"))
+      outputGate->setLaneSockets(params.getBool("lane_sockets"));
+  }
+
+  if (params.hasChild("format"))
+    res->setFormat(params.getString("format"));
+
+  if (params.hasChild("advertise_host"))
+    res->setAdvertiseHost(params.getString("advertise_host"));
+
+  if (params.hasChild("keepalive") ? params.getBool("keepalive") :
+      (params.hasChild("keepalive_idle") || params.hasChild("keepalive_intvl") || params.hasChild("keepalive_cnt")))
+    res->setKeepAlive(
+      params.getUInt("keepalive_idle", 0),
+      params.getUInt("keepalive_intvl", 0),
+      params.getUInt("keepalive_cnt", 0));
+
+  res->setProtocol(protocol);
+  return res.release();
+}
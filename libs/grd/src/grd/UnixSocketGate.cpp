@@ -0,0 +1,963 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        UnixSocketGate.cpp
+// Project:     grdLib
+// Purpose:     Unix domain socket gate (Linux).
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+// posix
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+// std
+#include <list>
+#include <set>
+#include <vector>
+
+// boost
+#include "boost/thread.hpp"
+#include "boost/bind.hpp"
+#include "boost/ptr_container/ptr_vector.hpp"
+#include "boost/ptr_container/ptr_map.hpp"
+
+#include "grd/UnixSocketGate.h"
+#include "grd/EnvSerializerJsonYajl.h"
+#include "grd/EnvSerializerBinDict.h"
+#include "grd/MessageGate.h"
+#include "grd/MessageAddress.h"
+#include "grd/Connection.h"
+#include "grd/ConnectionPool.h"
+#include "grd/MessageConst.h"
+
+#include "perf/Timer.h"
+#include "perf/Counter.h"
+#include "perf/Log.h"
+#include "perf/time_utils.h"
+
+#ifdef DEBUG_MEM
+#include "sc/DebugMem.h"
+#endif
+
+using namespace perf;
+
+//----------------------------------------------------------------------------------
+// Constants
+//----------------------------------------------------------------------------------
+const uint GRD_UDS_DEF_INACT_CONN_TIMEOUT = 30000;
+const uint GRD_UDS_MAX_MSG_SIZE = 65536;
+const uint GRD_UDS_MAX_CONTROL_SIZE = 256;  // max size of message sent back by receiver
+const uint GRD_UDS_RECV_BATCH = 32;      // max messages per recvmmsg
+const uint GRD_UDS_SEND_BATCH = 64;      // max messages per sendmmsg
+const uint GRD_UDS_MAX_EVENTS = 64;
+const uint GRD_UDS_WAIT_TIMEOUT = 100;   // ms, server thread poll limit
+const uint GRD_UDS_DEF_SEND_TIMEOUT = 1000; // ms without progress before pending messages fail
+const int GRD_UDS_LISTEN_BACKLOG = 128;
+const scString GRD_UDS_FORMAT_JSON = "json";
+const scString GRD_UDS_FORMAT_BIN = "bin";
+
+//----------------------------------------------------------------------------------
+// Local functions
+//----------------------------------------------------------------------------------
+// names not starting with "/" are placed in abstract namespace (no file to clean up)
+static socklen_t grdUdsPrepareAddress(const scString &name, struct sockaddr_un &addr)
+{
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  scString path;
+  size_t offset = 0;
+  if (!name.empty() && (name[0] == '/')) {
+    path = name;
+  } else {
+    path = scString("grd-") + name;
+    offset = 1;
+  }
+
+  if (path.length() + offset >= sizeof(addr.sun_path))
+    throw scError("UDS address too long: "+name);
+
+  memcpy(addr.sun_path + offset, path.c_str(), path.length());
+  return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + offset + path.length());
+}
+
+static void grdUdsSetNonBlocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+//----------------------------------------------------------------------------------
+// Local classes - declarations
+//----------------------------------------------------------------------------------
+/// Message received from client, queued for scheduler
+class grdUdsFrame {
+public:
+  grdUdsFrame(int a_fd): fd(a_fd) {}
+  int fd; // for requests sent back to client
+  scString data;
+};
+
+typedef std::list<grdUdsFrame> grdUdsMessageList;
+
+class grdUdsGate: public scMessageGate {
+public:
+  grdUdsGate();
+  virtual ~grdUdsGate();
+  void setProtocol(const scString &protocol);
+  void setAddress(const scString &address);
+  void setInactTimeout(uint msecs);
+  void setFormat(const scString &format);
+  virtual bool supportsProtocol(const scString &protocol);
+  virtual bool getOwnAddress(const scString &protocol, scMessageAddress &output);
+protected:
+  scString m_protocol;
+  scString m_address;
+  scString m_format;
+  uint m_inactTimeout; // inactivity timeout for connections
+};
+
+class grdUdsConnectionOut: public scConnection {
+public:
+  // construction
+  grdUdsConnectionOut();
+  virtual ~grdUdsConnectionOut();
+  // exec
+  bool connect(const scString &address);
+  virtual void close();
+  virtual bool isConnected();
+  /// sends messages starting from <sentCount> until receiver queue is full, 
+  /// on error throws exception, sentCount = number of messages sent
+  void sendBatch(const std::vector<scString> &messages, size_t &sentCount);
+  /// handles messages sent back by receiver (resync requests)
+  void checkControl();
+  scEnvSerializerBinDict &getDictSerializer();
+  void setGeneration(uint value) { m_generation = value; }
+  uint getGeneration() const { return m_generation; }
+protected:
+  void checkConnected();
+protected:
+  int m_fd;
+  uint m_generation; // set by gate, new connection with the same ID has other value
+  std::auto_ptr<scEnvSerializerBinDict> m_dictSerializer; // per-connection dictionary
+};
+
+/// Messages prepared for one connection, waiting while receiver queue is full
+class grdUdsBatch {
+public:
+  grdUdsBatch(uint a_generation): generation(a_generation), sentCount(0), 
+    progressTime(cpu_time_ms()) {}
+  uint generation; // messages are encoded with dictionary of this connection
+  boost::ptr_vector<scEnvelope> envelopes;
+  std::vector<scString> messages;
+  size_t sentCount;
+  cpu_ticks progressTime; // when last message was sent
+};
+
+typedef boost::ptr_map<scString, grdUdsBatch> grdUdsBatchMap;
+
+class grdUdsGateInput: public grdUdsGate {
+public:
+  grdUdsGateInput();
+  virtual ~grdUdsGateInput();
+  void setQueueLimit(uint value);
+  virtual void init();
+  virtual int run();
+protected:
+  void close();
+  void runThread();
+  void acceptClients();
+  void readClient(int fd);
+  void closeClient(int fd);
+  bool waitForQueueSpace();
+  void putEnvelopeData(const scString &data);
+  void requestResync(int fd);
+protected:
+  int m_listenFd;
+  int m_epollFd;
+  int m_wakeFd;
+  uint m_queueLimit;
+  std::auto_ptr<scEnvelopeSerializerBase> m_serializer;
+  std::auto_ptr<scEnvSerializerBinDict> m_binSerializer;
+  // server thread
+  std::auto_ptr<boost::thread> m_thread;
+  volatile bool m_terminated;
+  std::vector<char> m_recvBuffer;
+  std::set<int> m_clients; // used only by server thread
+  // input queue
+  boost::mutex m_queueMutex;
+  boost::condition_variable m_queueSpace;
+  grdUdsMessageList m_queue;
+  size_t m_queueSize;
+};
+
+class grdUdsGateOutput: public grdUdsGate {
+public:
+  grdUdsGateOutput();
+  virtual ~grdUdsGateOutput();
+  void setSendTimeout(uint value);
+  virtual int run();
+protected:
+  void prepareForSend(scEnvelope *envelope);
+  /// returns <true> if batch is finished (sent or failed)
+  bool transmitBatch(const scString &connectionId, grdUdsBatch &batch);
+  void failBatch(grdUdsBatch &batch, const scString &errorMsg);
+  void checkPending();
+  grdUdsConnectionOut *findConnection(const scString &connectionId);
+  grdUdsConnectionOut *prepareConnection(const scMessageAddress &address);
+protected:
+  scConnectionPool m_connections;
+  std::auto_ptr<scEnvelopeSerializerBase> m_serializer;
+  uint m_sendTimeout;
+  uint m_connGeneration;
+  grdUdsBatchMap m_pending; // connection ID -> messages not sent yet
+};
+
+//----------------------------------------------------------------------------------
+// Implementation part
+//----------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------
+// grdUdsGate
+//----------------------------------------------------------------------------------
+grdUdsGate::grdUdsGate(): scMessageGate()
+{
+  m_inactTimeout = GRD_UDS_DEF_INACT_CONN_TIMEOUT;
+  m_format = GRD_UDS_FORMAT_BIN;
+}
+
+grdUdsGate::~grdUdsGate()
+{
+}
+
+void grdUdsGate::setProtocol(const scString &protocol)
+{
+  m_protocol = protocol;
+}
+
+void grdUdsGate::setAddress(const scString &address)
+{
+  m_address = address;
+}
+
+void grdUdsGate::setInactTimeout(uint msecs)
+{
+  m_inactTimeout = msecs;
+}
+
+void grdUdsGate::setFormat(const scString &format)
+{
+  if ((format != GRD_UDS_FORMAT_JSON) && (format != GRD_UDS_FORMAT_BIN))
+    throw scError("Unknown UDS message format: "+format);
+  m_format = format;
+}
+
+bool grdUdsGate::supportsProtocol(const scString &protocol)
+{
+  return (m_protocol == protocol);
+}
+
+bool grdUdsGate::getOwnAddress(const scString &protocol, scMessageAddress &output)
+{
+  bool res = false;
+  if (protocol == m_protocol)
+  {
+    output.clear();
+    output.setProtocol(protocol);
+    output.setHost(m_address);
+    output.setNode(getOwnerName());
+    res = true;
+  }
+  return res;
+}
+
+//----------------------------------------------------------------------------------
+// grdUdsGateInput
+//----------------------------------------------------------------------------------
+grdUdsGateInput::grdUdsGateInput(): grdUdsGate(),
+  m_listenFd(-1), m_epollFd(-1), m_wakeFd(-1),
+  m_queueLimit(GRD_UDS_DEF_INPUT_QUEUE_LIMIT), m_terminated(false), m_queueSize(0)
+{
+  m_serializer.reset(new scEnvSerializerJsonYajl());
+  m_binSerializer.reset(new scEnvSerializerBinDict());
+}
+
+grdUdsGateInput::~grdUdsGateInput()
+{
+  close();
+}
+
+void grdUdsGateInput::setQueueLimit(uint value)
+{
+  m_queueLimit = (value > 0)?value:1;
+}
+
+void grdUdsGateInput::init()
+{
+  struct sockaddr_un addr;
+  socklen_t addrLen = grdUdsPrepareAddress(m_address, addr);
+
+  if (addr.sun_path[0] != '\0')
+    unlink(addr.sun_path);
+
+  try {
+    m_listenFd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (m_listenFd < 0)
+      throw scError("UDS socket failed, errno: "+toString(errno));
+
+    if (bind(m_listenFd, reinterpret_cast<struct sockaddr *>(&addr), addrLen) != 0)
+      throw scError("UDS bind failed: "+m_address+", errno: "+toString(errno));
+
+    if (listen(m_listenFd, GRD_UDS_LISTEN_BACKLOG) != 0)
+      throw scError("UDS listen failed: "+m_address+", errno: "+toString(errno));
+
+    grdUdsSetNonBlocking(m_listenFd);
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK);
+    m_epollFd = epoll_create(GRD_UDS_MAX_EVENTS);
+    if ((m_wakeFd < 0) || (m_epollFd < 0))
+      throw scError("UDS epoll init failed, errno: "+toString(errno));
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = m_listenFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &event);
+    event.data.fd = m_wakeFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+
+    m_recvBuffer.resize(GRD_UDS_RECV_BATCH * GRD_UDS_MAX_MSG_SIZE);
+    m_terminated = false;
+    m_thread.reset(new boost::thread(boost::bind(&grdUdsGateInput::runThread, this)));
+  }
+  catch(...) {
+    close();
+    throw;
+  }
+}
+
+void grdUdsGateInput::close()
+{
+  if (m_thread.get() != SC_NULL) {
+    m_terminated = true;
+    {
+      boost::mutex::scoped_lock l(m_queueMutex);
+      m_queueSpace.notify_all();
+    }
+    uint64_t value = 1;
+    if (write(m_wakeFd, &value, sizeof(value)) < 0)
+      Log::addError("UDS - server thread wake-up failed");
+    m_thread->join();
+    m_thread.reset();
+  }
+
+  if (m_epollFd >= 0) {
+    ::close(m_epollFd);
+    m_epollFd = -1;
+  }
+
+  if (m_wakeFd >= 0) {
+    ::close(m_wakeFd);
+    m_wakeFd = -1;
+  }
+
+  if (m_listenFd >= 0) {
+    ::close(m_listenFd);
+    m_listenFd = -1;
+    if (!m_address.empty() && (m_address[0] == '/'))
+      unlink(m_address.c_str());
+  }
+}
+
+int grdUdsGateInput::run()
+{
+  int res = 0;
+  grdUdsMessageList messages;
+
+  {
+    boost::mutex::scoped_lock l(m_queueMutex);
+    if (m_queueSize == 0)
+      return 0;
+    messages.swap(m_queue);
+    m_queueSize = 0;
+    m_queueSpace.notify_all();
+  }
+
+  for(grdUdsMessageList::const_iterator it = messages.begin(), epos = messages.end(); it != epos; ++it)
+  {
+    try {
+      putEnvelopeData(it->data);
+      res++;
+    }
+    catch(const std::exception &e) {
+      Log::addError(scString("UDS message decode failed: ")+e.what());
+      requestResync(it->fd);
+    }
+  }
+  return res;
+}
+
+// binary dictionary of sender is lost (session evicted by other senders), 
+// sender is asked to start a new one; if fd was closed & reused by other 
+// client meanwhile, request is ignored there (other session)
+void grdUdsGateInput::requestResync(int fd)
+{
+  ulong64 sessionId;
+  if (!m_binSerializer->takeResyncSession(sessionId))
+    return;
+
+  scString data;
+  scEnvSerializerBinDict::makeResyncRequest(sessionId, data);
+  if (send(fd, data.c_str(), data.length(), MSG_NOSIGNAL | MSG_DONTWAIT) == static_cast<ssize_t>(data.length()))
+    Counter::inc("msg-uds-resync-req");
+}
+
+void grdUdsGateInput::putEnvelopeData(const scString &data)
+{
+  std::auto_ptr<scEnvelope> guard(new scEnvelope());
+  if (scEnvSerializerBinDict::isBinaryFrame(data.c_str(), data.length()))
+    m_binSerializer->convFromBuffer(data.c_str(), data.length(), *guard);
+  else
+    m_serializer->convFromString(data, *guard);
+  Counter::inc("msg-size", data.length());
+  handleMsgReceived(*guard);
+  put(guard.release());
+}
+
+// server thread: accepts connections & reads messages into input queue
+void grdUdsGateInput::runThread()
+{
+  struct epoll_event events[GRD_UDS_MAX_EVENTS];
+
+  while(!m_terminated)
+  {
+    int cnt = epoll_wait(m_epollFd, events, GRD_UDS_MAX_EVENTS, GRD_UDS_WAIT_TIMEOUT);
+    if (cnt < 0) {
+      if (errno != EINTR)
+        Log::addError("UDS epoll_wait failed, errno: "+toString(errno));
+      continue;
+    }
+
+    for(int i=0; (i < cnt) && !m_terminated; i++)
+    {
+      int fd = events[i].data.fd;
+      if (fd == m_listenFd) {
+        acceptClients();
+      } else if (fd == m_wakeFd) {
+        uint64_t value;
+        if (read(m_wakeFd, &value, sizeof(value)) < 0) {
+          // nothing to do, counter already reset
+        }
+      } else if ((events[i].events & EPOLLIN) != 0) {
+        readClient(fd);
+      } else {
+        closeClient(fd);
+      }
+    }
+  }
+
+  // close remaining client sockets
+  for(std::set<int>::const_iterator it = m_clients.begin(), epos = m_clients.end(); it != epos; ++it)
+    ::close(*it);
+  m_clients.clear();
+}
+
+void grdUdsGateInput::acceptClients()
+{
+  int fd;
+  while((fd = accept(m_listenFd, SC_NULL, SC_NULL)) >= 0)
+  {
+    grdUdsSetNonBlocking(fd);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+      ::close(fd);
+    else
+      m_clients.insert(fd);
+  }
+}
+
+void grdUdsGateInput::closeClient(int fd)
+{
+  epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, SC_NULL);
+  m_clients.erase(fd);
+  ::close(fd);
+}
+
+// returns <false> if thread is terminated
+bool grdUdsGateInput::waitForQueueSpace()
+{
+  boost::mutex::scoped_lock l(m_queueMutex);
+  while((m_queueSize >= m_queueLimit) && !m_terminated)
+    m_queueSpace.timed_wait(l, boost::posix_time::milliseconds(GRD_UDS_WAIT_TIMEOUT));
+  return !m_terminated;
+}
+
+// reads available messages in batches, connection is closed on EOF
+void grdUdsGateInput::readClient(int fd)
+{
+  struct mmsghdr msgs[GRD_UDS_RECV_BATCH];
+  struct iovec iovecs[GRD_UDS_RECV_BATCH];
+  grdUdsMessageList received;
+  bool done = false;
+
+  while(!done && waitForQueueSpace())
+  {
+    memset(msgs, 0, sizeof(msgs));
+    for(uint i=0; i < GRD_UDS_RECV_BATCH; i++)
+    {
+      iovecs[i].iov_base = &m_recvBuffer[i * GRD_UDS_MAX_MSG_SIZE];
+      iovecs[i].iov_len = GRD_UDS_MAX_MSG_SIZE;
+      msgs[i].msg_hdr.msg_iov = &iovecs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int cnt = recvmmsg(fd, msgs, GRD_UDS_RECV_BATCH, MSG_DONTWAIT, SC_NULL);
+    if (cnt < 0) {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+        closeClient(fd);
+      break;
+    }
+
+    for(int i=0; i < cnt; i++)
+    {
+      if (msgs[i].msg_len == 0) {
+        // peer closed connection
+        closeClient(fd);
+        done = true;
+        break;
+      }
+      if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+        Log::addError("UDS message too long, skipped");
+        continue;
+      }
+      received.push_back(grdUdsFrame(fd));
+      received.back().data.assign(static_cast<const char *>(iovecs[i].iov_base), msgs[i].msg_len);
+    }
+
+    if (!received.empty()) {
+      boost::mutex::scoped_lock l(m_queueMutex);
+      m_queueSize += received.size();
+      m_queue.splice(m_queue.end(), received);
+    }
+
+    if (static_cast<uint>(cnt) < GRD_UDS_RECV_BATCH)
+      done = true;
+  }
+}
+
+//----------------------------------------------------------------------------------
+// grdUdsGateOutput
+//----------------------------------------------------------------------------------
+grdUdsGateOutput::grdUdsGateOutput(): grdUdsGate(), m_sendTimeout(GRD_UDS_DEF_SEND_TIMEOUT), m_connGeneration(0)
+{
+  m_serializer.reset(new scEnvSerializerJsonYajl());
+}
+
+grdUdsGateOutput::~grdUdsGateOutput()
+{
+}
+
+void grdUdsGateOutput::setSendTimeout(uint value)
+{
+  m_sendTimeout = value;
+}
+
+// messages are grouped per connection & sent in batches, scheduler thread 
+// is never blocked by full receiver queue: messages wait in m_pending 
+// (in order) and are sent in next runs
+int grdUdsGateOutput::run()
+{
+  int res = 0;
+
+  m_connections.checkActive();
+  checkPending();
+
+  // connections with pending messages are pinned, so they are not 
+  // evicted by pool limit when next connection is opened
+  for(grdUdsBatchMap::iterator it = m_pending.begin(), epos = m_pending.end(); it != epos; ++it)
+    m_connections.pin(it->first);
+
+  while(!empty())
+  {
+    prepareForSend(get());
+    res++;
+  }
+
+  for(grdUdsBatchMap::iterator it = m_pending.begin(); it != m_pending.end(); /* empty here */)
+  {
+    if (transmitBatch(it->first, *it->second))
+      m_pending.erase(it++);
+    else
+      ++it;
+  }
+
+  m_connections.unpinAll();
+  return res;
+}
+
+// messages of closed / replaced connections are encoded with lost dictionary
+void grdUdsGateOutput::checkPending()
+{
+  for(grdUdsBatchMap::iterator it = m_pending.begin(); it != m_pending.end(); /* empty here */)
+  {
+    grdUdsConnectionOut *connection = findConnection(it->first);
+    if ((connection == SC_NULL) || (connection->getGeneration() != it->second->generation)) {
+      failBatch(*it->second, "UDS-Transmit - connection closed");
+      m_pending.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// takes ownership of envelope
+void grdUdsGateOutput::prepareForSend(scEnvelope *envelope)
+{
+  std::auto_ptr<scEnvelope> envelopeGuard(envelope);
+
+  try {
+    scString connectionId = envelope->getReceiver().getHost();
+    grdUdsConnectionOut *connection = prepareConnection(envelope->getReceiver());
+    m_connections.pin(connectionId);
+
+    grdUdsBatchMap::iterator it = m_pending.find(connectionId);
+    if (it == m_pending.end())
+      it = m_pending.insert(connectionId, new grdUdsBatch(connection->getGeneration())).first;
+
+    grdUdsBatch &batch = *it->second;
+    scString dataStr;
+    bool binFormat = (m_format == GRD_UDS_FORMAT_BIN);
+    if (binFormat)
+      connection->getDictSerializer().convToString(*envelope, dataStr);
+    else
+      m_serializer->convToString(*envelope, dataStr);
+
+    if (dataStr.length() > GRD_UDS_MAX_MSG_SIZE) {
+      // frame is not sent, receiver must not miss dictionary entries
+      if (binFormat)
+        connection->getDictSerializer().rollbackFrame();
+      throw scError("UDS message too long ("+toString(dataStr.length())+")");
+    }
+
+    handleMsgReadyForSend(*envelope);
+    batch.messages.push_back(dataStr);
+    batch.envelopes.push_back(envelopeGuard.release());
+  }
+  catch (scError &e) {
+    e.addDetails(scDataNode(envelopeGuard->getReceiver().getAsString()));
+    handleTransmitError(*envelopeGuard, e);
+  }
+  catch(const std::exception& e) {
+    scString msg = scString("UDS-Transmit - exception (std): ") + e.what();
+    scString dets = scString("out-addr: ") + envelopeGuard->getReceiver().getAsString();
+    handleTransmitError(*envelopeGuard, SC_MSG_STATUS_EXCEPTION, msg, dets);
+  }
+}
+
+bool grdUdsGateOutput::transmitBatch(const scString &connectionId, grdUdsBatch &batch)
+{
+  size_t startCount = batch.sentCount;
+  scString errorMsg;
+
+  if (batch.messages.empty())
+    return true;
+
+#ifdef SC_TIMER_ENABLED
+  Timer::start("msg-total");
+  Timer::start("msg-execute-uds");
+#endif
+
+  try {
+    grdUdsConnectionOut *connection = findConnection(connectionId);
+    if (connection == SC_NULL)
+      throw scError("connection closed");
+    connection->checkControl();
+    connection->sendBatch(batch.messages, batch.sentCount);
+  }
+  catch (scError &e) {
+    errorMsg = scString("UDS-Transmit - error: ") + e.what();
+  }
+  catch(const std::exception& e) {
+    errorMsg = scString("UDS-Transmit - exception (std): ") + e.what();
+  }
+  catch(...) {
+    errorMsg = scString("UDS-Transmit - exception (unknown)");
+  }
+
+#ifdef SC_TIMER_ENABLED
+  Timer::stop("msg-execute-uds");
+  Timer::stop("msg-total");
+#endif
+
+  if (batch.sentCount > startCount) {
+    Counter::inc("msg-total", batch.sentCount - startCount);
+    Counter::inc("msg-uds-batch");
+    batch.progressTime = cpu_time_ms();
+  }
+
+  for(size_t i = startCount; i < batch.sentCount; i++)
+  {
+    Counter::inc("msg-size", batch.messages[i].length());
+    handleMsgSent(batch.envelopes[i]);
+  }
+
+  if (errorMsg.empty() && (batch.sentCount < batch.messages.size()) && 
+      is_cpu_time_elapsed_ms(batch.progressTime, m_sendTimeout))
+    errorMsg = scString("UDS send timeout, receiver not responding");
+
+  if (!errorMsg.empty()) {
+    failBatch(batch, errorMsg);
+    // connection (with dictionary) is not usable after error
+    m_connections.remove(connectionId);
+    return true;
+  }
+
+  if (batch.sentCount < batch.messages.size()) {
+    if (batch.sentCount > 0) {
+      Counter::inc("msg-uds-send-partial");
+      batch.messages.erase(batch.messages.begin(), batch.messages.begin() + batch.sentCount);
+      batch.envelopes.erase(batch.envelopes.begin(), batch.envelopes.begin() + batch.sentCount);
+      batch.sentCount = 0;
+    }
+    return false;
+  }
+
+  return true;
+}
+
+void grdUdsGateOutput::failBatch(grdUdsBatch &batch, const scString &errorMsg)
+{
+  for(size_t i = batch.sentCount, epos = batch.envelopes.size(); i != epos; i++)
+  {
+    scString dets = scString("out-addr: ") + batch.envelopes[i].getReceiver().getAsString();
+    handleTransmitError(batch.envelopes[i], SC_MSG_STATUS_EXCEPTION, errorMsg, dets);
+  }
+  batch.sentCount = batch.messages.size();
+}
+
+grdUdsConnectionOut *grdUdsGateOutput::prepareConnection(const scMessageAddress &address)
+{
+  scString host = address.getHost();
+
+  scString connectionId = host;
+  scString connectionStr;
+
+  if (m_address.empty())
+    connectionStr = host;
+  else
+    connectionStr = m_address;
+
+  grdUdsConnectionOut *item = findConnection(connectionId);
+  if (item == SC_NULL)
+  {
+    std::auto_ptr<grdUdsConnectionOut> connGuard;
+    connGuard.reset(new grdUdsConnectionOut());
+
+#ifdef SC_TIMER_ENABLED
+  Timer::start("msg-total");
+  Timer::start("msg-connect-uds");
+#endif
+    connGuard.get()->connect(connectionStr);
+#ifdef SC_TIMER_ENABLED
+  Timer::stop("msg-connect-uds");
+  Timer::stop("msg-total");
+#endif
+    item = connGuard.get();
+    item->setInactTimeout(this->m_inactTimeout);
+    item->setGeneration(++m_connGeneration);
+    m_connections.add(connectionId, connGuard.release());
+  }
+  return item;
+}
+
+grdUdsConnectionOut *grdUdsGateOutput::findConnection(const scString &connectionId)
+{
+  grdUdsConnectionOut *res = dynamic_cast<grdUdsConnectionOut *>(m_connections.find(connectionId));
+  return res;
+}
+
+//----------------------------------------------------------------------------------
+// grdUdsConnectionOut
+//----------------------------------------------------------------------------------
+grdUdsConnectionOut::grdUdsConnectionOut(): scConnection(), m_fd(-1), m_generation(0)
+{
+}
+
+grdUdsConnectionOut::~grdUdsConnectionOut()
+{
+  performAutoClose();
+  close();
+}
+
+bool grdUdsConnectionOut::isConnected()
+{
+  return (m_fd >= 0);
+}
+
+bool grdUdsConnectionOut::connect(const scString &address)
+{
+  bool res = isConnected();
+  if (!res) {
+    struct sockaddr_un addr;
+    socklen_t addrLen = grdUdsPrepareAddress(address, addr);
+
+    m_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (m_fd < 0)
+      throw scError("UDS socket failed, errno: "+toString(errno));
+
+    if (::connect(m_fd, reinterpret_cast<struct sockaddr *>(&addr), addrLen) != 0) {
+      int error = errno;
+      close();
+      throw scError("UDS connect failed: "+address+", errno: "+toString(error));
+    }
+
+    grdUdsSetNonBlocking(m_fd);
+    res = true;
+  }
+  signalConnected();
+  return res;
+}
+
+void grdUdsConnectionOut::close()
+{
+  if (isConnected())
+  {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+void grdUdsConnectionOut::checkConnected()
+{
+  if (!isConnected())
+    throw scError("UDS connection not active!");
+}
+
+void grdUdsConnectionOut::sendBatch(const std::vector<scString> &messages, size_t &sentCount)
+{
+  struct mmsghdr msgs[GRD_UDS_SEND_BATCH];
+  struct iovec iovecs[GRD_UDS_SEND_BATCH];
+
+  checkConnected();
+
+  while(sentCount < messages.size())
+  {
+    uint cnt = 0;
+    memset(msgs, 0, sizeof(msgs));
+    while((cnt < GRD_UDS_SEND_BATCH) && (sentCount + cnt < messages.size()))
+    {
+      const scString &message = messages[sentCount + cnt];
+      iovecs[cnt].iov_base = const_cast<char *>(message.c_str());
+      iovecs[cnt].iov_len = message.length();
+      msgs[cnt].msg_hdr.msg_iov = &iovecs[cnt];
+      msgs[cnt].msg_hdr.msg_iovlen = 1;
+      cnt++;
+    }
+
+    int res = sendmmsg(m_fd, msgs, cnt, MSG_NOSIGNAL);
+    if (res > 0) {
+      sentCount += res;
+      signalUsed();
+    } else if ((res < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      // receiver queue is full, rest is sent in next run
+      break;
+    } else if ((res < 0) && (errno == EINTR)) {
+      continue;
+    } else {
+      int error = errno;
+      close();
+      throw scError("UDS send failed, errno: "+toString(error));
+    }
+  }
+}
+
+// receiver writes back only resync requests, EOF closes connection
+void grdUdsConnectionOut::checkControl()
+{
+  char buffer[GRD_UDS_MAX_CONTROL_SIZE];
+  ulong64 sessionId;
+
+  while(isConnected())
+  {
+    ssize_t cnt = recv(m_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (cnt < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        close();
+      break;
+    }
+    if (cnt == 0) {
+      close();
+      break;
+    }
+    if (scEnvSerializerBinDict::isResyncRequest(buffer, cnt, sessionId) &&
+        (m_dictSerializer.get() != SC_NULL) && m_dictSerializer->handleResyncRequest(sessionId))
+      Counter::inc("msg-uds-resync");
+  }
+}
+
+scEnvSerializerBinDict &grdUdsConnectionOut::getDictSerializer()
+{
+  if (m_dictSerializer.get() == SC_NULL)
+    m_dictSerializer.reset(new scEnvSerializerBinDict());
+  return *m_dictSerializer;
+}
+
+//----------------------------------------------------------------------------------
+// grdUdsGateFactory
+//----------------------------------------------------------------------------------
+grdUdsGateFactory::grdUdsGateFactory(): scGateFactory()
+{
+}
+
+grdUdsGateFactory::~grdUdsGateFactory()
+{
+}
+
+scMessageGate *grdUdsGateFactory::createGate(bool input, const scDataNode &params, const scString &protocol) const
+{
+  std::auto_ptr<grdUdsGate> res;
+  if (input) {
+    grdUdsGateInput *inputGate = new grdUdsGateInput();
+    res.reset(inputGate);
+    if (params.size()>0)
+      inputGate->setAddress(params.getString(0));
+    if (params.hasChild("queue_limit"))
+      inputGate->setQueueLimit(params.getUInt("queue_limit"));
+  }
+  else {
+    grdUdsGateOutput *outputGate = new grdUdsGateOutput();
+    res.reset(outputGate);
+    if (params.size()>0)
+      outputGate->setAddress(params.getString(0));
+
+    if (params.size()>1) {
+      uint timeout = params.getUInt(1);
+      outputGate->setInactTimeout(timeout);
+    }
+
+    if (params.hasChild("send_timeout"))
+      outputGate->setSendTimeout(params.getUInt("send_timeout"));
+  }
+
+  if (params.hasChild("format"))
+    res->setFormat(params.getString("format"));
+
+  res->setProtocol(protocol);
+  return res.release();
+}
@@ -9,6 +9,10 @@
 // Licence:     BSD
 /////////////////////////////////////////////////////////////////////////////
 
+// std
+#include <set>
+#include <vector>
+
 // perf
 #include "perf/Log.h"
 #include "perf/Counter.h"
@@ -18,6 +22,7 @@
 #include "grd/CompactServer.h"
 #include "grd/WorkQueueClientImpl.h"
 #include "grd/details/SchedulerImpl.h"
+#include "grd/MessageConst.h"
 
 #ifdef DEBUG_MEM
 #include "sc/DebugMem.h"
@@ -26,6 +31,7 @@
 using namespace perf;
 
 const uint DEF_YIELD_DELAY = 500;
+const scString WQ_BATCH_COMMAND = "squeue.batch";
 
 //-------------------------------------------------------------------------------
 // Private classes
@@ -34,6 +40,15 @@ class scWqWorkerEntry;
 
 typedef boost::ptr_vector<scWqWorkerEntry> scWqWorkerColn;
 
+struct scWqBatchResult {
+  scWqBatchResult(): status(SC_MSG_STATUS_UNK_MSG) {}
+  int status;
+  scDataNode output;
+};
+
+typedef std::vector<scWqBatchResult> scWqBatchResultList;
+typedef std::vector<uint> scWqBatchIndexList;
+
 class scWqAppBodyImpl: public scWqAppBody {
 public:
 // construct
@@ -43,6 +58,7 @@ public:
   void setCliArgs(const scDataNode &args);
   void addTask(scTask *task);
   void addWorker(scWqWorker *worker);
+  void processBatch(const scDataNode &input, scDataNode &output);
   virtual scWqServerProxy *prepareServerProxy();
   virtual scSignal *prepareYieldSignal(bool withDelay);
   void setStopOnIdle(bool value);  
@@ -73,6 +89,7 @@ protected:
   std::auto_ptr<scSignal> m_yieldSignalDelay;
   std::auto_ptr<scSignal> m_yieldSignalNoDelay;
   std::auto_ptr<scListener> m_yieldListener;
+  std::auto_ptr<scListener> m_batchListener;
   scWqWorkerColn m_workers;
 };
 
@@ -99,10 +116,61 @@ protected:
 
 class scWqWorkerEntry {
 public:
-  scWqWorkerEntry(scWqWorker *worker, scListener *listener): m_worker(worker), m_listener(listener) {}
+  scWqWorkerEntry(scWqWorker *worker, scListener *listener, const scStringList &commands): 
+    m_worker(worker), m_listener(listener), m_commands(commands.begin(), commands.end()) {}
+  scWqWorker *getWorker() { return m_worker.get(); }
+  bool supportsCommand(const scString &command) const { return (m_commands.find(command) != m_commands.end()); }
 protected:
   std::auto_ptr<scWqWorker> m_worker;
   std::auto_ptr<scListener> m_listener;
+  std::set<scString> m_commands;
+};
+
+/// handles squeue.batch - dispatches items to workers
+class scWqBatchListener: public scListener {
+public:
+  scWqBatchListener(scWqAppBodyImpl *owner): scListener(), m_owner(owner) {}
+  virtual ~scWqBatchListener() {}
+  virtual bool process(const scString &eventName, const scDataNode *aInput, scDataNode *aOutput) { 
+    if ((aInput == SC_NULL) || !aInput->hasChild("items"))
+      return false;
+    m_owner->processBatch(*aInput, *aOutput);
+    return true;
+  }
+protected:
+  scWqAppBodyImpl *m_owner;  
+};
+
+/// items of batch selected for one worker
+class scWqBatchIteratorImpl: public scWqBatchIterator {
+public:
+  scWqBatchIteratorImpl(scDataNode &items, const scWqBatchIndexList &indices, scWqBatchResultList &results): 
+    scWqBatchIterator(), m_items(items), m_indices(indices), m_results(results), m_pos(-1) {}
+  virtual ~scWqBatchIteratorImpl() {}
+  virtual bool next() {
+    if (m_pos + 1 >= int(m_indices.size()))
+      return false;
+    m_pos++;
+    scDataNode &item = m_items[m_indices[m_pos]];
+    m_command = item.getString("command");
+    m_args = (item.hasChild("params") ? &item["params"] : &m_nullArgs);
+    getResult().status = SC_MSG_STATUS_OK;
+    return true;
+  }
+  virtual const scString &getCommand() const { return m_command; }
+  virtual const scDataNode &getArgs() const { return *m_args; }
+  virtual scDataNode &getOutput() { return getResult().output; }
+  virtual void setStatus(int value) { getResult().status = value; }
+protected:
+  scWqBatchResult &getResult() { return m_results[m_indices[m_pos]]; }
+protected:
+  scDataNode &m_items;
+  const scWqBatchIndexList &m_indices;
+  scWqBatchResultList &m_results;
+  int m_pos;
+  scString m_command;
+  scDataNode *m_args;
+  scDataNode m_nullArgs;
 };
 
 struct LastTimeMarker {
@@ -188,6 +256,13 @@ void scWqAppBodyImpl::addWorker(scWqWorker *worker)
   worker->getSupportedCommands(cmdList);
   
   //for(uint i=0, epos = cmdList.size(); i != epos; i++)
+  if (!cmdList.empty() && (m_batchListener.get() == SC_NULL)) {
+    m_batchListener.reset(new scWqBatchListener(this));
+    m_notifier->addListener(WQ_BATCH_COMMAND, m_batchListener.get());
+    commandMsg.setCommand(WQ_BATCH_COMMAND);
+    m_compactServer->addInterfaceToObserved(commandMsg.getInterface());
+  }
+
   for(scStringList::iterator it = cmdList.begin(), epos = cmdList.end(); it != epos; ++it)
   {
     //commandMsg.setCommand(cmdList[i]);
@@ -198,7 +273,7 @@ void scWqAppBodyImpl::addWorker(scWqWorker *worker)
   }  
     
   if (!cmdList.empty()) {  
-    m_workers.push_back(new scWqWorkerEntry(workerGuard.release(), listerGuard.release()));
+    m_workers.push_back(new scWqWorkerEntry(workerGuard.release(), listerGuard.release(), cmdList));
   }  
 
   scWqModalWorker *mworker = dynamic_cast<scWqModalWorker *>(worker);
@@ -206,6 +281,45 @@ void scWqAppBodyImpl::addWorker(scWqWorker *worker)
     mworker->setYieldSignal(prepareYieldSignal(true));
 }
 
+// input: items - list of {command, params}
+// output: list of {status, result|error}, one per item
+void scWqAppBodyImpl::processBatch(const scDataNode &input, scDataNode &output)
+{
+  scDataNode items;
+  input.getElement("items", items);
+  scWqBatchResultList results(items.size());
+  std::vector<bool> assigned(items.size(), false);
+
+  for(scWqWorkerColn::iterator it = m_workers.begin(), epos = m_workers.end(); it != epos; ++it)
+  {
+    scWqBatchIndexList indices;
+    for(uint i=0, eposi = items.size(); i != eposi; i++)
+      if (!assigned[i] && it->supportsCommand(items[i].getString("command"))) {
+        indices.push_back(i);
+        assigned[i] = true;
+      }  
+
+    if (!indices.empty()) {
+      scWqBatchIteratorImpl batchItems(items, indices, results);
+      it->getWorker()->processBatch(batchItems);
+    }  
+  }
+
+  scDataNode resultList(ict_list);
+  for(uint i=0, epos = results.size(); i != epos; i++)
+  {
+    std::auto_ptr<scDataNode> itemGuard(new scDataNode(ict_parent));
+    itemGuard->addChild("status", new scDataNode(results[i].status));
+    if (results[i].status == SC_MSG_STATUS_OK)
+      itemGuard->addChild("result", new scDataNode(results[i].output));
+    else if (!results[i].output.empty())
+      itemGuard->addChild("error", new scDataNode(results[i].output));
+    resultList.addChild(itemGuard.release());
+  }
+
+  output.eatValueFrom(resultList);
+}
+
 void scWqAppBodyImpl::setCliArgs(const scDataNode &args)
 {
   scString script;
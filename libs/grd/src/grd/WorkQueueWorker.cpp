@@ -9,6 +9,8 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include "grd/WorkQueueWorker.h"
+#include "grd/MessageConst.h"
+#include "sc/utils.h"
 #include "sc/proc/process.h"
 #include "perf/Timer.h"
 #include "perf/Counter.h"
@@ -16,6 +18,29 @@
 
 using namespace perf;
 
+void scWqWorker::processBatch(scWqBatchIterator &items)
+{
+  while(items.next())
+  {
+    try {
+      if (!process(items.getCommand(), items.getArgs(), items.getOutput()))
+        items.setStatus(SC_MSG_STATUS_UNK_MSG);
+    }
+    catch(scError &excp) {
+      scString msg = scString("WQW01: Exception (scError): ") + excp.what()+", code: "+toString(excp.getErrorCode())+", details: "+excp.getDetails();
+      Log::addError(msg);
+      items.setStatus(SC_MSG_STATUS_EXCEPTION);
+      items.getOutput() = scDataNode(msg);
+    }
+    catch(const std::exception& e) {
+      scString msg = scString("WQW02: Exception (std): ") + e.what();
+      Log::addError(msg);
+      items.setStatus(SC_MSG_STATUS_EXCEPTION);
+      items.getOutput() = scDataNode(msg);
+    }
+  }
+}
+
 void scWqModalWorker::addWorkerIdToResult(scDataNode &output)
 {
   if (!output.isParent())
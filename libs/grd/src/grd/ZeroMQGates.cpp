@@ -11,7 +11,22 @@
 // zmq
 #include "zmq.hpp"
 
+// std
+#include <map>
+#include <set>
+#include <list>
+#include <vector>
+
+// boost
+#include "boost/shared_ptr.hpp"
+#include "boost/thread.hpp"
+#include "boost/bind.hpp"
+#include "boost/ptr_container/ptr_list.hpp"
+#include "boost/lockfree/spsc_queue.hpp"
+#include "boost/date_time/posix_time/posix_time.hpp"
+
 // perf
+#include "perf/time_utils.h"
 #include "perf/Timer.h"
 #include "perf/Counter.h"
 #include "perf/Log.h"
@@ -21,6 +36,7 @@
 
 #include "grd/MessageConst.h"
 #include "grd/EnvSerializerJsonYajl.h"
+#include "grd/EnvSerializerBinDict.h"
 #include "grd/MessageGate.h"
 #include "grd/Connection.h"
 #include "grd/ConnectionPool.h"
@@ -37,14 +53,143 @@ const scString SC_PROTOCOL_PGM = "pgm";
 const uint SC_ZMQ_DEF_INACT_CONN_TIMEOUT = 30000;
 const uint SC_ZMQ_MAX_MSG_SIZE = 65536;
 const scString SC_ZMQ_TOPIC_SEP = "|";
+const scString SC_ZMQ_FORMAT_JSON = "json";
+const scString SC_ZMQ_FORMAT_BIN = "bin";
+const scString SC_ZMQ_MODE_SYNC = "sync";   // REQ/REP
+const scString SC_ZMQ_MODE_ASYNC = "async"; // DEALER/ROUTER, pipelined
+const uint SC_ZMQ_IO_QUEUE_SIZE = 4096;   // capacity of hand-off queues
+const uint SC_ZMQ_IO_POLL_TIMEOUT = 100;  // ms
+const uint SC_ZMQ_STATS_INTERVAL = 1000;  // ms, refresh of pool stats copy in I/O thread mode
+const uint SC_ZMQ_SEQ_FRAME_SIZE = 24;    // publisher id, sequence, send time
+const uint SC_ZMQ_MAX_PUB_STREAMS = 1024; // tracked (publisher, topic) pairs
+const uint SC_ZMQ_DEF_SEND_BATCH = 1;     // opt-in: older receivers read only first part, rest is lost
+const uint SC_ZMQ_MAX_SEND_BATCH = 256;   
+
+#if ZMQ_VERSION_MAJOR < 3
+#define SC_ZMQ_POLL_MSEC 1000
+#else
+#define SC_ZMQ_POLL_MSEC 1
+#endif
 
 //----------------------------------------------------------------------------------
 // Local classes
 //----------------------------------------------------------------------------------
 class zmConnectionOut;
+class zmGate;
+class zmIoThread;
 
 typedef boost::ptr_map<scString,zmConnectionOut> zmConnectionOutMap; 
 typedef std::auto_ptr<zmq::socket_t> zmSocketGuard; 
+typedef boost::ptr_map<scString,scEnvSerializerBinDict> zmDictSerializerMap; 
+typedef boost::shared_ptr<zmIoThread> zmIoThreadTransporter;
+typedef std::list<zmGate *> zmGateList;
+typedef std::vector<zmq::pollitem_t> zmPollItemList;
+
+/// Single producer / single consumer hand-off between I/O thread and scheduler
+typedef boost::lockfree::spsc_queue<scEnvelope *> zmEnvelopeQueue;
+
+/// Transmit error detected in I/O thread, reported by scheduler thread
+class zmIoFailure {
+public:
+  zmIoFailure(scEnvelope *a_envelope, int a_status, const scString &a_msg, const scString &a_details):
+    envelope(a_envelope), status(a_status), msg(a_msg), details(a_details) {}
+  ~zmIoFailure() { delete envelope; }
+  scEnvelope *envelope;
+  int status;
+  scString msg;
+  scString details;
+};
+
+typedef boost::lockfree::spsc_queue<zmIoFailure *> zmFailureQueue;
+typedef boost::ptr_list<zmIoFailure> zmFailureList;
+
+/// Envelopes collected for one connection, sent as one multipart message
+class zmSendBatch {
+public:
+  zmSendBatch(const scString &a_connectionId, ulong64 a_generation): 
+    connectionId(a_connectionId), generation(a_generation), dataSize(0) {}
+  scString connectionId;
+  ulong64 generation; // frames are encoded with dictionary of this connection instance
+  ulong64 dataSize;
+  boost::ptr_list<scEnvelope> envelopes;
+  std::vector<scString> frames; // encoded envelopes
+};
+
+typedef boost::ptr_list<zmSendBatch> zmSendBatchList;
+
+/// Return path to a peer connected to one of our ROUTER sockets
+class zmRoute {
+public:
+  zmRoute(): socket(SC_NULL), lastSeen(0), ioThread(false) {}
+  zmq::socket_t *socket;
+  scString identity;
+  cpu_ticks lastSeen;
+  bool ioThread; // socket is owned by I/O thread
+};
+
+typedef std::map<scString,zmRoute> zmRouteMap;
+
+/// PGM / EPGM socket options, 0 - 0MQ default
+class zmMulticastOptions {
+public:
+  zmMulticastOptions(): rate(0), recoveryIvl(0), hops(0) {}
+  bool isEmpty() const { return (rate == 0) && (recoveryIvl == 0) && (hops == 0); }
+  uint rate;        // kbit/s
+  uint recoveryIvl; // ms
+  uint hops;
+};
+
+/// Transport keepalive options, 0 - 0MQ / OS default
+class zmKeepaliveOptions {
+public:
+  zmKeepaliveOptions(): heartbeatIvl(0), heartbeatTimeout(0), heartbeatTtl(0), 
+    tcpKeepalive(-1), tcpKeepaliveIdle(0), tcpKeepaliveIntvl(0), tcpKeepaliveCnt(0) {}
+  bool isEmpty() const { return (heartbeatIvl == 0) && (tcpKeepalive < 0); }
+  bool usesHeartbeat() const { return (heartbeatIvl > 0); }
+  uint heartbeatIvl;     // ms, ZMTP PING interval
+  uint heartbeatTimeout; // ms, disconnect if no traffic after PING
+  uint heartbeatTtl;     // ms, advertised to remote side
+  int tcpKeepalive;      // -1 - OS default, 0 - off, 1 - on
+  uint tcpKeepaliveIdle; // sec
+  uint tcpKeepaliveIntvl; // sec
+  uint tcpKeepaliveCnt;
+};
+
+/// Peer of output connection detected as lost
+class zmLostPeer {
+public:
+  zmLostPeer(const scString &a_connectionId, const scString &a_host): connectionId(a_connectionId), host(a_host) {}
+  scString connectionId;
+  scString host;
+};
+
+typedef std::list<zmLostPeer> zmLostPeerList;
+
+/// Delivery state of one (publisher, topic) stream on subscriber side
+class zmPubStreamInfo {
+public:
+  zmPubStreamInfo(): lastSeq(0), received(0), lost(0), lastLag(0), maxLag(0) {}
+  ulong64 lastSeq;
+  ulong64 received;
+  ulong64 lost;
+  ulong64 lastLag; // ms, requires synchronized clocks
+  ulong64 maxLag;
+};
+
+typedef std::pair<ulong64, scString> zmPubStreamKey;
+typedef std::map<zmPubStreamKey, zmPubStreamInfo> zmPubStreamMap;
+typedef std::map<scString, ulong64> zmPubSeqMap;
+
+/// replies received from one peer
+struct zmPeerReplyInfo {
+  zmPeerReplyInfo(): msgCount(0), byteCount(0) {}
+  ulong64 msgCount;
+  ulong64 byteCount;
+};
+
+/// replies received per connection id, for each protocol
+typedef std::map<scString, zmPeerReplyInfo> zmPeerReplyMap;
+typedef std::map<scString, zmPeerReplyMap> zmPeerTrafficMap;
 
 class zmContext: public zmContextBase {
 public:
@@ -52,8 +197,74 @@ public:
   virtual ~zmContext();
   zmq::context_t &getHandle();
   virtual void clear();
+  // routes for async mode
+  void registerRoute(const scString &connectionId, zmq::socket_t *socket, const scString &identity, bool ioThread);
+  bool findRoute(const scString &connectionId, uint maxAge, bool ioThread, zmRoute &output);
+  void removeRoutes(zmq::socket_t *socket);
+  // replies received by input gates in sync mode, for output gate stats
+  void noteReceived(const scString &protocol, const scString &connectionId, ulong64 byteCount);
+  void takeReceived(const scString &protocol, zmPeerReplyMap &output);
+  // I/O thread
+  zmIoThreadTransporter prepareIoThread();
+  virtual bool waitForIoActivity(uint timeMs);
+protected:
+  void stopIoThread();
 protected:
   std::auto_ptr<zmq::context_t> m_context;
+  zmRouteMap m_routes;
+  boost::mutex m_routesMutex;
+  zmPeerTrafficMap m_received;
+  boost::mutex m_receivedMutex;
+  zmIoThreadTransporter m_ioThread;
+};
+
+/// Command passed from scheduler to I/O thread
+class zmIoCommand {
+public:
+  zmIoCommand(zmGate *a_gate, bool a_add): gate(a_gate), add(a_add), done(false) {}
+  zmGate *gate;
+  bool add;
+  bool done;
+  scString error;
+};
+
+typedef std::list<zmIoCommand *> zmIoCommandList;
+
+/// Optional thread performing all socket I/O for gates of one context.
+/// Sockets of attached gates are created, polled and closed only here.
+class zmIoThread {
+public:
+  zmIoThread(zmContext *context);
+  ~zmIoThread();
+  void start();
+  void stop();
+  // scheduler thread
+  void addGate(zmGate *gate);
+  void removeGate(zmGate *gate);
+  void wakeUp();
+  bool waitForActivity(uint timeMs);
+protected:
+  void run();
+  bool isStopRequested();
+  void executeCommand(zmIoCommand *command);
+  void processCommands();
+  void performCycle(zmPollItemList &items);
+  void closeAll();
+  void signalActivity();
+protected:
+  zmContext *m_context;
+  std::auto_ptr<boost::thread> m_thread;
+  bool m_running;
+  bool m_stopRequested;
+  boost::mutex m_mutex;
+  boost::condition_variable m_cmdDone;
+  zmIoCommandList m_commands;
+  zmGateList m_gates;             // used only by I/O thread
+  zmSocketGuard m_wakeRecv;       // used only by I/O thread
+  zmSocketGuard m_wakeSend;       // used only by scheduler thread
+  boost::mutex m_activityMutex;
+  boost::condition_variable m_activityCond;
+  bool m_activity;
 };
 
 class zmGate: public scMessageGate {
@@ -64,18 +275,41 @@ public:
   void setProtocol(const scString &protocol);
   void setAddress(const scString &address);
   void setInactTimeout(uint msecs);
+  void setFormat(const scString &format);
+  void setMode(const scString &mode);
+  void setUseIoThread(bool value);
+  void setMulticastOptions(const zmMulticastOptions &options);
+  void setKeepaliveOptions(const zmKeepaliveOptions &options);
+  bool isIoThreadMode() const;
   virtual bool supportsProtocol(const scString &protocol);
   virtual bool getOwnAddress(const scString &protocol, scMessageAddress &output);
+  // called from I/O thread
+  virtual void ioInit() {}
+  virtual int ioRun() { return 0; }
+  virtual void ioAddPollItems(zmPollItemList &items) {}
+  virtual void ioClose() {}
 protected:
   void splitTopic(const scString &rawHost, scString &host, scString &topic);
   scString extractTopic(const scString &addr);
+  scString getConnectionId(const scMessageAddress &address);
+  // perf stats are not thread-safe, skipped in I/O thread mode
+  void startTimer(const scString &name);
+  void stopTimer(const scString &name);
+  void incCounter(const scString &name, ulong64 value = 1);
+  void decodeEnvelope(const char *data, size_t dataSize, scEnvelope &output);
 protected:
   scString m_protocol; 
   scString m_zmqProtocol; 
   scString m_address; 
   uint m_inactTimeout; // inactivity timeout for connections
+  scString m_format; // output format: json, bin
+  bool m_asyncMode;
+  zmMulticastOptions m_mcastOptions;
+  zmKeepaliveOptions m_keepaliveOptions;
   std::auto_ptr<scEnvelopeSerializerBase> m_serializer; 
+  std::auto_ptr<scEnvSerializerBinDict> m_binSerializer; // decoder
   zmContext *m_context;
+  zmIoThreadTransporter m_ioThread;
 };
 
 class zmConnectionOut: public scConnection {
@@ -84,45 +318,287 @@ public:
   zmConnectionOut(zmContext *context);
   virtual ~zmConnectionOut();
   // exec
-  bool connect(const scString &address, bool usePublish);  
+  bool connect(const scString &address, int socketType);  
   virtual void close();
   virtual bool isConnected();  
-  void send(char *ptr, size_t asize);
+  void send(const char *ptr, size_t asize);
+  void send(const scString &topicFrame, const char *ptr, size_t asize, const scString &seqFrame);
+  void sendMultipart(const std::vector<scString> &frames, size_t extraSize);
+  bool receive(zmq::message_t &msg);
+  void setMulticastOptions(const zmMulticastOptions &options);
+  void setKeepaliveOptions(const zmKeepaliveOptions &options);
+  void *getSocketHandle();
+  scEnvSerializerBinDict &getDictSerializer();
+  void setConnectionId(const scString &value);
+  const scString &getConnectionId() const;
+  void setPeerHost(const scString &value);
+  const scString &getPeerHost() const;
+  /// unique per gate, changes when connection is created again
+  void setGeneration(ulong64 value) { m_generation = value; }
+  ulong64 getGeneration() const { return m_generation; }
+  bool checkPeerLost();
 protected:  
   void checkConnected();
+  void startMonitor();
+  void stopMonitor();
 protected:
+  scString m_connectionId;
+  scString m_peerHost;
+  ulong64 m_generation;
   zmSocketGuard m_socket;
+  zmSocketGuard m_monitor; // receives disconnect events, used with heartbeats
   zmContext *m_context;
+  zmMulticastOptions m_mcastOptions;
+  zmKeepaliveOptions m_keepaliveOptions;
+  std::auto_ptr<scEnvSerializerBinDict> m_dictSerializer; // per-connection dictionary
 };
 
 class zmGateInput: public zmGate {
 public:
   zmGateInput(zmContext *context);
   virtual ~zmGateInput();
+  void setSubscribeAddress(const scString &value);
   virtual void init();
   virtual int run();
+  virtual void handleRoleRegistered(const scString &roleName);
+  virtual void getStats(scDataNode &output);
+  virtual void ioInit();
+  virtual int ioRun();
+  virtual void ioAddPollItems(zmPollItemList &items);
+  virtual void ioClose();
 protected:    
+  void initSocket();
+  void checkSequence(const scString &topicFrame, const zmq::message_t &seqMsg);
+  void subscribe(zmq::socket_t &socket, const scString &topic);
+  void applyPendingTopics();
+  bool canHandOff();
+  int flushHandOff();
+  int pullAll();
   bool pull();
-  void putEnvelopeStr(const scString &str);
+  bool pullRouted();
+  bool pullPublished(zmq::socket_t &socket);
+  void putEnvelopeData(const char *data, size_t dataSize, const scString &identity, bool reply = false);
+  bool putPartData(const zmq::message_t &msg, const scString &identity, bool reply = false);
+  void requestResync(const scString &identity, ulong64 sessionId);
 protected:    
   std::auto_ptr<zmq::socket_t> m_socket;
   bool m_connected;
   scString m_topic;
+  scString m_subscribeAddress; 
+  std::auto_ptr<zmq::socket_t> m_subSocket; // connected to publisher(s)
+  std::set<scString> m_topics;              // subscribed on m_subSocket
+  scStringList m_pendingTopics;             // roles registered since last pull
+  boost::mutex m_topicMutex;
+  std::auto_ptr<zmEnvelopeQueue> m_handoff; // received, I/O thread -> scheduler
+  boost::ptr_list<scEnvelope> m_handoffPending; // I/O thread only, received when m_handoff was full
+  volatile bool m_handoffFull; // I/O thread waits for scheduler
+  zmPubStreamMap m_streams;                 // sequence tracking of published msgs
+  ulong64 m_lostTotal;
+  boost::mutex m_streamMutex;
 };
 
 class zmGateOutput: public zmGate {
 public:
   zmGateOutput(zmContext *context);
   virtual ~zmGateOutput();
+  void setMaxConnections(uint value);
+  void setBackoff(uint minDelay, uint maxDelay);
+  void setPublishAddress(const scString &value);
+  void setSendBatch(uint value);
+  virtual void init();
   virtual int run();
+  virtual void getStats(scDataNode &output);
+  int pullReplies(zmConnectionOut *connection);
+  virtual void ioInit();
+  virtual int ioRun();
+  virtual void ioAddPollItems(zmPollItemList &items);
+  virtual void ioClose();
 protected:
+  int runWithIoThread();
+  void applyReceivedStats();
+  void updateStatsCopy();
+  void checkLostPeers(zmLostPeerList &output);
+  int handleLostPeers(const zmLostPeerList &peers);
+  void transmitGuarded(scEnvelope *envelope, zmSendBatchList *batches = SC_NULL);
+  bool addToBatch(zmSendBatchList &batches, std::auto_ptr<scEnvelope> &envelopeGuard);
+  void flushBatches(zmSendBatchList &batches);
+  void flushBatch(zmSendBatch &batch);
+  void reportBatchError(zmSendBatch &batch, const scError &e);
+  void reportTransmitError(scEnvelope *envelope, const scError &e);
+  void reportTransmitError(scEnvelope *envelope, int errorCode, const scString &errorMsg, const scString &details);
   void transmitEnvelope(scEnvelope *envelope);
+  bool transmitRouted(scEnvelope *envelope);
+  void transmitPublished(scEnvelope *envelope, const scString &topic);
+  scString nextSeqFrame(const scString &connectionId, const scString &topic);
+  void initPublisher();
   zmConnectionOut *findConnection(const scString &connectionId);
   zmConnectionOut *prepareConnection(const scMessageAddress &address);
+  void encodeEnvelope(const scEnvelope &envelope, scEnvSerializerBinDict *dictSerializer, scString &output);
 protected:
   scConnectionPool m_connections;    
+  zmDictSerializerMap m_routeSerializers;
+  std::auto_ptr<zmEnvelopeQueue> m_sendQueue; // to send, scheduler -> I/O thread
+  std::auto_ptr<zmEnvelopeQueue> m_replies;   // received on DEALER, I/O thread -> scheduler
+  std::auto_ptr<zmFailureQueue> m_failures;   // I/O thread -> scheduler
+  zmFailureList m_failureOverflow;            // used when m_failures is full
+  boost::mutex m_failureMutex;                // guards m_failureOverflow
+  boost::mutex m_poolMutex; // guards m_statsCopy & m_lostPeers in I/O thread mode
+  scDataNode m_statsCopy;   // I/O thread mode: pool stats for scheduler thread
+  cpu_ticks m_statsTime;    // when m_statsCopy was updated
+  scString m_publishAddress;
+  zmSocketGuard m_pubSocket; // bound PUB socket, shared by all subscribers
+  std::auto_ptr<scEnvSerializerBinDict> m_pubSerializer;
+  ulong64 m_publisherId;     // random, identifies sequence of this gate
+  zmPubSeqMap m_pubSeq;      // last sequence number per connection & topic
+  uint m_sendBatch;          // max messages per multipart send, 1 - no batching
+  ulong64 m_connGeneration;  // last generation assigned to output connection
+  zmLostPeerList m_lostPeers; // detected by I/O thread
+};
+
+/// Collects sockets of output connections for polling
+class zmPollItemCollector {
+public:
+  zmPollItemCollector(zmPollItemList &items): m_items(items) {}
+  void operator()(scConnection *connection) {
+    void *handle = static_cast<zmConnectionOut *>(connection)->getSocketHandle();
+    if (handle != SC_NULL) {
+      zmq::pollitem_t item = {handle, 0, ZMQ_POLLIN, 0};
+      m_items.push_back(item);
+    }
+  }
+protected:
+  zmPollItemList &m_items;
+};
+
+/// Collects connections which lost peer (heartbeat timeout)
+class zmLostPeerCollector {
+public:
+  zmLostPeerCollector(zmLostPeerList &output): m_output(output) {}
+  void operator()(scConnection *connection) {
+    zmConnectionOut *conn = static_cast<zmConnectionOut *>(connection);
+    if (conn->checkPeerLost())
+      m_output.push_back(zmLostPeer(conn->getConnectionId(), conn->getPeerHost()));
+  }
+protected:
+  zmLostPeerList &m_output;
+};
+
+/// Reads replies delivered back on DEALER connections
+class zmReplyPuller {
+public:
+  zmReplyPuller(zmGateOutput *gate, int &counter): m_gate(gate), m_counter(counter) {}
+  void operator()(scConnection *connection) {
+    m_counter += m_gate->pullReplies(static_cast<zmConnectionOut *>(connection));
+  }
+protected:
+  zmGateOutput *m_gate;
+  int &m_counter;
 };
 
+static bool zmHasMoreParts(zmq::socket_t &socket)
+{
+#if ZMQ_VERSION_MAJOR < 3
+  int64_t more = 0;
+#else
+  int more = 0;
+#endif
+  size_t moreSize = sizeof(more);
+  socket.getsockopt(ZMQ_RCVMORE, &more, &moreSize);
+  return (more != 0);
+}
+
+// topic frame is terminated by separator so subscription prefix match is exact
+static scString zmTopicFrame(const scString &topic)
+{
+  return topic + SC_ZMQ_TOPIC_SEP;
+}
+
+// must be called before bind / connect, options missing in used 0MQ version are skipped
+static void zmApplyKeepaliveOptions(zmq::socket_t &socket, const zmKeepaliveOptions &options)
+{
+#ifdef ZMQ_TCP_KEEPALIVE
+  if (options.tcpKeepalive >= 0) {
+    int value = options.tcpKeepalive;
+    socket.setsockopt(ZMQ_TCP_KEEPALIVE, &value, sizeof(value));
+  }
+  if (options.tcpKeepaliveIdle > 0) {
+    int value = options.tcpKeepaliveIdle;
+    socket.setsockopt(ZMQ_TCP_KEEPALIVE_IDLE, &value, sizeof(value));
+  }
+  if (options.tcpKeepaliveIntvl > 0) {
+    int value = options.tcpKeepaliveIntvl;
+    socket.setsockopt(ZMQ_TCP_KEEPALIVE_INTVL, &value, sizeof(value));
+  }
+  if (options.tcpKeepaliveCnt > 0) {
+    int value = options.tcpKeepaliveCnt;
+    socket.setsockopt(ZMQ_TCP_KEEPALIVE_CNT, &value, sizeof(value));
+  }
+#endif
+#ifdef ZMQ_HEARTBEAT_IVL
+  if (options.heartbeatIvl > 0) {
+    int value = options.heartbeatIvl;
+    socket.setsockopt(ZMQ_HEARTBEAT_IVL, &value, sizeof(value));
+  }
+  if (options.heartbeatTimeout > 0) {
+    int value = options.heartbeatTimeout;
+    socket.setsockopt(ZMQ_HEARTBEAT_TIMEOUT, &value, sizeof(value));
+  }
+  if (options.heartbeatTtl > 0) {
+    int value = options.heartbeatTtl;
+    socket.setsockopt(ZMQ_HEARTBEAT_TTL, &value, sizeof(value));
+  }
+#endif
+}
+
+// must be called before bind / connect
+static void zmApplyMulticastOptions(zmq::socket_t &socket, const zmMulticastOptions &options)
+{
+#if ZMQ_VERSION_MAJOR < 3
+  if (options.rate > 0) {
+    int64_t rate = options.rate;
+    socket.setsockopt(ZMQ_RATE, &rate, sizeof(rate));
+  }
+  if (options.recoveryIvl > 0) {
+    int64_t recoveryIvl = options.recoveryIvl;
+    socket.setsockopt(ZMQ_RECOVERY_IVL_MSEC, &recoveryIvl, sizeof(recoveryIvl));
+  }
+#else
+  if (options.rate > 0) {
+    int rate = options.rate;
+    socket.setsockopt(ZMQ_RATE, &rate, sizeof(rate));
+  }
+  if (options.recoveryIvl > 0) {
+    int recoveryIvl = options.recoveryIvl;
+    socket.setsockopt(ZMQ_RECOVERY_IVL, &recoveryIvl, sizeof(recoveryIvl));
+  }
+  if (options.hops > 0) {
+    int hops = options.hops;
+    socket.setsockopt(ZMQ_MULTICAST_HOPS, &hops, sizeof(hops));
+  }
+#endif
+}
+
+static ulong64 zmWallTimeMs()
+{
+  using namespace boost::posix_time;
+  static const ptime epoch(boost::gregorian::date(1970, 1, 1));
+  return static_cast<ulong64>((microsec_clock::universal_time() - epoch).total_milliseconds());
+}
+
+static void zmWriteUInt64(ulong64 value, char *output)
+{
+  for(int i=7; i >= 0; i--, value >>= 8)
+    output[i] = static_cast<char>(value & 0xff);
+}
+
+static ulong64 zmReadUInt64(const char *input)
+{
+  ulong64 res = 0;
+  for(int i=0; i < 8; i++)
+    res = (res << 8) | static_cast<unsigned char>(input[i]);
+  return res;
+}
+
 //----------------------------------------------------------------------------------
 // Local classes - bodies
 //----------------------------------------------------------------------------------
@@ -148,19 +624,311 @@ zmContext::zmContext()
 
 zmContext::~zmContext()
 {
+  stopIoThread();
   m_context.reset(); //DEBUG
 }
 
 void zmContext::clear()
 {
+  stopIoThread();
   m_context.reset(); 
 }
 
+zmIoThreadTransporter zmContext::prepareIoThread()
+{
+  if (m_ioThread.get() == SC_NULL) {
+    m_ioThread.reset(new zmIoThread(this));
+    m_ioThread->start();
+  }
+  return m_ioThread;
+}
+
+void zmContext::stopIoThread()
+{
+  if (m_ioThread.get() != SC_NULL) {
+    m_ioThread->stop();
+    m_ioThread.reset();
+  }
+}
+
+bool zmContext::waitForIoActivity(uint timeMs)
+{
+  if (m_ioThread.get() == SC_NULL)
+    return false;
+  m_ioThread->waitForActivity(timeMs);
+  return true;
+}
+
 zmq::context_t &zmContext::getHandle()
 {
   return *m_context;
 }
 
+void zmContext::registerRoute(const scString &connectionId, zmq::socket_t *socket, const scString &identity, bool ioThread)
+{
+  boost::mutex::scoped_lock l(m_routesMutex);
+  zmRoute &route = m_routes[connectionId];
+  route.socket = socket;
+  route.identity = identity;
+  route.lastSeen = cpu_time_ms();
+  route.ioThread = ioThread;
+}
+
+// sockets cannot be shared between threads, so route is returned only 
+// if it belongs to the same thread as the caller
+bool zmContext::findRoute(const scString &connectionId, uint maxAge, bool ioThread, zmRoute &output)
+{
+  boost::mutex::scoped_lock l(m_routesMutex);
+  zmRouteMap::iterator it = m_routes.find(connectionId);
+  if (it == m_routes.end())
+    return false;
+
+  if ((maxAge > 0) && is_cpu_time_elapsed_ms(it->second.lastSeen, maxAge))
+  {
+    m_routes.erase(it);
+    return false;
+  }
+
+  if (it->second.ioThread != ioThread)
+    return false;
+
+  output = it->second;
+  return true;
+}
+
+void zmContext::removeRoutes(zmq::socket_t *socket)
+{
+  boost::mutex::scoped_lock l(m_routesMutex);
+  zmRouteMap::iterator it = m_routes.begin();
+  while(it != m_routes.end())
+  {
+    if (it->second.socket == socket)
+      m_routes.erase(it++);
+    else
+      ++it;
+  }
+}
+
+// number of peers is limited, so traffic from not known peers does not 
+// accumulate when there is no output gate for protocol
+void zmContext::noteReceived(const scString &protocol, const scString &connectionId, ulong64 byteCount)
+{
+  boost::mutex::scoped_lock l(m_receivedMutex);
+  zmPeerReplyMap &peers = m_received[protocol];
+  zmPeerReplyMap::iterator it = peers.find(connectionId);
+  if (it == peers.end()) {
+    if (peers.size() >= SC_CONN_POOL_MAX_PEER_INFO)
+      return;
+    it = peers.insert(std::make_pair(connectionId, zmPeerReplyInfo())).first;
+  }
+  it->second.msgCount++;
+  it->second.byteCount += byteCount;
+}
+
+void zmContext::takeReceived(const scString &protocol, zmPeerReplyMap &output)
+{
+  boost::mutex::scoped_lock l(m_receivedMutex);
+  zmPeerTrafficMap::iterator it = m_received.find(protocol);
+  if (it != m_received.end())
+    output.swap(it->second);
+}
+
+//----------------------------------------------------------------------------------
+// zmIoThread
+//----------------------------------------------------------------------------------
+zmIoThread::zmIoThread(zmContext *context): m_context(context), m_running(false), 
+  m_stopRequested(false), m_activity(false)
+{
+  // inproc endpoints are local to context, there is one thread per context
+  scString wakeAddr = "inproc://grd-zmq-io-wake";
+  m_wakeRecv.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_PAIR));
+  m_wakeRecv->bind(wakeAddr.c_str());
+  m_wakeSend.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_PAIR));
+  m_wakeSend->connect(wakeAddr.c_str());
+}
+
+zmIoThread::~zmIoThread()
+{
+  stop();
+}
+
+void zmIoThread::start()
+{
+  boost::mutex::scoped_lock l(m_mutex);
+  if (m_running)
+    return;
+  m_stopRequested = false;
+  m_running = true;
+  m_thread.reset(new boost::thread(boost::bind(&zmIoThread::run, this)));
+}
+
+void zmIoThread::stop()
+{
+  {
+    boost::mutex::scoped_lock l(m_mutex);
+    if (!m_running)
+      return;
+    m_stopRequested = true;
+  }
+  wakeUp();
+  m_thread->join();
+  m_thread.reset();
+
+  boost::mutex::scoped_lock l(m_mutex);
+  m_running = false;
+  // sockets need to be closed before context is terminated
+  m_wakeSend.reset();
+  m_wakeRecv.reset();
+  // release waiting commands
+  for(zmIoCommandList::iterator it = m_commands.begin(), epos = m_commands.end(); it != epos; ++it)
+    (*it)->done = true;
+  m_commands.clear();
+  m_cmdDone.notify_all();
+}
+
+void zmIoThread::addGate(zmGate *gate)
+{
+  zmIoCommand command(gate, true);
+  executeCommand(&command);
+  if (!command.error.empty())
+    throw scError("ZMQ I/O thread - gate init failed: "+command.error);
+}
+
+void zmIoThread::removeGate(zmGate *gate)
+{
+  zmIoCommand command(gate, false);
+  executeCommand(&command);
+}
+
+void zmIoThread::executeCommand(zmIoCommand *command)
+{
+  boost::mutex::scoped_lock l(m_mutex);
+  if (!m_running) {
+    if (command->add)
+      command->error = "thread not running";
+    return;
+  }
+  m_commands.push_back(command);
+  l.unlock();
+
+  wakeUp();
+
+  l.lock();
+  while(!command->done)
+    m_cmdDone.wait(l);
+}
+
+void zmIoThread::wakeUp()
+{
+  if (m_wakeSend.get() == SC_NULL)
+    return;
+  zmq::message_t msg(0);
+  m_wakeSend->send(msg, ZMQ_NOBLOCK);
+}
+
+bool zmIoThread::waitForActivity(uint timeMs)
+{
+  boost::mutex::scoped_lock l(m_activityMutex);
+  if (!m_activity)
+    m_activityCond.timed_wait(l, boost::posix_time::milliseconds(timeMs));
+  bool res = m_activity;
+  m_activity = false;
+  return res;
+}
+
+void zmIoThread::signalActivity()
+{
+  boost::mutex::scoped_lock l(m_activityMutex);
+  m_activity = true;
+  m_activityCond.notify_one();
+}
+
+bool zmIoThread::isStopRequested()
+{
+  boost::mutex::scoped_lock l(m_mutex);
+  return m_stopRequested;
+}
+
+void zmIoThread::run()
+{
+  zmPollItemList items;
+
+  while(!isStopRequested()) 
+  {
+    processCommands();
+    performCycle(items);
+  }
+
+  closeAll();
+}
+
+void zmIoThread::processCommands()
+{
+  boost::mutex::scoped_lock l(m_mutex);
+  if (m_commands.empty())
+    return;
+
+  for(zmIoCommandList::iterator it = m_commands.begin(), epos = m_commands.end(); it != epos; ++it)
+  {
+    zmIoCommand *command = *it;
+    try {
+      if (command->add) {
+        command->gate->ioInit();
+        m_gates.push_back(command->gate);
+      } else {
+        m_gates.remove(command->gate);
+        command->gate->ioClose();
+      }  
+    }
+    catch(const std::exception& e) {
+      command->error = e.what();
+    }  
+    command->done = true;
+  }
+  m_commands.clear();
+  m_cmdDone.notify_all();
+}
+
+void zmIoThread::performCycle(zmPollItemList &items)
+{
+  items.clear();
+  zmq::pollitem_t wakeItem = {static_cast<void *>(*m_wakeRecv), 0, ZMQ_POLLIN, 0};
+  items.push_back(wakeItem);
+
+  for(zmGateList::iterator it = m_gates.begin(), epos = m_gates.end(); it != epos; ++it)
+    (*it)->ioAddPollItems(items);
+
+  zmq::poll(&items[0], items.size(), SC_ZMQ_IO_POLL_TIMEOUT * SC_ZMQ_POLL_MSEC);
+
+  if ((items[0].revents & ZMQ_POLLIN) != 0)
+  {
+    zmq::message_t msg;
+    while(m_wakeRecv->recv(&msg, ZMQ_NOBLOCK))
+      ;
+  }
+
+  int cnt = 0;
+  for(zmGateList::iterator it = m_gates.begin(), epos = m_gates.end(); it != epos; ++it)
+  {
+    try {
+      cnt += (*it)->ioRun();
+    }
+    catch(const std::exception& e) {
+      Log::addError(scString("ZMQ I/O thread - exception: ") + e.what());
+    }  
+  }
+
+  if (cnt > 0)
+    signalActivity();
+}
+
+void zmIoThread::closeAll()
+{
+  for(zmGateList::iterator it = m_gates.begin(), epos = m_gates.end(); it != epos; ++it)
+    (*it)->ioClose();
+  m_gates.clear();
+}
+
 //----------------------------------------------------------------------------------
 // zmGate
 //----------------------------------------------------------------------------------
@@ -168,7 +936,10 @@ zmGate::zmGate(zmContext *context): scMessageGate()
 {
   m_context = context;
   m_serializer.reset(new scEnvSerializerJsonYajl());
+  m_binSerializer.reset(new scEnvSerializerBinDict());
   m_inactTimeout = SC_ZMQ_DEF_INACT_CONN_TIMEOUT;
+  m_format = SC_ZMQ_FORMAT_JSON;
+  m_asyncMode = false;
 }
 
 zmGate::~zmGate()
@@ -195,6 +966,46 @@ void zmGate::setInactTimeout(uint msecs)
   m_inactTimeout = msecs;
 }
 
+void zmGate::setFormat(const scString &format)
+{
+  if ((format != SC_ZMQ_FORMAT_JSON) && (format != SC_ZMQ_FORMAT_BIN))
+    throw scError("Unknown ZMQ gate format: "+format);
+  m_format = format;
+}
+
+void zmGate::setMode(const scString &mode)
+{
+  if (mode == SC_ZMQ_MODE_ASYNC)
+    m_asyncMode = true;
+  else if (mode == SC_ZMQ_MODE_SYNC)
+    m_asyncMode = false;
+  else  
+    throw scError("Unknown ZMQ gate mode: "+mode);
+}
+
+void zmGate::setMulticastOptions(const zmMulticastOptions &options)
+{
+  m_mcastOptions = options;
+}
+
+void zmGate::setKeepaliveOptions(const zmKeepaliveOptions &options)
+{
+  m_keepaliveOptions = options;
+}
+
+void zmGate::setUseIoThread(bool value)
+{
+  if (value)
+    m_ioThread = m_context->prepareIoThread();
+  else
+    m_ioThread.reset();
+}
+
+bool zmGate::isIoThreadMode() const
+{
+  return (m_ioThread.get() != SC_NULL);
+}
+
 bool zmGate::supportsProtocol(const scString &protocol)
 {
   return (m_protocol == protocol);
@@ -218,6 +1029,44 @@ scString zmGate::extractTopic(const scString &addr)
   return topic;
 }
 
+void zmGate::startTimer(const scString &name)
+{
+  if (!isIoThreadMode())
+    Timer::start(name);
+}
+
+void zmGate::stopTimer(const scString &name)
+{
+  if (!isIoThreadMode())
+    Timer::stop(name);
+}
+
+void zmGate::incCounter(const scString &name, ulong64 value)
+{
+  if (!isIoThreadMode())
+    Counter::inc(name, value);
+}
+
+scString zmGate::getConnectionId(const scMessageAddress &address)
+{
+  scString host, topic;
+  splitTopic(address.getHost(), host, topic);
+  return address.getProtocol() + host;
+}
+
+void zmGate::decodeEnvelope(const char *data, size_t dataSize, scEnvelope &output)
+{
+  if (scEnvSerializerBinDict::isBinaryFrame(data, dataSize))
+  {
+    m_binSerializer->convFromBuffer(data, dataSize, output);
+  } else {
+    // JSON frames are sent with terminating zero
+    if ((dataSize > 0) && (data[dataSize - 1] == '\0'))
+      dataSize--;
+    m_serializer->convFromString(scString(data, dataSize), output);
+  }
+}
+
 bool zmGate::getOwnAddress(const scString &protocol, scMessageAddress &output)
 {
   bool res = false;
@@ -234,47 +1083,213 @@ bool zmGate::getOwnAddress(const scString &protocol, scMessageAddress &output)
 //----------------------------------------------------------------------------------
 // zmGateInput
 //----------------------------------------------------------------------------------
-zmGateInput::zmGateInput(zmContext *context): zmGate(context)
+zmGateInput::zmGateInput(zmContext *context): zmGate(context), m_connected(false), 
+  m_handoffFull(false), m_lostTotal(0)
 {
 }
 
 zmGateInput::~zmGateInput()
 {
+  if (isIoThreadMode()) {
+    m_ioThread->removeGate(this);
+    if (m_handoff.get() != SC_NULL) {
+      scEnvelope *envelope;
+      while(m_handoff->pop(envelope))
+        delete envelope;
+    }    
+  }  
+  ioClose();
 }
 
 void zmGateInput::init()
 {
-  scString host, topic;
-  splitTopic(m_address, host, topic); 
-  bool useSub = (!topic.empty());
+  if (isIoThreadMode()) {
+    m_handoff.reset(new zmEnvelopeQueue(SC_ZMQ_IO_QUEUE_SIZE));
+    m_ioThread->addGate(this);
+  } else {
+    initSocket();
+  }  
+}
 
-  if (useSub)
-    m_socket.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_SUB));
-  else
+void zmGateInput::ioInit()
+{
+  initSocket();
+}
+
+void zmGateInput::ioClose()
+{
+  if (m_socket.get() != SC_NULL) {
+    m_context->removeRoutes(m_socket.get());
+    m_socket.reset();
+  }  
+  m_subSocket.reset();
+  m_topics.clear();
+  m_connected = false;
+}
+
+void zmGateInput::ioAddPollItems(zmPollItemList &items)
+{
+  if (m_socket.get() != SC_NULL) {
+    zmq::pollitem_t item = {static_cast<void *>(*m_socket), 0, ZMQ_POLLIN, 0};
+    items.push_back(item);
+  }  
+  if (m_subSocket.get() != SC_NULL) {
+    zmq::pollitem_t item = {static_cast<void *>(*m_subSocket), 0, ZMQ_POLLIN, 0};
+    items.push_back(item);
+  }  
+}
+
+int zmGateInput::ioRun()
+{
+  return pullAll();
+}
+
+void zmGateInput::initSocket()
+{
+  scString host, topic;
+  splitTopic(m_address, host, topic); 
+  bool useSub = (!topic.empty());
+
+  if (useSub)
+    m_socket.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_SUB));
+  else if (m_asyncMode)
+    m_socket.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_ROUTER));
+  else
     m_socket.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_REP));
     
   try {
+    if (useSub)
+      zmApplyMulticastOptions(*m_socket, m_mcastOptions);
+    zmApplyKeepaliveOptions(*m_socket, m_keepaliveOptions);
     m_socket->bind(host.c_str());
     if (!topic.empty()) {
-      scString rawTopic(topic + SC_ZMQ_TOPIC_SEP);
-      m_socket->setsockopt(ZMQ_SUBSCRIBE, rawTopic.c_str(), rawTopic.length());
+      subscribe(*m_socket, topic);
       m_topic = topic;
     }  
+    if (!m_subscribeAddress.empty()) {
+      m_subSocket.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_SUB));
+      zmApplyMulticastOptions(*m_subSocket, m_mcastOptions);
+      zmApplyKeepaliveOptions(*m_subSocket, m_keepaliveOptions);
+      m_subSocket->connect(m_subscribeAddress.c_str());
+    }  
   } catch(...) {
+    m_subSocket.reset();
     m_socket.reset();
     throw;
   }  
+  m_connected = true;
+}
+
+void zmGateInput::setSubscribeAddress(const scString &value)
+{
+  m_subscribeAddress = value;
+}
+
+void zmGateInput::subscribe(zmq::socket_t &socket, const scString &topic)
+{
+  scString topicFrame(zmTopicFrame(topic));
+  socket.setsockopt(ZMQ_SUBSCRIBE, topicFrame.c_str(), topicFrame.length());
+}
+
+// can be called from any thread, subscription is performed by socket owner
+void zmGateInput::handleRoleRegistered(const scString &roleName)
+{
+  if (m_subscribeAddress.empty())
+    return;
+  boost::mutex::scoped_lock l(m_topicMutex);
+  m_pendingTopics.push_back(roleName);
+}
+
+void zmGateInput::applyPendingTopics()
+{
+  if (m_subSocket.get() == SC_NULL)
+    return;
+
+  scStringList topics;
+  {
+    boost::mutex::scoped_lock l(m_topicMutex);
+    if (m_pendingTopics.empty())
+      return;
+    topics.swap(m_pendingTopics);
+  }
+
+  for(scStringList::const_iterator it = topics.begin(), epos = topics.end(); it != epos; ++it)
+  {
+    if (m_topics.insert(*it).second)
+      subscribe(*m_subSocket, *it);
+  }
+}
+
+// in I/O thread mode stop reading when scheduler is not consuming
+bool zmGateInput::canHandOff()
+{
+  if (!isIoThreadMode())
+    return true;
+  m_handoffFull = (!m_handoffPending.empty() || (m_handoff->write_available() < SC_ZMQ_MAX_SEND_BATCH));
+  return !m_handoffFull;
+}
+
+// I/O thread: moves envelopes waiting for space to scheduler, in order
+int zmGateInput::flushHandOff()
+{
+  int res = 0;
+  while(!m_handoffPending.empty() && m_handoff->push(&m_handoffPending.front()))
+  {
+    m_handoffPending.pop_front().release();
+    res++;
+  }
+  return res;
 }
 
 int zmGateInput::run()
 { 
   int res = 0;
+  if (isIoThreadMode()) {
+    // envelopes already received & decoded by I/O thread
+    scEnvelope *envelope;
+    while(m_handoff->pop(envelope))
+    {
+      handleMsgReceived(*envelope);
+      put(envelope);
+      res++;
+    }
+    // I/O thread stopped reading, don't wait for its poll timeout
+    if ((res > 0) && m_handoffFull)
+      m_ioThread->wakeUp();
+  } else {
+    res = pullAll();
+  }
+  return res;
+}
+
+int zmGateInput::pullAll()
+{ 
+  int res = 0;
+  if (isIoThreadMode())
+    res += flushHandOff();
+
   if (m_connected)
   {
-    while(pull())
+    applyPendingTopics();
+    bool routed = (m_asyncMode && m_topic.empty());
+    while(canHandOff())
     {  
+      if (routed) {
+        if (!pullRouted())
+          break;
+      } else if (!m_topic.empty()) {
+        if (!pullPublished(*m_socket))
+          break;
+      } else {
+        if (!pull())
+          break;
+      }  
       res++;
     }  
+
+    if (m_subSocket.get() != SC_NULL)
+      while(canHandOff() && pullPublished(*m_subSocket))
+        res++;
   }
   return res;
 }
@@ -284,123 +1299,863 @@ bool zmGateInput::pull()
   bool res = false;
   
 #ifdef SC_TIMER_ENABLED
-  Timer::start("msg-total");
-  Timer::start("msg-execute-zmq");
+  startTimer("msg-total");
+  startTimer("msg-execute-zmq");
 #endif     
   
   zmq::message_t msg;  
   int rc = m_socket->recv(&msg, ZMQ_NOBLOCK); 
   
 #ifdef SC_TIMER_ENABLED
-  Timer::stop("msg-execute-zmq");
-  Timer::stop("msg-total");
+  stopTimer("msg-execute-zmq");
+  stopTimer("msg-total");
 #endif     
   
   if (rc) {
-    scString envelopeStr((char*) msg.data());
-    if (!m_topic.empty())
-    {
-      if (!envelopeStr.empty())
-        if (envelopeStr.substr(0, m_topic.length())+SC_ZMQ_TOPIC_SEP == m_topic+SC_ZMQ_TOPIC_SEP)
-          envelopeStr = envelopeStr.substr(m_topic.length()+SC_ZMQ_TOPIC_SEP.length());
-    }  
-    Counter::inc("msg-size", envelopeStr.length());
-    putEnvelopeStr(envelopeStr);
+    incCounter("msg-size", msg.size());
+    putPartData(msg, scString(), true);
+    // batch: each next part is a separate envelope
+    while(zmHasMoreParts(*m_socket)) {
+      zmq::message_t partMsg;  
+      m_socket->recv(&partMsg, 0);
+      incCounter("msg-size", partMsg.size());
+      putPartData(partMsg, scString(), true);
+    }
     res = true;
   }
   return res;
 }
 
-void zmGateInput::putEnvelopeStr(const scString &str)
+// SUB socket: [topic][payload], topic is already matched by 0MQ 
+// so payload is decoded directly from message buffer
+bool zmGateInput::pullPublished(zmq::socket_t &socket)
+{
+  zmq::message_t topicMsg;  
+  if (!socket.recv(&topicMsg, ZMQ_NOBLOCK))
+    return false;
+
+  if (zmHasMoreParts(socket)) {
+    zmq::message_t msg;  
+    socket.recv(&msg, 0);
+    if (zmHasMoreParts(socket)) {
+      zmq::message_t seqMsg;
+      socket.recv(&seqMsg, 0);
+      checkSequence(scString(static_cast<const char *>(topicMsg.data()), topicMsg.size()), seqMsg);
+    }
+    // skip unexpected parts
+    while(zmHasMoreParts(socket)) {
+      zmq::message_t extraMsg;  
+      socket.recv(&extraMsg, 0);
+    }  
+    incCounter("msg-size", msg.size());
+    putPartData(msg, scString());
+  }  
+  return true;
+}
+
+// detects messages lost by multicast transport (gaps in sequence)
+void zmGateInput::checkSequence(const scString &topicFrame, const zmq::message_t &seqMsg)
+{
+  if (seqMsg.size() != SC_ZMQ_SEQ_FRAME_SIZE)
+    return;
+
+  const char *data = static_cast<const char *>(seqMsg.data());
+  zmPubStreamKey key(zmReadUInt64(data), topicFrame);
+  ulong64 seq = zmReadUInt64(data + 8);
+  ulong64 sentTime = zmReadUInt64(data + 16);
+  ulong64 now = zmWallTimeMs();
+  ulong64 lost = 0;
+
+  {
+    boost::mutex::scoped_lock l(m_streamMutex);
+    zmPubStreamMap::iterator it = m_streams.find(key);
+    if (it == m_streams.end()) {
+      if (m_streams.size() >= SC_ZMQ_MAX_PUB_STREAMS)
+        return;
+      it = m_streams.insert(std::make_pair(key, zmPubStreamInfo())).first;
+    } else if (seq > it->second.lastSeq + 1) {
+      lost = seq - it->second.lastSeq - 1;
+    }
+
+    zmPubStreamInfo &info = it->second;
+    if (seq > info.lastSeq)
+      info.lastSeq = seq;
+    info.received++;
+    info.lost += lost;
+    info.lastLag = (now > sentTime)?(now - sentTime):0;
+    if (info.lastLag > info.maxLag)
+      info.maxLag = info.lastLag;
+    m_lostTotal += lost;
+  }
+
+  if (lost > 0)
+    incCounter("msg-pub-lost", lost);
+}
+
+void zmGateInput::getStats(scDataNode &output)
+{
+  std::auto_ptr<scDataNode> streamGuard;
+  std::auto_ptr<scDataNode> streamsGuard(new scDataNode());
+
+  streamsGuard->setAsList();
+  output.setAsParent();
+  output.addChild("protocol", new scDataNode(m_protocol));
+
+  boost::mutex::scoped_lock l(m_streamMutex);
+  if (m_streams.empty())
+    return;
+
+  output.addChild("lost", new scDataNode(m_lostTotal));
+
+  for(zmPubStreamMap::const_iterator it = m_streams.begin(), epos = m_streams.end(); it != epos; ++it)
+  {
+    const zmPubStreamInfo &info = it->second;
+    scString topic(it->first.second);
+    if (!topic.empty())
+      topic.erase(topic.length() - SC_ZMQ_TOPIC_SEP.length());
+    streamGuard.reset(new scDataNode(ict_parent));
+    streamGuard->addChild("publisher", new scDataNode(toString(it->first.first)));
+    streamGuard->addChild("topic", new scDataNode(topic));
+    streamGuard->addChild("received", new scDataNode(info.received));
+    streamGuard->addChild("lost", new scDataNode(info.lost));
+    streamGuard->addChild("last_seq", new scDataNode(info.lastSeq));
+    streamGuard->addChild("last_lag", new scDataNode(info.lastLag));
+    streamGuard->addChild("max_lag", new scDataNode(info.maxLag));
+    streamsGuard->addChild(streamGuard.release());
+  }
+
+  output.addChild("streams", streamsGuard.release());
+}
+
+// ROUTER socket: [identity][(empty)][payload] 
+// (empty delimiter is sent only by REQ peers)
+bool zmGateInput::pullRouted()
+{
+  zmq::message_t identity;  
+  if (!m_socket->recv(&identity, ZMQ_NOBLOCK))
+    return false;
+
+  scString identityStr(static_cast<const char *>(identity.data()), identity.size());
+  // [(empty)][payload]... - each non-empty part is an envelope (batch)
+  while(zmHasMoreParts(*m_socket))
+  {
+    zmq::message_t msg;  
+    m_socket->recv(&msg, 0);
+    if (msg.size() > 0) {
+      incCounter("msg-size", msg.size());
+      putPartData(msg, identityStr);
+    }  
+  }
+  return true;
+}
+
+// decode error of one part must not stop reading of next parts of the same 
+// message, otherwise they would be read as start of next message 
+// (e.g. payload as ROUTER identity); returns <false> if part was dropped
+bool zmGateInput::putPartData(const zmq::message_t &msg, const scString &identity, bool reply)
+{
+  try {
+    putEnvelopeData(static_cast<const char *>(msg.data()), msg.size(), identity, reply);
+    return true;
+  }
+  catch(const std::exception &e) {
+    incCounter("msg-zmq-decode-error");
+    Log::addError(scString("ZMQ message decode failed: ") + e.what());
+    // binary dictionary lost (e.g. we were restarted, DEALER reconnected 
+    // with the same session), only DEALER peers can be asked for resync
+    ulong64 sessionId;
+    if (m_binSerializer->takeResyncSession(sessionId) && !identity.empty())
+      requestResync(identity, sessionId);
+    return false;
+  }
+}
+
+void zmGateInput::requestResync(const scString &identity, ulong64 sessionId)
+{
+  scString frame;
+  scEnvSerializerBinDict::makeResyncRequest(sessionId, frame);
+
+  zmq::message_t identityMsg(identity.length());
+  memcpy(identityMsg.data(), identity.c_str(), identityMsg.size());
+  zmq::message_t msg(frame.length());
+  memcpy(msg.data(), frame.c_str(), msg.size());
+  m_socket->send(identityMsg, ZMQ_SNDMORE);
+  m_socket->send(msg);
+  incCounter("msg-zmq-resync-req");
+}
+
+// <reply> - received on sync socket, where responses to our output gate arrive
+void zmGateInput::putEnvelopeData(const char *data, size_t dataSize, const scString &identity, bool reply)
 {
   std::auto_ptr<scEnvelope> guard(new scEnvelope());
-  m_serializer->convFromString(str, *guard);
-  handleMsgReceived(*guard);
-  put(guard.release());
+  decodeEnvelope(data, dataSize, *guard);
+
+  if (!identity.empty() && (guard->getSender().getProtocol() == m_protocol))
+    m_context->registerRoute(getConnectionId(guard->getSender()), m_socket.get(), identity, isIoThreadMode());
+
+  // sync socket receives also requests of other nodes - not traffic of output gate
+  if (reply && (guard->getSender().getProtocol() == m_protocol) && 
+      (guard->getEvent() != SC_NULL) && guard->getEvent()->isResponse())
+    m_context->noteReceived(m_protocol, getConnectionId(guard->getSender()), dataSize);
+
+  if (isIoThreadMode()) {
+    // multipart batch can be longer than space checked by canHandOff, 
+    // envelope is then kept by I/O thread (in order) until scheduler frees space
+    if (m_handoffPending.empty() && m_handoff->push(guard.get()))
+      guard.release();
+    else
+      m_handoffPending.push_back(guard.release());
+  } else {
+    handleMsgReceived(*guard);
+    put(guard.release());
+  }  
 }
 
 //----------------------------------------------------------------------------------
 // zmGateOutput
 //----------------------------------------------------------------------------------
-zmGateOutput::zmGateOutput(zmContext *context): zmGate(context)
+zmGateOutput::zmGateOutput(zmContext *context): zmGate(context), m_statsTime(0), 
+  m_sendBatch(SC_ZMQ_DEF_SEND_BATCH), m_connGeneration(0)
 {
+  // unique per gate instance & restart
+  m_publisherId = (zmWallTimeMs() << 16) ^ static_cast<ulong64>(reinterpret_cast<size_t>(this));
 }
 
 zmGateOutput::~zmGateOutput()
 {
+  if (isIoThreadMode()) {
+    m_ioThread->removeGate(this);
+    scEnvelope *envelope;
+    if (m_sendQueue.get() != SC_NULL)
+      while(m_sendQueue->pop(envelope))
+        delete envelope;
+    if (m_replies.get() != SC_NULL)
+      while(m_replies->pop(envelope))
+        delete envelope;
+    zmIoFailure *failure;    
+    if (m_failures.get() != SC_NULL)
+      while(m_failures->pop(failure))
+        delete failure;
+  }
+}
+
+void zmGateOutput::init()
+{
+  if (!isIoThreadMode())
+    initPublisher();
+  else {
+    m_sendQueue.reset(new zmEnvelopeQueue(SC_ZMQ_IO_QUEUE_SIZE));
+    m_replies.reset(new zmEnvelopeQueue(SC_ZMQ_IO_QUEUE_SIZE));
+    m_failures.reset(new zmFailureQueue(SC_ZMQ_IO_QUEUE_SIZE));
+    m_ioThread->addGate(this);
+  }
 }
 
 int zmGateOutput::run()
 {
   int res = 0;
-  std::auto_ptr<scEnvelope> envelopeGuard;
+
+  if (isIoThreadMode())
+    return runWithIoThread();
     
   m_connections.checkActive();  
+  applyReceivedStats();
 
+  if (m_keepaliveOptions.usesHeartbeat()) {
+    zmLostPeerList lostPeers;
+    checkLostPeers(lostPeers);
+    res += handleLostPeers(lostPeers);
+  }
+
+  if (m_asyncMode)
+    m_connections.forEach(zmReplyPuller(this, res));
+
+  zmSendBatchList batches;
   while(!empty()) 
   {
-    envelopeGuard.reset(get());
+    transmitGuarded(get(), &batches);
     res++;
-    try {
+  } // while     
+
+  flushBatches(batches);
+  return res;
+}
+
+// scheduler side of I/O thread mode
+int zmGateOutput::runWithIoThread()
+{
+  int res = 0;
+  
+  zmIoFailure *failure;
+  while(m_failures->pop(failure))
+  {
+    std::auto_ptr<zmIoFailure> failureGuard(failure);
+    handleTransmitError(*failure->envelope, failure->status, failure->msg, failure->details);
+    res++;
+  }
+
+  zmFailureList overflow;
+  {
+    boost::mutex::scoped_lock l(m_failureMutex);
+    overflow.transfer(overflow.end(), m_failureOverflow);
+  }  
+  if (!overflow.empty())
+    Counter::inc("msg-zmq-failure-overflow", overflow.size());
+  for(zmFailureList::iterator it = overflow.begin(), epos = overflow.end(); it != epos; ++it)
+  {
+    handleTransmitError(*it->envelope, it->status, it->msg, it->details);
+    res++;
+  }
+
+  scEnvelope *envelope;
+  while(m_replies->pop(envelope))
+  {
+    handleMsgReceived(*envelope);
+    getOwner()->postEnvelopeForThis(envelope);
+    res++;
+  }
+
+  int sentCnt = 0;
+  while(!empty() && (m_sendQueue->write_available() > 0)) 
+  {
+    envelope = get();
+    handleMsgReadyForSend(*envelope);
+    m_sendQueue->push(envelope);
+    sentCnt++;
+  }
+
+  if (sentCnt > 0)
+    m_ioThread->wakeUp();
+
+  if (m_keepaliveOptions.usesHeartbeat()) {
+    zmLostPeerList lostPeers;
+    {
+      boost::mutex::scoped_lock l(m_poolMutex);
+      lostPeers.swap(m_lostPeers);
+    }  
+    res += handleLostPeers(lostPeers);
+  }
+
+  return res + sentCnt;
+}
+
+// in sync mode replies are received by input gate, it's traffic is 
+// passed here to measure latency of peers
+void zmGateOutput::applyReceivedStats()
+{
+  if (m_asyncMode)
+    return;
+
+  zmPeerReplyMap received;
+  m_context->takeReceived(m_protocol, received);
+  for(zmPeerReplyMap::const_iterator it = received.begin(), epos = received.end(); it != epos; ++it)
+    m_connections.signalReceived(it->first, it->second.byteCount, static_cast<uint>(it->second.msgCount));
+}
+
+// removes connections with lost peer from pool
+void zmGateOutput::checkLostPeers(zmLostPeerList &output)
+{
+  m_connections.forEach(zmLostPeerCollector(output));
+  for(zmLostPeerList::const_iterator it = output.begin(), epos = output.end(); it != epos; ++it)
+    m_connections.signalFailure(it->connectionId);
+}
+
+// scheduler thread only - posts core.peer_down
+int zmGateOutput::handleLostPeers(const zmLostPeerList &peers)
+{
+  int res = 0;
+  for(zmLostPeerList::const_iterator it = peers.begin(), epos = peers.end(); it != epos; ++it)
+  {
+    Log::addWarning("ZMQ peer lost (heartbeat): "+it->host);
+    signalPeerDown(m_protocol, it->host, "heartbeat");
+    res++;
+  }
+  return res;
+}
+
+void zmGateOutput::setPublishAddress(const scString &value)
+{
+  m_publishAddress = value;
+}
+
+void zmGateOutput::initPublisher()
+{
+  if (m_publishAddress.empty())
+    return;
+
+  m_pubSocket.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_PUB));
+  try {
+    zmApplyMulticastOptions(*m_pubSocket, m_mcastOptions);
+    zmApplyKeepaliveOptions(*m_pubSocket, m_keepaliveOptions);
+    m_pubSocket->bind(m_publishAddress.c_str());
+  } catch(...) {
+    m_pubSocket.reset();
+    throw;
+  }  
+
+  m_pubSerializer.reset(new scEnvSerializerBinDict());
+  m_pubSerializer->setSelfContained(true);
+}
+
+void zmGateOutput::ioInit()
+{
+  initPublisher();
+}
+
+void zmGateOutput::setMaxConnections(uint value)
+{
+  m_connections.setMaxSize(value);
+}
+
+void zmGateOutput::setBackoff(uint minDelay, uint maxDelay)
+{
+  m_connections.setBackoff(minDelay, maxDelay);
+}
+
+void zmGateOutput::setSendBatch(uint value)
+{
+  if (value > SC_ZMQ_MAX_SEND_BATCH)
+    m_sendBatch = SC_ZMQ_MAX_SEND_BATCH;
+  else if (value == 0)
+    m_sendBatch = 1;
+  else
+    m_sendBatch = value;
+}
+
+// in I/O thread mode pool is used only by I/O thread, 
+// stats are taken from its copy
+void zmGateOutput::getStats(scDataNode &output)
+{
+  if (isIoThreadMode()) {
+    boost::mutex::scoped_lock l(m_poolMutex);
+    output = m_statsCopy;
+  } else {
+    m_connections.getStats(output);
+  }
+  output.setElementSafe("protocol", scDataNode(m_protocol));
+}
+
+void zmGateOutput::updateStatsCopy()
+{
+  if ((m_statsTime != 0) && !is_cpu_time_elapsed_ms(m_statsTime, SC_ZMQ_STATS_INTERVAL))
+    return;
+  m_statsTime = cpu_time_ms();
+
+  scDataNode stats;
+  m_connections.getStats(stats);
+  boost::mutex::scoped_lock l(m_poolMutex);
+  m_statsCopy = stats;
+}
+
+// pool is not locked, scheduler thread uses only copy of its stats
+int zmGateOutput::ioRun()
+{
+  int res = 0;
+    
+  m_connections.checkActive();  
+  applyReceivedStats();
+
+  if (m_keepaliveOptions.usesHeartbeat()) {
+    zmLostPeerList lostPeers;
+    checkLostPeers(lostPeers);
+    if (!lostPeers.empty()) {
+      boost::mutex::scoped_lock l(m_poolMutex);
+      m_lostPeers.splice(m_lostPeers.end(), lostPeers);
+    }
+  }
+
+  if (m_asyncMode)
+    m_connections.forEach(zmReplyPuller(this, res));
+
+  zmSendBatchList batches;
+  scEnvelope *envelope;
+  while(m_sendQueue->pop(envelope)) 
+  {
+    transmitGuarded(envelope, &batches);
+    res++;
+  }
+
+  flushBatches(batches);
+  updateStatsCopy();
+  return res;
+}
+
+void zmGateOutput::ioAddPollItems(zmPollItemList &items)
+{
+  if (m_asyncMode)
+    m_connections.forEach(zmPollItemCollector(items));
+}
+
+void zmGateOutput::ioClose()
+{
+  m_connections.clear();
+  m_routeSerializers.clear();
+  m_pubSocket.reset();
+  boost::mutex::scoped_lock l(m_poolMutex);
+  m_lostPeers.clear();
+}
+
+// takes ownership of envelope, if <batches> are provided envelope 
+// can be only encoded & sent later with flushBatches
+void zmGateOutput::transmitGuarded(scEnvelope *envelope, zmSendBatchList *batches)
+{
+  std::auto_ptr<scEnvelope> envelopeGuard(envelope);
+
+  try {
+    if ((batches == SC_NULL) || !addToBatch(*batches, envelopeGuard))
       transmitEnvelope(envelopeGuard.get());
+  }
+  catch (scError &e) {
+    e.addDetails("out-addr", scDataNode(envelopeGuard->getReceiver().getAsString())); 
+    reportTransmitError(envelopeGuard.release(), e);
+  }      
+  catch(const std::exception& e) {
+    scString msg = scString("0MQ-Transmit - exception (std): ") + e.what();
+    scString dets = scString("out-addr: ") + envelopeGuard->getReceiver().getAsString();
+    reportTransmitError(envelopeGuard.release(), SC_MSG_STATUS_EXCEPTION, msg, dets);
+  }  
+  catch(...) {
+    scString msg = scString("0MQ-Transmit - exception (unknown)");
+    scString dets = scString("out-addr: ") + envelopeGuard->getReceiver().getAsString();
+    reportTransmitError(envelopeGuard.release(), SC_MSG_STATUS_EXCEPTION, msg, dets);
+  }  
+}
+
+// encodes envelope into batch of it's connection, published & routed
+// messages are not batched, returns <true> if envelope was taken
+bool zmGateOutput::addToBatch(zmSendBatchList &batches, std::auto_ptr<scEnvelope> &envelopeGuard)
+{
+  if (m_sendBatch <= 1)
+    return false;
+
+  const scMessageAddress &receiver = envelopeGuard->getReceiver();
+  if (!extractTopic(receiver.getHost()).empty())
+    return false;
+
+  scString connectionId = getConnectionId(receiver);
+  zmRoute route;
+  if (m_asyncMode && m_context->findRoute(connectionId, m_inactTimeout, isIoThreadMode(), route))
+    return false;
+
+  zmConnectionOut *item = prepareConnection(receiver);
+  if (item == SC_NULL)
+    throw scError("zmq gate.execute failed - connection failed");
+
+  // connection (with it's dictionary) can't be evicted by pool limit 
+  // until batches are sent, see flushBatches
+  m_connections.pin(connectionId);
+
+  scString dataStr;  
+  encodeEnvelope(*envelopeGuard, &item->getDictSerializer(), dataStr);
+
+  // last batch of connection keeps order of messages
+  zmSendBatch *batch = SC_NULL;
+  for(zmSendBatchList::reverse_iterator it = batches.rbegin(), epos = batches.rend(); it != epos; ++it)
+    if ((it->connectionId == connectionId) && (it->generation == item->getGeneration())) {
+      batch = &(*it);
+      break;
+    }
+
+  if ((batch == SC_NULL) || (batch->frames.size() >= m_sendBatch) || (batch->dataSize + dataStr.length() >= SC_ZMQ_MAX_MSG_SIZE)) {
+    batches.push_back(new zmSendBatch(connectionId, item->getGeneration()));
+    batch = &batches.back();
+  }  
+
+  // JSON is sent with terminating zero
+  batch->dataSize += (m_format == SC_ZMQ_FORMAT_BIN)?dataStr.length():dataStr.length()+1;
+  batch->frames.push_back(scString());
+  batch->frames.back().swap(dataStr);
+  batch->envelopes.push_back(envelopeGuard);
+  return true;
+}
+
+void zmGateOutput::flushBatches(zmSendBatchList &batches)
+{
+  for(zmSendBatchList::iterator it = batches.begin(), epos = batches.end(); it != epos; ++it)
+  {
+    try {
+      flushBatch(*it);
     }
     catch (scError &e) {
-      e.addDetails("out-addr", scDataNode(envelopeGuard->getReceiver().getAsString())); 
-      handleTransmitError(*envelopeGuard.get(), e);
+      e.addDetails("out-conn", scDataNode(it->connectionId)); 
+      reportBatchError(*it, e);
     }      
     catch(const std::exception& e) {
-      scString msg = scString("0MQ-Transmit - exception (std): ") + e.what();
-      scString dets = scString("out-addr: ") + envelopeGuard->getReceiver().getAsString();
-      handleTransmitError(*envelopeGuard.get(), SC_MSG_STATUS_EXCEPTION, msg, dets);
+      reportBatchError(*it, scError(scString("0MQ-Transmit - exception (std): ") + e.what()));
     }  
     catch(...) {
-      scString msg = scString("0MQ-Transmit - exception (unknown)");
-      scString dets = scString("out-addr: ") + envelopeGuard->getReceiver().getAsString();
-      handleTransmitError(*envelopeGuard.get(), SC_MSG_STATUS_EXCEPTION, msg, dets);
+      reportBatchError(*it, scError("0MQ-Transmit - exception (unknown)"));
     }  
-  } // while     
+  }
+  batches.clear();
+  m_connections.unpinAll();
+}
 
+// one multipart send per connection, accounting per batch
+void zmGateOutput::flushBatch(zmSendBatch &batch)
+{
+  zmConnectionOut *item = findConnection(batch.connectionId);
+  if ((item == SC_NULL) || (item->getGeneration() != batch.generation)) {
+    // closed after failure of previous batch, frames use dictionary of 
+    // closed connection - encode again for new one, all later batches
+    // of this connection have old generation too, so order is kept
+    while(!batch.envelopes.empty())
+      transmitGuarded(batch.envelopes.pop_front().release());
+    return;
+  }
+
+  if (!isIoThreadMode()) // msg trace is not thread-safe
+    for(boost::ptr_list<scEnvelope>::iterator it = batch.envelopes.begin(), epos = batch.envelopes.end(); it != epos; ++it)
+      handleMsgReadyForSend(*it);
+
+#ifdef SC_TIMER_ENABLED
+  startTimer("msg-total");
+  startTimer("msg-execute-zmq");
+#endif     
+
+  try {
+    item->sendMultipart(batch.frames, (m_format == SC_ZMQ_FORMAT_BIN)?0:1);
+  } 
+  catch(...) {
+    // closes connection (with dictionary) & delays reconnect
+    m_connections.signalFailure(batch.connectionId);
+    throw;  
+  }  
+
+#ifdef SC_TIMER_ENABLED
+  stopTimer("msg-execute-zmq");
+  stopTimer("msg-total");
+#endif     
+
+  m_connections.signalSent(batch.connectionId, batch.dataSize, batch.envelopes.size());
+  incCounter("msg-total", batch.envelopes.size());
+  incCounter("msg-size", batch.dataSize);
+  incCounter("msg-batch");
+
+  if (!isIoThreadMode()) // msg trace is not thread-safe
+    for(boost::ptr_list<scEnvelope>::iterator it = batch.envelopes.begin(), epos = batch.envelopes.end(); it != epos; ++it)
+      handleMsgSent(*it);
+}
+
+// multipart message is delivered completely or not at all
+void zmGateOutput::reportBatchError(zmSendBatch &batch, const scError &e)
+{
+  while(!batch.envelopes.empty())
+    reportTransmitError(batch.envelopes.pop_front().release(), e);
+}
+
+void zmGateOutput::reportTransmitError(scEnvelope *envelope, const scError &e)
+{
+  int error = e.getErrorCode();
+  if (error == 0)
+    error = SC_RESP_STATUS_TRANSMIT_ERROR;
+  reportTransmitError(envelope, error, 
+    "Unknown transmit error["+toString(error)+"]: "+e.what(), e.getDetails());
+}
+
+// takes ownership of envelope
+void zmGateOutput::reportTransmitError(scEnvelope *envelope, int errorCode, const scString &errorMsg, const scString &details)
+{
+  std::auto_ptr<scEnvelope> envelopeGuard(envelope);
+
+  if (!isIoThreadMode()) {
+    handleTransmitError(*envelope, errorCode, errorMsg, details);
+  } else {
+    // error response has to be created in scheduler thread
+    std::auto_ptr<zmIoFailure> failureGuard(new zmIoFailure(envelopeGuard.release(), errorCode, errorMsg, details));
+    if (m_failures->push(failureGuard.get())) {
+      failureGuard.release();
+    } else {
+      // each failure has to be reported, requestor waits for response
+      boost::mutex::scoped_lock l(m_failureMutex);
+      m_failureOverflow.push_back(failureGuard.release());
+    }  
+  }  
+}
+
+int zmGateOutput::pullReplies(zmConnectionOut *connection)
+{
+  int res = 0;
+  zmq::message_t msg;
+  
+  while((!isIoThreadMode() || (m_replies->write_available() > 0)) && connection->receive(msg))
+  {
+    if (msg.size() == 0)
+      continue;
+    ulong64 sessionId;
+    if (scEnvSerializerBinDict::isResyncRequest(static_cast<const char *>(msg.data()), msg.size(), sessionId)) {
+      // next frame starts new dictionary
+      if (connection->getDictSerializer().handleResyncRequest(sessionId))
+        incCounter("msg-zmq-resync");
+      continue;
+    }
+    m_connections.signalReceived(connection->getConnectionId(), msg.size());
+    std::auto_ptr<scEnvelope> guard(new scEnvelope());
+    decodeEnvelope(static_cast<const char *>(msg.data()), msg.size(), *guard);
+    if (isIoThreadMode()) {
+      m_replies->push(guard.release());
+    } else {
+      handleMsgReceived(*guard);
+      getOwner()->postEnvelopeForThis(guard.release());
+    }  
+    res++;
+  }
   return res;
 }
 
+// throws if message is too long, dictionary is then left as before the call
+// (receiver never sees the frame)
+void zmGateOutput::encodeEnvelope(const scEnvelope &envelope, scEnvSerializerBinDict *dictSerializer, scString &output)
+{
+  if (m_format == SC_ZMQ_FORMAT_BIN)
+    dictSerializer->convToString(envelope, output); 
+  else
+    m_serializer->convToString(envelope, output); 
+
+  if (output.length() >= SC_ZMQ_MAX_MSG_SIZE) {
+    if (m_format == SC_ZMQ_FORMAT_BIN)
+      dictSerializer->rollbackFrame();
+    throw scError("ZMQ message too long ("+toString(output.length())+")");
+  }  
+}
+
+// send using ROUTER socket of peer that is connected to us
+bool zmGateOutput::transmitRouted(scEnvelope *envelope)
+{
+  zmRoute route;
+  scString connectionId = getConnectionId(envelope->getReceiver());
+
+  if (!m_context->findRoute(connectionId, m_inactTimeout, isIoThreadMode(), route))
+    return false;
+
+  zmDictSerializerMap::iterator it = m_routeSerializers.find(connectionId);
+  if (it == m_routeSerializers.end())
+    it = m_routeSerializers.insert(connectionId, new scEnvSerializerBinDict()).first;
+
+  scString dataStr;  
+  encodeEnvelope(*envelope, it->second, dataStr);
+  size_t dataSize = (m_format == SC_ZMQ_FORMAT_BIN)?dataStr.length():dataStr.length()+1;
+
+  incCounter("msg-size", dataSize);
+  incCounter("msg-total");
+
+  if (!isIoThreadMode()) // msg trace is not thread-safe
+    handleMsgReadyForSend(*envelope);
+  try {
+    zmq::message_t identityMsg(route.identity.length());
+    memcpy(identityMsg.data(), route.identity.c_str(), identityMsg.size());
+    zmq::message_t msg(dataSize);
+    memcpy(msg.data(), dataStr.c_str(), dataSize);
+    route.socket->send(identityMsg, ZMQ_SNDMORE);
+    route.socket->send(msg);
+  }
+  catch(...) {
+    it->second->resetDictionary();
+    throw;
+  }
+  m_connections.signalSent(connectionId, dataSize);
+  if (!isIoThreadMode()) // msg trace is not thread-safe
+    handleMsgSent(*envelope);
+  return true;
+}
+
+// one encode & one send for all subscribers of topic
+void zmGateOutput::transmitPublished(scEnvelope *envelope, const scString &topic)
+{
+  scString dataStr;  
+  encodeEnvelope(*envelope, m_pubSerializer.get(), dataStr);
+  size_t dataSize = (m_format == SC_ZMQ_FORMAT_BIN)?dataStr.length():dataStr.length()+1;
+
+  incCounter("msg-size", dataSize);
+  incCounter("msg-total");
+
+  if (!isIoThreadMode()) // msg trace is not thread-safe
+    handleMsgReadyForSend(*envelope);
+
+  scString topicFrame(zmTopicFrame(topic));
+  zmq::message_t topicMsg(topicFrame.length());
+  memcpy(topicMsg.data(), topicFrame.c_str(), topicMsg.size());
+  zmq::message_t msg(dataSize);
+  memcpy(msg.data(), dataStr.c_str(), dataSize);
+  scString seqFrame(nextSeqFrame("", topic));
+  zmq::message_t seqMsg(seqFrame.length());
+  memcpy(seqMsg.data(), seqFrame.c_str(), seqMsg.size());
+  m_pubSocket->send(topicMsg, ZMQ_SNDMORE);
+  m_pubSocket->send(msg, ZMQ_SNDMORE);
+  m_pubSocket->send(seqMsg);
+
+  if (!isIoThreadMode()) // msg trace is not thread-safe
+    handleMsgSent(*envelope);
+}
+
+// sequence frame: [publisher-id][seq][send time (ms)], 8 bytes each,
+// used by subscribers to detect lost messages & measure lag;
+// each subscriber sees only messages sent to it's connection, so
+// sequence is counted per connection (empty - bound PUB socket) & topic
+scString zmGateOutput::nextSeqFrame(const scString &connectionId, const scString &topic)
+{
+  char buffer[SC_ZMQ_SEQ_FRAME_SIZE];
+  ulong64 seq = ++m_pubSeq[connectionId + " " + topic];
+  zmWriteUInt64(m_publisherId, buffer);
+  zmWriteUInt64(seq, buffer + 8);
+  zmWriteUInt64(zmWallTimeMs(), buffer + 16);
+  return scString(buffer, SC_ZMQ_SEQ_FRAME_SIZE);
+}
+
 void zmGateOutput::transmitEnvelope(scEnvelope *envelope)
 {
   scString dataStr;  
+  scString topic = extractTopic(envelope->getReceiver().getHost());
+
+  if (!topic.empty() && (m_pubSocket.get() != SC_NULL)) {
+    transmitPublished(envelope, topic);
+    return;
+  }  
+
+  if (m_asyncMode && topic.empty() && transmitRouted(envelope))
+    return;
 
-  m_serializer->convToString(*envelope, dataStr); 
-  
   zmConnectionOut *item = prepareConnection(envelope->getReceiver());
   if (item == SC_NULL)
     throw scError("zmq gate.execute failed - connection failed");
       
   if (item) {    
-     scString topic = extractTopic(envelope->getReceiver().getHost());
-     if (!topic.empty())
-       dataStr = topic + SC_ZMQ_TOPIC_SEP + dataStr;
-
-     if (dataStr.length() >= SC_ZMQ_MAX_MSG_SIZE)
-       throw scError("ZMQ message too long ("+toString(dataStr.length())+")");
+     bool binFormat = (m_format == SC_ZMQ_FORMAT_BIN);
+     encodeEnvelope(*envelope, &item->getDictSerializer(), dataStr);
        
-     Counter::inc("msg-size", dataStr.length());
-       
-     scChar data[SC_ZMQ_MAX_MSG_SIZE];
-     //wxStrncpy(data, dataStr.c_str(), dataStr.length()+1);
-     strncpy(data, dataStr.c_str(), dataStr.length()+1);
+     incCounter("msg-size", dataStr.length());
+     
+     // JSON is sent with terminating zero
+     size_t dataSize = binFormat?dataStr.length():dataStr.length()+1;
      
-  Counter::inc("msg-total");
+  incCounter("msg-total");
      
 #ifdef SC_TIMER_ENABLED
-  Timer::start("msg-total");
-  Timer::start("msg-execute-zmq");
+  startTimer("msg-total");
+  startTimer("msg-execute-zmq");
 #endif     
 
-  handleMsgReadyForSend(*envelope);
-  item->send(data, (dataStr.length()+1)*sizeof(scChar));
-  handleMsgSent(*envelope);
+  if (!isIoThreadMode()) // msg trace is not thread-safe
+    handleMsgReadyForSend(*envelope);
+  scString connectionId = item->getConnectionId();
+  try {
+    if (topic.empty())
+      item->send(dataStr.c_str(), dataSize);
+    else
+      item->send(zmTopicFrame(topic), dataStr.c_str(), dataSize, nextSeqFrame(connectionId, topic));
+  } 
+  catch(...) {
+    // closes connection (with dictionary) & delays reconnect
+    m_connections.signalFailure(connectionId);
+    throw;  
+  }  
+  m_connections.signalSent(connectionId, dataSize);
+  if (!isIoThreadMode()) // msg trace is not thread-safe
+    handleMsgSent(*envelope);
 
 #ifdef SC_TIMER_ENABLED
-  Timer::stop("msg-execute-zmq");
-  Timer::stop("msg-total");
+  stopTimer("msg-execute-zmq");
+  stopTimer("msg-total");
 #endif     
   }
   else
@@ -414,7 +2169,7 @@ zmConnectionOut *zmGateOutput::prepareConnection(const scMessageAddress &address
   
   splitTopic(rawHost, host, topic);
   
-  scString connectionId = address.getProtocol() + host;
+  scString connectionId = getConnectionId(address);
   scString connectionStr;
   
   if (m_address.empty())
@@ -425,19 +2180,43 @@ zmConnectionOut *zmGateOutput::prepareConnection(const scMessageAddress &address
   zmConnectionOut *item = findConnection(connectionId);
   if (item == SC_NULL)
   {
+    if (!m_connections.canConnect(connectionId))
+      throw scError("ZMQ peer unavailable (reconnect back-off): "+host);
+      
     std::auto_ptr<zmConnectionOut> connGuard;
     connGuard.reset(new zmConnectionOut(this->m_context));
+    connGuard->setConnectionId(connectionId);
+    connGuard->setMulticastOptions(m_mcastOptions);
+    connGuard->setKeepaliveOptions(m_keepaliveOptions);
+    connGuard->setPeerHost(host);
+    connGuard->setGeneration(++m_connGeneration);
 #ifdef SC_TIMER_ENABLED
-  Timer::start("msg-total");
-  Timer::start("msg-connect-zmq");
+  startTimer("msg-total");
+  startTimer("msg-connect-zmq");
 #endif    
-    connGuard.get()->connect(connectionStr, !topic.empty());
+    int socketType;
+    if (!topic.empty())
+      socketType = ZMQ_PUB;
+    else if (m_asyncMode)
+      socketType = ZMQ_DEALER;
+    else
+      socketType = ZMQ_REQ;
+    try {
+      connGuard.get()->connect(connectionStr, socketType);
+    }
+    catch(...) {
+      m_connections.signalFailure(connectionId);
+      throw;
+    }
 #ifdef SC_TIMER_ENABLED
-  Timer::stop("msg-connect-zmq");
-  Timer::stop("msg-total");
+  stopTimer("msg-connect-zmq");
+  stopTimer("msg-total");
 #endif    
     item = connGuard.get();
     item->setInactTimeout(this->m_inactTimeout);
+    // subscribers can join at any time
+    if (socketType == ZMQ_PUB)
+      item->getDictSerializer().setSelfContained(true);
     m_connections.add(connectionId, connGuard.release());    
   }
   return item;
@@ -452,7 +2231,7 @@ zmConnectionOut *zmGateOutput::findConnection(const scString &connectionId)
 //----------------------------------------------------------------------------------
 // zmConnectionOut
 //----------------------------------------------------------------------------------
-zmConnectionOut::zmConnectionOut(zmContext *context): scConnection(), m_context(context)
+zmConnectionOut::zmConnectionOut(zmContext *context): scConnection(), m_generation(0), m_context(context)
 {
 }
 
@@ -465,18 +2244,22 @@ bool zmConnectionOut::isConnected()
   return (m_socket.get() != SC_NULL);
 }
 
-bool zmConnectionOut::connect(const scString &address, bool usePublish)
+bool zmConnectionOut::connect(const scString &address, int socketType)
 {
   bool res = isConnected();
   if (!res) {
-    if (usePublish)
-      m_socket.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_PUB));
-    else  
-      m_socket.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_REQ));
+    m_socket.reset(new zmq::socket_t(m_context->getHandle(), socketType));
     try {
+      if (!m_mcastOptions.isEmpty())
+        zmApplyMulticastOptions(*m_socket, m_mcastOptions);
+      if (!m_keepaliveOptions.isEmpty())
+        zmApplyKeepaliveOptions(*m_socket, m_keepaliveOptions);
+      if (m_keepaliveOptions.usesHeartbeat())
+        startMonitor();
       m_socket->connect(address.c_str());
     } 
     catch(...) {
+      stopMonitor();
       m_socket.reset();
       throw;
     }  
@@ -490,17 +2273,83 @@ void zmConnectionOut::close()
 {
   if (isConnected())
   {
+    stopMonitor();
     m_socket.reset();
   }
 }
 
+// monitor is PAIR socket connected to inproc endpoint unique for connection
+// instance (address of object can be reused after it is deleted)
+void zmConnectionOut::startMonitor()
+{
+#if ZMQ_VERSION_MAJOR >= 4
+  stopMonitor();
+  scString endpoint = "inproc://grd-mon-"+toString(static_cast<ulong64>(reinterpret_cast<size_t>(this)))+
+    "-"+toString(m_generation);
+  if (zmq_socket_monitor(static_cast<void *>(*m_socket), endpoint.c_str(), ZMQ_EVENT_DISCONNECTED) != 0)
+    throw scError("ZMQ socket monitor failed: "+m_connectionId);
+  m_monitor.reset(new zmq::socket_t(m_context->getHandle(), ZMQ_PAIR));
+  m_monitor->connect(endpoint.c_str());
+#endif
+}
+
+// socket stops sending events, so monitor can be started again
+void zmConnectionOut::stopMonitor()
+{
+  if (m_monitor.get() == SC_NULL)
+    return;
+#if ZMQ_VERSION_MAJOR >= 4
+  if (m_socket.get() != SC_NULL)
+    zmq_socket_monitor(static_cast<void *>(*m_socket), NULL, 0);
+#endif
+  m_monitor.reset();
+}
+
+// returns <true> if peer disconnected since last check
+bool zmConnectionOut::checkPeerLost()
+{
+  bool res = false;
+  if (m_monitor.get() == SC_NULL)
+    return res;
+  
+  // event: frame 1 - event id (2 bytes) & value (4 bytes), frame 2 - endpoint  
+  zmq::message_t msg;
+  while(m_monitor->recv(&msg, ZMQ_NOBLOCK)) 
+  {
+    if (msg.size() >= sizeof(uint16_t)) {
+      uint16_t eventId;
+      memcpy(&eventId, msg.data(), sizeof(eventId));
+      if (eventId == ZMQ_EVENT_DISCONNECTED)
+        res = true;
+    }    
+    while(zmHasMoreParts(*m_monitor))
+      m_monitor->recv(&msg);
+  }
+  return res;
+}
+
+void zmConnectionOut::setPeerHost(const scString &value)
+{
+  m_peerHost = value;
+}
+
+const scString &zmConnectionOut::getPeerHost() const
+{
+  return m_peerHost;
+}
+
+void zmConnectionOut::setKeepaliveOptions(const zmKeepaliveOptions &options)
+{
+  m_keepaliveOptions = options;
+}
+
 void zmConnectionOut::checkConnected()
 {
   if (!isConnected())
     throw scError("ZMQ connection not active!");
 }
 
-void zmConnectionOut::send(char *ptr, size_t asize)
+void zmConnectionOut::send(const char *ptr, size_t asize)
 {
   checkConnected();
   zmq::message_t msg (asize);      
@@ -509,6 +2358,66 @@ void zmConnectionOut::send(char *ptr, size_t asize)
   signalUsed();
 }
 
+void zmConnectionOut::send(const scString &topicFrame, const char *ptr, size_t asize, const scString &seqFrame)
+{
+  checkConnected();
+  zmq::message_t topicMsg(topicFrame.length());
+  memcpy(topicMsg.data(), topicFrame.c_str(), topicMsg.size());
+  zmq::message_t msg (asize);      
+  memcpy(msg.data(), ptr, msg.size()); 
+  zmq::message_t seqMsg(seqFrame.length());
+  memcpy(seqMsg.data(), seqFrame.c_str(), seqMsg.size());
+  m_socket->send(topicMsg, ZMQ_SNDMORE);
+  m_socket->send(msg, ZMQ_SNDMORE);
+  m_socket->send(seqMsg);
+  signalUsed();
+}
+
+// each frame is one message part, <extraSize> - bytes of terminating zero
+void zmConnectionOut::sendMultipart(const std::vector<scString> &frames, size_t extraSize)
+{
+  checkConnected();
+  for(size_t i=0, cnt = frames.size(); i < cnt; i++)
+  {
+    zmq::message_t msg(frames[i].length() + extraSize);
+    memcpy(msg.data(), frames[i].c_str(), msg.size()); 
+    m_socket->send(msg, (i + 1 < cnt)?ZMQ_SNDMORE:0);
+  }
+  signalUsed();
+}
+
+void zmConnectionOut::setMulticastOptions(const zmMulticastOptions &options)
+{
+  m_mcastOptions = options;
+}
+
+void zmConnectionOut::setConnectionId(const scString &value)
+{
+  m_connectionId = value;
+}
+
+const scString &zmConnectionOut::getConnectionId() const
+{
+  return m_connectionId;
+}
+
+bool zmConnectionOut::receive(zmq::message_t &msg)
+{
+  if (!isConnected())
+    return false;
+  bool res = m_socket->recv(&msg, ZMQ_NOBLOCK);
+  if (res)
+    signalUsed();
+  return res;
+}
+
+scEnvSerializerBinDict &zmConnectionOut::getDictSerializer()
+{
+  if (m_dictSerializer.get() == SC_NULL)
+    m_dictSerializer.reset(new scEnvSerializerBinDict());
+  return *m_dictSerializer;
+}
+
 //----------------------------------------------------------------------------------
 // zmGateFactory
 //----------------------------------------------------------------------------------
@@ -538,6 +2447,54 @@ scMessageGate *zmGateFactory::createGate(bool input, const scDataNode &params, c
       static_cast<zmGateOutput *>(res.get())->setInactTimeout(timeout);  
     }  
   }  
+
+  if (params.hasChild("format"))
+    res->setFormat(params.getString("format"));
+
+  if (params.hasChild("mode"))
+    res->setMode(params.getString("mode"));
+
+  if (params.hasChild("io_thread"))
+    res->setUseIoThread(params.getBool("io_thread"));
+
+  if (params.hasChild("rate") || params.hasChild("recovery_ivl") || params.hasChild("multicast_hops")) {
+    zmMulticastOptions options;
+    options.rate = params.getUInt("rate", 0);
+    options.recoveryIvl = params.getUInt("recovery_ivl", 0);
+    options.hops = params.getUInt("multicast_hops", 0);
+    res->setMulticastOptions(options);
+  }
+
+  if (params.hasChild("heartbeat_ivl") || params.hasChild("tcp_keepalive")) {
+    zmKeepaliveOptions options;
+    options.heartbeatIvl = params.getUInt("heartbeat_ivl", 0);
+    options.heartbeatTimeout = params.getUInt("heartbeat_timeout", 0);
+    options.heartbeatTtl = params.getUInt("heartbeat_ttl", 0);
+    if (params.hasChild("tcp_keepalive"))
+      options.tcpKeepalive = params.getBool("tcp_keepalive")?1:0;
+    options.tcpKeepaliveIdle = params.getUInt("tcp_keepalive_idle", 0);
+    options.tcpKeepaliveIntvl = params.getUInt("tcp_keepalive_intvl", 0);
+    options.tcpKeepaliveCnt = params.getUInt("tcp_keepalive_cnt", 0);
+    res->setKeepaliveOptions(options);
+  }
+
+  if (!input) {
+    zmGateOutput *output = static_cast<zmGateOutput *>(res.get());
+    if (params.hasChild("max_connections"))
+      output->setMaxConnections(params.getUInt("max_connections"));
+    if (params.hasChild("backoff_min") || params.hasChild("backoff_max"))
+      output->setBackoff(
+        params.getUInt("backoff_min", SC_CONN_POOL_DEF_BACKOFF_MIN), 
+        params.getUInt("backoff_max", SC_CONN_POOL_DEF_BACKOFF_MAX));
+    if (params.hasChild("publish"))
+      output->setPublishAddress(params.getString("publish"));
+    if (params.hasChild("send_batch"))
+      output->setSendBatch(params.getUInt("send_batch"));
+  } else {
+    if (params.hasChild("subscribe"))
+      static_cast<zmGateInput *>(res.get())->setSubscribeAddress(params.getString("subscribe"));
+  }
+  
   return res.release();
 }
 
@@ -867,6 +867,7 @@ scEnvelope *scScheduler::createErrorResponseFor(const scEnvelope &srcEnvelope, c
   newEnvelope->setEvent(newResponse);  
   newEnvelope->setReceiver(srcEnvelope.getSender());
   newEnvelope->setSender(srcEnvelope.getReceiver());
+  newEnvelope->setPriority(srcEnvelope.getPriority());
   
   return newEnvelope;
 }
@@ -1202,6 +1203,9 @@ void scScheduler::postResponse(const scEnvelope &orgEnvelope, const scResponse &
    newEnvelope->setReceiver(orgEnvelope.getSender());
    newResponse->setRequestId(message->getRequestId());
    newEnvelope->setEvent(newResponse);
+   // explicit priority of request is used for response, auto priority is 
+   // not written to the wire
+   newEnvelope->setPriority(orgEnvelope.getPriority());
    
    scMessageTrace::addTrace("resp_rdy", newEnvelope->getSender().getAsString(), newEnvelope->getReceiver().getAsString(), message->getRequestId(), message->getCommand());
 
@@ -1554,6 +1558,8 @@ bool scScheduler::registerNodeAs(const scString &source, const scString &target,
       break;
     case scMessageAddress::AdrFmtRole:  
       entryHandle = m_registry.registerNodeForRole(trg, src.getRole(), features);
+      if (isOwnAddressSkipTask(trg))
+        notifyGatesRoleRegistered(src.getRole());
       break;
     case scMessageAddress::AdrFmtDefault:
       entryHandle = m_registry.registerNodeForName(trg, src.getNode(), features);
@@ -1763,6 +1769,59 @@ void scScheduler::getStats(int &taskCnt, int &moduleCnt, int &gateCnt)
   gateCnt = m_inputGates.size() + m_outputGates.size();
 }
 
+// informs input gates about new local role (for role-driven subscriptions)
+void scScheduler::notifyGatesRoleRegistered(const scString &roleName)
+{
+  for(scMessageGateColnIterator i=m_inputGates.begin(); i!=m_inputGates.end(); ++i)
+    (*i).handleRoleRegistered(roleName);
+}
+
+// returns list of statistics for gates that provide them
+void scScheduler::getGateStats(scDataNode &output)
+{
+  std::auto_ptr<scDataNode> gateGuard;
+
+  output.clear();
+  output.setAsList();
+
+  for(scMessageGateColnIterator i=m_inputGates.begin(); i!=m_inputGates.end(); ++i)
+  {
+    gateGuard.reset(new scDataNode());
+    (*i).getStats(*gateGuard);
+    if (!gateGuard->empty()) {
+      gateGuard->setElementSafe("direction", scDataNode(scString("input")));
+      output.addChild(gateGuard.release());
+    }  
+  }
+
+  for(scMessageGateColnIterator i=m_outputGates.begin(); i!=m_outputGates.end(); ++i)
+  {
+    gateGuard.reset(new scDataNode());
+    (*i).getStats(*gateGuard);
+    if (!gateGuard->empty()) {
+      gateGuard->setElementSafe("direction", scDataNode(scString("output")));
+      output.addChild(gateGuard.release());
+    }  
+  }
+}
+
+// returns list of statistics for modules that provide them
+void scScheduler::getModuleStats(scDataNode &output)
+{
+  std::auto_ptr<scDataNode> moduleGuard;
+
+  output.clear();
+  output.setAsList();
+
+  for(scModuleListIterator i=m_modules.begin(); i!=m_modules.end(); ++i)
+  {
+    moduleGuard.reset(new scDataNode());
+    (*i)->getStats(*moduleGuard);
+    if (!moduleGuard->empty())
+      output.addChild(moduleGuard.release());
+  }
+}
+
 // Resolve destination address and send message to this address
 // if not found - try to forward
 // if forward fails - error
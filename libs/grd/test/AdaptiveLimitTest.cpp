@@ -0,0 +1,154 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        AdaptiveLimitTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for grdAdaptiveLimit.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//grd
+#include "grd/AdaptiveLimit.h"
+
+#include "UnitTest.h"
+
+static void testStart()
+{
+  grdAdaptiveLimit limit;
+
+  limit.start(2, 8, 0);
+  GRD_CHECK_EQUAL(limit.getLimit(), 2U);
+  GRD_CHECK(limit.isSlowStart());
+
+  limit.start(2, 8, 100);
+  GRD_CHECK_EQUAL(limit.getLimit(), 8U);
+
+  // max below min
+  limit.start(0, 0, 5);
+  GRD_CHECK_EQUAL(limit.getMinLimit(), 1U);
+  GRD_CHECK_EQUAL(limit.getMaxLimit(), 1U);
+  GRD_CHECK_EQUAL(limit.getLimit(), 1U);
+}
+
+static void testSlowStart()
+{
+  grdAdaptiveLimit limit;
+  limit.start(1, 10, 1);
+
+  for(uint i = 2; i <= 10; i++) {
+    GRD_CHECK(!limit.handleSuccess(10));
+    GRD_CHECK_EQUAL(limit.getLimit(), i);
+  }
+
+  // max reached
+  limit.handleSuccess(10);
+  GRD_CHECK_EQUAL(limit.getLimit(), 10U);
+  GRD_CHECK(limit.isSlowStart());
+}
+
+// slow response: * 0.75, once per window, then +1 per window of responses
+static void testLatencyDecrease()
+{
+  grdAdaptiveLimit limit;
+  limit.start(1, 64, 8);
+
+  limit.handleSuccess(10);
+  GRD_CHECK_EQUAL(limit.getLimit(), 9U);
+  GRD_CHECK_EQUAL(limit.getBaseResponseTime(), 10U);
+
+  // 2 * 10 + 5 is still fast
+  GRD_CHECK(!limit.handleSuccess(25));
+  GRD_CHECK_EQUAL(limit.getLimit(), 10U);
+
+  GRD_CHECK(limit.handleSuccess(26));
+  GRD_CHECK_EQUAL(limit.getLimit(), 7U);
+  GRD_CHECK(!limit.isSlowStart());
+
+  // the same overload reported by other messages in flight
+  GRD_CHECK(!limit.handleSuccess(26));
+  GRD_CHECK_EQUAL(limit.getLimit(), 7U);
+
+  // additive increase
+  for(uint i = 0; i < 10; i++)
+    limit.handleSuccess(10);
+  GRD_CHECK_EQUAL(limit.getLimit(), 8U);
+}
+
+static void testOverload()
+{
+  grdAdaptiveLimit limit;
+  limit.start(2, 64, 16);
+
+  // first overload is handled at once
+  GRD_CHECK(limit.handleOverload());
+  GRD_CHECK_EQUAL(limit.getLimit(), 8U);
+  GRD_CHECK(!limit.handleOverload());
+  GRD_CHECK_EQUAL(limit.getLimit(), 8U);
+
+  for(uint i = 0; i < 20; i++)
+    limit.handleOverload();
+  GRD_CHECK_EQUAL(limit.getLimit(), 2U);
+}
+
+static void testFailure()
+{
+  grdAdaptiveLimit limit;
+  limit.start(1, 64, 4);
+
+  for(uint i = 0; i < 10; i++)
+    limit.handleFailure();
+  GRD_CHECK_EQUAL(limit.getLimit(), 4U);
+  GRD_CHECK(limit.isSlowStart());
+}
+
+// base follows slower target partially, lower value is used at once
+static void testBase()
+{
+  grdAdaptiveLimit limit;
+  limit.start(1, 64, 1);
+
+  limit.handleSuccess(10);
+  for(uint i = 1; i < GRD_SQUEUE_ADAPT_BASE_RESET; i++)
+    limit.handleSuccess(10);
+  GRD_CHECK_EQUAL(limit.getBaseResponseTime(), 10U);
+
+  for(uint i = 0; i < GRD_SQUEUE_ADAPT_BASE_RESET; i++)
+    limit.handleSuccess(50);
+  GRD_CHECK_EQUAL(limit.getBaseResponseTime(), 20U);
+
+  for(uint i = 0; i < 10 * GRD_SQUEUE_ADAPT_BASE_RESET; i++)
+    limit.handleSuccess(50);
+  GRD_CHECK(limit.getBaseResponseTime() > 40U);
+  GRD_CHECK(limit.getBaseResponseTime() <= 50U);
+
+  limit.handleSuccess(5);
+  GRD_CHECK_EQUAL(limit.getBaseResponseTime(), 5U);
+}
+
+// slow responses under load do not make limit grow to max
+static void testLoad()
+{
+  grdAdaptiveLimit limit;
+  limit.start(1, 64, 1);
+
+  for(uint i = 0; i < 10; i++)
+    limit.handleSuccess(10);
+
+  // response time grows with number of messages in flight
+  for(uint i = 0; i < 5 * GRD_SQUEUE_ADAPT_BASE_RESET; i++)
+    limit.handleSuccess(10 * limit.getLimit());
+
+  GRD_CHECK(limit.getLimit() < 64U);
+}
+
+void testAdaptiveLimit()
+{
+  testStart();
+  testSlowStart();
+  testLatencyDecrease();
+  testOverload();
+  testFailure();
+  testBase();
+  testLoad();
+}
@@ -0,0 +1,43 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        BoostMsgQueueGateTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for boost message queue gates.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//std
+#include <unistd.h>
+
+//sc
+#include "sc/utils.h"
+
+//grd
+#include "grd/BoostMsgQueueGate.h"
+
+#include "UnitTest.h"
+#include "GateTest.h"
+
+static void testRoundTrip(bool useThread)
+{
+  grdBmqGateFactory factory;
+  // unique per process, tests can run in parallel
+  scString name = "grd_test_" + toString(getpid());
+
+  scDataNode inputParams(ict_parent);
+  inputParams.addChild(new scDataNode(name));
+  inputParams.addChild("thread", new scDataNode(useThread));
+
+  // no address: connect to host of receiver
+  scDataNode outputParams(ict_parent);
+
+  grdTestRoundTrip(factory, "bmq", inputParams, outputParams, "bmq::#"+name+"/main");
+}
+
+void testBoostMsgQueueGate()
+{
+  testRoundTrip(false);
+  testRoundTrip(true);
+}
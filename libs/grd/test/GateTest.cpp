@@ -0,0 +1,75 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        GateTest.cpp
+// Project:     grdLib
+// Purpose:     Helpers for unit tests of transport gates.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//std
+#include <memory>
+
+//perf
+#include "perf/time_utils.h"
+
+//grd
+#include "grd/Envelope.h"
+#include "grd/Message.h"
+
+#include "UnitTest.h"
+#include "GateTest.h"
+
+using namespace perf;
+
+const uint GRD_TEST_GATE_TIMEOUT = 2000; // ms
+
+void grdTestPutCommand(scMessageGate &output, const scString &receiver, const scString &command)
+{
+  std::auto_ptr<scMessage> messageGuard(new scMessage());
+  messageGuard->setCommand(command);
+
+  std::auto_ptr<scEnvelope> envelope(new scEnvelope());
+  envelope->setSender(scMessageAddress("test_sender"));
+  envelope->setReceiver(scMessageAddress(receiver));
+  envelope->setEvent(messageGuard.release());
+  output.put(envelope.release());
+}
+
+void grdTestReceiveCommands(scMessageGate &output, scMessageGate &input, uint count,
+  std::vector<scString> &commands)
+{
+  cpu_ticks startTime = cpu_time_ms();
+  while((commands.size() < count) && !is_cpu_time_elapsed_ms(startTime, GRD_TEST_GATE_TIMEOUT))
+  {
+    output.run();
+    input.run();
+    while(!input.empty())
+    {
+      std::auto_ptr<scEnvelope> envelope(input.get());
+      commands.push_back(dynamic_cast<scMessage *>(envelope->getEvent())->getCommand());
+    }
+  }
+}
+
+void grdTestRoundTrip(const scGateFactory &factory, const scString &protocol,
+  const scDataNode &inputParams, const scDataNode &outputParams, const scString &receiver)
+{
+  std::auto_ptr<scMessageGate> input(factory.createGate(true, inputParams, protocol));
+  std::auto_ptr<scMessageGate> output(factory.createGate(false, outputParams, protocol));
+  input->init();
+  output->init();
+
+  grdTestPutCommand(*output, receiver, "test.first");
+  grdTestPutCommand(*output, receiver, "test.second");
+
+  std::vector<scString> commands;
+  grdTestReceiveCommands(*output, *input, 2, commands);
+
+  GRD_CHECK_EQUAL(commands.size(), size_t(2));
+  if (commands.size() == 2) {
+    GRD_CHECK(commands[0] == "test.first");
+    GRD_CHECK(commands[1] == "test.second");
+  }
+}
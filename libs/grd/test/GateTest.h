@@ -0,0 +1,49 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        GateTest.h
+// Project:     grdLib
+// Purpose:     Helpers for unit tests of transport gates.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GRDGATETEST_H__
+#define _GRDGATETEST_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file GateTest.h
+///
+/// Round trip through pair of gates created by the same factory: output 
+/// gate sends envelopes to address of input gate, both gates are run 
+/// in the test thread until all envelopes are received.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//std
+#include <vector>
+
+//sc
+#include "sc/dtypes.h"
+#include "sc/DataNode.h"
+
+//grd
+#include "grd/GateFactory.h"
+#include "grd/MessageGate.h"
+
+// ----------------------------------------------------------------------------
+// Function definitions
+// ----------------------------------------------------------------------------
+/// puts message <command> to output gate
+void grdTestPutCommand(scMessageGate &output, const scString &receiver, const scString &command);
+/// runs both gates until <count> envelopes are received or timeout passes
+void grdTestReceiveCommands(scMessageGate &output, scMessageGate &input, uint count,
+  std::vector<scString> &commands);
+/// sends two messages to <receiver> & checks they are received in order
+void grdTestRoundTrip(const scGateFactory &factory, const scString &protocol,
+  const scDataNode &inputParams, const scDataNode &outputParams, const scString &receiver);
+
+#endif // _GRDGATETEST_H__
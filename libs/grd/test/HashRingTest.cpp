@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        HashRingTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for grdHashRing.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//std
+#include <map>
+
+//sc
+#include "sc/utils.h"
+
+//grd
+#include "grd/HashRing.h"
+
+#include "UnitTest.h"
+
+const uint GRD_TEST_RING_KEYS = 1000;
+
+static void testHash()
+{
+  // FNV-1a reference values
+  GRD_CHECK_EQUAL(grdHashRing::calcHash(""), 2166136261U);
+  GRD_CHECK_EQUAL(grdHashRing::calcHash("a"), 0xe40c292cU);
+  GRD_CHECK_EQUAL(grdHashRing::calcHash("foobar"), 0xbf9cf968U);
+}
+
+static void testEmpty()
+{
+  grdHashRing ring;
+  grdHashRingNodeSet skip;
+  skip.insert("a");
+
+  GRD_CHECK(ring.empty());
+  GRD_CHECK(ring.findOwner("key").empty());
+  GRD_CHECK(ring.findOwner("key", skip).empty());
+}
+
+static void testOwner()
+{
+  grdHashRing ring(10);
+  ring.addNode("a");
+  ring.addNode("b");
+  ring.addNode("c");
+
+  GRD_CHECK(!ring.empty());
+  GRD_CHECK(ring.size() <= 30);
+
+  std::map<scString, uint> counts;
+  for(uint i = 0; i < GRD_TEST_RING_KEYS; i++) {
+    scString key = "key" + toString(i);
+    scString owner = ring.findOwner(key);
+    // the same key - the same owner
+    GRD_CHECK_EQUAL(owner, ring.findOwner(key));
+    counts[owner]++;
+  }
+
+  // all nodes own some keys
+  GRD_CHECK_EQUAL(counts.size(), 3U);
+}
+
+// adding a node moves keys only to this node
+static void testAddNode()
+{
+  grdHashRing before, after;
+  before.addNode("a");
+  before.addNode("b");
+  after.addNode("a");
+  after.addNode("b");
+  after.addNode("c");
+
+  uint moved = 0;
+  for(uint i = 0; i < GRD_TEST_RING_KEYS; i++) {
+    scString key = "key" + toString(i);
+    scString oldOwner = before.findOwner(key);
+    scString newOwner = after.findOwner(key);
+    if (oldOwner != newOwner) {
+      GRD_CHECK_EQUAL(newOwner, scString("c"));
+      moved++;
+    }
+  }
+
+  GRD_CHECK(moved > 0);
+  GRD_CHECK(moved < GRD_TEST_RING_KEYS);
+}
+
+static void testSkip()
+{
+  grdHashRing ring;
+  ring.addNode("a");
+  ring.addNode("b");
+
+  grdHashRingNodeSet skip;
+  for(uint i = 0; i < GRD_TEST_RING_KEYS; i++) {
+    scString key = "key" + toString(i);
+    scString owner = ring.findOwner(key);
+    skip.clear();
+    GRD_CHECK_EQUAL(ring.findOwner(key, skip), owner);
+    skip.insert(owner);
+    GRD_CHECK(ring.findOwner(key, skip) != owner);
+    // all skipped - owner is used
+    skip.insert("a");
+    skip.insert("b");
+    GRD_CHECK_EQUAL(ring.findOwner(key, skip), owner);
+  }
+}
+
+static void testClear()
+{
+  grdHashRing ring;
+  ring.addNode("a");
+  ring.clear();
+  GRD_CHECK(ring.empty());
+  GRD_CHECK(ring.findOwner("key").empty());
+  ring.addNode("b");
+  GRD_CHECK_EQUAL(ring.findOwner("key"), scString("b"));
+}
+
+void testHashRing()
+{
+  testHash();
+  testEmpty();
+  testOwner();
+  testAddNode();
+  testSkip();
+  testClear();
+}
@@ -0,0 +1,78 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        LatencyHistogramTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for grdLatencyHistogram.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//grd
+#include "grd/LatencyHistogram.h"
+
+#include "UnitTest.h"
+
+static void testEmpty()
+{
+  grdLatencyHistogram hist;
+  GRD_CHECK_EQUAL(hist.getCount(), 0U);
+  GRD_CHECK_EQUAL(hist.getMax(), 0U);
+  GRD_CHECK(hist.getAvg() == 0.0);
+  GRD_CHECK_EQUAL(hist.getPercentile(50.0), 0U);
+}
+
+// buckets: 0 -> le 0, 1 -> le 1, 2..3 -> le 3, 100 -> le 127
+static void testPercentiles()
+{
+  grdLatencyHistogram hist;
+  hist.add(0);
+  hist.add(1);
+  hist.add(2);
+  hist.add(3);
+  hist.add(100);
+
+  GRD_CHECK_EQUAL(hist.getCount(), 5U);
+  GRD_CHECK_EQUAL(hist.getMax(), 100U);
+  GRD_CHECK(hist.getAvg() > 21.19 && hist.getAvg() < 21.21);
+  GRD_CHECK_EQUAL(hist.getPercentile(0.0), 0U);
+  GRD_CHECK_EQUAL(hist.getPercentile(50.0), 1U);
+  GRD_CHECK_EQUAL(hist.getPercentile(80.0), 3U);
+  // limit of last used bucket (127) is above max
+  GRD_CHECK_EQUAL(hist.getPercentile(100.0), 100U);
+}
+
+static void testBigValue()
+{
+  grdLatencyHistogram hist;
+  cpu_ticks big = static_cast<cpu_ticks>(1) << 40;
+  hist.add(big);
+  GRD_CHECK_EQUAL(hist.getMax(), big);
+  GRD_CHECK_EQUAL(hist.getPercentile(99.0), big);
+}
+
+static void testMerge()
+{
+  grdLatencyHistogram a, b;
+  a.add(1);
+  a.add(10);
+  b.add(1000);
+
+  a.add(b);
+  GRD_CHECK_EQUAL(a.getCount(), 3U);
+  GRD_CHECK_EQUAL(a.getMax(), 1000U);
+  GRD_CHECK(a.getAvg() == 337.0);
+
+  a.clear();
+  GRD_CHECK_EQUAL(a.getCount(), 0U);
+  GRD_CHECK_EQUAL(a.getMax(), 0U);
+  GRD_CHECK_EQUAL(b.getCount(), 1U);
+}
+
+void testLatencyHistogram()
+{
+  testEmpty();
+  testPercentiles();
+  testBigValue();
+  testMerge();
+}
@@ -0,0 +1,111 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        MessageGateTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for priority lanes of message gate.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//std
+#include <memory>
+#include <vector>
+
+//grd
+#include "grd/MessageGate.h"
+#include "grd/Envelope.h"
+#include "grd/Message.h"
+
+#include "UnitTest.h"
+
+// gate without transport, only lanes are used
+class grdTestLaneGate: public scMessageGate {
+public:
+  virtual bool supportsProtocol(const scString &protocol) { return false; }
+  virtual int run() { return 0; }
+};
+
+static void putMessage(scMessageGate &gate, const scString &sender, const scString &command,
+  uint priority = SC_ENV_PRIORITY_AUTO)
+{
+  std::auto_ptr<scMessage> messageGuard(new scMessage());
+  messageGuard->setCommand(command);
+
+  std::auto_ptr<scEnvelope> envelope(new scEnvelope());
+  envelope->setSender(scMessageAddress(sender));
+  envelope->setReceiver(scMessageAddress("bmq::receiver"));
+  envelope->setPriority(priority);
+  envelope->setEvent(messageGuard.release());
+  gate.put(envelope.release());
+}
+
+static void takeCommands(scMessageGate &gate, std::vector<scString> &output)
+{
+  while(!gate.empty())
+  {
+    std::auto_ptr<scEnvelope> envelope(gate.get());
+    output.push_back(dynamic_cast<scMessage *>(envelope->getEvent())->getCommand());
+  }
+}
+
+// control message of other peer is taken before waiting bulk messages
+static void testControlOfOtherPeer()
+{
+  grdTestLaneGate gate;
+  std::vector<scString> commands;
+
+  putMessage(gate, "bmq::bulk_sender", "job.commit");
+  putMessage(gate, "bmq::bulk_sender", "job.commit");
+  putMessage(gate, "bmq::other_sender", "squeue.mark_alive");
+  takeCommands(gate, commands);
+
+  GRD_CHECK_EQUAL(commands.size(), size_t(3));
+  if (commands.size() == 3)
+    GRD_CHECK(commands[0] == "squeue.mark_alive");
+}
+
+// control lane by command does not overtake earlier message of the same pair
+static void testSamePeerOrder()
+{
+  grdTestLaneGate gate;
+  std::vector<scString> commands;
+
+  putMessage(gate, "bmq::sender", "job.commit");
+  putMessage(gate, "bmq::sender", "squeue.mark_alive");
+  takeCommands(gate, commands);
+
+  GRD_CHECK_EQUAL(commands.size(), size_t(2));
+  if (commands.size() == 2) {
+    GRD_CHECK(commands[0] == "job.commit");
+    GRD_CHECK(commands[1] == "squeue.mark_alive");
+  }
+}
+
+// explicit control priority overtakes bulk of the same pair
+static void testExplicitControlOvertakesBulk()
+{
+  grdTestLaneGate gate;
+  std::vector<scString> commands;
+
+  putMessage(gate, "bmq::sender", "job.commit");
+  putMessage(gate, "bmq::sender", "job.set_vars");
+  putMessage(gate, "bmq::sender", "job.stop", SC_ENV_PRIORITY_CONTROL);
+  putMessage(gate, "bmq::sender", "job.commit");
+  takeCommands(gate, commands);
+
+  GRD_CHECK_EQUAL(commands.size(), size_t(4));
+  if (commands.size() == 4) {
+    GRD_CHECK(commands[0] == "job.stop");
+    GRD_CHECK(commands[1] == "job.commit");
+    GRD_CHECK(commands[2] == "job.set_vars");
+    GRD_CHECK(commands[3] == "job.commit");
+  }
+}
+
+void testMessageGate()
+{
+  testControlOfOtherPeer();
+  testSamePeerOrder();
+  testExplicitControlOvertakesBulk();
+}
@@ -0,0 +1,83 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        PeerDownStateTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for grdPeerDownState.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//grd
+#include "grd/PeerDownState.h"
+#include "grd/Event.h"
+
+#include "UnitTest.h"
+
+const cpu_ticks GRD_TEST_PEER_GRACE = 5000;
+const cpu_ticks GRD_TEST_PEER_PROBE = 1000;
+
+static void testInitial()
+{
+  grdPeerDownState state(GRD_TEST_PEER_GRACE, GRD_TEST_PEER_PROBE);
+
+  GRD_CHECK(!state.isDown());
+  GRD_CHECK(!state.isExpired(100000));
+  GRD_CHECK(!state.isProbeDue(100000));
+  GRD_CHECK(!state.handleProbeResponse(SC_REQUEST_ID_NULL));
+}
+
+// first probe at once, next after interval
+static void testProbeSchedule()
+{
+  grdPeerDownState state(GRD_TEST_PEER_GRACE, GRD_TEST_PEER_PROBE);
+
+  state.notePeerDown(1000);
+  GRD_CHECK(state.isDown());
+  GRD_CHECK(state.isProbeDue(1000));
+
+  state.noteProbeSent(7, 1000);
+  GRD_CHECK_EQUAL(state.getProbeRequestId(), 7);
+  GRD_CHECK(!state.isProbeDue(1500));
+  GRD_CHECK(state.isProbeDue(2000));
+
+  // repeated peer_down keeps first time
+  state.notePeerDown(3000);
+  GRD_CHECK(!state.isExpired(5999));
+  GRD_CHECK(state.isExpired(6000));
+}
+
+// peer reconnects within grace period: probe response resumes reader
+static void testReconnect()
+{
+  grdPeerDownState state(GRD_TEST_PEER_GRACE, GRD_TEST_PEER_PROBE);
+
+  state.notePeerDown(1000);
+  state.noteProbeSent(7, 1000);
+  state.noteProbeSent(8, 2000);
+
+  // response of older probe is not tracked
+  GRD_CHECK(!state.handleProbeResponse(7));
+  GRD_CHECK(state.handleProbeResponse(8));
+  GRD_CHECK(!state.handleProbeResponse(8));
+  GRD_CHECK(state.isDown());
+
+  state.noteContact();
+  GRD_CHECK(!state.isDown());
+  GRD_CHECK(!state.isExpired(100000));
+  GRD_CHECK(!state.isProbeDue(100000));
+  GRD_CHECK_EQUAL(state.getProbeRequestId(), SC_REQUEST_ID_NULL);
+
+  // next loss starts new grace period & probing
+  state.notePeerDown(50000);
+  GRD_CHECK(state.isProbeDue(50000));
+  GRD_CHECK(!state.isExpired(54999));
+  GRD_CHECK(state.isExpired(55000));
+}
+
+void testPeerDownState()
+{
+  testInitial();
+  testProbeSchedule();
+  testReconnect();
+}
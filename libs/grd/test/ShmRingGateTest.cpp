@@ -0,0 +1,88 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        ShmRingGateTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for shared memory gates.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//std
+#include <unistd.h>
+#include <memory>
+
+//sc
+#include "sc/utils.h"
+
+//grd
+#include "grd/ShmRingGate.h"
+
+#include "UnitTest.h"
+#include "GateTest.h"
+
+// unique per process, tests can run in parallel
+static scString getTestSegmentName()
+{
+  return "grd_test_" + toString(getpid());
+}
+
+static void testRoundTrip(const scString &format, bool useThread)
+{
+  grdShmGateFactory factory;
+  scString name = getTestSegmentName();
+
+  scDataNode inputParams(ict_parent);
+  inputParams.addChild(new scDataNode(name));
+  inputParams.addChild("rings", new scDataNode(2U));
+  inputParams.addChild("ring_size", new scDataNode(65536U));
+  inputParams.addChild("thread", new scDataNode(useThread));
+
+  scDataNode outputParams(ict_parent);
+  // empty address: connect to host of receiver
+  outputParams.addChild(new scDataNode(scString()));
+  outputParams.addChild("format", new scDataNode(format));
+
+  grdTestRoundTrip(factory, "shm", inputParams, outputParams, "shm::#"+name+"/main");
+}
+
+// segment of running receiver is not taken over, it is free after close
+static void testExclusiveSegment()
+{
+  grdShmGateFactory factory;
+
+  scDataNode params(ict_parent);
+  params.addChild(new scDataNode(getTestSegmentName()));
+
+  std::auto_ptr<scMessageGate> first(factory.createGate(true, params, "shm"));
+  first->init();
+
+  std::auto_ptr<scMessageGate> second(factory.createGate(true, params, "shm"));
+  bool failed = false;
+  try {
+    second->init();
+  }
+  catch(const scError &e) {
+    failed = true;
+  }
+  GRD_CHECK(failed);
+
+  first.reset();
+  second.reset(factory.createGate(true, params, "shm"));
+  failed = false;
+  try {
+    second->init();
+  }
+  catch(const scError &e) {
+    failed = true;
+  }
+  GRD_CHECK(!failed);
+}
+
+void testShmRingGate()
+{
+  testRoundTrip("bin", false);
+  testRoundTrip("json", false);
+  testRoundTrip("bin", true);
+  testExclusiveSegment();
+}
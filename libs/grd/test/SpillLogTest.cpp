@@ -0,0 +1,177 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        SpillLogTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for grdSpillLog.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//boost
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+//sc
+#include "sc/utils.h"
+
+//grd
+#include "grd/SpillLog.h"
+#include "grd/Message.h"
+
+#include "UnitTest.h"
+
+// segment files are created in own temporary directory, removed with 
+// its content when suite ends
+class grdTestSpillDir {
+public:
+  grdTestSpillDir() {
+    m_path = boost::filesystem::temp_directory_path() / 
+      boost::filesystem::unique_path("grd-spill-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(m_path);
+  }
+  ~grdTestSpillDir() {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(m_path, ec);
+  }
+  scString getSpillPath() const {
+    return (m_path / "spill").string();
+  }
+protected:
+  boost::filesystem::path m_path;
+};
+
+static void pushMessage(grdSpillLog &log, int requestId, size_t payloadSize)
+{
+  scDataNode params(ict_parent);
+  params.addChild("data", new scDataNode(scString(payloadSize, 'x')));
+  log.push(scEnvelope(scMessageAddress("@test"), scMessageAddress("@queue"), 
+    new scMessage("test.spill", &params, requestId)));
+}
+
+static bool segmentExists(const grdSpillLog &log, uint seqNo)
+{
+  return boost::filesystem::exists(boost::filesystem::path(
+    (log.getBasePath()+"."+toString(seqNo)+".seg").c_str()));
+}
+
+static void testOrder(const scString &spillPath)
+{
+  grdSpillLog log(spillPath, GRD_SPILL_MIN_SEGMENT_SIZE);
+  scEnvelope envelope;
+
+  GRD_CHECK(log.empty());
+  GRD_CHECK(!log.pop(envelope));
+
+  for(int i=1; i <= 3; i++)
+    pushMessage(log, i, 10);
+  GRD_CHECK_EQUAL(log.size(), 3U);
+  GRD_CHECK_EQUAL(log.getSegmentCount(), 1U);
+
+  for(int i=1; i <= 3; i++) {
+    GRD_CHECK(log.pop(envelope));
+    GRD_CHECK_EQUAL(envelope.getEvent()->getRequestId(), i);
+    GRD_CHECK_EQUAL(dynamic_cast<scMessage *>(envelope.getEvent())->getCommand(), scString("test.spill"));
+  }
+
+  GRD_CHECK(log.empty());
+  GRD_CHECK(!log.pop(envelope));
+}
+
+// records bigger than segment get own segment, read segments are deleted
+static void testSegments(const scString &spillPath)
+{
+  const uint count = 10;
+  const size_t payloadSize = GRD_SPILL_MIN_SEGMENT_SIZE / 4;
+  grdSpillLog log(spillPath, GRD_SPILL_MIN_SEGMENT_SIZE);
+  scEnvelope envelope;
+
+  for(uint i=1; i <= count; i++)
+    pushMessage(log, i, payloadSize);
+  pushMessage(log, count + 1, GRD_SPILL_MIN_SEGMENT_SIZE * 2);
+
+  GRD_CHECK_EQUAL(log.size(), count + 1);
+  GRD_CHECK(log.getSegmentCount() > 2);
+  GRD_CHECK(segmentExists(log, 1));
+
+  for(uint i=1; i <= count + 1; i++) {
+    GRD_CHECK(log.pop(envelope));
+    GRD_CHECK_EQUAL(envelope.getEvent()->getRequestId(), static_cast<int>(i));
+  }
+
+  GRD_CHECK(log.empty());
+  GRD_CHECK(!segmentExists(log, 1));
+  GRD_CHECK(log.getSegmentCount() <= 1);
+}
+
+// push after all records were read reuses last segment
+static void testReuse(const scString &spillPath)
+{
+  grdSpillLog log(spillPath, GRD_SPILL_MIN_SEGMENT_SIZE);
+  scEnvelope envelope;
+
+  for(int round = 0; round < 100; round++) {
+    pushMessage(log, round + 1, 1000);
+    GRD_CHECK(log.pop(envelope));
+    GRD_CHECK_EQUAL(envelope.getEvent()->getRequestId(), round + 1);
+  }
+
+  GRD_CHECK_EQUAL(log.getSegmentCount(), 1U);
+}
+
+// queue bookkeeping is read back with envelope
+static void testRecordInfo(const scString &spillPath)
+{
+  grdSpillLog log(spillPath, GRD_SPILL_MIN_SEGMENT_SIZE);
+  scEnvelope envelope;
+  grdSpillRecordInfo info;
+
+  info.enqueueTime = 0x123456789ULL;
+  info.startTime = 1000;
+  info.retryCount = 3;
+  log.push(scEnvelope(scMessageAddress("@test"), scMessageAddress("@queue"), 
+    new scMessage("test.spill", SC_NULL, 1)), info);
+  pushMessage(log, 2, 10);
+
+  grdSpillRecordInfo output;
+  GRD_CHECK(log.pop(envelope, output));
+  GRD_CHECK_EQUAL(envelope.getEvent()->getRequestId(), 1);
+  GRD_CHECK(output.enqueueTime == info.enqueueTime);
+  GRD_CHECK(output.startTime == info.startTime);
+  GRD_CHECK_EQUAL(output.retryCount, 3U);
+
+  GRD_CHECK(log.pop(envelope, output));
+  GRD_CHECK_EQUAL(envelope.getEvent()->getRequestId(), 2);
+  GRD_CHECK(output.enqueueTime == 0);
+  GRD_CHECK_EQUAL(output.retryCount, 0U);
+}
+
+static void testClear(const scString &spillPath)
+{
+  grdSpillLog log(spillPath, GRD_SPILL_MIN_SEGMENT_SIZE);
+  scEnvelope envelope;
+
+  pushMessage(log, 1, 10);
+  GRD_CHECK(segmentExists(log, 1));
+
+  log.clear();
+  GRD_CHECK(log.empty());
+  GRD_CHECK(!log.pop(envelope));
+  GRD_CHECK(!segmentExists(log, 1));
+
+  pushMessage(log, 2, 10);
+  GRD_CHECK(log.pop(envelope));
+  GRD_CHECK_EQUAL(envelope.getEvent()->getRequestId(), 2);
+}
+
+void testSpillLog()
+{
+  grdTestSpillDir dir;
+  scString spillPath = dir.getSpillPath();
+
+  testOrder(spillPath);
+  testSegments(spillPath);
+  testReuse(spillPath);
+  testRecordInfo(spillPath);
+  testClear(spillPath);
+}
@@ -0,0 +1,39 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        TcpRawGateTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for raw TCP gates.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//grd
+#include "grd/TcpRawGate.h"
+
+#include "UnitTest.h"
+#include "GateTest.h"
+
+const scString GRD_TEST_TCPX_PORT = "15792";
+
+static void testRoundTrip(const scString &format)
+{
+  grdTcpxGateFactory factory;
+
+  scDataNode inputParams(ict_parent);
+  inputParams.addChild(new scDataNode("127.0.0.1:"+GRD_TEST_TCPX_PORT));
+
+  scDataNode outputParams(ict_parent);
+  // empty address: connect to host of receiver
+  outputParams.addChild(new scDataNode(scString()));
+  outputParams.addChild("format", new scDataNode(format));
+
+  grdTestRoundTrip(factory, "tcpx", inputParams, outputParams, 
+    "tcpx::#127.0.0.1-"+GRD_TEST_TCPX_PORT+"/main");
+}
+
+void testTcpRawGate()
+{
+  testRoundTrip("bin");
+  testRoundTrip("json");
+}
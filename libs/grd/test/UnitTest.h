@@ -0,0 +1,56 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        UnitTest.h
+// Project:     grdLib
+// Purpose:     Minimal checks for unit tests of grd components.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GRDUNITTEST_H__
+#define _GRDUNITTEST_H__
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file UnitTest.h
+///
+/// Tests are plain functions registered in UnitTestMain.cpp. Failed check
+/// is reported with file & line, remaining checks are still executed.
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//sc
+#include "sc/dtypes.h"
+
+// ----------------------------------------------------------------------------
+// Class definitions
+// ----------------------------------------------------------------------------
+class grdUnitTest {
+public:
+  static void check(bool value, const char *expr, const char *file, int line);
+  static uint getCheckCount();
+  static uint getFailCount();
+};
+
+#define GRD_CHECK(expr) grdUnitTest::check((expr), #expr, __FILE__, __LINE__)
+#define GRD_CHECK_EQUAL(a, b) grdUnitTest::check(((a) == (b)), #a " == " #b, __FILE__, __LINE__)
+
+// ----------------------------------------------------------------------------
+// Test suites
+// ----------------------------------------------------------------------------
+void testLatencyHistogram();
+void testSpillLog();
+void testHashRing();
+void testAdaptiveLimit();
+void testZeroMQGate();
+void testMessageGate();
+void testPeerDownState();
+void testShmRingGate();
+void testUnixSocketGate();
+void testTcpRawGate();
+void testBoostMsgQueueGate();
+
+#endif // _GRDUNITTEST_H__
@@ -0,0 +1,88 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        UnitTestMain.cpp
+// Project:     grdLib
+// Purpose:     Command line runner for unit tests of grd components.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+// Build (from libs/grd, no project files are provided - link with the same 
+// libraries as application using grd):
+//   g++ -Iinclude -Itest -I<sc, perf, dtp include dirs> test/*.cpp 
+//     <grd sources or library> -l<sc, perf, dtp libraries> -lzmq 
+//     -lboost_filesystem -lboost_system -lboost_thread -lrt -lpthread 
+//     -o grd_unit_test
+// Usage:
+//   grd_unit_test
+// Returns 0 when all checks passed, 1 otherwise.
+// Gate suites use 127.0.0.1 ports 15791-15792 and shared memory, socket & 
+// message queue names with pid of test process, spill files are written to
+// temporary directory.
+
+#include <iostream>
+
+#include "UnitTest.h"
+
+static uint g_checkCount = 0;
+static uint g_failCount = 0;
+
+void grdUnitTest::check(bool value, const char *expr, const char *file, int line)
+{
+  g_checkCount++;
+  if (!value) {
+    g_failCount++;
+    std::cerr << file << "(" << line << "): check failed: " << expr << std::endl;
+  }
+}
+
+uint grdUnitTest::getCheckCount()
+{
+  return g_checkCount;
+}
+
+uint grdUnitTest::getFailCount()
+{
+  return g_failCount;
+}
+
+typedef void (*grdUnitTestFunc)();
+
+struct grdUnitTestSuite {
+  const char *name;
+  grdUnitTestFunc func;
+};
+
+static const grdUnitTestSuite g_suites[] = {
+  {"LatencyHistogram", testLatencyHistogram},
+  {"SpillLog", testSpillLog},
+  {"HashRing", testHashRing},
+  {"AdaptiveLimit", testAdaptiveLimit},
+  {"ZeroMQGate", testZeroMQGate},
+  {"MessageGate", testMessageGate},
+  {"PeerDownState", testPeerDownState},
+  {"ShmRingGate", testShmRingGate},
+  {"UnixSocketGate", testUnixSocketGate},
+  {"TcpRawGate", testTcpRawGate},
+  {"BoostMsgQueueGate", testBoostMsgQueueGate}
+};
+
+int main(int argc, char* argv[])
+{
+  for(uint i=0; i < sizeof(g_suites) / sizeof(g_suites[0]); i++)
+  {
+    std::cout << "Running: " << g_suites[i].name << std::endl;
+    try {
+      g_suites[i].func();
+    }
+    catch(const std::exception &e) {
+      grdUnitTest::check(false, e.what(), g_suites[i].name, 0);
+    }
+  }
+
+  std::cout << "Checks: " << grdUnitTest::getCheckCount() 
+    << ", failed: " << grdUnitTest::getFailCount() << std::endl;
+
+  return (grdUnitTest::getFailCount() > 0)?1:0;
+}
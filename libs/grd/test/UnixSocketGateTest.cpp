@@ -0,0 +1,44 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        UnixSocketGateTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for unix domain socket gates.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//std
+#include <unistd.h>
+
+//sc
+#include "sc/utils.h"
+
+//grd
+#include "grd/UnixSocketGate.h"
+
+#include "UnitTest.h"
+#include "GateTest.h"
+
+static void testRoundTrip(const scString &format)
+{
+  grdUdsGateFactory factory;
+  // abstract socket name, unique per process
+  scString name = "grd_test_" + toString(getpid());
+
+  scDataNode inputParams(ict_parent);
+  inputParams.addChild(new scDataNode(name));
+
+  scDataNode outputParams(ict_parent);
+  // empty address: connect to host of receiver
+  outputParams.addChild(new scDataNode(scString()));
+  outputParams.addChild("format", new scDataNode(format));
+
+  grdTestRoundTrip(factory, "uds", inputParams, outputParams, "uds::#"+name+"/main");
+}
+
+void testUnixSocketGate()
+{
+  testRoundTrip("bin");
+  testRoundTrip("json");
+}
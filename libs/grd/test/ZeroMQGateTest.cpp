@@ -0,0 +1,112 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        ZeroMQGateTest.cpp
+// Project:     grdLib
+// Purpose:     Unit tests for 0MQ input gate.
+// Author:      Piotr Likus
+// Modified by:
+// Created:     18/10/2026
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+//std
+#include <string.h>
+#include <memory>
+#include <vector>
+
+//zmq
+#include "zmq.hpp"
+
+//sc
+#include "sc/utils.h"
+
+//perf
+#include "perf/time_utils.h"
+
+//grd
+#include "grd/ZeroMQGates.h"
+#include "grd/MessageGate.h"
+#include "grd/Envelope.h"
+#include "grd/Message.h"
+#include "grd/EnvSerializerJsonYajl.h"
+
+#include "UnitTest.h"
+
+using namespace perf;
+
+const scString GRD_TEST_ZMQ_ADDRESS = "tcp://127.0.0.1:15791";
+const uint GRD_TEST_ZMQ_TIMEOUT = 2000; // ms
+
+static scString encodeTestMessage(const scString &command)
+{
+  scEnvelope envelope;
+  std::auto_ptr<scMessage> messageGuard(new scMessage());
+  messageGuard->setCommand(command);
+  envelope.setEvent(messageGuard.release());
+
+  scString res;
+  scEnvSerializerJsonYajl serializer;
+  serializer.convToString(envelope, res);
+  return res;
+}
+
+static void sendPart(zmq::socket_t &socket, const scString &data, bool more)
+{
+  zmq::message_t msg(data.length());
+  if (!data.empty())
+    memcpy(msg.data(), data.c_str(), data.length());
+  socket.send(msg, more?ZMQ_SNDMORE:0);
+}
+
+// runs gate until <count> envelopes are received or timeout passes
+static void receiveCommands(scMessageGate &gate, uint count, std::vector<scString> &output)
+{
+  cpu_ticks startTime = cpu_time_ms();
+  while((output.size() < count) && !is_cpu_time_elapsed_ms(startTime, GRD_TEST_ZMQ_TIMEOUT))
+  {
+    gate.run();
+    while(!gate.empty())
+    {
+      std::auto_ptr<scEnvelope> envelope(gate.get());
+      output.push_back(dynamic_cast<scMessage *>(envelope->getEvent())->getCommand());
+    }
+  }
+}
+
+// corrupt part of multipart message is dropped, next parts of the same
+// message and next messages are decoded
+static void testCorruptFrame()
+{
+  std::auto_ptr<zmContextBase> context(zmContextBase::newContext());
+  zmGateFactoryForTcp factory(context.get());
+
+  scDataNode params(ict_parent);
+  params.addChild(new scDataNode(GRD_TEST_ZMQ_ADDRESS));
+  params.addChild("mode", new scDataNode(scString("async")));
+  params.addChild("format", new scDataNode(scString("json")));
+
+  std::auto_ptr<scMessageGate> gate(factory.createGate(true, params, "tcp"));
+  gate->init();
+
+  zmq::context_t peerContext(1);
+  zmq::socket_t peer(peerContext, ZMQ_DEALER);
+  peer.connect(GRD_TEST_ZMQ_ADDRESS.c_str());
+
+  // DEALER -> ROUTER: [(identity)][payload][payload]...
+  sendPart(peer, "{\"corrupt", true);
+  sendPart(peer, encodeTestMessage("test.first"), false);
+  sendPart(peer, encodeTestMessage("test.second"), false);
+
+  std::vector<scString> commands;
+  receiveCommands(*gate, 2, commands);
+
+  GRD_CHECK_EQUAL(commands.size(), size_t(2));
+  if (commands.size() == 2) {
+    GRD_CHECK(commands[0] == "test.first");
+    GRD_CHECK(commands[1] == "test.second");
+  }
+}
+
+void testZeroMQGate()
+{
+  testCorruptFrame();
+}